@@ -9,12 +9,24 @@ SOURCES += \
     UnQLite/unqlite.c \
     qunqlite.cpp \
     main.cpp \
-    qunqlitecursor.cpp
+    qunqlitecursor.cpp \
+    qunqlitekey.cpp \
+    qunqlitesnapshot.cpp \
+    qunqlitestatement.cpp \
+    qunqlitecollectioncursor.cpp \
+    qunqlitepool.cpp
 
 HEADERS  += \
     UnQLite/unqlite.h \
     qunqlite.h \
     qunqlitecursor.h \
+    qunqlitekey.h \
+    qunqlitesnapshot.h \
+    qunqlitestatement.h \
+    qunqlitecollectioncursor.h \
+    qunqlitepool.h \
     dpointer.h
 
 CONFIG += c++11
+
+DEFINES += UNQLITE_ENABLE_THREADS
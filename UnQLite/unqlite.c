@@ -172,6 +172,10 @@ typedef struct jx9_value unqlite_value;
 typedef struct unqlite_vfs unqlite_vfs;
 typedef struct unqlite_vm unqlite_vm;
 typedef struct unqlite unqlite;
+typedef struct unqlite_pager_stats unqlite_pager_stats;
+typedef struct unqlite_mem_stats unqlite_mem_stats;
+typedef struct unqlite_record_cache_stats unqlite_record_cache_stats;
+typedef struct unqlite_snapshot unqlite_snapshot;
 /*
  * ------------------------------
  * Compile time directives
@@ -464,6 +468,79 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_CONFIG_KV_ENGINE           4  /* ONE ARGUMENT: const char *zKvName */
 #define UNQLITE_CONFIG_DISABLE_AUTO_COMMIT 5  /* NO ARGUMENTS */
 #define UNQLITE_CONFIG_GET_KV_NAME         6  /* ONE ARGUMENT: const char **pzPtr */
+#define UNQLITE_CONFIG_WAL_AUTOCHECKPOINT  7  /* ONE ARGUMENT: int nFrame */
+#define UNQLITE_CONFIG_WAL_CHECKPOINT      8  /* NO ARGUMENTS */
+#define UNQLITE_CONFIG_COMMIT_WINDOW       9  /* ONE ARGUMENT: int nMicroSec */
+#define UNQLITE_CONFIG_PAGER_STATS        10  /* TWO ARGUMENTS: unqlite_pager_stats *pStats, int bReset */
+#define UNQLITE_CONFIG_WRITE_BACK         11  /* TWO ARGUMENTS: int nMinPage, int *pnPage */
+#define UNQLITE_CONFIG_IN_WRITE_TRANSACTION 12 /* ONE ARGUMENT: int *pbOpen */
+#define UNQLITE_CONFIG_BEGIN_NEW          13  /* NO ARGUMENTS */
+/*
+ * Background write-back.
+ *
+ * Dirty pages are normally written to the database file by the thread committing
+ * the transaction. When invoked periodically from a background thread (multi-thread
+ * mode) with the UNQLITE_CONFIG_WRITE_BACK verb, [unqlite_config()] writes the unused
+ * dirty pages of the active transaction (sorted by page number) once at least nMinPage
+ * of them accumulated, so that the commit only has to write the residue. In write-ahead
+ * log mode, it checkpoints the log instead once it holds at least nMinPage frames and
+ * no write transaction is active. The number of pages written is stored in *pnPage
+ * (may be NULL). This is never an error to find nothing to write or a busy log.
+ */
+/*
+ * Write transaction state.
+ *
+ * When invoked with the UNQLITE_CONFIG_IN_WRITE_TRANSACTION verb, [unqlite_config()]
+ * stores a non-zero value in *pbOpen if a write transaction is open on the handle,
+ * zero otherwise. A handle opened with UNQLITE_OPEN_SHARED_CACHE releases its read
+ * lock when [unqlite_rollback()] is called outside of a write transaction, so that
+ * the other handles opened on the same file can commit.
+ * The UNQLITE_CONFIG_BEGIN_NEW verb opens a write transaction like [unqlite_begin()]
+ * but fails with UNQLITE_LOCKED instead of joining a write transaction already open,
+ * so that a caller sharing the handle never commits changes it did not make.
+ * In-memory databases have no write transaction.
+ */
+/*
+ * Pager statistics.
+ *
+ * An instance of the following structure is filled by [unqlite_config()] when
+ * invoked with the UNQLITE_CONFIG_PAGER_STATS verb. Counters are cumulative since
+ * the database was opened or since the last call with a non-zero bReset argument.
+ */
+struct unqlite_pager_stats
+{
+  unqlite_int64 nCacheHit;    /* Page requests served from memory */
+  unqlite_int64 nCacheMiss;   /* Page requests that had to load the page */
+  unqlite_int64 nCacheEvict;  /* Unused pages evicted from the page cache */
+  unqlite_int64 nPageRead;    /* Pages read from the database file or the write-ahead log */
+  unqlite_int64 nSharedHit;   /* Pages served by another handle (UNQLITE_OPEN_SHARED_CACHE) */
+  unqlite_int64 nPageWrite;   /* Pages written to the database file or the write-ahead log */
+  unqlite_int64 nHotFlush;    /* Hot dirty pages flushed before commit time */
+  unqlite_int64 nJournalByte; /* Bytes written to the rollback journal */
+  unqlite_int64 nSync;        /* Total number of sync operations */
+  unqlite_int64 iSyncTime;    /* Time spent in sync operations (microseconds) */
+  unsigned int nPage;         /* Pages currently in memory */
+  unsigned int nHot;          /* Hot dirty pages currently in memory */
+  unsigned int nCacheMax;     /* Page cache limit (UNQLITE_CONFIG_MAX_PAGE_CACHE) */
+};
+/*
+ * Memory allocator statistics.
+ *
+ * In multi-thread mode, the allocators shared by several threads keep a small cache
+ * of free chunks per thread so that most allocations do not lock the shared pools.
+ * An instance of the following structure is filled by [unqlite_lib_mem_stats()]
+ * with the counters of these caches, summed over the whole library. Counters are
+ * cumulative since the library was initialized or since the last call with a
+ * non-zero bReset argument. They are always zero in single-thread mode.
+ */
+struct unqlite_mem_stats
+{
+  unqlite_int64 nCacheHit;  /* Allocations served by a per-thread cache */
+  unqlite_int64 nRefill;    /* Batches of chunks taken from the shared pools */
+  unqlite_int64 nFlush;     /* Batches of chunks given back to the shared pools */
+  unqlite_int64 nLockWait;  /* Times a shared pool was locked by another thread */
+  unsigned int nCached;     /* Chunks currently held by the per-thread caches */
+};
 /*
  * UnQLite/Jx9 Virtual Machine Configuration Commands.
  *
@@ -494,6 +571,28 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_VM_CONFIG_IO_STREAM       11  /* ONE ARGUMENT: const unqlite_io_stream *pStream */
 #define UNQLITE_VM_CONFIG_ARGV_ENTRY      12  /* ONE ARGUMENT: const char *zValue */
 #define UNQLITE_VM_CONFIG_EXTRACT_OUTPUT  13  /* TWO ARGUMENTS: const void **ppOut, unsigned int *pOutputLen */
+#define UNQLITE_VM_CONFIG_RECORD_CACHE    14  /* ONE ARGUMENT: unsigned int nMaxByte */
+#define UNQLITE_VM_CONFIG_RECORD_CACHE_STATS 15 /* TWO ARGUMENTS: unqlite_record_cache_stats *pStats, int bReset */
+/*
+ * Collection record cache statistics.
+ *
+ * Each virtual machine keeps the collection records it fetched or stored in decoded
+ * form, so that they are not read and decoded again. The cache holds at most
+ * UNQLITE_VM_CONFIG_RECORD_CACHE bytes (4MB by default, zero disables it), the least
+ * recently used records being evicted first. An instance of the following structure
+ * is filled by [unqlite_vm_config()] when invoked with the UNQLITE_VM_CONFIG_RECORD_CACHE_STATS
+ * verb. Counters are cumulative since the script was compiled or since the last call
+ * with a non-zero bReset argument.
+ */
+struct unqlite_record_cache_stats
+{
+  unqlite_int64 nHit;       /* Record lookups served from the cache */
+  unqlite_int64 nMiss;      /* Record lookups that had to read and decode the record */
+  unqlite_int64 nEvict;     /* Records evicted to stay within the budget */
+  unsigned int nRecord;     /* Records currently cached */
+  unsigned int nByte;       /* Estimated size of the cached records */
+  unsigned int nMaxByte;    /* Cache budget (UNQLITE_VM_CONFIG_RECORD_CACHE) */
+};
 /*
  * Storage engine configuration commands.
  *
@@ -509,6 +608,9 @@ typedef sxi64 unqlite_int64;
  */
 #define UNQLITE_KV_CONFIG_HASH_FUNC  1 /* ONE ARGUMENT: unsigned int (*xHash)(const void *,unsigned int) */
 #define UNQLITE_KV_CONFIG_CMP_FUNC   2 /* ONE ARGUMENT: int (*xCmp)(const void *,const void *,unsigned int) */
+#define UNQLITE_KV_CONFIG_GET_BUCKET 3 /* THREE ARGUMENTS: const void *pKey,int nKeyLen,unqlite_int64 *pBucket */
+#define UNQLITE_KV_CONFIG_HASH_SEED  4 /* ONE ARGUMENT: unsigned int nSeed */
+#define UNQLITE_KV_CONFIG_COMPACT    5 /* NO ARGUMENTS */
 /*
  * Global Library Configuration Commands.
  *
@@ -554,6 +656,8 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_OPEN_OMIT_JOURNALING  0x00000040  /* Omit journaling for this database. Ok for [unqlite_open] */
 #define UNQLITE_OPEN_IN_MEMORY        0x00000080  /* An in memory database. Ok for [unqlite_open]*/
 #define UNQLITE_OPEN_MMAP             0x00000100  /* Obtain a memory view of the whole file. Ok for [unqlite_open] */
+#define UNQLITE_OPEN_WAL              0x00000200  /* Write-ahead log journaling. Ok for [unqlite_open] */
+#define UNQLITE_OPEN_SHARED_CACHE     0x00000400  /* Share clean pages with the other handles opened on the same file. Ok for [unqlite_open] */
 /*
  * Synchronization Type Flags
  *
@@ -634,9 +738,18 @@ struct unqlite_file {
  * the file. The sector size is the minimum write that can be performed without
  * disturbing other bytes in the file.
  *
+ * The xFileId() method (iVersion 2 and later, may be NULL) reports the device and inode
+ * numbers of the file. Handles opened with the [UNQLITE_OPEN_SHARED_CACHE] flag use them
+ * to recognize each other. Without it, each handle keeps its own pages.
+ *
+ * The xWritev() method (iVersion 3 and later, may be NULL) writes nBuf buffers of iBufSize
+ * bytes each, back to back starting at offset iOfst, with as few system calls as possible.
+ * It is used to write runs of consecutive pages. Without it, each buffer is written
+ * by a separate call to xWrite().
+ *
  */
 struct unqlite_io_methods {
-  int iVersion;                 /* Structure version number (currently 1) */
+  int iVersion;                 /* Structure version number (currently 3) */
   int (*xClose)(unqlite_file*);
   int (*xRead)(unqlite_file*, void*, unqlite_int64 iAmt, unqlite_int64 iOfst);
   int (*xWrite)(unqlite_file*, const void*, unqlite_int64 iAmt, unqlite_int64 iOfst);
@@ -647,6 +760,8 @@ struct unqlite_io_methods {
   int (*xUnlock)(unqlite_file*, int);
   int (*xCheckReservedLock)(unqlite_file*, int *pResOut);
   int (*xSectorSize)(unqlite_file*);
+  int (*xFileId)(unqlite_file*, unqlite_int64 *pDev, unqlite_int64 *pIno);
+  int (*xWritev)(unqlite_file*, const void * const *apBuf, int nBuf, unqlite_int64 iBufSize, unqlite_int64 iOfst);
 };
 /*
  * CAPIREF: OS Interface Object
@@ -795,9 +910,14 @@ struct unqlite_kv_cursor
  * UnQLite works with run-time interchangeable storage engines (i.e. Hash, B+Tree, R+Tree, LSM, etc.).
  * The storage engine works with key/value pairs where both the key
  * and the value are byte arrays of arbitrary length and with no restrictions on content.
- * UnQLite come with two built-in KV storage engine: A Virtual Linear Hash (VLH) storage
- * engine is used for persistent on-disk databases with O(1) lookup time and an in-memory
- * hash-table or Red-black tree storage engine is used for in-memory databases.
+ * UnQLite come with four built-in KV storage engine: A Virtual Linear Hash (VLH) storage
+ * engine is used by default for persistent on-disk databases with O(1) lookup time,
+ * an ordered B+Tree storage engine named "btree" with O(log n) lookups and range cursors
+ * can be selected for a fresh database via [unqlite_config()] with a configuration verb
+ * set to UNQLITE_CONFIG_KV_ENGINE and an in-memory
+ * hash-table storage engine is used for in-memory databases. An ordered in-memory
+ * skip list named "skiplist" can be selected the same way before the first record
+ * of an in-memory database is stored.
  * Future versions of UnQLite might add other built-in storage engines (i.e. LSM). 
  * Registration of a Key/Value storage engine at run-time is done via [unqlite_lib_config()]
  * with a configuration verb set to UNQLITE_LIB_CONFIG_STORAGE_ENGINE.
@@ -857,6 +977,12 @@ struct unqlite_kv_methods
 #ifndef UNQLITE_JOURNAL_FILE_SUFFIX
 #define UNQLITE_JOURNAL_FILE_SUFFIX "_unqlite_journal"
 #endif
+/*
+ * UnQLite write-ahead log file suffix (UNQLITE_OPEN_WAL).
+ */
+#ifndef UNQLITE_WAL_FILE_SUFFIX
+#define UNQLITE_WAL_FILE_SUFFIX "_unqlite_wal"
+#endif
 /*
  * Call Context - Error Message Serverity Level.
  *
@@ -887,6 +1013,10 @@ UNQLITE_APIEXPORT int unqlite_kv_fetch(unqlite *pDb,const void *pKey,int nKeyLen
 UNQLITE_APIEXPORT int unqlite_kv_fetch_callback(unqlite *pDb,const void *pKey,
 	                    int nKeyLen,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData);
 UNQLITE_APIEXPORT int unqlite_kv_delete(unqlite *pDb,const void *pKey,int nKeyLen);
+UNQLITE_APIEXPORT int unqlite_kv_store_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,
+	                    const void **apData,const unqlite_int64 *anDataLen);
+UNQLITE_APIEXPORT int unqlite_kv_fetch_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,
+	                    int (*xConsumer)(int,const void *,unsigned int,void *),void *pUserData,int *aRc);
 UNQLITE_APIEXPORT int unqlite_kv_config(unqlite *pDb,int iOp,...);
 
 /* Document (JSON) Store Interfaces powered by the Jx9 Scripting Language */
@@ -915,6 +1045,12 @@ UNQLITE_APIEXPORT int unqlite_kv_cursor_data_callback(unqlite_kv_cursor *pCursor
 UNQLITE_APIEXPORT int unqlite_kv_cursor_delete_entry(unqlite_kv_cursor *pCursor);
 UNQLITE_APIEXPORT int unqlite_kv_cursor_reset(unqlite_kv_cursor *pCursor);
 
+/* Snapshot (Consistent Read) Interfaces */
+UNQLITE_APIEXPORT int unqlite_snapshot_open(unqlite *pDb,unqlite_snapshot **ppOut);
+UNQLITE_APIEXPORT int unqlite_snapshot_release(unqlite *pDb,unqlite_snapshot *pSnap);
+UNQLITE_APIEXPORT int unqlite_snapshot_cursor_init(unqlite_snapshot *pSnap,unqlite_kv_cursor **ppOut);
+UNQLITE_APIEXPORT int unqlite_snapshot_cursor_release(unqlite_snapshot *pSnap,unqlite_kv_cursor *pCur);
+
 /* Manual Transaction Manager */
 UNQLITE_APIEXPORT int unqlite_begin(unqlite *pDb);
 UNQLITE_APIEXPORT int unqlite_commit(unqlite *pDb);
@@ -1016,6 +1152,7 @@ UNQLITE_APIEXPORT int unqlite_lib_config(int nConfigOp,...);
 UNQLITE_APIEXPORT int unqlite_lib_init(void);
 UNQLITE_APIEXPORT int unqlite_lib_shutdown(void);
 UNQLITE_APIEXPORT int unqlite_lib_is_threadsafe(void);
+UNQLITE_APIEXPORT int unqlite_lib_mem_stats(unqlite_mem_stats *pStats,int bReset);
 UNQLITE_APIEXPORT const char * unqlite_lib_version(void);
 UNQLITE_APIEXPORT const char * unqlite_lib_signature(void);
 UNQLITE_APIEXPORT const char * unqlite_lib_ident(void);
@@ -1645,7 +1782,7 @@ typedef sxi32 (*ProcRawStrCmp)(const SyString *, const SyString *);
 
 #define SX_ADDR(PTR)    ((sxptr)PTR)
 #define SX_ARRAYSIZE(X) (sizeof(X)/sizeof(X[0]))
-#define SXUNUSED(P)	(P = 0)
+#define SXUNUSED(P)	((void)(P))
 #define	SX_EMPTY(PTR)   (PTR == 0)
 #define SX_EMPTY_STR(STR) (STR == 0 || STR[0] == 0 )
 typedef struct SyMemBackend SyMemBackend;
@@ -1728,6 +1865,19 @@ struct SyBlob
 /* A memory backend subsystem is defined by an instance of the following structures */
 typedef union SyMemHeader SyMemHeader;
 typedef struct SyMemBlock SyMemBlock;
+typedef struct SyMemCache SyMemCache;
+typedef struct SyMemCacheStats SyMemCacheStats;
+/*
+ * Counters of the per-thread pool caches, see [SyMemBackendCacheStats()].
+ */
+struct SyMemCacheStats
+{
+	sxu64 nHit;    /* Pool allocations served by a per-thread cache */
+	sxu64 nRefill; /* Batches of chunks taken from the shared pools */
+	sxu64 nFlush;  /* Batches of chunks given back to the shared pools */
+	sxu64 nWait;   /* Times a shared pool was locked by another thread */
+	sxu32 nCached; /* Chunks currently held by the per-thread caches */
+};
 struct SyMemBlock
 {
 	SyMemBlock *pNext, *pPrev; /* Chain of allocated memory blocks */
@@ -1756,6 +1906,7 @@ struct SyMemBackend
 	SyMutex *pMutex;               /* Per instance mutex */
 	sxu32 nMagic;                  /* Sanity check against misuse */
 	SyMemHeader *apPool[SXMEM_POOL_NBUCKETS+SXMEM_POOL_INCR]; /* Pool of memory chunks */
+	SyMemCache *pCache;            /* Per-thread caches in front of apPool[] (Thread-safe backends only) */
 };
 /* Mutex types */
 #define SXMUTEX_TYPE_FAST	1
@@ -1798,6 +1949,12 @@ struct SyMemBackend
 	(METHOD)->xLeave(MUTEX);\
 	}\
 }
+/* Thread-local storage */
+#if defined(_MSC_VER)
+#define SX_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define SX_THREAD_LOCAL __thread
+#endif
 /* Comparison, byte swap, byte copy macros */
 #define SX_MACRO_FAST_CMP(X1, X2, SIZE, RC){\
 	register unsigned char *r1 = (unsigned char *)X1;\
@@ -3191,6 +3348,7 @@ JX9_PRIVATE sxu32 SyStrlen(const char *zSrc);
 JX9_PRIVATE const SyMutexMethods *SyMutexExportMethods(void);
 JX9_PRIVATE sxi32 SyMemBackendMakeThreadSafe(SyMemBackend *pBackend, const SyMutexMethods *pMethods);
 JX9_PRIVATE sxi32 SyMemBackendDisbaleMutexing(SyMemBackend *pBackend);
+JX9_PRIVATE void SyMemBackendCacheStats(const SyMutexMethods *pMethods, SyMemCacheStats *pStats, int bReset);
 #endif
 JX9_PRIVATE void SyBigEndianPack32(unsigned char *buf,sxu32 nb);
 JX9_PRIVATE void SyBigEndianUnpack32(const unsigned char *buf,sxu32 *uNB);
@@ -3315,7 +3473,9 @@ struct unqlite_db
 	Pager *pPager;              /* Pager and Transaction manager */
 	jx9 *pJx9;                  /* Jx9 Engine handle */
 	unqlite_kv_cursor *pCursor; /* Database cursor for common usage */
+	SySet aReadCursor;          /* Idle cursors of concurrent readers (unqlite_kv_cursor *) */
 };
+typedef struct unqlite_commit_member unqlite_commit_member;
 /*
  * Each database connection is an instance of the following structure.
  */
@@ -3327,12 +3487,30 @@ struct unqlite
 #if defined(UNQLITE_ENABLE_THREADS)
 	const SyMutexMethods *pMethods;  /* Mutex methods */
 	SyMutex *pMutex;                 /* Per-handle mutex */
+	SyMutex *pReadMutex;             /* Protect the state shared by concurrent readers */
+	sxu32 nReader;                   /* Total number of active readers */
 #endif
 	unqlite_vm *pVms;                /* List of active VM */
 	sxi32 iVm;                       /* Total number of active VM */
 	sxi32 iFlags;                    /* Control flags (See below)  */
 	unqlite *pNext,*pPrev;           /* List of active DB handles */
 	sxu32 nMagic;                    /* Sanity check against misuse */
+	sxu32 nCommitWindow;             /* Group commit window in microseconds (0: disabled) */
+	sxu32 iCommitGroup;              /* Group currently gathering commit requests */
+	SyMutex *apCommitGate[2];        /* Held by the leader of even and odd groups while gathering */
+	sxu32 anCommitPass[2];           /* Members yet to pass each gate */
+	unqlite_commit_member *pCommitMember; /* Members of the gathering group */
+	const void *pCommitWriter;       /* Last thread to change the database */
+	int bCommitShared;               /* TRUE if several threads changed the database since the last commit */
+	int bCommitLeader;               /* TRUE while a thread is gathering a group */
+};
+/*
+ * A thread waiting for the leader of its group to commit.
+ */
+struct unqlite_commit_member
+{
+	int rc;                          /* Result of the group commit */
+	unqlite_commit_member *pNext;    /* Next member of the group */
 };
 #define UNQLITE_FL_DISABLE_AUTO_COMMIT   0x001 /* Disable auto-commit on close */
 /*
@@ -3353,8 +3531,10 @@ struct unqlite_col_record
 	unqlite_col *pCol;                      /* Collecion this record belong */
 	jx9_int64 nId;                          /* Unique record ID */
 	jx9_value sValue;                       /* In-memory value of the record */
+	sxu32 nByte;                            /* Estimated size charged against the VM record cache */
 	unqlite_col_record *pNextCol,*pPrevCol; /* Collision chain */
 	unqlite_col_record *pNext,*pPrev;       /* Linked list of records */
+	unqlite_col_record *pLruNext,*pLruPrev; /* VM wide LRU list of cached records */
 };
 /* 
  * Magic number to identify a valid collection on disk.
@@ -3372,6 +3552,8 @@ struct unqlite_col
 	sxu32 nSchemaOfft; /* Shema offset in sHeader */
 	SyBlob sWorker;    /* General purpose working buffer */
 	SyBlob sHeader;    /* Collection binary header */
+	SySet aIndex;      /* Indexed fields (SyString instances) */
+	SyBlob sIndexKey;  /* Index key working buffer */
 	jx9_int64 nLastid; /* Last collection record ID */
 	jx9_int64 nCurid;  /* Current record ID */
 	jx9_int64 nTotRec; /* Total number of records in the collection */
@@ -3385,6 +3567,10 @@ struct unqlite_col
 	unqlite_col *pNext,*pPrev;  /* Next and previous collection in the chain */
 	unqlite_col *pNextCol,*pPrevCol; /* Collision chain */
 };
+/*
+ * Possible values for the unqlite_col.iFlags field.
+ */
+#define UNQLITE_COL_HEADER_DIRTY 0x001 /* Record counters not yet written to the collection header */
 /*
  * Each unQLite Virtual Machine resulting from successful compilation of
  * a Jx9 script is represented by an instance of the following structure.
@@ -3401,6 +3587,14 @@ struct unqlite_vm
 	sxu32 iCol;                /* Total number of loaded collections */
 	sxu32 iColSize;            /* apCol[] size  */
 	jx9_vm *pJx9Vm;            /* Compiled Jx9 script*/
+	unqlite_col_record *pRecLru;  /* Cached collection records, most recently used first */
+	unqlite_col_record *pRecTail; /* Least recently used cached record */
+	sxu32 nRecCached;          /* Total number of cached records */
+	sxu32 nRecByte;            /* Estimated size of the cached records */
+	sxu32 nRecMax;             /* Record cache budget in bytes */
+	sxi64 nRecHit;             /* Record cache hits */
+	sxi64 nRecMiss;            /* Record cache misses */
+	sxi64 nRecEvict;           /* Records evicted to stay within nRecMax */
 	unqlite_vm *pNext,*pPrev;  /* Linked list of active unQLite VM */
 	sxu32 nMagic;              /* Magic number to avoid misuse */
 };
@@ -3433,6 +3627,18 @@ struct unqlite_vm
 # undef UNQLITE_DEFAULT_PAGE_SIZE
 #endif
 # define UNQLITE_DEFAULT_PAGE_SIZE 4096 /* 4K */
+/*
+ * The default number of pages the pager is allowed to keep in memory.
+ */
+#ifndef UNQLITE_DEFAULT_PAGE_CACHE
+# define UNQLITE_DEFAULT_PAGE_CACHE 2048 /* 8MB with 4K pages */
+#endif
+/*
+ * The default size in bytes of the collection record cache of a VM.
+ */
+#ifndef UNQLITE_DEFAULT_RECORD_CACHE
+# define UNQLITE_DEFAULT_RECORD_CACHE (4 << 20) /* 4MB */
+#endif
 /* Forward declaration */
 typedef struct Bitvec Bitvec;
 /* Private library functions */
@@ -3451,11 +3657,15 @@ UNQLITE_PRIVATE int unqliteGetPageSize(void);
 UNQLITE_PRIVATE int unqliteGenError(unqlite *pDb,const char *zErr);
 UNQLITE_PRIVATE int unqliteGenErrorFormat(unqlite *pDb,const char *zFmt,...);
 UNQLITE_PRIVATE int unqliteGenOutofMem(unqlite *pDb);
+#if defined(UNQLITE_ENABLE_THREADS)
+UNQLITE_PRIVATE void unqliteCommitNoteWriter(unqlite *pDb);
+#endif
 /* unql_vm.c */
 UNQLITE_PRIVATE int unqliteCreateCollection(unqlite_vm *pVm,SyString *pName);
 UNQLITE_PRIVATE jx9_int64 unqliteCollectionLastRecordId(unqlite_col *pCol);
 UNQLITE_PRIVATE jx9_int64 unqliteCollectionCurrentRecordId(unqlite_col *pCol);
 UNQLITE_PRIVATE int unqliteCollectionCacheRemoveRecord(unqlite_col *pCol,jx9_int64 nId);
+UNQLITE_PRIVATE void unqliteVmEvictRecords(unqlite_vm *pVm,sxu32 nMaxByte);
 UNQLITE_PRIVATE jx9_int64 unqliteCollectionTotalRecords(unqlite_col *pCol);
 UNQLITE_PRIVATE void unqliteCollectionResetRecordCursor(unqlite_col *pCol);
 UNQLITE_PRIVATE int unqliteCollectionFetchNextRecord(unqlite_col *pCol,jx9_value *pValue);
@@ -3463,8 +3673,13 @@ UNQLITE_PRIVATE int unqliteCollectionFetchRecordById(unqlite_col *pCol,jx9_int64
 UNQLITE_PRIVATE unqlite_col * unqliteCollectionFetch(unqlite_vm *pVm,SyString *pCol,int iFlag);
 UNQLITE_PRIVATE int unqliteCollectionSetSchema(unqlite_col *pCol,jx9_value *pValue);
 UNQLITE_PRIVATE int unqliteCollectionPut(unqlite_col *pCol,jx9_value *pValue,int iFlag);
+UNQLITE_PRIVATE int unqliteVmSyncCollections(unqlite_vm *pVm);
+UNQLITE_PRIVATE void unqliteVmRollbackCollections(unqlite_vm *pVm);
 UNQLITE_PRIVATE int unqliteCollectionDropRecord(unqlite_col *pCol,jx9_int64 nId,int wr_header,int log_err);
 UNQLITE_PRIVATE int unqliteDropCollection(unqlite_col *pCol);
+UNQLITE_PRIVATE int unqliteCollectionCreateIndex(unqlite_col *pCol,const SyString *pField);
+UNQLITE_PRIVATE int unqliteCollectionDropIndex(unqlite_col *pCol,const SyString *pField);
+UNQLITE_PRIVATE int unqliteCollectionFetchByValue(unqlite_col *pCol,const SyString *pField,jx9_value *pValue,jx9_value *pArray);
 /* unql_jx9.c */
 UNQLITE_PRIVATE int unqliteRegisterJx9Functions(unqlite_vm *pVm);
 /* fastjson.c */
@@ -3484,11 +3699,16 @@ UNQLITE_PRIVATE sxi32 FastJsonDecode(
 UNQLITE_PRIVATE const unqlite_vfs * unqliteExportBuiltinVfs(void);
 /* mem_kv.c */
 UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportMemKvStorage(void);
+/* skiplist_kv.c */
+UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportSkipListKvStorage(void);
 /* lhash_kv.c */
 UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportDiskKvStorage(void);
+/* btree_kv.c */
+UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportBtreeKvStorage(void);
 /* os.c */
 UNQLITE_PRIVATE int unqliteOsRead(unqlite_file *id, void *pBuf, unqlite_int64 amt, unqlite_int64 offset);
 UNQLITE_PRIVATE int unqliteOsWrite(unqlite_file *id, const void *pBuf, unqlite_int64 amt, unqlite_int64 offset);
+UNQLITE_PRIVATE int unqliteOsWritev(unqlite_file *id, const void * const *apBuf, int nBuf, unqlite_int64 iBufSize, unqlite_int64 offset);
 UNQLITE_PRIVATE int unqliteOsTruncate(unqlite_file *id, unqlite_int64 size);
 UNQLITE_PRIVATE int unqliteOsSync(unqlite_file *id, int flags);
 UNQLITE_PRIVATE int unqliteOsFileSize(unqlite_file *id, unqlite_int64 *pSize);
@@ -3515,6 +3735,10 @@ UNQLITE_PRIVATE void unqliteBitvecDestroy(Bitvec *p);
 UNQLITE_PRIVATE int unqliteInitCursor(unqlite *pDb,unqlite_kv_cursor **ppOut);
 UNQLITE_PRIVATE int unqliteReleaseCursor(unqlite *pDb,unqlite_kv_cursor *pCur);
 UNQLITE_PRIVATE int unqlitePagerSetCachesize(Pager *pPager,int mxPage);
+UNQLITE_PRIVATE int unqlitePagerStats(Pager *pPager,unqlite_pager_stats *pStats,int bReset);
+UNQLITE_PRIVATE int unqlitePagerSetWalAutoCheckpoint(Pager *pPager,int nFrame);
+UNQLITE_PRIVATE int unqlitePagerWalCheckpoint(Pager *pPager);
+UNQLITE_PRIVATE int unqlitePagerWriteBack(Pager *pPager,int nMinPage,int *pnPage);
 UNQLITE_PRIVATE int unqlitePagerClose(Pager *pPager);
 UNQLITE_PRIVATE int unqlitePagerOpen(
   unqlite_vfs *pVfs,       /* The virtual file system to use */
@@ -3523,8 +3747,16 @@ UNQLITE_PRIVATE int unqlitePagerOpen(
   unsigned int iFlags      /* flags controlling this file */
   );
 UNQLITE_PRIVATE int unqlitePagerRegisterKvEngine(Pager *pPager,unqlite_kv_methods *pMethods);
+UNQLITE_PRIVATE int unqlitePagerSetKvEngine(Pager *pPager,unqlite_kv_methods *pMethods);
 UNQLITE_PRIVATE unqlite_kv_engine * unqlitePagerGetKvEngine(unqlite *pDb);
+UNQLITE_PRIVATE unqlite * unqliteCursorDb(unqlite_kv_cursor *pCursor);
+UNQLITE_PRIVATE void unqlitePagerSaveKvConfig(Pager *pPager,int iOp,va_list ap);
+UNQLITE_PRIVATE int unqlitePagerSnapshotOpen(Pager *pPager,unqlite_snapshot **ppOut);
+UNQLITE_PRIVATE int unqlitePagerSnapshotRelease(unqlite_snapshot *pSnap);
+UNQLITE_PRIVATE int unqliteSnapshotInitCursor(unqlite_snapshot *pSnap,unqlite_kv_cursor **ppOut);
+UNQLITE_PRIVATE int unqliteSnapshotReleaseCursor(unqlite_snapshot *pSnap,unqlite_kv_cursor *pCur);
 UNQLITE_PRIVATE int unqlitePagerBegin(Pager *pPager);
+UNQLITE_PRIVATE int unqlitePagerInWriteTransaction(Pager *pPager);
 UNQLITE_PRIVATE int unqlitePagerCommit(Pager *pPager);
 UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine);
 UNQLITE_PRIVATE void unqlitePagerRandomString(Pager *pPager,char *zBuf,sxu32 nLen);
@@ -3590,7 +3822,7 @@ static struct unqlGlobal_Data
 	unqlite *pDB;                          /* List of active DB handles */
 	sxu32 nMagic;                          /* Sanity check against library misuse */
 }sUnqlMPGlobal = {
-	{0, 0, 0, 0, 0, 0, 0, 0, {0}}, 
+	{0, 0, 0, 0, 0, 0, 0, 0, {0}, 0}, 
 #if defined(UNQLITE_ENABLE_THREADS)
 	0, 
 	0, 
@@ -3880,9 +4112,15 @@ static sxi32 unqliteCoreInitialize(void)
 		/* Install the built-in Key Value storage engines */
 		pMethods = unqliteExportMemKvStorage(); /* In-memory storage */
 		unqlite_lib_config(UNQLITE_LIB_CONFIG_STORAGE_ENGINE,pMethods);
+		/* Ordered in-memory key/value storage */
+		pMethods = unqliteExportSkipListKvStorage(); /* Skip list storage */
+		unqlite_lib_config(UNQLITE_LIB_CONFIG_STORAGE_ENGINE,pMethods);
 		/* Default disk key/value storage engine */
 		pMethods = unqliteExportDiskKvStorage(); /* Disk storage */
 		unqlite_lib_config(UNQLITE_LIB_CONFIG_STORAGE_ENGINE,pMethods);
+		/* Ordered disk key/value storage engine */
+		pMethods = unqliteExportBtreeKvStorage(); /* B+Tree storage */
+		unqlite_lib_config(UNQLITE_LIB_CONFIG_STORAGE_ENGINE,pMethods);
 		/* Default page size */
 		if( sUnqlMPGlobal.iPageSize < UNQLITE_MIN_PAGE_SIZE ){
 			unqlite_lib_config(UNQLITE_LIB_CONFIG_PAGE_SIZE,UNQLITE_DEFAULT_PAGE_SIZE);
@@ -3900,6 +4138,163 @@ End:
 #endif
 	return rc;
 }
+#if defined(UNQLITE_ENABLE_THREADS)
+/*
+ * Shared/Exclusive access to a database handle.
+ *
+ * Threads sharing a handle may read in parallel: A reader go through the per-handle
+ * mutex just long enough to register itself and perform its lookup without holding it.
+ * Every other operation hold the per-handle mutex for its whole duration and wait for
+ * the registered readers to drain before touching the database. Readers arriving
+ * meanwhile block on the per-handle mutex so a writer is never starved and each reader
+ * work on a consistent snapshot.
+ * Concurrent readers only serialize on pReadMutex which protect the state they share
+ * (page cache, idle cursors and error log).
+ */
+static int unqliteEnterShared(unqlite *pDb)
+{
+	if( pDb == 0 ){
+		/* Snapshot cursor, see [unqliteCursorDb()] */
+		return UNQLITE_OK;
+	}
+	/* Acquire DB mutex */
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
+		UNQLITE_THRD_DB_RELEASE(pDb) ){
+			return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+	/* Open the database and install the storage engine (if not yet done) so that
+	 * the lookup itself never change the pager state.
+	 */
+	unqlitePagerGetKvEngine(pDb);
+	/* Register this reader */
+	pDb->nReader++;
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+	/* Leave DB mutex */
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	return UNQLITE_OK;
+}
+/*
+ * Unregister a reader.
+ */
+static void unqliteLeaveShared(unqlite *pDb)
+{
+	if( pDb == 0 ){
+		/* Snapshot cursor */
+		return;
+	}
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+	pDb->nReader--;
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+}
+/*
+ * Wait for the active readers to finish their work.
+ * This routine must be called with the DB mutex held.
+ */
+static void unqliteWaitReaders(unqlite *pDb)
+{
+	const unqlite_vfs *pVfs;
+	sxu32 nReader;
+	if( pDb->pReadMutex == 0 ){
+		/* No concurrent readers */
+		return;
+	}
+	pVfs = unqliteExportBuiltinVfs();
+	for(;;){
+		SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+		nReader = pDb->nReader;
+		SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+		if( nReader < 1 ){
+			break;
+		}
+		/* Lookups are short, poll again shortly */
+		if( pVfs && pVfs->xSleep ){
+			pVfs->xSleep((unqlite_vfs *)pVfs,10);
+		}
+	}
+}
+/*
+ * Wait for the group commit in progress, if any, and for its members to leave
+ * before the handle is released.
+ * This routine must be called with the DB mutex held.
+ */
+static void unqliteCommitDrain(unqlite *pDb)
+{
+	const unqlite_vfs *pVfs = unqliteExportBuiltinVfs();
+	SyMutex *pGate;
+	while( pDb->bCommitLeader || pDb->anCommitPass[0] > 0 || pDb->anCommitPass[1] > 0 ){
+		pGate = pDb->bCommitLeader ? pDb->apCommitGate[pDb->iCommitGroup & 1] : 0;
+		SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+		if( pGate ){
+			/* Wait for the leader to commit */
+			SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pGate);
+			SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pGate);
+		}else if( pVfs && pVfs->xSleep ){
+			/* Members are on their way out */
+			pVfs->xSleep((unqlite_vfs *)pVfs,10);
+		}
+		SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+	}
+}
+#endif /* UNQLITE_ENABLE_THREADS */
+/*
+ * Obtain a cursor for a lookup performed under a shared lock.
+ * Concurrent readers cannot share the database cursor, each one borrow
+ * an idle cursor instead.
+ */
+static int unqliteReadCursorAcquire(unqlite *pDb,unqlite_kv_cursor **ppOut)
+{
+#if defined(UNQLITE_ENABLE_THREADS)
+	if( pDb->pReadMutex ){
+		unqlite_kv_cursor **ppCur;
+		int rc = UNQLITE_OK;
+		SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+		ppCur = (unqlite_kv_cursor **)SySetPop(&pDb->sDB.aReadCursor);
+		if( ppCur ){
+			*ppOut = *ppCur;
+		}else{
+			/* Allocate a new one */
+			rc = unqliteInitCursor(pDb,ppOut);
+		}
+		SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+		return rc;
+	}
+#endif
+	/* No concurrent readers, use the database cursor */
+	*ppOut = pDb->sDB.pCursor;
+	return UNQLITE_OK;
+}
+/*
+ * Give back a cursor obtained via [unqliteReadCursorAcquire()].
+ */
+static void unqliteReadCursorRelease(unqlite *pDb,unqlite_kv_cursor *pCur)
+{
+	if( pCur == pDb->sDB.pCursor ){
+		/* Database cursor */
+		return;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+	if( SySetPut(&pDb->sDB.aReadCursor,(const void *)&pCur) != SXRET_OK ){
+		unqliteReleaseCursor(pDb,pCur);
+	}
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+}
+/*
+ * Log an error on behalf of a reader.
+ */
+static void unqliteReadError(unqlite *pDb,const char *zErr)
+{
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+	unqliteGenError(pDb,zErr);
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+}
 /* Forward declaration */
 static int unqliteVmRelease(unqlite_vm *pVm);
 /*
@@ -4030,6 +4425,35 @@ int unqlite_lib_is_threadsafe(void)
 	return 0;
 #endif
 }
+/*
+ * [CAPIREF: unqlite_lib_mem_stats()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_lib_mem_stats(unqlite_mem_stats *pStats,int bReset)
+{
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMemCacheStats sStats;
+#endif
+	if( pStats == 0 ){
+		return UNQLITE_CORRUPT;
+	}
+	SyZero(pStats,sizeof(unqlite_mem_stats));
+#if defined(UNQLITE_ENABLE_THREADS)
+	if( sUnqlMPGlobal.nMagic != UNQLITE_LIB_MAGIC ){
+		/* Library not initialized */
+		return UNQLITE_OK;
+	}
+	SyMemBackendCacheStats(sUnqlMPGlobal.pMutexMethods,&sStats,bReset);
+	pStats->nCacheHit = (unqlite_int64)sStats.nHit;
+	pStats->nRefill = (unqlite_int64)sStats.nRefill;
+	pStats->nFlush = (unqlite_int64)sStats.nFlush;
+	pStats->nLockWait = (unqlite_int64)sStats.nWait;
+	pStats->nCached = sStats.nCached;
+#else
+	SXUNUSED(bReset);
+#endif
+	return UNQLITE_OK;
+}
 /*
  *
  * [CAPIREF: unqlite_lib_version()]
@@ -4081,14 +4505,12 @@ static unsigned int unqliteSanityzeFlag(unsigned int iFlags)
 		iFlags |= UNQLITE_OPEN_READWRITE;
 	}
 	if( iFlags & UNQLITE_OPEN_CREATE ){
-		iFlags &= ~(UNQLITE_OPEN_MMAP|UNQLITE_OPEN_READONLY);
+		iFlags &= ~UNQLITE_OPEN_READONLY;
 		/* Auto-append the R+W flag */
 		iFlags |= UNQLITE_OPEN_READWRITE;
 	}else{
 		if( iFlags & UNQLITE_OPEN_READONLY ){
 			iFlags &= ~UNQLITE_OPEN_READWRITE;
-		}else if( iFlags & UNQLITE_OPEN_READWRITE ){
-			iFlags &= ~UNQLITE_OPEN_MMAP;
 		}
 	}
 	return iFlags;
@@ -4113,6 +4535,7 @@ static int unqliteInitDatabase(
 	SyMemBackendDisbaleMutexing(&pDB->sMem);
 #endif
 	SyBlobInit(&pDB->sErr,&pDB->sMem);	
+	SySetInit(&pStorage->aReadCursor,&pDB->sMem,sizeof(unqlite_kv_cursor *));
 	/* Sanityze flags */
 	iFlags = unqliteSanityzeFlag(iFlags);
 	/* Init the pager and the transaction manager */
@@ -4153,6 +4576,7 @@ static int unqliteInitVm(unqlite *pDb,jx9_vm *pJx9Vm,unqlite_vm **ppOut)
 	pVm->iColSize = 32; /* Must be a power of two */
 	/* Zero the table */
 	SyZero((void *)pVm->apCol,pVm->iColSize * sizeof(unqlite_col *));
+	pVm->nRecMax = UNQLITE_DEFAULT_RECORD_CACHE;
 #if defined(UNQLITE_ENABLE_THREADS)
 	if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE ){
 		 /* Associate a recursive mutex with this instance */
@@ -4256,6 +4680,13 @@ static int unqliteConfigure(unqlite *pDb,int nOp,va_list ap)
 		rc = unqlitePagerSetCachesize(pDb->sDB.pPager,max_page);
 		break;
 										}
+	case UNQLITE_CONFIG_PAGER_STATS: {
+		unqlite_pager_stats *pStats = va_arg(ap,unqlite_pager_stats *);
+		int bReset = va_arg(ap,int);
+		/* Cache, IO and sync counters */
+		rc = unqlitePagerStats(pDb->sDB.pPager,pStats,bReset);
+		break;
+									 }
 	case UNQLITE_CONFIG_ERR_LOG: {
 		/* Database error log if any */
 		const char **pzPtr = va_arg(ap, const char **);
@@ -4282,6 +4713,67 @@ static int unqliteConfigure(unqlite *pDb,int nOp,va_list ap)
 		pDb->iFlags |= UNQLITE_FL_DISABLE_AUTO_COMMIT;
 		break;
 											}
+	case UNQLITE_CONFIG_KV_ENGINE: {
+		/* Select the underlying KV storage engine of a fresh database */
+		const char *zName = va_arg(ap,const char *);
+		unqlite_kv_methods *pMethods;
+		if( zName == 0 ){
+			rc = UNQLITE_CORRUPT;
+			break;
+		}
+		pMethods = unqliteFindKVStore(zName,SyStrlen(zName));
+		if( pMethods == 0 ){
+			unqliteGenErrorFormat(pDb,"No such Key/Value storage engine '%s'",zName);
+			rc = UNQLITE_NOTIMPLEMENTED;
+			break;
+		}
+		rc = unqlitePagerSetKvEngine(pDb->sDB.pPager,pMethods);
+		break;
+								   }
+	case UNQLITE_CONFIG_WAL_AUTOCHECKPOINT: {
+		int nFrame = va_arg(ap,int);
+		/* Write-ahead log auto-checkpoint threshold */
+		rc = unqlitePagerSetWalAutoCheckpoint(pDb->sDB.pPager,nFrame);
+		break;
+											}
+	case UNQLITE_CONFIG_WAL_CHECKPOINT:
+		/* Transfer the write-ahead log to the database file */
+		rc = unqlitePagerWalCheckpoint(pDb->sDB.pPager);
+		break;
+	case UNQLITE_CONFIG_WRITE_BACK: {
+		int nMinPage = va_arg(ap,int);
+		int *pnPage = va_arg(ap,int *);
+		/* Background write-back of the dirty pages or of the write-ahead log */
+		rc = unqlitePagerWriteBack(pDb->sDB.pPager,nMinPage,pnPage);
+		break;
+									}
+	case UNQLITE_CONFIG_IN_WRITE_TRANSACTION: {
+		int *pbOpen = va_arg(ap,int *);
+		if( pbOpen == 0 ){
+			rc = UNQLITE_CORRUPT;
+			break;
+		}
+		*pbOpen = unqlitePagerInWriteTransaction(pDb->sDB.pPager);
+		break;
+											  }
+	case UNQLITE_CONFIG_BEGIN_NEW:
+		/* Begin a write transaction of our own */
+		if( unqlitePagerInWriteTransaction(pDb->sDB.pPager) ){
+			rc = UNQLITE_LOCKED;
+			break;
+		}
+		rc = unqlitePagerBegin(pDb->sDB.pPager);
+		break;
+	case UNQLITE_CONFIG_COMMIT_WINDOW: {
+		int nMicroSec = va_arg(ap,int);
+		/* Group commit window, zero commit immediately */
+		if( nMicroSec < 0 ){
+			rc = UNQLITE_INVALID;
+			break;
+		}
+		pDb->nCommitWindow = (sxu32)nMicroSec;
+		break;
+									   }
 	case UNQLITE_CONFIG_GET_KV_NAME: {
 		/* Name of the underlying KV storage engine */
 		const char **pzPtr = va_arg(ap,const char **);
@@ -4350,6 +4842,24 @@ int unqlite_open(unqlite **ppDB,const char *zFilename,unsigned int iMode)
 			 rc = UNQLITE_NOMEM;
 			 goto Release;
 		 }
+		 /* Readers share the page cache under this one */
+		 pHandle->pReadMutex = SyMutexNew(sUnqlMPGlobal.pMutexMethods, SXMUTEX_TYPE_RECURSIVE);
+		 if( pHandle->pReadMutex == 0 ){
+			 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pHandle->pMutex);
+			 rc = UNQLITE_NOMEM;
+			 goto Release;
+		 }
+		 /* Gates of the group commit */
+		 pHandle->apCommitGate[0] = SyMutexNew(sUnqlMPGlobal.pMutexMethods, SXMUTEX_TYPE_FAST);
+		 pHandle->apCommitGate[1] = SyMutexNew(sUnqlMPGlobal.pMutexMethods, SXMUTEX_TYPE_FAST);
+		 if( pHandle->apCommitGate[0] == 0 || pHandle->apCommitGate[1] == 0 ){
+			 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pHandle->apCommitGate[0]);
+			 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pHandle->apCommitGate[1]);
+			 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pHandle->pReadMutex);
+			 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pHandle->pMutex);
+			 rc = UNQLITE_NOMEM;
+			 goto Release;
+		 }
 	 }
 #endif
 	/* Link to the list of active DB handles */
@@ -4391,6 +4901,8 @@ int unqlite_config(unqlite *pDb,int nConfigOp,...)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 va_start(ap, nConfigOp);
 	 rc = unqliteConfigure(&(*pDb),nConfigOp, ap);
@@ -4418,6 +4930,10 @@ int unqlite_close(unqlite *pDb)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Let the group commit in progress complete */
+	 unqliteCommitDrain(pDb);
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	/* Release the database handle */
 	rc = unqliteDbRelease(pDb);
@@ -4426,6 +4942,9 @@ int unqlite_close(unqlite *pDb)
 	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
 	 /* Release DB mutex */
 	 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pDb->pMutex) /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex) /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pDb->apCommitGate[0]) /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 SyMutexRelease(sUnqlMPGlobal.pMutexMethods, pDb->apCommitGate[1]) /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
 #endif
 #if defined(UNQLITE_ENABLE_THREADS)
 	/* Enter the global mutex */
@@ -4460,6 +4979,8 @@ int unqlite_compile(unqlite *pDb,const char *zJx9,int nByte,unqlite_vm **ppOut)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT;
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Compile the Jx9 script first */
 	 rc = jx9_compile(pDb->sDB.pJx9,zJx9,nByte,&pVm);
@@ -4495,6 +5016,8 @@ int unqlite_compile_file(unqlite *pDb,const char *zPath,unqlite_vm **ppOut)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT;
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Compile the Jx9 script first */
 	rc = jx9_compile_file(pDb->sDB.pJx9,zPath,&pVm);
@@ -4517,8 +5040,39 @@ int unqlite_compile_file(unqlite *pDb,const char *zPath,unqlite_vm **ppOut)
  */
 static int unqliteVmConfig(unqlite_vm *pVm,sxi32 iOp,va_list ap)
 {
-	int rc;
-	rc = jx9VmConfigure(pVm->pJx9Vm,iOp,ap);
+	int rc = UNQLITE_OK;
+	switch(iOp){
+	case UNQLITE_VM_CONFIG_RECORD_CACHE:{
+		/* Collection record cache budget */
+		unsigned int nMax = va_arg(ap,unsigned int);
+		pVm->nRecMax = (sxu32)nMax;
+		/* Shrink the cache now */
+		unqliteVmEvictRecords(pVm,pVm->nRecMax);
+		break;
+										}
+	case UNQLITE_VM_CONFIG_RECORD_CACHE_STATS:{
+		/* Collection record cache statistics */
+		unqlite_record_cache_stats *pStats = va_arg(ap,unqlite_record_cache_stats *);
+		int bReset = va_arg(ap,int);
+		if( pStats == 0 ){
+			rc = UNQLITE_CORRUPT;
+			break;
+		}
+		pStats->nHit = pVm->nRecHit;
+		pStats->nMiss = pVm->nRecMiss;
+		pStats->nEvict = pVm->nRecEvict;
+		pStats->nRecord = pVm->nRecCached;
+		pStats->nByte = pVm->nRecByte;
+		pStats->nMaxByte = pVm->nRecMax;
+		if( bReset ){
+			pVm->nRecHit = pVm->nRecMiss = pVm->nRecEvict = 0;
+		}
+		break;
+											  }
+	default:
+		rc = jx9VmConfigure(pVm->pJx9Vm,iOp,ap);
+		break;
+	}
 	return rc;
 }
 /*
@@ -4569,6 +5123,13 @@ int unqlite_vm_exec(unqlite_vm *pVm)
 #endif
 	/* Execute the Jx9 bytecode program */
 	 rc = jx9VmByteCodeExec(pVm->pJx9Vm);
+	 if( pVm->iCol > 0 ){
+		 /* Write the collection headers deferred by the stores */
+		 int rc2 = unqliteVmSyncCollections(pVm);
+		 if( rc == UNQLITE_OK ){
+			 rc = rc2;
+		 }
+	 }
 #if defined(UNQLITE_ENABLE_THREADS)
 	 /* Leave DB mutex */
 	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pVm->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
@@ -4611,6 +5172,8 @@ int unqlite_vm_release(unqlite_vm *pVm)
 				UNQLITE_THRD_DB_RELEASE(pDb) ){
 					return UNQLITE_ABORT; /* Another thread have released this instance */
 			}
+			/* Wait for the concurrent readers to leave */
+			unqliteWaitReaders(pDb);
 #endif
 		MACRO_LD_REMOVE(pDb->pVms, pVm);
 		pDb->iVm--;
@@ -5444,6 +6007,8 @@ int unqlite_kv_store(unqlite *pDb,const void *pKey,int nKeyLen,const void *pData
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5488,6 +6053,8 @@ int unqlite_kv_store_fmt(unqlite *pDb,const void *pKey,int nKeyLen,const char *z
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5541,6 +6108,8 @@ int unqlite_kv_append(unqlite *pDb,const void *pKey,int nKeyLen,const void *pDat
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5585,6 +6154,8 @@ int unqlite_kv_append_fmt(unqlite *pDb,const void *pKey,int nKeyLen,const char *
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5634,23 +6205,24 @@ int unqlite_kv_fetch(unqlite *pDb,const void *pKey,int nKeyLen,void *pBuf,unqlit
 		return UNQLITE_CORRUPT;
 	}
 #if defined(UNQLITE_ENABLE_THREADS)
-	 /* Acquire DB mutex */
-	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
-	 if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
-		 UNQLITE_THRD_DB_RELEASE(pDb) ){
-			 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 /* Acquire a shared lock on the DB */
+	 if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
 	 pMethods = pEngine->pIo->pMethods;
-	 pCur = pDb->sDB.pCursor;
+	 rc = unqliteReadCursorAcquire(pDb,&pCur);
+	 if( rc != UNQLITE_OK ){
+		 goto leave;
+	 }
 	 if( nKeyLen < 0 ){
 		 /* Assume a null terminated string and compute it's length */
 		 nKeyLen = SyStrlen((const char *)pKey);
 	 }
 	 if( !nKeyLen ){
-		  unqliteGenError(pDb,"Empty key");
+		  unqliteReadError(pDb,"Empty key");
 		  rc = UNQLITE_EMPTY;
 	 }else{
 		  /* Seek to the record position */
@@ -5672,9 +6244,11 @@ int unqlite_kv_fetch(unqlite *pDb,const void *pKey,int nKeyLen,void *pBuf,unqlit
 			 SyBlobRelease(&sBlob);
 		 }
 	 }
+	 unqliteReadCursorRelease(pDb,pCur);
+leave:
 #if defined(UNQLITE_ENABLE_THREADS)
-	 /* Leave DB mutex */
-	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 /* Release the shared lock */
+	 unqliteLeaveShared(pDb);
 #endif
 	return rc;
 }
@@ -5692,23 +6266,24 @@ int unqlite_kv_fetch_callback(unqlite *pDb,const void *pKey,int nKeyLen,int (*xC
 		return UNQLITE_CORRUPT;
 	}
 #if defined(UNQLITE_ENABLE_THREADS)
-	 /* Acquire DB mutex */
-	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
-	 if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
-		 UNQLITE_THRD_DB_RELEASE(pDb) ){
-			 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 /* Acquire a shared lock on the DB */
+	 if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
 	 pMethods = pEngine->pIo->pMethods;
-	 pCur = pDb->sDB.pCursor;
+	 rc = unqliteReadCursorAcquire(pDb,&pCur);
+	 if( rc != UNQLITE_OK ){
+		 goto leave;
+	 }
 	 if( nKeyLen < 0 ){
 		 /* Assume a null terminated string and compute it's length */
 		 nKeyLen = SyStrlen((const char *)pKey);
 	 }
 	 if( !nKeyLen ){
-		 unqliteGenError(pDb,"Empty key");
+		 unqliteReadError(pDb,"Empty key");
 		 rc = UNQLITE_EMPTY;
 	 }else{
 		 /* Seek to the record position */
@@ -5718,9 +6293,11 @@ int unqlite_kv_fetch_callback(unqlite *pDb,const void *pKey,int nKeyLen,int (*xC
 		 /* Consume the data directly */
 		 rc = pMethods->xData(pCur,xConsumer,pUserData);	 
 	 }
+	 unqliteReadCursorRelease(pDb,pCur);
+leave:
 #if defined(UNQLITE_ENABLE_THREADS)
-	 /* Leave DB mutex */
-	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 /* Release the shared lock */
+	 unqliteLeaveShared(pDb);
 #endif
 	return rc;
 }
@@ -5744,6 +6321,8 @@ int unqlite_kv_delete(unqlite *pDb,const void *pKey,int nKeyLen)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5776,6 +6355,272 @@ int unqlite_kv_delete(unqlite *pDb,const void *pKey,int nKeyLen)
 #endif
 	return rc;
 }
+/*
+ * [CAPIREF: unqlite_kv_store_batch()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_kv_store_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,const void **apData,const unqlite_int64 *anDataLen)
+{
+	unqlite_kv_engine *pEngine;
+	int nKeyLen;
+	int bJoin;
+	int rc,i;
+	if( UNQLITE_DB_MISUSE(pDb) || (nEntry > 0 && (apKey == 0 || apData == 0 || anDataLen == 0)) ){
+		return UNQLITE_CORRUPT;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Acquire DB mutex */
+	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
+		 UNQLITE_THRD_DB_RELEASE(pDb) ){
+			 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
+#endif
+	 /* If a write-transaction is already open (unqlite_begin() or previous writes),
+	  * the batch joins it and the caller commits or rolls back the whole transaction.
+	  * This must be checked first, loading the storage engine of a new database
+	  * opens one.
+	  */
+	 bJoin = unqlitePagerInWriteTransaction(pDb->sDB.pPager);
+	 /* Point to the underlying storage engine */
+	 pEngine = unqlitePagerGetKvEngine(pDb);
+	 if( pEngine->pIo->pMethods->xReplace == 0 ){
+		 /* Storage engine does not implement such method */
+		 unqliteGenError(pDb,"xReplace() method not implemented in the underlying storage engine");
+		 rc = UNQLITE_NOTIMPLEMENTED;
+	 }else{
+		 /* Reject empty keys before anything is stored */
+		 rc = UNQLITE_OK;
+		 for( i = 0 ; i < nEntry ; ++i ){
+			 nKeyLen = anKeyLen ? anKeyLen[i] : -1;
+			 if( nKeyLen == 0 || (nKeyLen < 0 && ((const char *)apKey[i])[0] == 0) ){
+				 unqliteGenError(pDb,"Empty key");
+				 rc = UNQLITE_EMPTY;
+				 break;
+			 }
+		 }
+		 if( rc == UNQLITE_OK ){
+			 /* The whole batch is stored in a single write-transaction */
+			 if( !bJoin ){
+				 rc = unqlitePagerBegin(pDb->sDB.pPager);
+			 }
+			 for( i = 0 ; rc == UNQLITE_OK && i < nEntry ; ++i ){
+				 nKeyLen = anKeyLen ? anKeyLen[i] : -1;
+				 if( nKeyLen < 0 ){
+					 /* Assume a null terminated string and compute it's length */
+					 nKeyLen = SyStrlen((const char *)apKey[i]);
+				 }
+				 /* Perform the requested operation */
+				 rc = pEngine->pIo->pMethods->xReplace(pEngine,apKey[i],nKeyLen,apData[i],anDataLen[i]);
+			 }
+			 if( !bJoin ){
+				 if( rc == UNQLITE_OK ){
+					 /* Commit the batch */
+					 rc = unqlitePagerCommit(pDb->sDB.pPager);
+				 }else{
+					 /* Discard the partially stored batch */
+					 unqlitePagerRollback(pDb->sDB.pPager,TRUE);
+				 }
+			 }
+		 }
+	 }
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Leave DB mutex */
+	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+#endif
+	return rc;
+}
+/*
+ * A single lookup of a batched fetch operation.
+ */
+typedef struct unqlite_batch_entry unqlite_batch_entry;
+struct unqlite_batch_entry
+{
+	unqlite_int64 iBucket; /* Bucket hosting the key (Storage engine specific) */
+	int iEntry;            /* Index of the key in the caller's array */
+	int nKeyLen;           /* Key length */
+};
+/*
+ * Sort batch entries by bucket number using a stable bottom-up merge sort.
+ * Keys hosted in the same bucket (i.e. page) are thus looked up one after another
+ * and keys that share a bucket keep the order supplied by the caller.
+ */
+static void unqliteBatchSort(unqlite_batch_entry *aEntry,unqlite_batch_entry *aTmp,int nEntry)
+{
+	int nWidth,iLeft,iMid,iEnd,i,j,n;
+	for( nWidth = 1 ; nWidth < nEntry ; nWidth <<= 1 ){
+		n = 0;
+		for( iLeft = 0 ; iLeft < nEntry ; iLeft += nWidth << 1 ){
+			iMid = iLeft + nWidth;
+			if( iMid > nEntry ){
+				iMid = nEntry;
+			}
+			iEnd = iMid + nWidth;
+			if( iEnd > nEntry ){
+				iEnd = nEntry;
+			}
+			i = iLeft;
+			j = iMid;
+			while( i < iMid && j < iEnd ){
+				if( aEntry[j].iBucket < aEntry[i].iBucket ){
+					aTmp[n++] = aEntry[j++];
+				}else{
+					aTmp[n++] = aEntry[i++];
+				}
+			}
+			while( i < iMid ){
+				aTmp[n++] = aEntry[i++];
+			}
+			while( j < iEnd ){
+				aTmp[n++] = aEntry[j++];
+			}
+		}
+		SyMemcpy((const void *)aTmp,(void *)aEntry,(sxu32)(nEntry * sizeof(unqlite_batch_entry)));
+	}
+}
+/*
+ * Forward the data of a batched lookup to the caller's consumer callback.
+ */
+struct unqlite_batch_consumer
+{
+	int (*xConsumer)(int,const void *,unsigned int,void *); /* Caller's consumer callback */
+	void *pUserData; /* Last argument to xConsumer() */
+	int iEntry;      /* Index of the key being consumed */
+};
+static int unqliteBatchConsumer(const void *pData,unsigned int nLen,void *pUserData)
+{
+	struct unqlite_batch_consumer *pConsumer = (struct unqlite_batch_consumer *)pUserData;
+	int rc;
+	rc = pConsumer->xConsumer(pConsumer->iEntry,pData,nLen,pConsumer->pUserData);
+	return rc;
+}
+/*
+ * Invoke the xConfig() method of the underlying storage engine.
+ */
+static int unqliteKvEngineConfig(unqlite_kv_engine *pEngine,int iOp,...)
+{
+	va_list ap;
+	int rc;
+	if( pEngine->pIo->pMethods->xConfig == 0 ){
+		return UNQLITE_NOTIMPLEMENTED;
+	}
+	va_start(ap,iOp);
+	rc = pEngine->pIo->pMethods->xConfig(pEngine,iOp,ap);
+	va_end(ap);
+	return rc;
+}
+/*
+ * [CAPIREF: unqlite_kv_fetch_batch()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_kv_fetch_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,int (*xConsumer)(int,const void *,unsigned int,void *),void *pUserData,int *aRc)
+{
+	struct unqlite_batch_consumer sConsumer;
+	unqlite_batch_entry *aEntry,*pEntry;
+	unqlite_kv_methods *pMethods;
+	unqlite_kv_engine *pEngine;
+	unqlite_kv_cursor *pCur;
+	int bSort,rc,i;
+	if( UNQLITE_DB_MISUSE(pDb) || (nEntry > 0 && apKey == 0) ){
+		return UNQLITE_CORRUPT;
+	}
+	if( nEntry < 1 ){
+		/* Nothing to fetch */
+		return UNQLITE_OK;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Acquire a shared lock on the DB */
+	 if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 }
+#endif
+	 /* Point to the underlying storage engine */
+	 pEngine = unqlitePagerGetKvEngine(pDb);
+	 pMethods = pEngine->pIo->pMethods;
+	 rc = unqliteReadCursorAcquire(pDb,&pCur);
+	 if( rc != UNQLITE_OK ){
+		 goto leave;
+	 }
+	 /* Lookup entries followed by the merge sort working space */
+#if defined(UNQLITE_ENABLE_THREADS)
+	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+	 aEntry = (unqlite_batch_entry *)SyMemBackendAlloc(&pDb->sMem,(sxu32)(2 * nEntry * sizeof(unqlite_batch_entry)));
+#if defined(UNQLITE_ENABLE_THREADS)
+	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+	 if( aEntry == 0 ){
+		 unqliteReadError(pDb,"unQLite is running out of memory");
+		 rc = UNQLITE_NOMEM;
+		 goto done;
+	 }
+	 bSort = 1;
+	 for( i = 0 ; i < nEntry ; ++i ){
+		 pEntry = &aEntry[i];
+		 pEntry->iEntry = i;
+		 pEntry->iBucket = 0;
+		 pEntry->nKeyLen = anKeyLen ? anKeyLen[i] : -1;
+		 if( pEntry->nKeyLen < 0 ){
+			 /* Assume a null terminated string and compute it's length */
+			 pEntry->nKeyLen = SyStrlen((const char *)apKey[i]);
+		 }
+		 if( bSort && pEntry->nKeyLen > 0 ){
+			 /* Ask the storage engine for the bucket hosting this key */
+			 rc = unqliteKvEngineConfig(pEngine,UNQLITE_KV_CONFIG_GET_BUCKET,apKey[i],pEntry->nKeyLen,&pEntry->iBucket);
+			 if( rc != UNQLITE_OK ){
+				 /* Unsupported by the storage engine, perform the lookups in the caller's order */
+				 bSort = 0;
+			 }
+		 }
+	 }
+	 if( bSort ){
+		 unqliteBatchSort(aEntry,&aEntry[nEntry],nEntry);
+	 }
+	 sConsumer.xConsumer = xConsumer;
+	 sConsumer.pUserData = pUserData;
+	 rc = UNQLITE_OK;
+	 for( i = 0 ; i < nEntry ; ++i ){
+		 pEntry = &aEntry[i];
+		 if( !pEntry->nKeyLen ){
+			 rc = UNQLITE_EMPTY;
+		 }else{
+			 /* Seek to the record position */
+			 rc = pMethods->xSeek(pCur,apKey[pEntry->iEntry],pEntry->nKeyLen,UNQLITE_CURSOR_MATCH_EXACT);
+			 if( rc == UNQLITE_OK && xConsumer ){
+				 /* Consume the data directly */
+				 sConsumer.iEntry = pEntry->iEntry;
+				 rc = pMethods->xData(pCur,unqliteBatchConsumer,&sConsumer);
+			 }
+		 }
+		 if( aRc ){
+			 aRc[pEntry->iEntry] = rc;
+		 }
+		 if( rc == UNQLITE_NOTFOUND || rc == UNQLITE_EMPTY ){
+			 /* Missing records are reported in aRc[] only */
+			 rc = UNQLITE_OK;
+		 }else if( rc != UNQLITE_OK ){
+			 /* IO error or abort request from the consumer */
+			 break;
+		 }
+	 }
+#if defined(UNQLITE_ENABLE_THREADS)
+	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+	 SyMemBackendFree(&pDb->sMem,aEntry);
+#if defined(UNQLITE_ENABLE_THREADS)
+	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods, pDb->pReadMutex);
+#endif
+done:
+	 unqliteReadCursorRelease(pDb,pCur);
+leave:
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Release the shared lock */
+	 unqliteLeaveShared(pDb);
+#endif
+	return rc;
+}
 /*
  * [CAPIREF: unqlite_kv_config()]
  * Please refer to the official documentation for function purpose and expected parameters.
@@ -5794,6 +6639,8 @@ int unqlite_kv_config(unqlite *pDb,int iOp,...)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Point to the underlying storage engine */
 	 pEngine = unqlitePagerGetKvEngine(pDb);
@@ -5807,6 +6654,12 @@ int unqlite_kv_config(unqlite *pDb,int iOp,...)
 		 va_start(ap,iOp);
 		 rc = pEngine->pIo->pMethods->xConfig(pEngine,iOp,ap);
 		 va_end(ap);
+		 if( rc == UNQLITE_OK ){
+			 /* Remember the installed callbacks for the snapshot engines */
+			 va_start(ap,iOp);
+			 unqlitePagerSaveKvConfig(pDb->sDB.pPager,iOp,ap);
+			 va_end(ap);
+		 }
 	 }
 #if defined(UNQLITE_ENABLE_THREADS)
 	 /* Leave DB mutex */
@@ -5831,7 +6684,11 @@ int unqlite_kv_cursor_init(unqlite *pDb,unqlite_kv_cursor **ppOut)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
+	 /* Make sure the storage engine recorded in the database header is installed */
+	 unqlitePagerGetKvEngine(pDb);
 	 /* Allocate a new cursor */
 	 rc = unqliteInitCursor(pDb,ppOut);
 #if defined(UNQLITE_ENABLE_THREADS)
@@ -5857,6 +6714,8 @@ int unqlite_kv_cursor_release(unqlite *pDb,unqlite_kv_cursor *pCur)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Release the cursor */
 	 rc = unqliteReleaseCursor(pDb,pCur);
@@ -5873,10 +6732,20 @@ int unqlite_kv_cursor_release(unqlite *pDb,unqlite_kv_cursor *pCur)
 int unqlite_kv_cursor_first_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xFirst == 0 ){
@@ -5885,6 +6754,10 @@ int unqlite_kv_cursor_first_entry(unqlite_kv_cursor *pCursor)
 		/* Seek to the first entry */
 		rc = pCursor->pStore->pIo->pMethods->xFirst(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -5894,10 +6767,20 @@ int unqlite_kv_cursor_first_entry(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_last_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xLast == 0 ){
@@ -5906,6 +6789,10 @@ int unqlite_kv_cursor_last_entry(unqlite_kv_cursor *pCursor)
 		/* Seek to the last entry */
 		rc = pCursor->pStore->pIo->pMethods->xLast(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -5915,10 +6802,20 @@ int unqlite_kv_cursor_last_entry(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_valid_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xValid == 0 ){
@@ -5926,6 +6823,10 @@ int unqlite_kv_cursor_valid_entry(unqlite_kv_cursor *pCursor)
 	}else{
 		rc = pCursor->pStore->pIo->pMethods->xValid(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -5935,10 +6836,20 @@ int unqlite_kv_cursor_valid_entry(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_next_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xNext == 0 ){
@@ -5947,6 +6858,10 @@ int unqlite_kv_cursor_next_entry(unqlite_kv_cursor *pCursor)
 		/* Seek to the next entry */
 		rc = pCursor->pStore->pIo->pMethods->xNext(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -5956,10 +6871,20 @@ int unqlite_kv_cursor_next_entry(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_prev_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xPrev == 0 ){
@@ -5968,6 +6893,10 @@ int unqlite_kv_cursor_prev_entry(unqlite_kv_cursor *pCursor)
 		/* Seek to the previous entry */
 		rc = pCursor->pStore->pIo->pMethods->xPrev(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -5977,10 +6906,28 @@ int unqlite_kv_cursor_prev_entry(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_delete_entry(unqlite_kv_cursor *pCursor)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire DB mutex */
+	pDb = unqliteCursorDb(pCursor);
+	if( pDb == 0 ){
+		/* Snapshots are read-only */
+		return UNQLITE_READ_ONLY;
+	}
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
+		UNQLITE_THRD_DB_RELEASE(pDb) ){
+			return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
+	/* Wait for the concurrent readers to leave */
+	unqliteWaitReaders(pDb);
 #endif
 	/* Check if the requested method is implemented by the underlying storage engine */
 	if( pCursor->pStore->pIo->pMethods->xDelete == 0 ){
@@ -5989,6 +6936,10 @@ int unqlite_kv_cursor_delete_entry(unqlite_kv_cursor *pCursor)
 		/* Delete the entry */
 		rc = pCursor->pStore->pIo->pMethods->xDelete(pCursor);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Leave DB mutex */
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+#endif
 	return rc;
 }
 /*
@@ -6019,6 +6970,9 @@ int unqlite_kv_cursor_reset(unqlite_kv_cursor *pCursor)
 int unqlite_kv_cursor_seek(unqlite_kv_cursor *pCursor,const void *pKey,int nKeyLen,int iPos)
 {
 	int rc = UNQLITE_OK;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
@@ -6028,12 +6982,23 @@ int unqlite_kv_cursor_seek(unqlite_kv_cursor *pCursor,const void *pKey,int nKeyL
 		/* Assume a null terminated string and compute it's length */
 		nKeyLen = SyStrlen((const char *)pKey);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
+#endif
 	if( !nKeyLen ){
 		rc = UNQLITE_EMPTY;
 	}else{
 		/* Seek to the desired location */
 		rc = pCursor->pStore->pIo->pMethods->xSeek(pCursor,pKey,nKeyLen,iPos);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -6058,13 +7023,27 @@ UNQLITE_PRIVATE int unqliteDataConsumer(
 int unqlite_kv_cursor_key_callback(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Consume the key directly */
 	rc = pCursor->pStore->pIo->pMethods->xKey(pCursor,xConsumer,pUserData);
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -6074,19 +7053,29 @@ int unqlite_kv_cursor_key_callback(unqlite_kv_cursor *pCursor,int (*xConsumer)(c
 int unqlite_kv_cursor_key(unqlite_kv_cursor *pCursor,void *pBuf,int *pnByte)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+	if( pBuf && (*pnByte) < 0 ){
+		return UNQLITE_CORRUPT;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	if( pBuf == 0 ){
 		/* Key length only */
 		rc = pCursor->pStore->pIo->pMethods->xKeyLength(pCursor,pnByte);
 	}else{
 		SyBlob sBlob;
-		if( (*pnByte) < 0 ){
-			return UNQLITE_CORRUPT;
-		}
 		/* Initialize the data consumer */
 		SyBlobInitFromBuf(&sBlob,pBuf,(sxu32)(*pnByte));
 		/* Consume the key */
@@ -6096,6 +7085,10 @@ int unqlite_kv_cursor_key(unqlite_kv_cursor *pCursor,void *pBuf,int *pnByte)
 		/* Cleanup */
 		SyBlobRelease(&sBlob);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -6105,13 +7098,27 @@ int unqlite_kv_cursor_key(unqlite_kv_cursor *pCursor,void *pBuf,int *pnByte)
 int unqlite_kv_cursor_data_callback(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	/* Consume the data directly */
 	rc = pCursor->pStore->pIo->pMethods->xData(pCursor,xConsumer,pUserData);
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
 /*
@@ -6121,19 +7128,29 @@ int unqlite_kv_cursor_data_callback(unqlite_kv_cursor *pCursor,int (*xConsumer)(
 int unqlite_kv_cursor_data(unqlite_kv_cursor *pCursor,void *pBuf,unqlite_int64 *pnByte)
 {
 	int rc;
+#if defined(UNQLITE_ENABLE_THREADS)
+	unqlite *pDb;
+#endif
 #ifdef UNTRUST
 	if( pCursor == 0 ){
 		return UNQLITE_CORRUPT;
 	}
+#endif
+	if( pBuf && (*pnByte) < 0 ){
+		return UNQLITE_CORRUPT;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Acquire a shared lock on the DB */
+	pDb = unqliteCursorDb(pCursor);
+	if( unqliteEnterShared(pDb) != UNQLITE_OK ){
+		return UNQLITE_ABORT; /* Another thread have released this instance */
+	}
 #endif
 	if( pBuf == 0 ){
 		/* Data length only */
 		rc = pCursor->pStore->pIo->pMethods->xDataLength(pCursor,pnByte);
 	}else{
 		SyBlob sBlob;
-		if( (*pnByte) < 0 ){
-			return UNQLITE_CORRUPT;
-		}
 		/* Initialize the data consumer */
 		SyBlobInitFromBuf(&sBlob,pBuf,(sxu32)(*pnByte));
 		/* Consume the data */
@@ -6143,8 +7160,89 @@ int unqlite_kv_cursor_data(unqlite_kv_cursor *pCursor,void *pBuf,unqlite_int64 *
 		/* Cleanup */
 		SyBlobRelease(&sBlob);
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Release the shared lock */
+	unqliteLeaveShared(pDb);
+#endif
 	return rc;
 }
+/*
+ * [CAPIREF: unqlite_snapshot_open()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_snapshot_open(unqlite *pDb,unqlite_snapshot **ppOut)
+{
+	int rc;
+	if( UNQLITE_DB_MISUSE(pDb) || ppOut == 0 /* Noop */){
+		return UNQLITE_CORRUPT;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Acquire DB mutex */
+	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
+		 UNQLITE_THRD_DB_RELEASE(pDb) ){
+			 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
+#endif
+	 /* Take the snapshot */
+	 rc = unqlitePagerSnapshotOpen(pDb->sDB.pPager,ppOut);
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Leave DB mutex */
+	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+#endif
+	 return rc;
+}
+/*
+ * [CAPIREF: unqlite_snapshot_release()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_snapshot_release(unqlite *pDb,unqlite_snapshot *pSnap)
+{
+	int rc;
+	if( UNQLITE_DB_MISUSE(pDb) || pSnap == 0 /* Noop */){
+		return UNQLITE_CORRUPT;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Acquire DB mutex */
+	 SyMutexEnter(sUnqlMPGlobal.pMutexMethods, pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+	 if( sUnqlMPGlobal.nThreadingLevel > UNQLITE_THREAD_LEVEL_SINGLE && 
+		 UNQLITE_THRD_DB_RELEASE(pDb) ){
+			 return UNQLITE_ABORT; /* Another thread have released this instance */
+	 }
+#endif
+	 /* Release the snapshot */
+	 rc = unqlitePagerSnapshotRelease(pSnap);
+#if defined(UNQLITE_ENABLE_THREADS)
+	 /* Leave DB mutex */
+	 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex); /* NO-OP if sUnqlMPGlobal.nThreadingLevel != UNQLITE_THREAD_LEVEL_MULTI */
+#endif
+	 return rc;
+}
+/*
+ * [CAPIREF: unqlite_snapshot_cursor_init()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_snapshot_cursor_init(unqlite_snapshot *pSnap,unqlite_kv_cursor **ppOut)
+{
+	if( pSnap == 0 || ppOut == 0 /* Noop */){
+		return UNQLITE_CORRUPT;
+	}
+	/* Snapshot cursors do not need the DB mutex */
+	return unqliteSnapshotInitCursor(pSnap,ppOut);
+}
+/*
+ * [CAPIREF: unqlite_snapshot_cursor_release()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int unqlite_snapshot_cursor_release(unqlite_snapshot *pSnap,unqlite_kv_cursor *pCur)
+{
+	if( pSnap == 0 || pCur == 0 /* Noop */){
+		return UNQLITE_CORRUPT;
+	}
+	return unqliteSnapshotReleaseCursor(pSnap,pCur);
+}
 /*
  * [CAPIREF: unqlite_begin()]
  * Please refer to the official documentation for function purpose and expected parameters.
@@ -6162,6 +7260,8 @@ int unqlite_begin(unqlite *pDb)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Begin the write transaction */
 	 rc = unqlitePagerBegin(pDb->sDB.pPager);
@@ -6171,6 +7271,104 @@ int unqlite_begin(unqlite *pDb)
 #endif
 	 return rc;
 }
+#if defined(UNQLITE_ENABLE_THREADS)
+/*
+ * Record the thread changing the database (UNQLITE_CONFIG_COMMIT_WINDOW).
+ * The commit window is only opened if another thread changed the database
+ * since the last commit, a lone writer commits right away.
+ * This routine must be called with the DB mutex held.
+ */
+UNQLITE_PRIVATE void unqliteCommitNoteWriter(unqlite *pDb)
+{
+#if defined(SX_THREAD_LOCAL)
+	static SX_THREAD_LOCAL char cWriter = 0; /* Its address identify the calling thread */
+	if( pDb->pCommitWriter == 0 ){
+		pDb->pCommitWriter = (const void *)&cWriter;
+	}else if( pDb->pCommitWriter != (const void *)&cWriter ){
+		pDb->bCommitShared = 1;
+	}
+#else
+	/* Threads cannot be told apart, assume they all write */
+	pDb->bCommitShared = 1;
+#endif
+}
+/*
+ * Group commit (UNQLITE_CONFIG_COMMIT_WINDOW).
+ *
+ * If another thread changed the database since the last commit, the first thread to
+ * request a commit become the leader of a new group: It hold the gate of the group and
+ * release the DB mutex for the duration of the commit window so that other threads can
+ * complete their work and join the group by requesting a commit themselves. Members
+ * block on the gate until the group number changes. The leader then perform a single
+ * commit (one journal flush and one sync) on behalf of the whole group, hand its result
+ * to each member and open the gate.
+ * Consecutive groups use alternate gates so that the next group can start gathering
+ * before the members of the previous one left.
+ *
+ * While a group is gathering, rollbacks fail with UNQLITE_BUSY so that the changes of
+ * the group are not silently discarded, and unqlite_close() waits for the group.
+ *
+ * This routine must be called with the DB mutex held.
+ */
+static int unqliteGroupCommit(unqlite *pDb)
+{
+	const unqlite_vfs *pVfs;
+	unqlite_commit_member sMember,*pMember;
+	sxu32 iGroup,iGate,nWindow;
+	SyMutex *pGate;
+	int rc;
+	nWindow = pDb->nCommitWindow;
+	iGroup = pDb->iCommitGroup;
+	iGate = iGroup & 1;
+	pGate = pDb->apCommitGate[iGate];
+	if( pDb->bCommitLeader ){
+		/* Join the gathering group */
+		sMember.rc = UNQLITE_OK;
+		sMember.pNext = pDb->pCommitMember;
+		pDb->pCommitMember = &sMember;
+		pDb->anCommitPass[iGate]++;
+		while( pDb->iCommitGroup == iGroup ){
+			/* Wait for the leader to open the gate */
+			SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+			SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pGate);
+			SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pGate);
+			SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+		}
+		pDb->anCommitPass[iGate]--;
+		return sMember.rc;
+	}
+	if( !pDb->bCommitShared ){
+		/* No other thread is writing, commit right away */
+		rc = unqlitePagerCommit(pDb->sDB.pPager);
+		pDb->pCommitWriter = 0;
+		return rc;
+	}
+	/* Lead a new group. The gate is never entered with the DB mutex held */
+	pDb->bCommitLeader = 1;
+	pDb->pCommitMember = 0;
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pGate);
+	pVfs = unqliteExportBuiltinVfs();
+	if( pVfs && pVfs->xSleep ){
+		pVfs->xSleep((unqlite_vfs *)pVfs,(int)nWindow);
+	}
+	SyMutexEnter(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+	unqliteWaitReaders(pDb);
+	/* Commit on behalf of the whole group */
+	rc = unqlitePagerCommit(pDb->sDB.pPager);
+	for( pMember = pDb->pCommitMember ; pMember ; pMember = pMember->pNext ){
+		pMember->rc = rc;
+	}
+	pDb->pCommitMember = 0;
+	pDb->pCommitWriter = 0;
+	pDb->bCommitShared = 0;
+	pDb->bCommitLeader = 0;
+	pDb->iCommitGroup++;
+	/* Let the members go */
+	SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pGate);
+	return rc;
+}
+#endif /* UNQLITE_ENABLE_THREADS */
 /*
  * [CAPIREF: unqlite_commit()]
  * Please refer to the official documentation for function purpose and expected parameters.
@@ -6188,6 +7386,15 @@ int unqlite_commit(unqlite *pDb)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
+	 if( pDb->nCommitWindow > 0 && pDb->pMutex ){
+		 /* Merge with the commits requested by other threads */
+		 rc = unqliteGroupCommit(pDb);
+		 /* Leave DB mutex */
+		 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+		 return rc;
+	 }
 #endif
 	 /* Commit the transaction */
 	 rc = unqlitePagerCommit(pDb->sDB.pPager);
@@ -6214,6 +7421,13 @@ int unqlite_rollback(unqlite *pDb)
 		 UNQLITE_THRD_DB_RELEASE(pDb) ){
 			 return UNQLITE_ABORT; /* Another thread have released this instance */
 	 }
+	 if( pDb->bCommitLeader ){
+		 /* A group commit is gathering, its changes must not be discarded */
+		 SyMutexLeave(sUnqlMPGlobal.pMutexMethods,pDb->pMutex);
+		 return UNQLITE_BUSY;
+	 }
+	 /* Wait for the concurrent readers to leave */
+	 unqliteWaitReaders(pDb);
 #endif
 	 /* Rollback the transaction */
 	 rc = unqlitePagerRollback(pDb->sDB.pPager,TRUE);
@@ -6555,8 +7769,8 @@ UNQLITE_PRIVATE void unqliteBitvecDestroy(Bitvec *p)
 }
 /*
  * ----------------------------------------------------------
- * File: fastjson.c
- * MD5: 3693c0022edc7d37b65124d7aef68397
+ * File: btree_kv.c
+ * MD5: 11dc7a9edfe5841c65e57f48f24d5bd2
  * ----------------------------------------------------------
  */
 /*
@@ -6571,214 +7785,1950 @@ UNQLITE_PRIVATE void unqliteBitvecDestroy(Bitvec *p)
  * or visit:
  *      http://unqlite.org/licensing.html
  */
- /* $SymiscID: fastjson.c v1.1 FreeBSD 2012-12-05 22:52 stable <chm@symisc.net> $ */
 #ifndef UNQLITE_AMALGAMATION
 #include "unqliteInt.h"
 #endif
-/* JSON binary encoding, decoding and stuff like that */
-#ifndef UNQLITE_FAST_JSON_NEST_LIMIT
-#if defined(__WINNT__) || defined(__UNIXES__)
-#define UNQLITE_FAST_JSON_NEST_LIMIT 64 /* Nesting limit */
-#else
-#define UNQLITE_FAST_JSON_NEST_LIMIT 32 /* Nesting limit */
+/*
+ * This file implements a disk based B+Tree storage engine on top of the pager.
+ * Unlike the linear hash engine (lhash_kv.c), records are kept sorted by key
+ * so that cursors walk the database in key order and seek operations honor
+ * the UNQLITE_CURSOR_MATCH_LE and UNQLITE_CURSOR_MATCH_GE positions.
+ * Select this engine via unqlite_config(UNQLITE_CONFIG_KV_ENGINE,"btree")
+ * before the first read or write on a fresh database.
+ *
+ * On-disk format (all integers are Big-Endian):
+ *  Page one: 4 byte magic, 8 byte root page number, 8 byte head of the free list.
+ *  Node pages: 1 byte node type, 3 reserved bytes, 4 byte number of cells,
+ *  4 byte offset of the cell content area, 8 byte right sibling (leaf)
+ *  or right-most child (interior) page number, 8 byte left sibling (leaf).
+ *  The header is followed by an array of 2 byte cell offsets sorted by key.
+ *  Cell content grows from the end of the page toward its beginning.
+ *  Cell: 8 byte left child (interior only), 4 byte key length, 8 byte data
+ *  length (leaf only), 8 byte overflow page number followed by the local
+ *  payload (key followed by data). The payload that does not fit locally
+ *  is stored on a chain of overflow pages.
+ *  Overflow and free pages: 8 byte next page number followed by raw data.
+ * The subtree pointed by the left child of a cell hold keys that are strictly
+ * less than the cell key. The right-most child hold the remaining keys.
+ */
+/* Magic number identifying a valid B+Tree storage image */
+#define BT_MAGIC 0xB7E1A9C3
+/* Node types */
+#define BT_NODE_LEAF     1
+#define BT_NODE_INTERIOR 2
+/*
+ * Node header size on disk.
+ */
+#define BT_NODE_HDR_SZ (1/*Type*/+3/*Reserved*/+4/*Cell count*/+4/*Content offset*/+8/*Next*/+8/*Prev*/)
+/*
+ * Cell header size on disk.
+ */
+#define BT_CELL_HDR_SZ (8/*Left child*/+4/*Key*/+8/*Data*/+8/*Overflow*/)
+/*
+** The maximum number of bytes of payload allowed on a single overflow page.
+*/
+#define BT_OVERFLOW_SIZE(PageSize) (PageSize-8)
+/*
+ * The maximum amount of payload (in bytes) that can be stored locally for
+ * a single cell. Large enough so that at least four cells fit in a node.
+ */
+#define BT_MX_LOCAL(PageSize) (((PageSize - BT_NODE_HDR_SZ) >> 2) - (BT_CELL_HDR_SZ + 2))
+/*
+ * Maximum depth of the tree.
+ */
+#define BT_MAX_DEPTH 64
+/* Forward declaration */
+typedef struct bt_kv_engine bt_kv_engine;
+typedef struct bt_kv_cursor bt_kv_cursor;
+/*
+ * A processed cell.
+ */
+typedef struct bt_cell bt_cell;
+struct bt_cell
+{
+	pgno iChild;                /* Left child (Interior nodes only) */
+	sxu32 nKey;                 /* Key length */
+	sxu64 nData;                /* Data length (Leaf nodes only) */
+	pgno iOvfl;                 /* First overflow page if any */
+	const unsigned char *zLocal; /* Local payload */
+	sxu32 nLocal;               /* Local payload length */
+	sxu32 nSize;                /* Total size of the cell on disk */
+};
+/*
+ * A cell scheduled for writing on a node page.
+ */
+typedef struct bt_slot bt_slot;
+struct bt_slot
+{
+	const unsigned char *zCell; /* Raw cell */
+	sxu32 nSize;                /* Raw cell size */
+};
+/*
+ * Root to leaf path of a lookup.
+ */
+typedef struct bt_path bt_path;
+struct bt_path
+{
+	unqlite_page *apPage[BT_MAX_DEPTH]; /* Referenced node pages */
+	sxu32 aiIdx[BT_MAX_DEPTH];          /* Followed child (Interior) or cell (Leaf) index */
+	int nDepth;                         /* Total number of referenced pages */
+};
+/*
+ * Seek targets.
+ */
+#define BT_SEEK_KEY   1 /* Given key */
+#define BT_SEEK_FIRST 2 /* Smallest key */
+#define BT_SEEK_LAST  3 /* Largest key */
+/*
+ * An instance of the following structure describe the B+Tree storage engine.
+ */
+struct bt_kv_engine
+{
+	const unqlite_kv_io *pIo;     /* IO methods: Must be first */
+	/* Private fields */
+	SyMemBackend sAllocator;      /* Private memory backend */
+	ProcCmp xCmp;                 /* Default comparison function */
+	unqlite_page *pHeader;        /* Page one (B+Tree header) */
+	pgno iRoot;                   /* Root page number */
+	pgno nFreeList;               /* List of free pages */
+	int iPageSize;                /* Page size */
+	sxu32 nMaxLocal;              /* Maximum local payload */
+	unsigned char *zScratch;      /* Copy of the node being rewritten */
+	bt_slot *aSlot;               /* Cells of the node being rewritten */
+	SyBlob sKey;                  /* Large keys loaded for comparison */
+	SyBlob sWorker;               /* Data of the record being appended or key being deleted */
+	SyBlob sCell;                 /* Cell being inserted */
+	SyBlob aSep[2];               /* Separator cells pushed up on splits */
+	bt_kv_cursor *pCursor;        /* List of cursors holding a leaf copy */
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutex *pMutex;              /* Protect the cursor list from concurrent readers */
 #endif
-#endif /* UNQLITE_FAST_JSON_NEST_LIMIT */
-/* 
- * JSON to Binary using the FastJSON implementation (BigEndian).
+};
+/*
+ * Each public cursor is identified by an instance of this structure.
  */
+struct bt_kv_cursor
+{
+	unqlite_kv_engine *pStore; /* Must be first */
+	/* Private fields */
+	int iState;                /* Current state of the cursor */
+	unsigned char *zLeaf;      /* Private copy of the current leaf */
+	pgno iLeaf;                /* Current leaf page number */
+	sxu32 iCell;               /* Current cell */
+	sxu32 nCell;               /* Total cells on the current leaf */
+	SyBlob sKey;               /* Key of the current record saved before the tree was modified */
+	int bOnNext;               /* Saved record removed meanwhile, already pointing to its successor */
+	bt_kv_cursor *pNext,*pPrev; /* List of cursors holding a leaf copy */
+};
 /*
- * FastJSON implemented binary token.
+ * Possible state of the cursor
  */
-#define FJSON_DOC_START    1 /* { */
-#define FJSON_DOC_END      2 /* } */
-#define FJSON_ARRAY_START  3 /* [ */
-#define FJSON_ARRAY_END    4 /* ] */
-#define FJSON_COLON        5 /* : */
-#define FJSON_COMMA        6 /* , */
-#define FJSON_ID           7 /* ID + 4 Bytes length */
-#define FJSON_STRING       8 /* String + 4 bytes length */
-#define FJSON_BYTE         9 /* Byte */
-#define FJSON_INT64       10 /* Integer 64 + 8 bytes */
-#define FJSON_REAL        18 /* Floating point value + 2 bytes */
-#define FJSON_NULL        23 /* NULL */
-#define FJSON_TRUE        24 /* TRUE */
-#define FJSON_FALSE       25 /* FALSE */
+#define BT_CURSOR_STATE_CELL 1 /* Pointing to a valid cell */
+#define BT_CURSOR_STATE_DONE 2 /* Cursor does not point to anything */
+#define BT_CURSOR_STATE_SAVED 3 /* Tree modified since, seek the saved key again */
 /*
- * Encode a Jx9 value to binary JSON.
+ * Node header accessors.
  */
-UNQLITE_PRIVATE sxi32 FastJsonEncode(
-	jx9_value *pValue, /* Value to encode */
-	SyBlob *pOut,      /* Store encoded value here */
-	int iNest          /* Nesting limit */ 
-	)
+static sxu32 btNodeCount(const unsigned char *zNode)
 {
-	sxi32 iType = pValue ? pValue->iFlags : MEMOBJ_NULL;
-	sxi32 rc = SXRET_OK;
-	int c;
-	if( iNest >= UNQLITE_FAST_JSON_NEST_LIMIT ){
-		/* Nesting limit reached */
-		return SXERR_LIMIT;
+	sxu32 n;
+	SyBigEndianUnpack32(&zNode[4],&n);
+	return n;
+}
+static pgno btNodeNext(const unsigned char *zNode)
+{
+	pgno iNext;
+	SyBigEndianUnpack64(&zNode[12],&iNext);
+	return iNext;
+}
+static pgno btNodePrev(const unsigned char *zNode)
+{
+	pgno iPrev;
+	SyBigEndianUnpack64(&zNode[20],&iPrev);
+	return iPrev;
+}
+/*
+ * Local payload length of a cell.
+ */
+static sxu32 btLocalSize(bt_kv_engine *pEngine,int iType,sxu32 nKey,sxu64 nData)
+{
+	sxu64 nPayload = nKey;
+	if( iType == BT_NODE_LEAF ){
+		nPayload += nData;
 	}
-	if( iType & (MEMOBJ_NULL|MEMOBJ_RES) ){
-		/*
-		 * Resources are encoded as null also.
-		 */
-		c = FJSON_NULL;
-		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-	}else if( iType & MEMOBJ_BOOL ){
-		c = pValue->x.iVal ? FJSON_TRUE : FJSON_FALSE;
-		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-	}else if( iType & MEMOBJ_STRING ){
-		unsigned char zBuf[sizeof(sxu32)]; /* String length */
-		c = FJSON_STRING;
-		SyBigEndianPack32(zBuf,SyBlobLength(&pValue->sBlob));
-		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-		if( rc == SXRET_OK ){
-			rc = SyBlobAppend(pOut,(const void *)zBuf,sizeof(zBuf));
-			if( rc == SXRET_OK ){
-				rc = SyBlobAppend(pOut,SyBlobData(&pValue->sBlob),SyBlobLength(&pValue->sBlob));
-			}
+	if( nPayload > (sxu64)pEngine->nMaxLocal ){
+		return pEngine->nMaxLocal;
+	}
+	return (sxu32)nPayload;
+}
+/*
+ * Process a raw cell.
+ */
+static void btParseRawCell(bt_kv_engine *pEngine,int iType,const unsigned char *zRaw,bt_cell *pCell)
+{
+	SyBigEndianUnpack64(zRaw,&pCell->iChild);
+	SyBigEndianUnpack32(&zRaw[8],&pCell->nKey);
+	SyBigEndianUnpack64(&zRaw[12],&pCell->nData);
+	SyBigEndianUnpack64(&zRaw[20],&pCell->iOvfl);
+	pCell->zLocal = &zRaw[BT_CELL_HDR_SZ];
+	pCell->nLocal = btLocalSize(pEngine,iType,pCell->nKey,pCell->nData);
+	pCell->nSize = BT_CELL_HDR_SZ + pCell->nLocal;
+}
+/*
+ * Process the cell at index iCell of the given node.
+ */
+static void btParseCell(bt_kv_engine *pEngine,const unsigned char *zNode,sxu32 iCell,bt_cell *pCell)
+{
+	sxu16 iOfft;
+	SyBigEndianUnpack16(&zNode[BT_NODE_HDR_SZ + (iCell << 1)],&iOfft);
+	btParseRawCell(pEngine,zNode[0],&zNode[iOfft],pCell);
+}
+/*
+ * Child page number at index iIdx of an interior node.
+ */
+static pgno btNodeChild(bt_kv_engine *pEngine,const unsigned char *zNode,sxu32 iIdx)
+{
+	bt_cell sCell;
+	if( iIdx >= btNodeCount(zNode) ){
+		/* Right-most child */
+		return btNodeNext(zNode);
+	}
+	btParseCell(pEngine,zNode,iIdx,&sCell);
+	return sCell.iChild;
+}
+/*
+ * Acquire a page for writing and keep it out of the hot dirty list
+ * since the engine may reference it again before the commit.
+ */
+static int btPageWrite(bt_kv_engine *pEngine,unqlite_page *pPage)
+{
+	int rc;
+	rc = pEngine->pIo->xWrite(pPage);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	pEngine->pIo->xDontMkHot(pPage);
+	return UNQLITE_OK;
+}
+/*
+ * Write the B+Tree header (Page one).
+ */
+static int btWriteHeader(bt_kv_engine *pEngine)
+{
+	unsigned char *zRaw;
+	int rc;
+	rc = btPageWrite(pEngine,pEngine->pHeader);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	zRaw = pEngine->pHeader->zData;
+	/* 4 byte magic number */
+	SyBigEndianPack32(zRaw,BT_MAGIC);
+	/* Root page */
+	SyBigEndianPack64(&zRaw[4],pEngine->iRoot);
+	/* List of free pages */
+	SyBigEndianPack64(&zRaw[12],pEngine->nFreeList);
+	return UNQLITE_OK;
+}
+/*
+ * Allocate a new page either from the free list or from the end
+ * of the database file. The page is returned zeroed and writable.
+ */
+static int btPageAlloc(bt_kv_engine *pEngine,unqlite_page **ppOut)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	unqlite_page *pPage;
+	int rc;
+	if( pEngine->nFreeList > 0 ){
+		/* Recycle a free page */
+		rc = pIo->xGet(pIo->pHandle,pEngine->nFreeList,&pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
 		}
-	}else if( iType & MEMOBJ_INT ){
-		unsigned char zBuf[8];
-		/* 64bit big endian integer */
-		c = FJSON_INT64;
-		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-		if( rc == SXRET_OK ){
-			SyBigEndianPack64(zBuf,(sxu64)pValue->x.iVal);
-			rc = SyBlobAppend(pOut,(const void *)zBuf,sizeof(zBuf));
+		rc = btPageWrite(pEngine,pPage);
+		if( rc != UNQLITE_OK ){
+			pIo->xPageUnref(pPage);
+			return rc;
 		}
-	}else if( iType & MEMOBJ_REAL ){
-		/* Real number */
-		c = FJSON_REAL;
-		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-		if( rc == SXRET_OK ){
-			sxu32 iOfft = SyBlobLength(pOut);
-			rc = SyBlobAppendBig16(pOut,0);
-			if( rc == SXRET_OK ){
-				unsigned char *zBlob;
-				SyBlobFormat(pOut,"%.15g",pValue->x.rVal);
-				zBlob = (unsigned char *)SyBlobDataAt(pOut,iOfft);
-				SyBigEndianPack16(zBlob,(sxu16)(SyBlobLength(pOut) - ( 2 + iOfft)));
-			}
+		/* Unlink from the free list */
+		SyBigEndianUnpack64(pPage->zData,&pEngine->nFreeList);
+		rc = btWriteHeader(pEngine);
+		if( rc != UNQLITE_OK ){
+			pIo->xPageUnref(pPage);
+			return rc;
 		}
-	}else if( iType & MEMOBJ_HASHMAP ){
-		/* A JSON object or array */
-		jx9_hashmap *pMap = (jx9_hashmap *)pValue->x.pOther;
-		jx9_hashmap_node *pNode;
-		jx9_value *pEntry;
-		/* Reset the hashmap loop cursor */
-		jx9HashmapResetLoopCursor(pMap);
-		if( pMap->iFlags & HASHMAP_JSON_OBJECT ){
-			jx9_value sKey;
-			/* A JSON object */
-			c = FJSON_DOC_START; /* { */
-			rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-			if( rc == SXRET_OK ){
-				jx9MemObjInit(pMap->pVm,&sKey);
-				/* Encode object entries */
-				while((pNode = jx9HashmapGetNextEntry(pMap)) != 0 ){
-					/* Extract the key */
-					jx9HashmapExtractNodeKey(pNode,&sKey);
-					/* Encode it */
-					rc = FastJsonEncode(&sKey,pOut,iNest+1);
-					if( rc != SXRET_OK ){
-						break;
-					}
-					c = FJSON_COLON;
-					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-					if( rc != SXRET_OK ){
-						break;
-					}
-					/* Extract the value */
-					pEntry = jx9HashmapGetNodeValue(pNode);
-					/* Encode it */
-					rc = FastJsonEncode(pEntry,pOut,iNest+1);
-					if( rc != SXRET_OK ){
-						break;
-					}
-					/* Delimit the entry */
-					c = FJSON_COMMA;
-					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-					if( rc != SXRET_OK ){
-						break;
-					}
-				}
-				jx9MemObjRelease(&sKey);
-				if( rc == SXRET_OK ){
-					c = FJSON_DOC_END; /* } */
-					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-				}
-			}
-		}else{
-			/* A JSON array */
-			c = FJSON_ARRAY_START; /* [ */
-			rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-			if( rc == SXRET_OK ){
-				/* Encode array entries */
-				while( (pNode = jx9HashmapGetNextEntry(pMap)) != 0 ){
-					/* Extract the value */
-					pEntry = jx9HashmapGetNodeValue(pNode);
-					/* Encode it */
-					rc = FastJsonEncode(pEntry,pOut,iNest+1);
-					if( rc != SXRET_OK ){
-						break;
-					}
-					/* Delimit the entry */
-					c = FJSON_COMMA;
-					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-					if( rc != SXRET_OK ){
-						break;
-					}
-				}
-				if( rc == SXRET_OK ){
-					c = FJSON_ARRAY_END; /* ] */
-					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
-				}
-			}
+	}else{
+		rc = pIo->xNew(pIo->pHandle,&pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		rc = btPageWrite(pEngine,pPage);
+		if( rc != UNQLITE_OK ){
+			pIo->xPageUnref(pPage);
+			return rc;
 		}
 	}
+	SyZero(pPage->zData,(sxu32)pEngine->iPageSize);
+	*ppOut = pPage;
+	return UNQLITE_OK;
+}
+/*
+ * Link a page to the list of free pages.
+ */
+static int btPageFree(bt_kv_engine *pEngine,unqlite_page *pPage)
+{
+	int rc;
+	rc = btPageWrite(pEngine,pPage);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	SyBigEndianPack64(pPage->zData,pEngine->nFreeList);
+	pEngine->nFreeList = pPage->pgno;
+	rc = btWriteHeader(pEngine);
 	return rc;
 }
 /*
- * Decode a FastJSON binary blob.
+ * Release a chain of overflow pages.
  */
-UNQLITE_PRIVATE sxi32 FastJsonDecode(
-	const void *pIn,  /* Binary JSON  */
-	sxu32 nByte,      /* Chunk delimiter */
-	jx9_value *pOut,  /* Decoded value */
-	const unsigned char **pzPtr,
-	int iNest /* Nesting limit */
+static int btFreeOverflow(bt_kv_engine *pEngine,pgno iOvfl)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	unqlite_page *pPage;
+	pgno iNext;
+	int rc;
+	while( iOvfl > 0 ){
+		rc = pIo->xGet(pIo->pHandle,iOvfl,&pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		SyBigEndianUnpack64(pPage->zData,&iNext);
+		rc = btPageFree(pEngine,pPage);
+		pIo->xPageUnref(pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		iOvfl = iNext;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Consume nAmount bytes of the cell payload (key followed by data)
+ * starting at offset iOfft.
+ */
+static int btPayloadRead(
+	bt_kv_engine *pEngine,
+	const bt_cell *pCell,
+	sxu64 iOfft,
+	sxu64 nAmount,
+	int (*xConsumer)(const void *,unsigned int,void *),
+	void *pUserData
 	)
 {
-	const unsigned char *zIn = (const unsigned char *)pIn;
-	const unsigned char *zEnd = &zIn[nByte];
-	sxi32 rc = SXRET_OK;
-	int c;
-	if( iNest >= UNQLITE_FAST_JSON_NEST_LIMIT ){
-		/* Nesting limit reached */
-		return SXERR_LIMIT;
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	sxu32 nOvfl = BT_OVERFLOW_SIZE(pEngine->iPageSize);
+	unqlite_page *pPage;
+	pgno iPage,iNext;
+	sxu64 n;
+	int rc;
+	if( iOfft < pCell->nLocal && nAmount > 0 ){
+		/* Local payload first */
+		n = pCell->nLocal - iOfft;
+		if( n > nAmount ){
+			n = nAmount;
+		}
+		rc = xConsumer((const void *)&pCell->zLocal[iOfft],(unsigned int)n,pUserData);
+		if( rc != UNQLITE_OK ){
+			/* Consumer routine request an operation abort */
+			return UNQLITE_ABORT;
+		}
+		iOfft += n;
+		nAmount -= n;
 	}
-	c = zIn[0];
-	/* Advance the stream cursor */
-	zIn++;
-	/* Process the binary token */
-	switch(c){
-	case FJSON_NULL:
-		/* null */
-		jx9_value_null(pOut);
-		break;
-	case FJSON_FALSE:
-		/* Boolean FALSE */
-		jx9_value_bool(pOut,0);
-		break;
-	case FJSON_TRUE:
-		/* Boolean TRUE */
-		jx9_value_bool(pOut,1);
-		break;
-	case FJSON_INT64: {
-		/* 64Bit integer */
-		sxu64 iVal;
+	/* Offset in the overflow stream */
+	iOfft -= pCell->nLocal;
+	iPage = pCell->iOvfl;
+	while( nAmount > 0 ){
+		if( iPage < 1 ){
+			pIo->xErr(pIo->pHandle,"Corrupt overflow page");
+			return UNQLITE_CORRUPT;
+		}
+		rc = pIo->xGet(pIo->pHandle,iPage,&pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		SyBigEndianUnpack64(pPage->zData,&iNext);
+		if( iOfft >= nOvfl ){
+			/* Skip this page */
+			iOfft -= nOvfl;
+		}else{
+			n = nOvfl - iOfft;
+			if( n > nAmount ){
+				n = nAmount;
+			}
+			rc = xConsumer((const void *)&pPage->zData[8 + iOfft],(unsigned int)n,pUserData);
+			if( rc != UNQLITE_OK ){
+				pIo->xPageUnref(pPage);
+				return UNQLITE_ABORT;
+			}
+			iOfft = 0;
+			nAmount -= n;
+		}
+		pIo->xPageUnref(pPage);
+		iPage = iNext;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Point to the full key of a given cell. Large keys are loaded in pWorker.
+ */
+static int btCellKey(bt_kv_engine *pEngine,const bt_cell *pCell,SyBlob *pWorker,const void **ppKey)
+{
+	int rc;
+	if( pCell->nKey <= pCell->nLocal ){
+		/* Key is stored locally */
+		*ppKey = (const void *)pCell->zLocal;
+		return UNQLITE_OK;
+	}
+	SyBlobReset(pWorker);
+	rc = btPayloadRead(pEngine,pCell,0,pCell->nKey,unqliteDataConsumer,pWorker);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	*ppKey = SyBlobData(pWorker);
+	return UNQLITE_OK;
+}
+/*
+ * Compare two keys. Shorter keys sort first when one is a prefix of the other.
+ */
+static int btKeyCmp(bt_kv_engine *pEngine,const void *pA,sxu32 nA,const void *pB,sxu32 nB)
+{
+	sxi32 rc;
+	rc = pEngine->xCmp(pA,pB,nA < nB ? nA : nB);
+	if( rc != 0 ){
+		return rc < 0 ? -1 : 1;
+	}
+	if( nA == nB ){
+		return 0;
+	}
+	return nA < nB ? -1 : 1;
+}
+/*
+ * Binary search a node for the given key.
+ * If bUpper is false, return the index of the first cell whose key is
+ * greater or equal to the target key (leaf lookup). Otherwise return the
+ * index of the first cell whose key is strictly greater (interior lookup).
+ */
+static int btNodeSearch(
+	bt_kv_engine *pEngine,
+	const unsigned char *zNode,
+	const void *pKey,sxu32 nKey,
+	int bUpper,
+	sxu32 *pIdx,
+	int *pExact
+	)
+{
+	sxu32 iLo = 0,iHi = btNodeCount(zNode),iMid;
+	const void *pCellKey;
+	bt_cell sCell;
+	SyBlob sKey;
+	int rc,cmp;
+	*pExact = 0;
+	/* Private buffer so that concurrent readers can search the same node */
+	SyBlobInit(&sKey,&pEngine->sAllocator);
+	while( iLo < iHi ){
+		iMid = (iLo + iHi) >> 1;
+		btParseCell(pEngine,zNode,iMid,&sCell);
+		if( sCell.nKey <= sCell.nLocal ){
+			/* Key is stored locally */
+			cmp = btKeyCmp(pEngine,(const void *)sCell.zLocal,sCell.nKey,pKey,nKey);
+		}else{
+			/* Large key, try to decide using the local prefix first */
+			cmp = pEngine->xCmp((const void *)sCell.zLocal,pKey,sCell.nLocal < nKey ? sCell.nLocal : nKey);
+			if( cmp != 0 || nKey <= sCell.nLocal ){
+				cmp = cmp != 0 ? (cmp < 0 ? -1 : 1) : 1;
+			}else{
+				rc = btCellKey(pEngine,&sCell,&sKey,&pCellKey);
+				if( rc != UNQLITE_OK ){
+					SyBlobRelease(&sKey);
+					return rc;
+				}
+				cmp = btKeyCmp(pEngine,pCellKey,sCell.nKey,pKey,nKey);
+			}
+		}
+		if( cmp == 0 ){
+			*pExact = 1;
+		}
+		if( cmp < 0 || (bUpper && cmp == 0) ){
+			iLo = iMid + 1;
+		}else{
+			iHi = iMid;
+		}
+	}
+	*pIdx = iLo;
+	SyBlobRelease(&sKey);
+	return UNQLITE_OK;
+}
+/*
+ * Release the pages referenced by a lookup path.
+ */
+static void btPathRelease(bt_kv_engine *pEngine,bt_path *pPath)
+{
+	int i;
+	for( i = 0 ; i < pPath->nDepth ; ++i ){
+		pEngine->pIo->xPageUnref(pPath->apPage[i]);
+	}
+	pPath->nDepth = 0;
+}
+/*
+ * Walk from the root to the leaf that hold (or should hold) the target key.
+ */
+static int btDescend(
+	bt_kv_engine *pEngine,
+	const void *pKey,sxu32 nKey,
+	int iWhere,
+	bt_path *pPath,
+	int *pExact
+	)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	unqlite_page *pPage;
+	const unsigned char *zNode;
+	sxu32 iIdx,nCell;
+	int rc,exact = 0;
+	pgno iPage;
+	pPath->nDepth = 0;
+	if( pEngine->pHeader == 0 ){
+		/* Read the database header first */
+		rc = pIo->xGet(pIo->pHandle,1,0);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		if( pEngine->iRoot < 1 ){
+			return UNQLITE_CORRUPT;
+		}
+	}
+	iPage = pEngine->iRoot;
+	for(;;){
+		if( pPath->nDepth >= BT_MAX_DEPTH ){
+			rc = UNQLITE_CORRUPT;
+			goto fail;
+		}
+		rc = pIo->xGet(pIo->pHandle,iPage,&pPage);
+		if( rc != UNQLITE_OK ){
+			goto fail;
+		}
+		pPath->apPage[pPath->nDepth++] = pPage;
+		zNode = pPage->zData;
+		if( zNode[0] != BT_NODE_LEAF && zNode[0] != BT_NODE_INTERIOR ){
+			pIo->xErr(pIo->pHandle,"Corrupt B+Tree node");
+			rc = UNQLITE_CORRUPT;
+			goto fail;
+		}
+		nCell = btNodeCount(zNode);
+		if( iWhere == BT_SEEK_FIRST ){
+			iIdx = 0;
+		}else if( iWhere == BT_SEEK_LAST ){
+			iIdx = nCell;
+			if( zNode[0] == BT_NODE_LEAF && iIdx > 0 ){
+				iIdx--;
+			}
+		}else{
+			rc = btNodeSearch(pEngine,zNode,pKey,nKey,zNode[0] == BT_NODE_INTERIOR,&iIdx,&exact);
+			if( rc != UNQLITE_OK ){
+				goto fail;
+			}
+		}
+		pPath->aiIdx[pPath->nDepth - 1] = iIdx;
+		if( zNode[0] == BT_NODE_LEAF ){
+			break;
+		}
+		/* Go down one level */
+		iPage = btNodeChild(pEngine,zNode,iIdx);
+	}
+	if( pExact ){
+		*pExact = exact;
+	}
+	return UNQLITE_OK;
+fail:
+	btPathRelease(pEngine,pPath);
+	return rc;
+}
+/*
+ * Write a list of cells on a node page.
+ */
+static void btNodeBuild(
+	bt_kv_engine *pEngine,
+	unsigned char *zNode,
+	int iType,
+	pgno iNext,pgno iPrev,
+	const bt_slot *aSlot,sxu32 nSlot
+	)
+{
+	sxu32 iContent = (sxu32)pEngine->iPageSize;
+	sxu32 i;
+	SyZero(zNode,BT_NODE_HDR_SZ);
+	zNode[0] = (unsigned char)iType;
+	SyBigEndianPack32(&zNode[4],nSlot);
+	SyBigEndianPack64(&zNode[12],iNext);
+	SyBigEndianPack64(&zNode[20],iPrev);
+	for( i = 0 ; i < nSlot ; ++i ){
+		iContent -= aSlot[i].nSize;
+		SyMemcpy((const void *)aSlot[i].zCell,&zNode[iContent],aSlot[i].nSize);
+		SyBigEndianPack16(&zNode[BT_NODE_HDR_SZ + (i << 1)],(sxu16)iContent);
+	}
+	SyBigEndianPack32(&zNode[8],iContent);
+	/* Zero the free space */
+	i = BT_NODE_HDR_SZ + (nSlot << 1);
+	SyZero(&zNode[i],iContent - i);
+}
+/*
+ * Copy a node in the scratch buffer and fill the slot array with its cells
+ * leaving a hole at index iHole if iHole is in range.
+ */
+static sxu32 btNodeLoadSlots(bt_kv_engine *pEngine,const unsigned char *zNode,sxu32 iHole)
+{
+	sxu32 nCell = btNodeCount(zNode);
+	bt_cell sCell;
+	sxu32 i,j;
+	SyMemcpy((const void *)zNode,pEngine->zScratch,(sxu32)pEngine->iPageSize);
+	for( i = j = 0 ; i < nCell ; ++i ){
+		if( i == iHole ){
+			j++;
+		}
+		btParseCell(pEngine,pEngine->zScratch,i,&sCell);
+		pEngine->aSlot[j].zCell = &sCell.zLocal[-BT_CELL_HDR_SZ];
+		pEngine->aSlot[j].nSize = sCell.nSize;
+		j++;
+	}
+	return nCell;
+}
+/*
+ * Total space required by a list of cells.
+ */
+static sxu32 btSlotSpace(const bt_slot *aSlot,sxu32 nSlot)
+{
+	sxu32 i,nByte = 0;
+	for( i = 0 ; i < nSlot ; ++i ){
+		nByte += aSlot[i].nSize + 2;
+	}
+	return nByte;
+}
+/*
+ * Remove the cell at index iIdx from a list of cells.
+ */
+static void btSlotRemove(bt_slot *aSlot,sxu32 nSlot,sxu32 iIdx)
+{
+	sxu32 i;
+	for( i = iIdx + 1 ; i < nSlot ; ++i ){
+		aSlot[i - 1] = aSlot[i];
+	}
+}
+/*
+ * Choose the split point of an overfull list of cells.
+ */
+static sxu32 btSplitPoint(const bt_slot *aSlot,sxu32 nSlot,sxu32 nMin,sxu32 nMax)
+{
+	sxu32 nTotal = btSlotSpace(aSlot,nSlot);
+	sxu32 i,nByte = 0;
+	for( i = 0 ; i < nSlot ; ++i ){
+		if( nByte + aSlot[i].nSize + 2 > (nTotal >> 1) ){
+			break;
+		}
+		nByte += aSlot[i].nSize + 2;
+	}
+	if( i < nMin ){
+		i = nMin;
+	}
+	if( i > nMax ){
+		i = nMax;
+	}
+	return i;
+}
+/*
+ * Build a cell from a key and (optionally) two chunks of data.
+ * Payload that does not fit locally is written to a fresh overflow chain.
+ */
+static int btBuildCell(
+	bt_kv_engine *pEngine,
+	SyBlob *pOut,
+	int iType,
+	pgno iChild,
+	const void *pKey,sxu32 nKey,
+	const void *pData,sxu64 nData,
+	const void *pData2,sxu64 nData2
+	)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	sxu32 nOvfl = BT_OVERFLOW_SIZE(pEngine->iPageSize);
+	const unsigned char *azSeg[3];
+	unqlite_page *pPage,*pLast = 0;
+	sxu64 anSeg[3],nPayload,n;
+	unsigned char zHdr[BT_CELL_HDR_SZ];
+	sxu32 nLocal,nCopy,iSeg;
+	sxu64 iSegOfft;
+	int rc;
+	azSeg[0] = (const unsigned char *)pKey;  anSeg[0] = nKey;
+	azSeg[1] = (const unsigned char *)pData; anSeg[1] = iType == BT_NODE_LEAF ? nData : 0;
+	azSeg[2] = (const unsigned char *)pData2; anSeg[2] = iType == BT_NODE_LEAF ? nData2 : 0;
+	nPayload = anSeg[0] + anSeg[1] + anSeg[2];
+	nLocal = btLocalSize(pEngine,iType,nKey,anSeg[1] + anSeg[2]);
+	/* Cell header */
+	SyBigEndianPack64(zHdr,iChild);
+	SyBigEndianPack32(&zHdr[8],nKey);
+	SyBigEndianPack64(&zHdr[12],anSeg[1] + anSeg[2]);
+	SyBigEndianPack64(&zHdr[20],0);
+	SyBlobReset(pOut);
+	if( SXRET_OK != SyBlobAppend(pOut,(const void *)zHdr,sizeof(zHdr)) ){
+		return UNQLITE_NOMEM;
+	}
+	/* Walk the payload segments */
+	iSeg = 0;
+	iSegOfft = 0;
+	nPayload -= nLocal;
+	while( nLocal > 0 ){
+		n = anSeg[iSeg] - iSegOfft;
+		if( n > nLocal ){
+			n = nLocal;
+		}
+		if( n > 0 && SXRET_OK != SyBlobAppend(pOut,(const void *)&azSeg[iSeg][iSegOfft],(sxu32)n) ){
+			return UNQLITE_NOMEM;
+		}
+		nLocal -= (sxu32)n;
+		iSegOfft += n;
+		if( iSegOfft >= anSeg[iSeg] ){
+			iSeg++;
+			iSegOfft = 0;
+		}
+	}
+	/* Overflow chain */
+	while( nPayload > 0 ){
+		rc = btPageAlloc(pEngine,&pPage);
+		if( rc != UNQLITE_OK ){
+			if( pLast ){
+				pIo->xPageUnref(pLast);
+			}
+			return rc;
+		}
+		if( pLast == 0 ){
+			/* First overflow page */
+			SyBigEndianPack64((unsigned char *)SyBlobDataAt(pOut,20),pPage->pgno);
+		}else{
+			SyBigEndianPack64(pLast->zData,pPage->pgno);
+			pIo->xPageUnref(pLast);
+		}
+		pLast = pPage;
+		nCopy = 0;
+		while( nCopy < nOvfl && nPayload > 0 ){
+			while( iSegOfft >= anSeg[iSeg] ){
+				iSeg++;
+				iSegOfft = 0;
+			}
+			n = anSeg[iSeg] - iSegOfft;
+			if( n > (sxu64)(nOvfl - nCopy) ){
+				n = nOvfl - nCopy;
+			}
+			SyMemcpy((const void *)&azSeg[iSeg][iSegOfft],&pPage->zData[8 + nCopy],(sxu32)n);
+			nCopy += (sxu32)n;
+			iSegOfft += n;
+			nPayload -= n;
+		}
+	}
+	if( pLast ){
+		pIo->xPageUnref(pLast);
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Insert (or replace when bReplace is true) a leaf cell at the position
+ * recorded in the lookup path. Overfull nodes are split and separator cells
+ * are pushed up to the parent nodes. A full root get a new parent.
+ */
+static int btInsertCell(bt_kv_engine *pEngine,bt_path *pPath,const unsigned char *zNew,sxu32 nNew,int bReplace)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	sxu32 nUsable = (sxu32)pEngine->iPageSize - BT_NODE_HDR_SZ;
+	bt_slot *aSlot = pEngine->aSlot;
+	const unsigned char *zSep = 0;
+	unqlite_page *pPage,*pNew,*pRoot;
+	pgno iNext,iPrev,iRight = 0;
+	sxu32 nSep = 0,nSlot,iIdx,m;
+	int iLevel,iType,iSep = 0;
+	const void *pKey;
+	bt_cell sCell;
+	SyBlob *pSep;
+	int rc;
+	for( iLevel = pPath->nDepth - 1 ; iLevel >= 0 ; iLevel-- ){
+		pPage = pPath->apPage[iLevel];
+		iIdx = pPath->aiIdx[iLevel];
+		iType = pPage->zData[0];
+		iNext = btNodeNext(pPage->zData);
+		iPrev = btNodePrev(pPage->zData);
+		if( iType == BT_NODE_LEAF ){
+			nSlot = btNodeLoadSlots(pEngine,pPage->zData,bReplace ? (sxu32)-1 : iIdx);
+			if( !bReplace ){
+				nSlot++;
+			}
+			aSlot[iIdx].zCell = zNew;
+			aSlot[iIdx].nSize = nNew;
+		}else{
+			/* The child at iIdx was split: it now hold the left half and iRight the right half */
+			nSlot = btNodeLoadSlots(pEngine,pPage->zData,iIdx);
+			if( iIdx < nSlot ){
+				/* Redirect the cell that pointed to the split child */
+				SyBigEndianPack64((unsigned char *)aSlot[iIdx + 1].zCell,iRight);
+			}else{
+				/* Split child was the right-most one */
+				iNext = iRight;
+			}
+			nSlot++;
+			aSlot[iIdx].zCell = zSep;
+			aSlot[iIdx].nSize = nSep;
+		}
+		if( btSlotSpace(aSlot,nSlot) <= nUsable ){
+			/* Fit in the current node */
+			rc = btPageWrite(pEngine,pPage);
+			if( rc != UNQLITE_OK ){
+				return rc;
+			}
+			btNodeBuild(pEngine,pPage->zData,iType,iNext,iPrev,aSlot,nSlot);
+			return UNQLITE_OK;
+		}
+		/* Split the node */
+		rc = btPageWrite(pEngine,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		rc = btPageAlloc(pEngine,&pNew);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		pSep = &pEngine->aSep[iSep];
+		iSep ^= 1;
+		if( iType == BT_NODE_LEAF ){
+			m = btSplitPoint(aSlot,nSlot,1,nSlot - 1);
+			/* Separator: Full key of the first cell of the right node */
+			btParseRawCell(pEngine,BT_NODE_LEAF,aSlot[m].zCell,&sCell);
+			rc = btCellKey(pEngine,&sCell,&pEngine->sKey,&pKey);
+			if( rc == UNQLITE_OK ){
+				rc = btBuildCell(pEngine,pSep,BT_NODE_INTERIOR,pPage->pgno,pKey,sCell.nKey,0,0,0,0);
+			}
+			if( rc != UNQLITE_OK ){
+				pIo->xPageUnref(pNew);
+				return rc;
+			}
+			btNodeBuild(pEngine,pPage->zData,BT_NODE_LEAF,pNew->pgno,iPrev,aSlot,m);
+			btNodeBuild(pEngine,pNew->zData,BT_NODE_LEAF,iNext,pPage->pgno,&aSlot[m],nSlot - m);
+			if( iNext > 0 ){
+				unqlite_page *pSibling;
+				/* Fix the left link of the old right sibling */
+				rc = pIo->xGet(pIo->pHandle,iNext,&pSibling);
+				if( rc == UNQLITE_OK ){
+					rc = btPageWrite(pEngine,pSibling);
+					if( rc == UNQLITE_OK ){
+						SyBigEndianPack64(&pSibling->zData[20],pNew->pgno);
+					}
+					pIo->xPageUnref(pSibling);
+				}
+				if( rc != UNQLITE_OK ){
+					pIo->xPageUnref(pNew);
+					return rc;
+				}
+			}
+		}else{
+			m = btSplitPoint(aSlot,nSlot,1,nSlot - 2);
+			/* The middle cell move up, its left child become the right-most child of the left node */
+			btParseRawCell(pEngine,BT_NODE_INTERIOR,aSlot[m].zCell,&sCell);
+			SyBlobReset(pSep);
+			if( SXRET_OK != SyBlobAppend(pSep,(const void *)aSlot[m].zCell,aSlot[m].nSize) ){
+				pIo->xPageUnref(pNew);
+				return UNQLITE_NOMEM;
+			}
+			SyBigEndianPack64((unsigned char *)SyBlobData(pSep),pPage->pgno);
+			btNodeBuild(pEngine,pPage->zData,BT_NODE_INTERIOR,sCell.iChild,0,aSlot,m);
+			btNodeBuild(pEngine,pNew->zData,BT_NODE_INTERIOR,iNext,0,&aSlot[m + 1],nSlot - m - 1);
+		}
+		zSep = (const unsigned char *)SyBlobData(pSep);
+		nSep = SyBlobLength(pSep);
+		iRight = pNew->pgno;
+		pIo->xPageUnref(pNew);
+		if( iLevel < 1 ){
+			/* Root split, grow the tree by one level */
+			rc = btPageAlloc(pEngine,&pRoot);
+			if( rc != UNQLITE_OK ){
+				return rc;
+			}
+			aSlot[0].zCell = zSep;
+			aSlot[0].nSize = nSep;
+			btNodeBuild(pEngine,pRoot->zData,BT_NODE_INTERIOR,iRight,0,aSlot,1);
+			pEngine->iRoot = pRoot->pgno;
+			pIo->xPageUnref(pRoot);
+			rc = btWriteHeader(pEngine);
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Remove the leaf cell recorded in the lookup path. Empty nodes are released
+ * and the tree shrink when the root is left with a single child.
+ */
+static int btDeleteCell(bt_kv_engine *pEngine,bt_path *pPath)
+{
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	bt_slot *aSlot = pEngine->aSlot;
+	unqlite_page *pPage,*pSibling;
+	pgno iNext,iPrev;
+	sxu32 nSlot,iIdx;
+	bt_cell sCell;
+	int iLevel;
+	int rc;
+	iLevel = pPath->nDepth - 1;
+	pPage = pPath->apPage[iLevel];
+	iIdx = pPath->aiIdx[iLevel];
+	/* Release the overflow pages of the target record */
+	btParseCell(pEngine,pPage->zData,iIdx,&sCell);
+	rc = btFreeOverflow(pEngine,sCell.iOvfl);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	iNext = btNodeNext(pPage->zData);
+	iPrev = btNodePrev(pPage->zData);
+	nSlot = btNodeLoadSlots(pEngine,pPage->zData,(sxu32)-1);
+	if( nSlot > 1 || iLevel < 1 ){
+		/* Remove the cell from its leaf */
+		btSlotRemove(aSlot,nSlot,iIdx);
+		rc = btPageWrite(pEngine,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		btNodeBuild(pEngine,pPage->zData,BT_NODE_LEAF,iNext,iPrev,aSlot,nSlot - 1);
+		return UNQLITE_OK;
+	}
+	/* Empty leaf, unlink from its siblings */
+	if( iPrev > 0 ){
+		rc = pIo->xGet(pIo->pHandle,iPrev,&pSibling);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		rc = btPageWrite(pEngine,pSibling);
+		if( rc == UNQLITE_OK ){
+			SyBigEndianPack64(&pSibling->zData[12],iNext);
+		}
+		pIo->xPageUnref(pSibling);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	if( iNext > 0 ){
+		rc = pIo->xGet(pIo->pHandle,iNext,&pSibling);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		rc = btPageWrite(pEngine,pSibling);
+		if( rc == UNQLITE_OK ){
+			SyBigEndianPack64(&pSibling->zData[20],iPrev);
+		}
+		pIo->xPageUnref(pSibling);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	rc = btPageFree(pEngine,pPage);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Remove the pointer to the released child from the parent nodes */
+	for( iLevel-- ; iLevel >= 0 ; iLevel-- ){
+		pPage = pPath->apPage[iLevel];
+		iIdx = pPath->aiIdx[iLevel];
+		iNext = btNodeNext(pPage->zData);
+		nSlot = btNodeLoadSlots(pEngine,pPage->zData,(sxu32)-1);
+		if( nSlot < 1 ){
+			/* The released child was the only one */
+			if( iLevel < 1 ){
+				/* Empty tree, turn the root into an empty leaf */
+				rc = btPageWrite(pEngine,pPage);
+				if( rc != UNQLITE_OK ){
+					return rc;
+				}
+				btNodeBuild(pEngine,pPage->zData,BT_NODE_LEAF,0,0,aSlot,0);
+				return UNQLITE_OK;
+			}
+			rc = btPageFree(pEngine,pPage);
+			if( rc != UNQLITE_OK ){
+				return rc;
+			}
+			continue;
+		}
+		if( iIdx >= nSlot ){
+			/* Right-most child, its left neighbour take its place */
+			iIdx = nSlot - 1;
+			btParseRawCell(pEngine,BT_NODE_INTERIOR,aSlot[iIdx].zCell,&sCell);
+			iNext = sCell.iChild;
+		}else{
+			btParseRawCell(pEngine,BT_NODE_INTERIOR,aSlot[iIdx].zCell,&sCell);
+		}
+		/* Drop the separator */
+		rc = btFreeOverflow(pEngine,sCell.iOvfl);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		btSlotRemove(aSlot,nSlot,iIdx);
+		rc = btPageWrite(pEngine,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		btNodeBuild(pEngine,pPage->zData,BT_NODE_INTERIOR,iNext,0,aSlot,nSlot - 1);
+		break;
+	}
+	/* Shrink the tree while the root is an interior node without cells */
+	for(;;){
+		rc = pIo->xGet(pIo->pHandle,pEngine->iRoot,&pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		if( pPage->zData[0] != BT_NODE_INTERIOR || btNodeCount(pPage->zData) > 0 ){
+			pIo->xPageUnref(pPage);
+			break;
+		}
+		pEngine->iRoot = btNodeNext(pPage->zData);
+		rc = btPageFree(pEngine,pPage);
+		pIo->xPageUnref(pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+/*
+ * The tree is about to be modified and the leaf copies of the active cursors
+ * will become stale. Cells may move to another leaf on splits and merges so
+ * each cursor save the key of its current record and seek it again on its
+ * next access.
+ * The handle is held exclusively while writing so no reader can touch
+ * the cursor list meanwhile.
+ */
+static void btSaveCursors(bt_kv_engine *pEngine)
+{
+	bt_kv_cursor *pCur;
+	bt_cell sCell;
+	int rc;
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		if( pCur->iState != BT_CURSOR_STATE_CELL || pCur->iCell >= pCur->nCell ){
+			continue;
+		}
+		btParseCell(pEngine,pCur->zLeaf,pCur->iCell,&sCell);
+		SyBlobReset(&pCur->sKey);
+		rc = btPayloadRead(pEngine,&sCell,0,sCell.nKey,unqliteDataConsumer,&pCur->sKey);
+		pCur->iState = rc == UNQLITE_OK ? BT_CURSOR_STATE_SAVED : BT_CURSOR_STATE_DONE;
+	}
+}
+/*
+ * Insert a new record or replace (or append to) an existing one.
+ */
+static int btRecordInsert(
+	bt_kv_engine *pEngine,
+	const void *pKey,sxu32 nKey,
+	const void *pData,unqlite_int64 nData,
+	int is_append
+	)
+{
+	const void *pOld = 0;
+	sxu64 nOld = 0;
+	bt_path sPath;
+	bt_cell sCell;
+	int rc,exact;
+	/* Invalidate cursors copies */
+	btSaveCursors(pEngine);
+	rc = btDescend(pEngine,pKey,nKey,BT_SEEK_KEY,&sPath,&exact);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	if( exact ){
+		/* Existing record */
+		btParseCell(pEngine,sPath.apPage[sPath.nDepth - 1]->zData,sPath.aiIdx[sPath.nDepth - 1],&sCell);
+		if( is_append ){
+			/* Load the old data */
+			if( sCell.nData + (sxu64)nData < sCell.nData || sCell.nData > (sxu64)SXU32_HIGH ){
+				pEngine->pIo->xErr(pEngine->pIo->pHandle,"Append operation will cause data overflow");
+				rc = UNQLITE_LIMIT;
+				goto done;
+			}
+			SyBlobReset(&pEngine->sWorker);
+			rc = btPayloadRead(pEngine,&sCell,sCell.nKey,sCell.nData,unqliteDataConsumer,&pEngine->sWorker);
+			if( rc != UNQLITE_OK ){
+				goto done;
+			}
+			pOld = SyBlobData(&pEngine->sWorker);
+			nOld = SyBlobLength(&pEngine->sWorker);
+		}
+		rc = btFreeOverflow(pEngine,sCell.iOvfl);
+		if( rc != UNQLITE_OK ){
+			goto done;
+		}
+	}
+	rc = btBuildCell(pEngine,&pEngine->sCell,BT_NODE_LEAF,0,pKey,nKey,pOld,nOld,pData,(sxu64)nData);
+	if( rc != UNQLITE_OK ){
+		goto done;
+	}
+	rc = btInsertCell(pEngine,&sPath,(const unsigned char *)SyBlobData(&pEngine->sCell),SyBlobLength(&pEngine->sCell),exact);
+done:
+	btPathRelease(pEngine,&sPath);
+	return rc;
+}
+/*
+ * Exported: xReplace() method.
+ */
+static int btree_kv_replace(
+	  unqlite_kv_engine *pKv,
+	  const void *pKey,int nKeyLen,
+	  const void *pData,unqlite_int64 nDataLen
+	  )
+{
+	int rc;
+	rc = btRecordInsert((bt_kv_engine *)pKv,pKey,(sxu32)nKeyLen,pData,nDataLen,0);
+	return rc;
+}
+/*
+ * Exported: xAppend() method.
+ */
+static int btree_kv_append(
+	  unqlite_kv_engine *pKv,
+	  const void *pKey,int nKeyLen,
+	  const void *pData,unqlite_int64 nDataLen
+	  )
+{
+	int rc;
+	rc = btRecordInsert((bt_kv_engine *)pKv,pKey,(sxu32)nKeyLen,pData,nDataLen,1);
+	return rc;
+}
+/*
+ * Exported: xOpen() method.
+ */
+static int btree_kv_open(unqlite_kv_engine *pKv,pgno dbSize)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pKv;
+	const unqlite_kv_io *pIo = pKv->pIo;
+	unqlite_page *pHeader,*pRoot;
+	sxu32 nMagic;
+	int rc;
+	if( dbSize < 1 ){
+		/* A new database, create the header */
+		rc = pIo->xNew(pIo->pHandle,&pHeader);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		pEngine->pHeader = pHeader;
+		rc = btWriteHeader(pEngine);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		/* Empty root leaf */
+		rc = btPageAlloc(pEngine,&pRoot);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		btNodeBuild(pEngine,pRoot->zData,BT_NODE_LEAF,0,0,0,0);
+		pEngine->iRoot = pRoot->pgno;
+		pIo->xPageUnref(pRoot);
+		rc = btWriteHeader(pEngine);
+		return rc;
+	}
+	/* Acquire the page one of the database */
+	rc = pIo->xGet(pIo->pHandle,1,&pHeader);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	pEngine->pHeader = pHeader;
+	/* 4 byte magic number */
+	SyBigEndianUnpack32(pHeader->zData,&nMagic);
+	if( nMagic != BT_MAGIC ){
+		/* Corrupt implementation */
+		return UNQLITE_CORRUPT;
+	}
+	/* Root page */
+	SyBigEndianUnpack64(&pHeader->zData[4],&pEngine->iRoot);
+	/* List of free pages */
+	SyBigEndianUnpack64(&pHeader->zData[12],&pEngine->nFreeList);
+	return UNQLITE_OK;
+}
+/*
+ * Exported: xInit() method.
+ * Initialize the Key value storage engine.
+ */
+static int btree_kv_init(unqlite_kv_engine *pKv,int iPageSize)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pKv;
+	sxu32 nSlot;
+	/* This structure is always zeroed, go to the initialization directly */
+	SyMemBackendInitFromParent(&pEngine->sAllocator,unqliteExportMemBackend());
+	pEngine->iPageSize = iPageSize;
+	pEngine->nMaxLocal = BT_MX_LOCAL(iPageSize);
+	/* Default comparison function */
+	pEngine->xCmp = SyMemcmp;
+	/* Working buffers */
+	pEngine->zScratch = (unsigned char *)SyMemBackendAlloc(&pEngine->sAllocator,(sxu32)iPageSize);
+	nSlot = ((sxu32)iPageSize / (BT_CELL_HDR_SZ + 2)) + 2;
+	pEngine->aSlot = (bt_slot *)SyMemBackendAlloc(&pEngine->sAllocator,nSlot * sizeof(bt_slot));
+	if( pEngine->zScratch == 0 || pEngine->aSlot == 0 ){
+		SyMemBackendRelease(&pEngine->sAllocator);
+		return UNQLITE_NOMEM;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	if( pEngine->sAllocator.pMutexMethods ){
+		/* Concurrent readers copy leaves, keep the allocator thread-safe
+		 * and protect the cursor list.
+		 */
+		pEngine->pMutex = SyMutexNew(pEngine->sAllocator.pMutexMethods,SXMUTEX_TYPE_FAST);
+		if( pEngine->pMutex == 0 ){
+			SyMemBackendRelease(&pEngine->sAllocator);
+			return UNQLITE_NOMEM;
+		}
+	}
+#endif
+	SyBlobInit(&pEngine->sKey,&pEngine->sAllocator);
+	SyBlobInit(&pEngine->sWorker,&pEngine->sAllocator);
+	SyBlobInit(&pEngine->sCell,&pEngine->sAllocator);
+	SyBlobInit(&pEngine->aSep[0],&pEngine->sAllocator);
+	SyBlobInit(&pEngine->aSep[1],&pEngine->sAllocator);
+	return UNQLITE_OK;
+}
+/*
+ * Exported: xRelease() method.
+ * Release the Key value storage engine.
+ */
+static void btree_kv_release(unqlite_kv_engine *pKv)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pKv;
+	bt_kv_cursor *pCur;
+	/* Leaf copies are about to be released, detach the cursors */
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		pCur->zLeaf = 0;
+		SyBlobInit(&pCur->sKey,&pEngine->sAllocator);
+		pCur->iState = BT_CURSOR_STATE_DONE;
+	}
+	pEngine->pCursor = 0;
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexRelease(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	/* Release the private memory backend */
+	SyMemBackendRelease(&pEngine->sAllocator);
+}
+/*
+ *  Exported: xConfig() method.
+ *  Configure the B+Tree KV store.
+ */
+static int btree_kv_config(unqlite_kv_engine *pKv,int op,va_list ap)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pKv;
+	int rc = UNQLITE_OK;
+	switch(op){
+	case UNQLITE_KV_CONFIG_CMP_FUNC: {
+		/* Default comparison function */
+		ProcCmp xCmp = va_arg(ap,ProcCmp);
+		if( xCmp ){
+			pEngine->xCmp  = xCmp;
+		}
+		break;
+									 }
+	default:
+		/* Unknown OP */
+		rc = UNQLITE_UNKNOWN;
+		break;
+	}
+	return rc;
+}
+/*
+ * Initialize the cursor.
+ */
+static void btCursorInit(unqlite_kv_cursor *pPtr)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pPtr;
+	pCur->iState = BT_CURSOR_STATE_DONE;
+	pCur->zLeaf = 0;
+	pCur->bOnNext = 0;
+	SyBlobInit(&pCur->sKey,&((bt_kv_engine *)pPtr->pStore)->sAllocator);
+}
+/*
+ * Release the cursor.
+ */
+static void btCursorRelease(unqlite_kv_cursor *pPtr)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pPtr;
+	bt_kv_engine *pEngine = (bt_kv_engine *)pPtr->pStore;
+	SyBlobRelease(&pCur->sKey);
+	if( pCur->zLeaf == 0 ){
+		/* Nothing to release */
+		return;
+	}
+	/* Unlink from the list of active cursors */
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexEnter(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	if( pCur->pPrev ){
+		pCur->pPrev->pNext = pCur->pNext;
+	}else{
+		pEngine->pCursor = pCur->pNext;
+	}
+	if( pCur->pNext ){
+		pCur->pNext->pPrev = pCur->pPrev;
+	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexLeave(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	SyMemBackendFree(&pEngine->sAllocator,pCur->zLeaf);
+	pCur->zLeaf = 0;
+	pCur->iState = BT_CURSOR_STATE_DONE;
+}
+/*
+ * Copy a leaf page so that the cursor does not hold a page reference
+ * between calls.
+ */
+static int btCursorCopyLeaf(bt_kv_cursor *pCur,const unqlite_page *pLeaf)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pCur->pStore;
+	if( pCur->zLeaf == 0 ){
+		pCur->zLeaf = (unsigned char *)SyMemBackendAlloc(&pEngine->sAllocator,(sxu32)pEngine->iPageSize);
+		if( pCur->zLeaf == 0 ){
+			pEngine->pIo->xErr(pEngine->pIo->pHandle,"KV store is running out of memory");
+			return UNQLITE_NOMEM;
+		}
+		/* Link to the list of active cursors */
+#if defined(UNQLITE_ENABLE_THREADS)
+		SyMutexEnter(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+		pCur->pPrev = 0;
+		pCur->pNext = pEngine->pCursor;
+		if( pEngine->pCursor ){
+			pEngine->pCursor->pPrev = pCur;
+		}
+		pEngine->pCursor = pCur;
+#if defined(UNQLITE_ENABLE_THREADS)
+		SyMutexLeave(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	}
+	SyMemcpy((const void *)pLeaf->zData,pCur->zLeaf,(sxu32)pEngine->iPageSize);
+	pCur->iLeaf = pLeaf->pgno;
+	pCur->nCell = pCur->zLeaf[0] == BT_NODE_LEAF ? btNodeCount(pCur->zLeaf) : 0;
+	return UNQLITE_OK;
+}
+/*
+ * Load the leaf page iLeaf in the cursor.
+ */
+static int btCursorLoadLeaf(bt_kv_cursor *pCur,pgno iLeaf)
+{
+	const unqlite_kv_io *pIo = pCur->pStore->pIo;
+	unqlite_page *pPage;
+	int rc;
+	rc = pIo->xGet(pIo->pHandle,iLeaf,&pPage);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	rc = btCursorCopyLeaf(pCur,pPage);
+	pIo->xPageUnref(pPage);
+	return rc;
+}
+/* Forward declaration */
+static int btCursorSeekKey(bt_kv_cursor *pCur,const void *pKey,int nByte,int iPos,int *pExact);
+/*
+ * Refresh the leaf copy if the tree was modified since it was taken.
+ * If the current record was removed meanwhile, the cursor point to its successor
+ * and the next call to btCursorNext() stays there so that it is not skipped.
+ */
+static int btCursorSync(bt_kv_cursor *pCur)
+{
+	int bOnNext,exact;
+	int rc;
+	if( pCur->iState == BT_CURSOR_STATE_SAVED ){
+		bOnNext = pCur->bOnNext;
+		rc = btCursorSeekKey(pCur,SyBlobData(&pCur->sKey),(int)SyBlobLength(&pCur->sKey),UNQLITE_CURSOR_MATCH_GE,&exact);
+		if( rc != UNQLITE_OK ){
+			pCur->iState = BT_CURSOR_STATE_DONE;
+			return rc == UNQLITE_NOTFOUND ? UNQLITE_INVALID : rc;
+		}
+		pCur->bOnNext = bOnNext || !exact;
+	}
+	if( pCur->iState != BT_CURSOR_STATE_CELL || pCur->zLeaf == 0 ){
+		pCur->iState = BT_CURSOR_STATE_DONE;
+		return UNQLITE_INVALID;
+	}
+	if( pCur->iCell >= pCur->nCell ){
+		pCur->iState = BT_CURSOR_STATE_DONE;
+		return UNQLITE_INVALID;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Point to the first cell of the next non-empty leaf.
+ */
+static int btCursorNextLeaf(bt_kv_cursor *pCur)
+{
+	pgno iNext;
+	int rc;
+	pCur->bOnNext = 0;
+	for(;;){
+		iNext = btNodeNext(pCur->zLeaf);
+		if( iNext < 1 ){
+			pCur->iState = BT_CURSOR_STATE_DONE;
+			return UNQLITE_DONE;
+		}
+		rc = btCursorLoadLeaf(pCur,iNext);
+		if( rc != UNQLITE_OK ){
+			pCur->iState = BT_CURSOR_STATE_DONE;
+			return rc;
+		}
+		if( pCur->nCell > 0 ){
+			pCur->iCell = 0;
+			pCur->iState = BT_CURSOR_STATE_CELL;
+			return UNQLITE_OK;
+		}
+	}
+}
+/*
+ * Point to the last cell of the previous non-empty leaf.
+ */
+static int btCursorPrevLeaf(bt_kv_cursor *pCur)
+{
+	pgno iPrev;
+	int rc;
+	pCur->bOnNext = 0;
+	for(;;){
+		iPrev = btNodePrev(pCur->zLeaf);
+		if( iPrev < 1 ){
+			pCur->iState = BT_CURSOR_STATE_DONE;
+			return UNQLITE_DONE;
+		}
+		rc = btCursorLoadLeaf(pCur,iPrev);
+		if( rc != UNQLITE_OK ){
+			pCur->iState = BT_CURSOR_STATE_DONE;
+			return rc;
+		}
+		if( pCur->nCell > 0 ){
+			pCur->iCell = pCur->nCell - 1;
+			pCur->iState = BT_CURSOR_STATE_CELL;
+			return UNQLITE_OK;
+		}
+	}
+}
+/*
+ * Position the cursor at the first or last record.
+ */
+static int btCursorEdge(bt_kv_cursor *pCur,int iWhere)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pCur->pStore;
+	bt_path sPath;
+	int rc;
+	pCur->iState = BT_CURSOR_STATE_DONE;
+	pCur->bOnNext = 0;
+	rc = btDescend(pEngine,0,0,iWhere,&sPath,0);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	rc = btCursorCopyLeaf(pCur,sPath.apPage[sPath.nDepth - 1]);
+	btPathRelease(pEngine,&sPath);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	if( pCur->nCell < 1 ){
+		/* Empty database */
+		return UNQLITE_DONE;
+	}
+	pCur->iCell = iWhere == BT_SEEK_FIRST ? 0 : pCur->nCell - 1;
+	pCur->iState = BT_CURSOR_STATE_CELL;
+	return UNQLITE_OK;
+}
+/*
+ * Point to the first record.
+ */
+static int btCursorFirst(unqlite_kv_cursor *pCursor)
+{
+	return btCursorEdge((bt_kv_cursor *)pCursor,BT_SEEK_FIRST);
+}
+/*
+ * Point to the last record.
+ */
+static int btCursorLast(unqlite_kv_cursor *pCursor)
+{
+	return btCursorEdge((bt_kv_cursor *)pCursor,BT_SEEK_LAST);
+}
+/*
+ * Is a valid cursor.
+ */
+static int btCursorValid(unqlite_kv_cursor *pCursor)
+{
+	return btCursorSync((bt_kv_cursor *)pCursor) == UNQLITE_OK;
+}
+/*
+ * Point to the next record.
+ */
+static int btCursorNext(unqlite_kv_cursor *pCursor)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	if( btCursorSync(pCur) != UNQLITE_OK ){
+		return UNQLITE_DONE;
+	}
+	if( pCur->bOnNext ){
+		/* Already on the successor of the removed record */
+		pCur->bOnNext = 0;
+		return UNQLITE_OK;
+	}
+	if( pCur->iCell + 1 < pCur->nCell ){
+		pCur->iCell++;
+		return UNQLITE_OK;
+	}
+	return btCursorNextLeaf(pCur);
+}
+/*
+ * Point to the previous record.
+ */
+static int btCursorPrev(unqlite_kv_cursor *pCursor)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	if( btCursorSync(pCur) != UNQLITE_OK ){
+		return UNQLITE_DONE;
+	}
+	pCur->bOnNext = 0;
+	if( pCur->iCell > 0 ){
+		pCur->iCell--;
+		return UNQLITE_OK;
+	}
+	return btCursorPrevLeaf(pCur);
+}
+/*
+ * Return key length.
+ */
+static int btCursorKeyLength(unqlite_kv_cursor *pCursor,int *pLen)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	bt_cell sCell;
+	int rc;
+	rc = btCursorSync(pCur);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	btParseCell((bt_kv_engine *)pCur->pStore,pCur->zLeaf,pCur->iCell,&sCell);
+	*pLen = (int)sCell.nKey;
+	return UNQLITE_OK;
+}
+/*
+ * Return data length.
+ */
+static int btCursorDataLength(unqlite_kv_cursor *pCursor,unqlite_int64 *pLen)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	bt_cell sCell;
+	int rc;
+	rc = btCursorSync(pCur);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	btParseCell((bt_kv_engine *)pCur->pStore,pCur->zLeaf,pCur->iCell,&sCell);
+	*pLen = (unqlite_int64)sCell.nData;
+	return UNQLITE_OK;
+}
+/*
+ * Consume the key.
+ */
+static int btCursorKey(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	bt_cell sCell;
+	int rc;
+	rc = btCursorSync(pCur);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	btParseCell((bt_kv_engine *)pCur->pStore,pCur->zLeaf,pCur->iCell,&sCell);
+	rc = btPayloadRead((bt_kv_engine *)pCur->pStore,&sCell,0,sCell.nKey,xConsumer,pUserData);
+	return rc;
+}
+/*
+ * Consume the data.
+ */
+static int btCursorData(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	bt_cell sCell;
+	int rc;
+	rc = btCursorSync(pCur);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	btParseCell((bt_kv_engine *)pCur->pStore,pCur->zLeaf,pCur->iCell,&sCell);
+	rc = btPayloadRead((bt_kv_engine *)pCur->pStore,&sCell,sCell.nKey,sCell.nData,xConsumer,pUserData);
+	return rc;
+}
+/*
+ * Find a particular record.
+ * UNQLITE_CURSOR_MATCH_LE and UNQLITE_CURSOR_MATCH_GE position the cursor
+ * on the nearest record when the key is not found.
+ * *pExact is set to TRUE if the key itself was found.
+ */
+static int btCursorSeekKey(bt_kv_cursor *pCur,const void *pKey,int nByte,int iPos,int *pExact)
+{
+	bt_kv_engine *pEngine = (bt_kv_engine *)pCur->pStore;
+	bt_path sPath;
+	sxu32 iIdx;
+	int rc,exact;
+	pCur->iState = BT_CURSOR_STATE_DONE;
+	pCur->bOnNext = 0;
+	*pExact = 0;
+	/* Perform a lookup */
+	rc = btDescend(pEngine,pKey,(sxu32)nByte,BT_SEEK_KEY,&sPath,&exact);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	*pExact = exact;
+	iIdx = sPath.aiIdx[sPath.nDepth - 1];
+	rc = btCursorCopyLeaf(pCur,sPath.apPage[sPath.nDepth - 1]);
+	btPathRelease(pEngine,&sPath);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	if( exact ){
+		pCur->iCell = iIdx;
+		pCur->iState = BT_CURSOR_STATE_CELL;
+		return UNQLITE_OK;
+	}
+	switch(iPos){
+	case UNQLITE_CURSOR_MATCH_GE:
+		/* Smallest key greater than the target */
+		if( iIdx < pCur->nCell ){
+			pCur->iCell = iIdx;
+			pCur->iState = BT_CURSOR_STATE_CELL;
+			return UNQLITE_OK;
+		}
+		rc = btCursorNextLeaf(pCur);
+		break;
+	case UNQLITE_CURSOR_MATCH_LE:
+		/* Largest key smaller than the target */
+		if( iIdx > 0 ){
+			pCur->iCell = iIdx - 1;
+			pCur->iState = BT_CURSOR_STATE_CELL;
+			return UNQLITE_OK;
+		}
+		rc = btCursorPrevLeaf(pCur);
+		break;
+	default:
+		rc = UNQLITE_NOTFOUND;
+		break;
+	}
+	return rc == UNQLITE_DONE ? UNQLITE_NOTFOUND : rc;
+}
+/*
+ * Find a particular record, refer to [btCursorSeekKey()].
+ */
+static int btCursorSeek(unqlite_kv_cursor *pCursor,const void *pKey,int nByte,int iPos)
+{
+	int exact;
+	return btCursorSeekKey((bt_kv_cursor *)pCursor,pKey,nByte,iPos,&exact);
+}
+/*
+ * Remove a particular record.
+ */
+static int btCursorDelete(unqlite_kv_cursor *pCursor)
+{
+	bt_kv_cursor *pCur = (bt_kv_cursor *)pCursor;
+	bt_kv_engine *pEngine = (bt_kv_engine *)pCursor->pStore;
+	bt_path sPath;
+	bt_cell sCell;
+	int rc,exact;
+	rc = btCursorSync(pCur);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Save the key of the target record */
+	btParseCell(pEngine,pCur->zLeaf,pCur->iCell,&sCell);
+	SyBlobReset(&pEngine->sWorker);
+	rc = btPayloadRead(pEngine,&sCell,0,sCell.nKey,unqliteDataConsumer,&pEngine->sWorker);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Invalidate cursors copies */
+	btSaveCursors(pEngine);
+	rc = btDescend(pEngine,SyBlobData(&pEngine->sWorker),SyBlobLength(&pEngine->sWorker),BT_SEEK_KEY,&sPath,&exact);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	if( !exact ){
+		btPathRelease(pEngine,&sPath);
+		return UNQLITE_NOTFOUND;
+	}
+	rc = btDeleteCell(pEngine,&sPath);
+	btPathRelease(pEngine,&sPath);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Point to the next entry */
+	rc = btCursorSeek(pCursor,SyBlobData(&pEngine->sWorker),(int)SyBlobLength(&pEngine->sWorker),UNQLITE_CURSOR_MATCH_GE);
+	return rc == UNQLITE_NOTFOUND ? UNQLITE_OK : rc;
+}
+/*
+ * Reset the cursor.
+ */
+static void btCursorReset(unqlite_kv_cursor *pCursor)
+{
+	btCursorFirst(pCursor);
+}
+/*
+ * Export the B+Tree storage engine.
+ */
+UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportBtreeKvStorage(void)
+{
+	static const unqlite_kv_methods sBtreeStore = {
+		"btree",                    /* zName */
+		sizeof(bt_kv_engine),       /* szKv */
+		sizeof(bt_kv_cursor),       /* szCursor */
+		1,                          /* iVersion */
+		btree_kv_init,              /* xInit */
+		btree_kv_release,           /* xRelease */
+		btree_kv_config,            /* xConfig */
+		btree_kv_open,              /* xOpen */
+		btree_kv_replace,           /* xReplace */
+		btree_kv_append,            /* xAppend */
+		btCursorInit,               /* xCursorInit */
+		btCursorSeek,               /* xSeek */
+		btCursorFirst,              /* xFirst */
+		btCursorLast,               /* xLast */
+		btCursorValid,              /* xValid */
+		btCursorNext,               /* xNext */
+		btCursorPrev,               /* xPrev */
+		btCursorDelete,             /* xDelete */
+		btCursorKeyLength,          /* xKeyLength */
+		btCursorKey,                /* xKey */
+		btCursorDataLength,         /* xDataLength */
+		btCursorData,               /* xData */
+		btCursorReset,              /* xReset */
+		btCursorRelease             /* xRelease */
+	};
+	return &sBtreeStore;
+}
+/*
+ * ----------------------------------------------------------
+ * File: fastjson.c
+ * MD5: 3693c0022edc7d37b65124d7aef68397
+ * ----------------------------------------------------------
+ */
+/*
+ * Symisc unQLite: An Embeddable NoSQL (Post Modern) Database Engine.
+ * Copyright (C) 2012-2013, Symisc Systems http://unqlite.org/
+ * Version 1.1.6
+ * For information on licensing, redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES
+ * please contact Symisc Systems via:
+ *       legal@symisc.net
+ *       licensing@symisc.net
+ *       contact@symisc.net
+ * or visit:
+ *      http://unqlite.org/licensing.html
+ */
+ /* $SymiscID: fastjson.c v1.1 FreeBSD 2012-12-05 22:52 stable <chm@symisc.net> $ */
+#ifndef UNQLITE_AMALGAMATION
+#include "unqliteInt.h"
+#endif
+/* JSON binary encoding, decoding and stuff like that */
+#ifndef UNQLITE_FAST_JSON_NEST_LIMIT
+#if defined(__WINNT__) || defined(__UNIXES__)
+#define UNQLITE_FAST_JSON_NEST_LIMIT 64 /* Nesting limit */
+#else
+#define UNQLITE_FAST_JSON_NEST_LIMIT 32 /* Nesting limit */
+#endif
+#endif /* UNQLITE_FAST_JSON_NEST_LIMIT */
+/* 
+ * JSON to Binary using the FastJSON implementation (BigEndian).
+ */
+/*
+ * FastJSON implemented binary token.
+ */
+#define FJSON_DOC_START    1 /* { */
+#define FJSON_DOC_END      2 /* } */
+#define FJSON_ARRAY_START  3 /* [ */
+#define FJSON_ARRAY_END    4 /* ] */
+#define FJSON_COLON        5 /* : */
+#define FJSON_COMMA        6 /* , */
+#define FJSON_ID           7 /* ID + 4 Bytes length */
+#define FJSON_STRING       8 /* String + 4 bytes length */
+#define FJSON_BYTE         9 /* Byte */
+#define FJSON_INT64       10 /* Integer 64 + 8 bytes */
+#define FJSON_REAL        18 /* Floating point value + 2 bytes */
+#define FJSON_NULL        23 /* NULL */
+#define FJSON_TRUE        24 /* TRUE */
+#define FJSON_FALSE       25 /* FALSE */
+/*
+ * Encode a Jx9 value to binary JSON.
+ */
+UNQLITE_PRIVATE sxi32 FastJsonEncode(
+	jx9_value *pValue, /* Value to encode */
+	SyBlob *pOut,      /* Store encoded value here */
+	int iNest          /* Nesting limit */ 
+	)
+{
+	sxi32 iType = pValue ? pValue->iFlags : MEMOBJ_NULL;
+	sxi32 rc = SXRET_OK;
+	int c;
+	if( iNest >= UNQLITE_FAST_JSON_NEST_LIMIT ){
+		/* Nesting limit reached */
+		return SXERR_LIMIT;
+	}
+	if( iType & (MEMOBJ_NULL|MEMOBJ_RES) ){
+		/*
+		 * Resources are encoded as null also.
+		 */
+		c = FJSON_NULL;
+		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+	}else if( iType & MEMOBJ_BOOL ){
+		c = pValue->x.iVal ? FJSON_TRUE : FJSON_FALSE;
+		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+	}else if( iType & MEMOBJ_STRING ){
+		unsigned char zBuf[sizeof(sxu32)]; /* String length */
+		c = FJSON_STRING;
+		SyBigEndianPack32(zBuf,SyBlobLength(&pValue->sBlob));
+		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+		if( rc == SXRET_OK ){
+			rc = SyBlobAppend(pOut,(const void *)zBuf,sizeof(zBuf));
+			if( rc == SXRET_OK ){
+				rc = SyBlobAppend(pOut,SyBlobData(&pValue->sBlob),SyBlobLength(&pValue->sBlob));
+			}
+		}
+	}else if( iType & MEMOBJ_INT ){
+		unsigned char zBuf[8];
+		/* 64bit big endian integer */
+		c = FJSON_INT64;
+		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+		if( rc == SXRET_OK ){
+			SyBigEndianPack64(zBuf,(sxu64)pValue->x.iVal);
+			rc = SyBlobAppend(pOut,(const void *)zBuf,sizeof(zBuf));
+		}
+	}else if( iType & MEMOBJ_REAL ){
+		/* Real number */
+		c = FJSON_REAL;
+		rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+		if( rc == SXRET_OK ){
+			sxu32 iOfft = SyBlobLength(pOut);
+			rc = SyBlobAppendBig16(pOut,0);
+			if( rc == SXRET_OK ){
+				unsigned char *zBlob;
+				SyBlobFormat(pOut,"%.15g",pValue->x.rVal);
+				zBlob = (unsigned char *)SyBlobDataAt(pOut,iOfft);
+				SyBigEndianPack16(zBlob,(sxu16)(SyBlobLength(pOut) - ( 2 + iOfft)));
+			}
+		}
+	}else if( iType & MEMOBJ_HASHMAP ){
+		/* A JSON object or array */
+		jx9_hashmap *pMap = (jx9_hashmap *)pValue->x.pOther;
+		jx9_hashmap_node *pNode;
+		jx9_value *pEntry;
+		/* Reset the hashmap loop cursor */
+		jx9HashmapResetLoopCursor(pMap);
+		if( pMap->iFlags & HASHMAP_JSON_OBJECT ){
+			jx9_value sKey;
+			/* A JSON object */
+			c = FJSON_DOC_START; /* { */
+			rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+			if( rc == SXRET_OK ){
+				jx9MemObjInit(pMap->pVm,&sKey);
+				/* Encode object entries */
+				while((pNode = jx9HashmapGetNextEntry(pMap)) != 0 ){
+					/* Extract the key */
+					jx9HashmapExtractNodeKey(pNode,&sKey);
+					/* Encode it */
+					rc = FastJsonEncode(&sKey,pOut,iNest+1);
+					if( rc != SXRET_OK ){
+						break;
+					}
+					c = FJSON_COLON;
+					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+					if( rc != SXRET_OK ){
+						break;
+					}
+					/* Extract the value */
+					pEntry = jx9HashmapGetNodeValue(pNode);
+					/* Encode it */
+					rc = FastJsonEncode(pEntry,pOut,iNest+1);
+					if( rc != SXRET_OK ){
+						break;
+					}
+					/* Delimit the entry */
+					c = FJSON_COMMA;
+					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+					if( rc != SXRET_OK ){
+						break;
+					}
+				}
+				jx9MemObjRelease(&sKey);
+				if( rc == SXRET_OK ){
+					c = FJSON_DOC_END; /* } */
+					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+				}
+			}
+		}else{
+			/* A JSON array */
+			c = FJSON_ARRAY_START; /* [ */
+			rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+			if( rc == SXRET_OK ){
+				/* Encode array entries */
+				while( (pNode = jx9HashmapGetNextEntry(pMap)) != 0 ){
+					/* Extract the value */
+					pEntry = jx9HashmapGetNodeValue(pNode);
+					/* Encode it */
+					rc = FastJsonEncode(pEntry,pOut,iNest+1);
+					if( rc != SXRET_OK ){
+						break;
+					}
+					/* Delimit the entry */
+					c = FJSON_COMMA;
+					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+					if( rc != SXRET_OK ){
+						break;
+					}
+				}
+				if( rc == SXRET_OK ){
+					c = FJSON_ARRAY_END; /* ] */
+					rc = SyBlobAppend(pOut,(const void *)&c,sizeof(char));
+				}
+			}
+		}
+	}
+	return rc;
+}
+/*
+ * Decode a FastJSON binary blob.
+ */
+UNQLITE_PRIVATE sxi32 FastJsonDecode(
+	const void *pIn,  /* Binary JSON  */
+	sxu32 nByte,      /* Chunk delimiter */
+	jx9_value *pOut,  /* Decoded value */
+	const unsigned char **pzPtr,
+	int iNest /* Nesting limit */
+	)
+{
+	const unsigned char *zIn = (const unsigned char *)pIn;
+	const unsigned char *zEnd = &zIn[nByte];
+	sxi32 rc = SXRET_OK;
+	int c;
+	if( iNest >= UNQLITE_FAST_JSON_NEST_LIMIT ){
+		/* Nesting limit reached */
+		return SXERR_LIMIT;
+	}
+	c = zIn[0];
+	/* Advance the stream cursor */
+	zIn++;
+	/* Process the binary token */
+	switch(c){
+	case FJSON_NULL:
+		/* null */
+		jx9_value_null(pOut);
+		break;
+	case FJSON_FALSE:
+		/* Boolean FALSE */
+		jx9_value_bool(pOut,0);
+		break;
+	case FJSON_TRUE:
+		/* Boolean TRUE */
+		jx9_value_bool(pOut,1);
+		break;
+	case FJSON_INT64: {
+		/* 64Bit integer */
+		sxu64 iVal;
 		/* Sanity check */
 		if( &zIn[8] >= zEnd ){
 			/* Corrupt chunk */
@@ -7012,7 +9962,7 @@ static struct Jx9Global_Data
 	jx9 *pEngines;                          /* List of active engine */
 	sxu32 nMagic;                           /* Sanity check against library misuse */
 }sJx9MPGlobal = {
-	{0, 0, 0, 0, 0, 0, 0, 0, {0}}, 
+	{0, 0, 0, 0, 0, 0, 0, 0, {0}, 0}, 
 #if defined(JX9_ENABLE_THREADS)
 	0, 
 	0, 
@@ -26816,6 +29766,13 @@ static void UnixMutexEnter(SyMutex *pMutex)
 {
 	pthread_mutex_lock(&pMutex->sMutex);
 }
+static sxi32 UnixMutexTryEnter(SyMutex *pMutex)
+{
+	if( pthread_mutex_trylock(&pMutex->sMutex) != 0 ){
+		return SXERR_BUSY;
+	}
+	return SXRET_OK;
+}
 static void UnixMutexLeave(SyMutex *pMutex)
 {
 	pthread_mutex_unlock(&pMutex->sMutex);
@@ -26827,7 +29784,7 @@ static const SyMutexMethods sPthreadMutexMethods = {
 	UnixMutexNew,      /* xNew() */
 	UnixMutexRelease,  /* xRelease() */
 	UnixMutexEnter,    /* xEnter() */
-	0,                 /* xTryEnter() */
+	UnixMutexTryEnter, /* xTryEnter() */
 	UnixMutexLeave     /* xLeave() */
 };
 JX9_PRIVATE const SyMutexMethods * SyMutexExportMethods(void)
@@ -27264,6 +30221,9 @@ JX9_PRIVATE sxi32 SyMemBackendFree(SyMemBackend *pBackend, void * pChunk)
 	return rc;
 }
 #if defined(JX9_ENABLE_THREADS)
+/* Forward declaration */
+static sxi32 MemCacheInit(SyMemBackend *pBackend);
+static void MemCacheRelease(SyMemBackend *pBackend, int bFlush);
 JX9_PRIVATE sxi32 SyMemBackendMakeThreadSafe(SyMemBackend *pBackend, const SyMutexMethods *pMethods)
 {
 	SyMutex *pMutex;
@@ -27279,6 +30239,8 @@ JX9_PRIVATE sxi32 SyMemBackendMakeThreadSafe(SyMemBackend *pBackend, const SyMut
 	/* Attach the mutex to the memory backend */
 	pBackend->pMutex = pMutex;
 	pBackend->pMutexMethods = pMethods;
+	/* Per-thread caches (Not fatal on failure) */
+	MemCacheInit(&(*pBackend));
 	return SXRET_OK;
 }
 JX9_PRIVATE sxi32 SyMemBackendDisbaleMutexing(SyMemBackend *pBackend)
@@ -27292,6 +30254,10 @@ JX9_PRIVATE sxi32 SyMemBackendDisbaleMutexing(SyMemBackend *pBackend)
 		/* There is no mutex subsystem at all */
 		return SXRET_OK;
 	}
+	if( pBackend->pCache ){
+		/* Give the cached chunks back to the pools */
+		MemCacheRelease(&(*pBackend), TRUE);
+	}
 	SyMutexRelease(pBackend->pMutexMethods, pBackend->pMutex);
 	pBackend->pMutexMethods = 0;
 	pBackend->pMutex = 0; 
@@ -27371,6 +30337,310 @@ static void * MemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nByte)
 	pBucket->nBucket = (SXMEM_POOL_MAGIC << 16) | nBucket;
 	return (void *)&pBucket[1];
 }
+#if defined(JX9_ENABLE_THREADS)
+/*
+ * Per-thread caches.
+ * A thread-safe backend puts a small cache of free chunks per bucket in front
+ * of apPool[] for each thread, so that most pool allocations and releases only
+ * lock the cache of the calling thread instead of the backend mutex.
+ * Chunks move between a cache and apPool[] by batches under the backend mutex.
+ * Threads are given one of the SXMEM_CACHE_COUNT caches on first use in a
+ * round-robin fashion, threads beyond that number share a cache.
+ * Each cache starts on its own CPU cache line so that threads do not write
+ * to the same lines.
+ */
+#define SXMEM_CACHE_COUNT	16
+#define SXMEM_CACHE_LINE	64
+/* Chunks moved at once between a cache and the shared pool (8KB worth, 2 to 32 chunks) */
+#define SXMEM_CACHE_BATCH(SIZE)	((SIZE) >= 4096 ? 2 : ((8192 / (SIZE)) > 32 ? 32 : (8192 / (SIZE))))
+/* Cache of a single thread */
+typedef struct SyMemMagazine SyMemMagazine;
+struct SyMemMagazine
+{
+	SyMutex *pMutex; /* Only contended when threads share this cache */
+	SyMemHeader *apChunk[SXMEM_POOL_NBUCKETS+SXMEM_POOL_INCR]; /* Cached chunks */
+	sxu32 anChunk[SXMEM_POOL_NBUCKETS+SXMEM_POOL_INCR];       /* Number of cached chunks per bucket */
+	SyMemCacheStats sStats; /* Counters */
+};
+/* Distance between two caches */
+#define SXMEM_CACHE_STRIDE	((sizeof(SyMemMagazine) + (SXMEM_CACHE_LINE - 1)) & ~(SXMEM_CACHE_LINE - 1))
+/* Per-thread caches of a backend */
+struct SyMemCache
+{
+	char *zMagazine;           /* SXMEM_CACHE_COUNT caches, SXMEM_CACHE_STRIDE bytes apart */
+	void *pRaw;                /* Allocated block */
+	SyMemCache *pNext, *pPrev; /* List of active caches */
+};
+#define MemCacheAt(CACHE, IDX)	((SyMemMagazine *)&(CACHE)->zMagazine[(IDX) * SXMEM_CACHE_STRIDE])
+#if defined(SX_THREAD_LOCAL)
+static SX_THREAD_LOCAL sxu32 iMemCacheSlot = 0; /* 1 + Cache index of the calling thread */
+#endif
+/* Global state of the per-thread caches, protected by the third static mutex */
+static struct Global_MemCache
+{
+	SyMemCache *pList;         /* Active caches */
+	SyMemCacheStats sRetired;  /* Counters of the released caches */
+	sxu32 nThread;             /* Threads given a cache so far */
+}sMemCacheGlobal = { 0, {0, 0, 0, 0, 0}, 0 };
+/*
+ * Return the cache of the calling thread.
+ */
+static SyMemMagazine * MemCacheGet(SyMemBackend *pBackend)
+{
+#if defined(SX_THREAD_LOCAL)
+	if( iMemCacheSlot == 0 ){
+		SyMutex *pStatic = SyMutexNew(pBackend->pMutexMethods, SXMUTEX_TYPE_STATIC_3);
+		SyMutexEnter(pBackend->pMutexMethods, pStatic);
+		iMemCacheSlot = 1 + (sMemCacheGlobal.nThread++ % SXMEM_CACHE_COUNT);
+		SyMutexLeave(pBackend->pMutexMethods, pStatic);
+	}
+	return MemCacheAt(pBackend->pCache, iMemCacheSlot - 1);
+#else
+	/* No thread-local storage, all threads share the first cache */
+	return MemCacheAt(pBackend->pCache, 0);
+#endif
+}
+/*
+ * Enter the backend mutex on behalf of a given cache.
+ */
+static void MemCacheLockBackend(SyMemBackend *pBackend, SyMemMagazine *pMag)
+{
+	const SyMutexMethods *pMethods = pBackend->pMutexMethods;
+	if( pMethods->xTryEnter ){
+		if( pMethods->xTryEnter(pBackend->pMutex) == SXRET_OK ){
+			return;
+		}
+		/* Contended */
+		pMag->sStats.nWait++;
+	}
+	pMethods->xEnter(pBackend->pMutex);
+}
+/*
+ * Allocate the per-thread caches of a thread-safe backend.
+ */
+static sxi32 MemCacheInit(SyMemBackend *pBackend)
+{
+	SyMemMagazine *pMag;
+	SyMemCache *pCache;
+	SyMutex *pStatic;
+	char *zRaw, *zBase;
+	sxu32 nByte, i;
+	nByte = (sxu32)(SXMEM_CACHE_COUNT * SXMEM_CACHE_STRIDE + sizeof(SyMemCache) + SXMEM_CACHE_LINE);
+	zRaw = (char *)pBackend->pMethods->xAlloc(nByte);
+	if( zRaw == 0 ){
+		return SXERR_MEM;
+	}
+	SyZero(zRaw, nByte);
+	/* Align on a cache line, the header follows the caches */
+	zBase = &zRaw[(SXMEM_CACHE_LINE - (SX_PTR_TO_INT(zRaw) & (SXMEM_CACHE_LINE - 1))) & (SXMEM_CACHE_LINE - 1)];
+	pCache = (SyMemCache *)&zBase[SXMEM_CACHE_COUNT * SXMEM_CACHE_STRIDE];
+	pCache->zMagazine = zBase;
+	pCache->pRaw = (void *)zRaw;
+	for( i = 0 ; i < SXMEM_CACHE_COUNT ; ++i ){
+		pMag = MemCacheAt(pCache, i);
+		pMag->pMutex = SyMutexNew(pBackend->pMutexMethods, SXMUTEX_TYPE_FAST);
+		if( pMag->pMutex == 0 ){
+			while( i > 0 ){
+				i--;
+				SyMutexRelease(pBackend->pMutexMethods, MemCacheAt(pCache, i)->pMutex);
+			}
+			pBackend->pMethods->xFree((void *)zRaw);
+			return SXERR_OS;
+		}
+	}
+	/* Register this cache */
+	pStatic = SyMutexNew(pBackend->pMutexMethods, SXMUTEX_TYPE_STATIC_3);
+	SyMutexEnter(pBackend->pMutexMethods, pStatic);
+	MACRO_LD_PUSH(sMemCacheGlobal.pList, pCache);
+	SyMutexLeave(pBackend->pMutexMethods, pStatic);
+	pBackend->pCache = pCache;
+	return SXRET_OK;
+}
+/*
+ * Release the per-thread caches of a backend.
+ * If bFlush is true, cached chunks are given back to apPool[], otherwise
+ * they are about to be released with the backend blocks.
+ */
+static void MemCacheRelease(SyMemBackend *pBackend, int bFlush)
+{
+	SyMemCache *pCache = pBackend->pCache;
+	SyMemMagazine *pMag;
+	SyMemHeader *pChunk;
+	SyMutex *pStatic;
+	sxu32 i, j;
+	pStatic = SyMutexNew(pBackend->pMutexMethods, SXMUTEX_TYPE_STATIC_3);
+	SyMutexEnter(pBackend->pMutexMethods, pStatic);
+	MACRO_LD_REMOVE(sMemCacheGlobal.pList, pCache);
+	for( i = 0 ; i < SXMEM_CACHE_COUNT ; ++i ){
+		pMag = MemCacheAt(pCache, i);
+		/* Keep the counters */
+		sMemCacheGlobal.sRetired.nHit += pMag->sStats.nHit;
+		sMemCacheGlobal.sRetired.nRefill += pMag->sStats.nRefill;
+		sMemCacheGlobal.sRetired.nFlush += pMag->sStats.nFlush;
+		sMemCacheGlobal.sRetired.nWait += pMag->sStats.nWait;
+	}
+	SyMutexLeave(pBackend->pMutexMethods, pStatic);
+	for( i = 0 ; i < SXMEM_CACHE_COUNT ; ++i ){
+		pMag = MemCacheAt(pCache, i);
+		if( bFlush ){
+			for( j = 0 ; j < SX_ARRAYSIZE(pMag->apChunk) ; ++j ){
+				while( pMag->apChunk[j] ){
+					pChunk = pMag->apChunk[j];
+					pMag->apChunk[j] = pChunk->pNext;
+					pChunk->pNext = pBackend->apPool[j];
+					pBackend->apPool[j] = pChunk;
+				}
+			}
+		}
+		SyMutexRelease(pBackend->pMutexMethods, pMag->pMutex);
+	}
+	pBackend->pCache = 0;
+	pBackend->pMethods->xFree(pCache->pRaw);
+}
+/*
+ * Pool allocation on behalf of a backend with per-thread caches.
+ */
+static void * MemCacheAlloc(SyMemBackend *pBackend, sxu32 nByte)
+{
+	SyMemMagazine *pMag;
+	SyMemHeader *pBucket;
+	sxu32 nBucketSize;
+	sxu32 nBucket, n;
+	if( nByte + sizeof(SyMemHeader) >= SXMEM_POOL_MAXALLOC ){
+		/* Big chunks are not cached */
+		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
+		pBucket = (SyMemHeader *)MemBackendPoolAlloc(&(*pBackend), nByte);
+		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
+		return (void *)pBucket;
+	}
+	/* Locate the appropriate bucket */
+	nBucket = 0;
+	nBucketSize = SXMEM_POOL_MINALLOC;
+	while( nByte + sizeof(SyMemHeader) > nBucketSize  ){
+		nBucketSize <<= 1;
+		nBucket++;
+	}
+	pMag = MemCacheGet(&(*pBackend));
+	SyMutexEnter(pBackend->pMutexMethods, pMag->pMutex);
+	pBucket = pMag->apChunk[nBucket];
+	if( pBucket ){
+		pMag->sStats.nHit++;
+	}else{
+		/* Refill from the shared pool */
+		MemCacheLockBackend(&(*pBackend), pMag);
+		for( n = 0 ; n < SXMEM_CACHE_BATCH(nBucketSize) ; ++n ){
+			if( pBackend->apPool[nBucket] == 0 && MemPoolBucketAlloc(&(*pBackend), nBucket) != SXRET_OK ){
+				break;
+			}
+			pBucket = pBackend->apPool[nBucket];
+			pBackend->apPool[nBucket] = pBucket->pNext;
+			pBucket->pNext = pMag->apChunk[nBucket];
+			pMag->apChunk[nBucket] = pBucket;
+			pMag->anChunk[nBucket]++;
+		}
+		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
+		pMag->sStats.nRefill++;
+		pBucket = pMag->apChunk[nBucket];
+		if( pBucket == 0 ){
+			/* Out of memory */
+			SyMutexLeave(pBackend->pMutexMethods, pMag->pMutex);
+			return 0;
+		}
+	}
+	/* Remove from the cache */
+	pMag->apChunk[nBucket] = pBucket->pNext;
+	pMag->anChunk[nBucket]--;
+	SyMutexLeave(pBackend->pMutexMethods, pMag->pMutex);
+	/* Record bucket&magic number */
+	pBucket->nBucket = (SXMEM_POOL_MAGIC << 16) | nBucket;
+	return (void *)&pBucket[1];
+}
+/*
+ * Pool release on behalf of a backend with per-thread caches.
+ */
+static sxi32 MemCacheFree(SyMemBackend *pBackend, void * pChunk)
+{
+	SyMemMagazine *pMag;
+	SyMemHeader *pHeader;
+	sxu32 nBucket, nBatch, n;
+	/* Get the corresponding bucket */
+	pHeader = (SyMemHeader *)(((char *)pChunk) - sizeof(SyMemHeader));
+	/* Sanity check to avoid misuse */
+	if( (pHeader->nBucket >> 16) != SXMEM_POOL_MAGIC ){
+		return SXERR_CORRUPT;
+	}
+	nBucket = pHeader->nBucket & 0xFFFF;
+	if( nBucket == SXU16_HIGH ){
+		/* Free the big block */
+		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
+		MemBackendFree(&(*pBackend), pHeader);
+		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
+		return SXRET_OK;
+	}
+	nBucket &= 0x0f;
+	pMag = MemCacheGet(&(*pBackend));
+	SyMutexEnter(pBackend->pMutexMethods, pMag->pMutex);
+	pHeader->pNext = pMag->apChunk[nBucket];
+	pMag->apChunk[nBucket] = pHeader;
+	pMag->anChunk[nBucket]++;
+	nBatch = SXMEM_CACHE_BATCH((sxu32)1 << (nBucket + SXMEM_POOL_INCR));
+	if( pMag->anChunk[nBucket] > (nBatch << 1) ){
+		/* Give a batch back to the shared pool */
+		MemCacheLockBackend(&(*pBackend), pMag);
+		for( n = 0 ; n < nBatch ; ++n ){
+			pHeader = pMag->apChunk[nBucket];
+			pMag->apChunk[nBucket] = pHeader->pNext;
+			pHeader->pNext = pBackend->apPool[nBucket];
+			pBackend->apPool[nBucket] = pHeader;
+		}
+		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
+		pMag->anChunk[nBucket] -= nBatch;
+		pMag->sStats.nFlush++;
+	}
+	SyMutexLeave(pBackend->pMutexMethods, pMag->pMutex);
+	return SXRET_OK;
+}
+/*
+ * Collect the counters of the per-thread caches of every thread-safe backend.
+ * If bReset is true, the counters start again from zero.
+ */
+JX9_PRIVATE void SyMemBackendCacheStats(const SyMutexMethods *pMethods, SyMemCacheStats *pStats, int bReset)
+{
+	SyMemMagazine *pMag;
+	SyMemCache *pCache;
+	SyMutex *pStatic;
+	sxu32 i, j;
+	SyZero(pStats, sizeof(SyMemCacheStats));
+	if( pMethods == 0 ){
+		/* Single-threaded library, there are no caches */
+		return;
+	}
+	pStatic = SyMutexNew(pMethods, SXMUTEX_TYPE_STATIC_3);
+	SyMutexEnter(pMethods, pStatic);
+	*pStats = sMemCacheGlobal.sRetired;
+	if( bReset ){
+		SyZero(&sMemCacheGlobal.sRetired, sizeof(SyMemCacheStats));
+	}
+	for( pCache = sMemCacheGlobal.pList ; pCache ; pCache = pCache->pNext ){
+		for( i = 0 ; i < SXMEM_CACHE_COUNT ; ++i ){
+			pMag = MemCacheAt(pCache, i);
+			SyMutexEnter(pMethods, pMag->pMutex);
+			pStats->nHit += pMag->sStats.nHit;
+			pStats->nRefill += pMag->sStats.nRefill;
+			pStats->nFlush += pMag->sStats.nFlush;
+			pStats->nWait += pMag->sStats.nWait;
+			for( j = 0 ; j < SX_ARRAYSIZE(pMag->anChunk) ; ++j ){
+				pStats->nCached += pMag->anChunk[j];
+			}
+			if( bReset ){
+				SyZero(&pMag->sStats, sizeof(SyMemCacheStats));
+			}
+			SyMutexLeave(pMethods, pMag->pMutex);
+		}
+	}
+	SyMutexLeave(pMethods, pStatic);
+}
+#endif /* JX9_ENABLE_THREADS */
 JX9_PRIVATE void * SyMemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nByte)
 {
 	void *pChunk;
@@ -27378,6 +30648,11 @@ JX9_PRIVATE void * SyMemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nByte)
 	if( SXMEM_BACKEND_CORRUPT(pBackend) ){
 		return 0;
 	}
+#endif
+#if defined(JX9_ENABLE_THREADS)
+	if( pBackend->pCache ){
+		return MemCacheAlloc(&(*pBackend), nByte);
+	}
 #endif
 	if( pBackend->pMutexMethods ){
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
@@ -27416,6 +30691,11 @@ JX9_PRIVATE sxi32 SyMemBackendPoolFree(SyMemBackend *pBackend, void * pChunk)
 	if( SXMEM_BACKEND_CORRUPT(pBackend) || pChunk == 0 ){
 		return SXERR_CORRUPT;
 	}
+#endif
+#if defined(JX9_ENABLE_THREADS)
+	if( pBackend->pCache ){
+		return MemCacheFree(&(*pBackend), pChunk);
+	}
 #endif
 	if( pBackend->pMutexMethods ){
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
@@ -27556,6 +30836,10 @@ JX9_PRIVATE sxi32 SyMemBackendInitFromParent(SyMemBackend *pBackend,const SyMemB
 		if( pBackend->pMutex ==  0){
 			return SXERR_OS;
 		}
+#if defined(JX9_ENABLE_THREADS)
+		/* Per-thread caches (Not fatal on failure) */
+		MemCacheInit(&(*pBackend));
+#endif
 	}
 #if defined(UNTRUST)
 	pBackend->nMagic = SXMEM_BACKEND_MAGIC;
@@ -27618,6 +30902,12 @@ JX9_PRIVATE sxi32 SyMemBackendRelease(SyMemBackend *pBackend)
 	if( SXMEM_BACKEND_CORRUPT(pBackend) ){
 		return SXERR_INVALID;
 	}
+#endif
+#if defined(JX9_ENABLE_THREADS)
+	if( pBackend->pCache ){
+		/* Cached chunks are released with the blocks */
+		MemCacheRelease(&(*pBackend), FALSE);
+	}
 #endif
 	if( pBackend->pMutexMethods ){
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
@@ -40538,8 +43828,10 @@ static int UnixVfs_Mmap(const char *zPath, void **ppMap, jx9_int64 *pSize)
 	}
 	/* stat the handle */
 	fstat(fd, &st);
-	/* Obtain a memory view of the whole file */
-	pMap = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE|MAP_FILE, fd, 0);
+	/* Obtain a memory view of the whole file. The view is shared so that
+	 * writes performed through the file descriptor are guaranteed to be visible.
+	 */
+	pMap = mmap(0, st.st_size, PROT_READ, MAP_SHARED|MAP_FILE, fd, 0);
 	rc = JX9_OK;
 	if( pMap == MAP_FAILED ){
 		rc = -1;
@@ -48675,10 +51967,37 @@ static sxi32 VmGetNextLine(SyString *pCursor, SyString *pCurrent)
  */
 /* Magic number identifying a valid storage image */
 #define L_HASH_MAGIC 0xFA782DCB
+/*
+ * Magic number identifying a storage image whose keys are hashed using the
+ * builtin seeded hash. The 4 bytes following the magic number hold the seed
+ * instead of the hash function fingerprint.
+ */
+#define L_HASH_MAGIC_SEEDED 0xFA782DCC
 /*
  * Magic word to hash to identify a valid hash function.
  */
 #define L_HASH_WORD "chm@symisc"
+/*
+ * Default seed of the builtin hash function.
+ */
+#define L_HASH_SEED 0x2F0B3A49
+/*
+ * Slot of a cell in the in-memory cell table of its page.
+ * All the cells stored in a bucket share the low bits of their hash (the ones
+ * that selected the bucket), so the hash is remixed (Murmur3 finalizer) before
+ * being masked, otherwise every cell of a large database would end up in the
+ * same chain.
+ */
+#define L_HASH_CELL_SLOT(HASH,SIZE) (lhCellMix(HASH) & ((SIZE) - 1))
+static sxu32 lhCellMix(sxu32 nHash)
+{
+	nHash ^= nHash >> 16;
+	nHash *= 0x85EBCA6B;
+	nHash ^= nHash >> 13;
+	nHash *= 0xC2B2AE35;
+	nHash ^= nHash >> 16;
+	return nHash;
+}
 /*
  * Cell size on disk. 
  */
@@ -48785,7 +52104,11 @@ struct lhash_kv_engine
 	const unqlite_kv_io *pIo;     /* IO methods: Must be first */
 	/* Private fields */
 	SyMemBackend sAllocator;      /* Private memory backend */
-	ProcHash xHash;               /* Default hash function */
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutex *pMutex;              /* Serialize page loads of concurrent readers */
+#endif
+	ProcHash xHash;               /* User hash function or legacy DJB hash, NULL for the builtin seeded hash */
+	sxu32 nSeed;                  /* Seed of the builtin hash function */
 	ProcCmp xCmp;                 /* Default comparison function */
 	unqlite_page *pHeader;        /* Page one to identify a valid implementation */
 	lhash_bmap_rec **apMap;       /* Buckets map records */
@@ -48801,6 +52124,113 @@ struct lhash_kv_engine
 	pgno nmax_split_nucket;       /* Next maximum split bucket (1 << nMsb): In-memory only */
 	sxu32 nMagic;                 /* Magic number to identify a valid linear hash disk database */
 };
+/*
+ * Legacy hash function (DJB). Used by databases created before the seeded
+ * hash become the default.
+ */
+static sxu32 lhash_bin_hash(const void *pSrc,sxu32 nLen)
+{
+	register unsigned char *zIn = (unsigned char *)pSrc;
+	unsigned char *zEnd;
+	sxu32 nH = 5381;
+	if( nLen > 2048 /* 2K */ ){
+		nLen = 2048;
+	}
+	zEnd = &zIn[nLen];
+	for(;;){
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+	}	
+	return nH;
+}
+/*
+ * Builtin seeded hash function (XXH64 folded to 32 bits).
+ * The key is consumed 8 bytes at a time (32 bytes per round for long keys) and
+ * every byte of it contributes to the final avalanche, so keys sharing a long
+ * prefix spread evenly across buckets. Words are read in little-endian order
+ * so the hash value, and thus the file format, is the same on every platform.
+ */
+#define LH_PRIME64_1 0x9E3779B185EBCA87
+#define LH_PRIME64_2 0xC2B2AE3D27D4EB4F
+#define LH_PRIME64_3 0x165667B19E3779F9
+#define LH_PRIME64_4 0x85EBCA77C2B2AE63
+#define LH_PRIME64_5 0x27D4EB2F165667C5
+#define LH_ROTL64(X,R) (((X) << (R)) | ((X) >> (64 - (R))))
+#define LH_READ32(Z) ((sxu32)(Z)[0] | ((sxu32)(Z)[1] << 8) | ((sxu32)(Z)[2] << 16) | ((sxu32)(Z)[3] << 24))
+#define LH_READ64(Z) ((sxu64)LH_READ32(Z) | ((sxu64)LH_READ32(&(Z)[4]) << 32))
+static sxu64 lhash_round(sxu64 nAcc,sxu64 nInput)
+{
+	nAcc += nInput * LH_PRIME64_2;
+	nAcc = LH_ROTL64(nAcc,31);
+	return nAcc * LH_PRIME64_1;
+}
+static sxu64 lhash_merge_round(sxu64 nAcc,sxu64 nVal)
+{
+	nAcc ^= lhash_round(0,nVal);
+	return nAcc * LH_PRIME64_1 + LH_PRIME64_4;
+}
+static sxu32 lhash_seeded_hash(const void *pSrc,sxu32 nLen,sxu32 nSeed)
+{
+	const unsigned char *zIn = (const unsigned char *)pSrc;
+	const unsigned char *zEnd = &zIn[nLen];
+	sxu64 nH;
+	if( nLen >= 32 ){
+		const unsigned char *zLimit = zEnd - 32;
+		sxu64 v1 = (sxu64)nSeed + LH_PRIME64_1 + LH_PRIME64_2;
+		sxu64 v2 = (sxu64)nSeed + LH_PRIME64_2;
+		sxu64 v3 = (sxu64)nSeed;
+		sxu64 v4 = (sxu64)nSeed - LH_PRIME64_1;
+		do{
+			v1 = lhash_round(v1,LH_READ64(zIn));      zIn += 8;
+			v2 = lhash_round(v2,LH_READ64(zIn));      zIn += 8;
+			v3 = lhash_round(v3,LH_READ64(zIn));      zIn += 8;
+			v4 = lhash_round(v4,LH_READ64(zIn));      zIn += 8;
+		}while( zIn <= zLimit );
+		nH = LH_ROTL64(v1,1) + LH_ROTL64(v2,7) + LH_ROTL64(v3,12) + LH_ROTL64(v4,18);
+		nH = lhash_merge_round(nH,v1);
+		nH = lhash_merge_round(nH,v2);
+		nH = lhash_merge_round(nH,v3);
+		nH = lhash_merge_round(nH,v4);
+	}else{
+		nH = (sxu64)nSeed + LH_PRIME64_5;
+	}
+	nH += (sxu64)nLen;
+	while( zIn + 8 <= zEnd ){
+		nH ^= lhash_round(0,LH_READ64(zIn));
+		nH = LH_ROTL64(nH,27) * LH_PRIME64_1 + LH_PRIME64_4;
+		zIn += 8;
+	}
+	if( zIn + 4 <= zEnd ){
+		nH ^= (sxu64)LH_READ32(zIn) * LH_PRIME64_1;
+		nH = LH_ROTL64(nH,23) * LH_PRIME64_2 + LH_PRIME64_3;
+		zIn += 4;
+	}
+	while( zIn < zEnd ){
+		nH ^= (sxu64)zIn[0] * LH_PRIME64_5;
+		nH = LH_ROTL64(nH,11) * LH_PRIME64_1;
+		zIn++;
+	}
+	/* Final avalanche */
+	nH ^= nH >> 33;
+	nH *= LH_PRIME64_2;
+	nH ^= nH >> 29;
+	nH *= LH_PRIME64_3;
+	nH ^= nH >> 32;
+	return (sxu32)nH;
+}
+/*
+ * Hash a key using the hash function this database was created with.
+ */
+static sxu32 lhHashKey(lhash_kv_engine *pEngine,const void *pKey,sxu32 nLen)
+{
+	if( pEngine->xHash ){
+		/* User defined or legacy hash function */
+		return pEngine->xHash(pKey,nLen);
+	}
+	return lhash_seeded_hash(pKey,nLen,pEngine->nSeed);
+}
 /*
  * Given a logical bucket number, return the record associated with it.
  */
@@ -48961,7 +52391,7 @@ static void lhCellDiscard(lhcell *pCell)
 	if( pCell->pPrevCol ){
 		pCell->pPrevCol->pNextCol = pCell->pNextCol;
 	}else{
-		pPage->apCell[pCell->nHash & (pPage->nCellSize - 1)] = pCell->pNextCol;
+		pPage->apCell[L_HASH_CELL_SLOT(pCell->nHash,pPage->nCellSize)] = pCell->pNextCol;
 	}
 	if( pCell->pNextCol ){
 		pCell->pNextCol->pPrevCol = pCell->pPrevCol;
@@ -48996,7 +52426,7 @@ static int lhInstallCell(lhcell *pCell)
 		pPage->apCell = apTable;
 		pPage->nCellSize = nTableSize;
 	}
-	iBucket = pCell->nHash & (pPage->nCellSize - 1);
+	iBucket = L_HASH_CELL_SLOT(pCell->nHash,pPage->nCellSize);
 	pCell->pNextCol = pPage->apCell[iBucket];
 	if( pPage->apCell[iBucket] ){
 		pPage->apCell[iBucket]->pPrevCol = pCell;
@@ -49029,7 +52459,7 @@ static int lhInstallCell(lhcell *pCell)
 				}
 				pEntry->pNextCol = pEntry->pPrevCol = 0;
 				/* Install in the new bucket */
-				iBucket = pEntry->nHash & (nNewSize - 1);
+				iBucket = L_HASH_CELL_SLOT(pEntry->nHash,nNewSize);
 				pEntry->pNextCol = apNew[iBucket];
 				if( apNew[iBucket]  ){
 					apNew[iBucket]->pPrevCol = pEntry;
@@ -49097,7 +52527,7 @@ static lhcell * lhFindCell(
 		return 0;
 	}
 	/* Point to the corresponding bucket */
-	pEntry = pPage->apCell[nHash & (pPage->nCellSize - 1)];
+	pEntry = pPage->apCell[L_HASH_CELL_SLOT(nHash,pPage->nCellSize)];
 	for(;;){
 		if( pEntry == 0 ){
 			break;
@@ -49329,6 +52759,11 @@ static int lhLoadPage(lhash_kv_engine *pEngine,pgno pnum,lhpage *pMaster,lhpage
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Concurrent readers may be loading the same page */
+	SyMutexEnter(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	rc = UNQLITE_OK;
 	if( pRaw->pUserData ){
 		/* The page is already parsed and loaded in memory. Point to it */
 		pPage = (lhpage *)pRaw->pUserData;
@@ -49336,7 +52771,8 @@ static int lhLoadPage(lhash_kv_engine *pEngine,pgno pnum,lhpage *pMaster,lhpage
 		/* Allocate a new page */
 		pPage = lhNewPage(pEngine,pRaw,pMaster);
 		if( pPage == 0 ){
-			return UNQLITE_NOMEM;
+			rc = UNQLITE_NOMEM;
+			goto leave;
 		}
 		/* Process the page */
 		rc = lhParsePageHeader(pPage);
@@ -49346,7 +52782,7 @@ static int lhLoadPage(lhash_kv_engine *pEngine,pgno pnum,lhpage *pMaster,lhpage
 		}
 		if( rc != UNQLITE_OK ){
 			pEngine->pIo->xPageUnref(pPage->pRaw); /* pPage will be released inside this call */
-			return rc;
+			goto leave;
 		}
 		if( pPage->sHdr.iSlave > 0 && iNest < 128 ){
 			if( pMaster == 0 ){
@@ -49359,7 +52795,11 @@ static int lhLoadPage(lhash_kv_engine *pEngine,pgno pnum,lhpage *pMaster,lhpage
 	if( ppOut ){
 		*ppOut = pPage;
 	}
-	return UNQLITE_OK;
+leave:
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexLeave(pEngine->sAllocator.pMutexMethods,pEngine->pMutex);
+#endif
+	return rc;
 }
 /*
  * Given a cell, Consume its key by invoking the given callback for each extracted chunk.
@@ -49531,24 +52971,38 @@ static int lhash_read_header(lhash_kv_engine *pEngine,unqlite_page *pHeader)
 {
 	const unsigned char *zRaw = pHeader->zData;
 	lhash_bmap_page *pMap;
-	sxu32 nHash;
+	sxu32 nMagic,nHash;
 	int rc;
 	pEngine->pHeader = pHeader;
 	/* 4 byte magic number */
-	SyBigEndianUnpack32(zRaw,&pEngine->nMagic);
+	SyBigEndianUnpack32(zRaw,&nMagic);
 	zRaw += 4;
-	if( pEngine->nMagic != L_HASH_MAGIC ){
+	if( nMagic != L_HASH_MAGIC && nMagic != L_HASH_MAGIC_SEEDED ){
 		/* Corrupt implementation */
 		return UNQLITE_CORRUPT;
 	}
-	/* 4 byte hash value to identify a valid hash function */
+	/* 4 byte hash value to identify a valid hash function or seed of the builtin hash */
 	SyBigEndianUnpack32(zRaw,&nHash);
 	zRaw += 4;
-	/* Sanity check */
-	if( pEngine->xHash(L_HASH_WORD,sizeof(L_HASH_WORD)-1) != nHash ){
-		/* Different hash function */
-		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Invalid hash function");
-		return UNQLITE_INVALID;
+	if( nMagic == L_HASH_MAGIC_SEEDED ){
+		if( pEngine->nMagic != L_HASH_MAGIC_SEEDED ){
+			/* A user hash function was installed */
+			pEngine->pIo->xErr(pEngine->pIo->pHandle,"Invalid hash function");
+			return UNQLITE_INVALID;
+		}
+		pEngine->nSeed = nHash;
+	}else{
+		if( pEngine->xHash == 0 ){
+			/* Database created with the legacy hash function */
+			pEngine->xHash = lhash_bin_hash;
+			pEngine->nMagic = L_HASH_MAGIC;
+		}
+		/* Sanity check */
+		if( pEngine->xHash(L_HASH_WORD,sizeof(L_HASH_WORD)-1) != nHash ){
+			/* Different hash function */
+			pEngine->pIo->xErr(pEngine->pIo->pHandle,"Invalid hash function");
+			return UNQLITE_INVALID;
+		}
 	}
 	/* List of free pages */
 	SyBigEndianUnpack64(zRaw,&pEngine->nFreeList);
@@ -49624,7 +53078,7 @@ static int lhRecordLookup(
 		return rc;
 	}
 	/* Compute the hash of the key first */
-	nHash = pEngine->xHash(pKey,nByte);
+	nHash = lhHashKey(pEngine,pKey,nByte);
 	/* Extract the logical (i.e. not real) page number */
 	iBucket = nHash & (pEngine->nmax_split_nucket - 1);
 	if( iBucket >= (pEngine->split_bucket + pEngine->max_split_bucket) ){
@@ -49783,10 +53237,18 @@ static int lhPageDefragment(lhpage *pPage)
 	lhash_kv_engine *pEngine = pPage->pHash;
 	unsigned char *zTmp,*zPtr,*zEnd,*zPayload;
 	lhcell *pCell;
+	int rc;
+	/* Acquire writer lock on this page before rewriting it */
+	rc = pEngine->pIo->xWrite(pPage->pRaw);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
 	/* Get a temporary page from the pager. This opertaion never fail */
 	zTmp = pEngine->pIo->xTmpPage(pEngine->pIo->pHandle);
-	/* Move the target cells to the begining */
-	pCell = pPage->pList;
+	/* Move the target cells to the begining. Cells of slave pages are
+	 * linked to the list of their master page.
+	 */
+	pCell = pPage->pMaster->pList;
 	/* Write the slave page number */
 	SyBigEndianPack64(&zTmp[2/*Offset of the first cell */+2/*Offset of the first free block */],pPage->sHdr.iSlave);
 	zPtr = &zTmp[L_HASH_PAGE_HDR_SZ]; /* Offset to start writing from */
@@ -49870,7 +53332,7 @@ static int lhPageDefragment(lhpage *pPage)
 static int lhAllocateSpace(lhpage *pPage,sxu64 nAmount,sxu16 *pOfft)
 {
 	const unsigned char *zEnd,*zPtr;
-	sxu16 iNext,iBlksz,nByte;
+	sxu16 iNext,iBlksz,nByte,iPrev;
 	unsigned char *zPrev;
 	int rc;
 	if( (sxu64)pPage->nFree < nAmount ){
@@ -49917,13 +53379,18 @@ static int lhAllocateSpace(lhpage *pPage,sxu64 nAmount,sxu16 *pOfft)
 		/* Point to the next free block */
 		zPtr = &pPage->pRaw->zData[iNext];
 	}
+	/* Save block offsets */
+	*pOfft = (sxu16)(zPtr - pPage->pRaw->zData);
+	iPrev = zPrev ? (sxu16)(zPrev - pPage->pRaw->zData) : 0;
 	/* Acquire writer lock on this page */
 	rc = pPage->pHash->pIo->xWrite(pPage->pRaw);
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
-	/* Save block offset */
-	*pOfft = (sxu16)(zPtr - pPage->pRaw->zData);
+	/* The writer lock may relocate the page content (memory mapped pages) */
+	if( zPrev ){
+		zPrev = &pPage->pRaw->zData[iPrev];
+	}
 	/* Fix pointers */
 	if( iBlksz >= nByte && (iBlksz - nByte) > 3 ){
 		unsigned char *zBlock = &pPage->pRaw->zData[(*pOfft) + nByte];
@@ -50386,9 +53853,6 @@ static int lhRecordOverwrite(
 			pEngine->pIo->xPageUnref(pOld);
 		}
 	}
-	/* Point to the data offset */
-	zRaw = &pOvfl->zData[pCell->iDataOfft];
-	zRawEnd = &pOvfl->zData[pEngine->iPageSize];
 	/* The data to be stored */
 	zPtr = (const unsigned char *)pData;
 	zEnd = &zPtr[nByte];
@@ -50398,6 +53862,9 @@ static int lhRecordOverwrite(
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
+	/* Point to the data offset (the page content may have been relocated by the writer lock) */
+	zRaw = &pOvfl->zData[pCell->iDataOfft];
+	zRawEnd = &pOvfl->zData[pEngine->iPageSize];
 	SyBigEndianPack64(pOvfl->zData,0);
 	for(;;){
 		sxu32 nLen;
@@ -50454,7 +53921,7 @@ static int lhRecordAppend(
 	unsigned char *zRaw,*zRawEnd;
 	unqlite_page *pOvfl,*pNew;
 	sxu64 nDatalen;
-	sxu32 nAvail;
+	sxu32 nAvail,iOfft;
 	pgno iOvfl;
 	int rc;
 	if( pCell->nData + nByte < pCell->nData ){
@@ -50555,11 +54022,14 @@ static int lhRecordAppend(
 	/* Start the append process */
 	zPtr = (const unsigned char *)pData;
 	zEnd = &zPtr[nByte];
-	/* Acquire a writer lock */
+	/* Acquire a writer lock (the page content may be relocated) */
+	iOfft = (sxu32)(zRaw - pOvfl->zData);
 	rc = pEngine->pIo->xWrite(pOvfl);
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
+	zRaw = &pOvfl->zData[iOfft];
+	zRawEnd = &pOvfl->zData[pEngine->iPageSize];
 	for(;;){
 		sxu32 nLen;
 		if( zPtr >= zEnd ){
@@ -50607,7 +54077,7 @@ static int lhRecordAppend(
  */
 static int lhSetEmptyPage(lhpage *pPage)
 {
-	unsigned char *zRaw = pPage->pRaw->zData;
+	unsigned char *zRaw;
 	lhphdr *pHeader = &pPage->sHdr;
 	sxu16 nByte;
 	int rc;
@@ -50616,6 +54086,7 @@ static int lhSetEmptyPage(lhpage *pPage)
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
+	zRaw = pPage->pRaw->zData;
 	/* Offset of the first cell */
 	SyBigEndianPack16(zRaw,0);
 	zRaw += 2;
@@ -51060,7 +54531,7 @@ static int lh_record_insert(
 	}
 	iCnt = 0;
 	/* Compute the hash of the key first */
-	nHash = pEngine->xHash(pKey,(sxu32)nKeyLen);
+	nHash = lhHashKey(pEngine,pKey,(sxu32)nKeyLen);
 retry:
 	/* Extract the logical bucket number */
 	iBucket = nHash & (pEngine->nmax_split_nucket - 1);
@@ -51164,8 +54635,8 @@ static int lhash_write_header(lhash_kv_engine *pEngine,unqlite_page *pHeader)
 	/* 4 byte magic number */
 	SyBigEndianPack32(zRaw,pEngine->nMagic);
 	zRaw += 4;
-	/* 4 byte hash value to identify a valid hash function */
-	SyBigEndianPack32(zRaw,pEngine->xHash(L_HASH_WORD,sizeof(L_HASH_WORD)-1));
+	/* 4 byte hash value to identify a valid hash function or seed of the builtin hash */
+	SyBigEndianPack32(zRaw,pEngine->xHash ? pEngine->xHash(L_HASH_WORD,sizeof(L_HASH_WORD)-1) : pEngine->nSeed);
 	zRaw += 4;
 	/* List of free pages: Empty */
 	SyBigEndianPack64(zRaw,0);
@@ -51255,26 +54726,6 @@ static void lhash_page_release(void *pUserData)
 	SyMemBackendPoolFree(&pEngine->sAllocator,pPage);
 	pRaw->pUserData = 0;
 }
-/*
- * Default hash function (DJB).
- */
-static sxu32 lhash_bin_hash(const void *pSrc,sxu32 nLen)
-{
-	register unsigned char *zIn = (unsigned char *)pSrc;
-	unsigned char *zEnd;
-	sxu32 nH = 5381;
-	if( nLen > 2048 /* 2K */ ){
-		nLen = 2048;
-	}
-	zEnd = &zIn[nLen];
-	for(;;){
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-	}	
-	return nH;
-}
 /*
  * Exported: xInit() method.
  * Initialize the Key value storage engine.
@@ -51287,12 +54738,21 @@ static int lhash_kv_init(unqlite_kv_engine *pEngine,int iPageSize)
 	/* This structure is always zeroed, go to the initialization directly */
 	SyMemBackendInitFromParent(&pHash->sAllocator,unqliteExportMemBackend());
 #if defined(UNQLITE_ENABLE_THREADS)
-	/* Already protected by the upper layers */
-	SyMemBackendDisbaleMutexing(&pHash->sAllocator);
+	if( pHash->sAllocator.pMutexMethods ){
+		/* Concurrent readers allocate pages and cells, keep the allocator
+		 * thread-safe and serialize their page loads.
+		 */
+		pHash->pMutex = SyMutexNew(pHash->sAllocator.pMutexMethods,SXMUTEX_TYPE_RECURSIVE);
+		if( pHash->pMutex == 0 ){
+			rc = UNQLITE_NOMEM;
+			goto err;
+		}
+	}
 #endif
 	pHash->iPageSize = iPageSize;
-	/* Default hash function */
-	pHash->xHash = lhash_bin_hash;
+	/* Default hash function: builtin seeded hash */
+	pHash->xHash = 0;
+	pHash->nSeed = L_HASH_SEED;
 	/* Default comparison function */
 	pHash->xCmp = SyMemcmp;
 	/* Allocate a new record map */
@@ -51308,12 +54768,15 @@ static int lhash_kv_init(unqlite_kv_engine *pEngine,int iPageSize)
 	pHash->split_bucket = 0; /* Logical not real bucket number */
 	pHash->max_split_bucket = 1;
 	pHash->nmax_split_nucket = 2;
-	pHash->nMagic = L_HASH_MAGIC;
+	pHash->nMagic = L_HASH_MAGIC_SEEDED;
 	/* Install the cache unpin and reload callbacks */
 	pHash->pIo->xSetUnpin(pHash->pIo->pHandle,lhash_page_release);
 	pHash->pIo->xSetReload(pHash->pIo->pHandle,lhash_page_release);
 	return UNQLITE_OK;
 err:
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexRelease(pHash->sAllocator.pMutexMethods,pHash->pMutex);
+#endif
 	SyMemBackendRelease(&pHash->sAllocator);
 	return rc;
 }
@@ -51324,9 +54787,34 @@ err:
 static void lhash_kv_release(unqlite_kv_engine *pEngine)
 {
 	lhash_kv_engine *pHash = (lhash_kv_engine *)pEngine;
+#if defined(UNQLITE_ENABLE_THREADS)
+	SyMutexRelease(pHash->sAllocator.pMutexMethods,pHash->pMutex);
+#endif
 	/* Release the private memory backend */
 	SyMemBackendRelease(&pHash->sAllocator);
 }
+/*
+ * Update the hash identification fields of the header (magic number and
+ * fingerprint or seed) when the hash function is changed on an empty database
+ * whose header is already written.
+ */
+static int lhRecordHashId(lhash_kv_engine *pEngine)
+{
+	unqlite_page *pHeader = pEngine->pHeader;
+	int rc;
+	if( pHeader == 0 ){
+		/* Header not yet written */
+		return UNQLITE_OK;
+	}
+	rc = pEngine->pIo->xWrite(pHeader);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	SyBigEndianPack32(pHeader->zData,pEngine->nMagic);
+	SyBigEndianPack32(&pHeader->zData[4],
+		pEngine->xHash ? pEngine->xHash(L_HASH_WORD,sizeof(L_HASH_WORD)-1) : pEngine->nSeed);
+	return UNQLITE_OK;
+}
 /*
  *  Exported: xConfig() method.
  *  Configure the linear hash KV store.
@@ -51345,10 +54833,25 @@ static int lhash_kv_config(unqlite_kv_engine *pEngine,int op,va_list ap)
 			ProcHash xHash = va_arg(ap,ProcHash);
 			if( xHash ){
 				pHash->xHash = xHash;
+				pHash->nMagic = L_HASH_MAGIC;
+				/* Record the new hash function */
+				rc = lhRecordHashId(pHash);
 			}
 		}
 		break;
 									  }
+	case UNQLITE_KV_CONFIG_HASH_SEED: {
+		/* Seed of the builtin hash function */
+		if( pHash->nBuckRec > 0 || pHash->xHash ){
+			/* Locked operation or not using the builtin hash */
+			rc = UNQLITE_LOCKED;
+		}else{
+			pHash->nSeed = va_arg(ap,unsigned int);
+			/* Record the new seed */
+			rc = lhRecordHashId(pHash);
+		}
+		break;
+									  }
 	case UNQLITE_KV_CONFIG_CMP_FUNC: {
 		/* Default comparison function */
 		ProcCmp xCmp = va_arg(ap,ProcCmp);
@@ -51357,6 +54860,35 @@ static int lhash_kv_config(unqlite_kv_engine *pEngine,int op,va_list ap)
 		}
 		break;
 									 }
+	case UNQLITE_KV_CONFIG_GET_BUCKET: {
+		/* Real page number of the bucket hosting the given key */
+		const void *pKey = va_arg(ap,const void *);
+		int nByte = va_arg(ap,int);
+		unqlite_int64 *pBucket = va_arg(ap,unqlite_int64 *);
+		lhash_bmap_rec *pRec;
+		pgno iBucket;
+		sxu32 nHash;
+		if( pBucket == 0 ){
+			rc = UNQLITE_CORRUPT;
+			break;
+		}
+		/* Acquire the first page (hash Header) so that the bucket map gets loaded */
+		rc = pEngine->pIo->xGet(pEngine->pIo->pHandle,1,0);
+		if( rc != UNQLITE_OK ){
+			break;
+		}
+		nHash = lhHashKey(pHash,pKey,(sxu32)nByte);
+		/* Extract the logical bucket number */
+		iBucket = nHash & (pHash->nmax_split_nucket - 1);
+		if( iBucket >= (pHash->split_bucket + pHash->max_split_bucket) ){
+			/* Low mask */
+			iBucket = nHash & (pHash->max_split_bucket - 1);
+		}
+		/* Map the logical bucket number to real page number */
+		pRec = lhMapFindBucket(pHash,iBucket);
+		*pBucket = pRec ? (unqlite_int64)pRec->iReal : 0;
+		break;
+									   }
 	default:
 		/* Unknown OP */
 		rc = UNQLITE_UNKNOWN;
@@ -51759,24 +55291,62 @@ UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportDiskKvStorage(void)
  * know works very well for this kind of operation.
  * Again, I insist on a red-black tree implementation for future version
  * of Unqlite.
- */
+ *
+ * Records are carved out of large slabs so that storing millions of small records
+ * does not cost a heap allocation (and its bookkeeping) each. The key and the data
+ * are stored inline right after the record header. Released chunks are kept on
+ * free lists indexed by size class and reused by records of the same class.
+ * UNQLITE_KV_CONFIG_COMPACT move the live records to fresh slabs and give the
+ * space lost to the free lists back to the system.
+ */
+/* Size of a slab */
+#define MEM_ARENA_SLAB_SIZE (64 * 1024)
+/* Chunk sizes are a multiple of this value */
+#define MEM_ARENA_ALIGN     16
+/* Largest chunk carved out of a slab, larger records are allocated on their own */
+#define MEM_ARENA_MAX_CHUNK 4096
+/* Total number of size classes */
+#define MEM_ARENA_NCLASS    (MEM_ARENA_MAX_CHUNK / MEM_ARENA_ALIGN)
+/* Round up to the next chunk size */
+#define MEM_ARENA_ROUND(N)  (((N) + (MEM_ARENA_ALIGN - 1)) & ~(MEM_ARENA_ALIGN - 1))
 /* Forward declaration */
 typedef struct mem_hash_kv_engine mem_hash_kv_engine;
+typedef struct mem_hash_cursor mem_hash_cursor;
 /*
- * Each record is storead in an instance of the following structure.
+ * Each record is storead in an instance of the following structure
+ * followed by the key and the data.
  */
 typedef struct mem_hash_record mem_hash_record;
 struct mem_hash_record
 {
-	mem_hash_kv_engine *pEngine;    /* Storage engine */
 	sxu32 nHash;                    /* Hash of the key */
-	const void *pKey;               /* Key */
 	sxu32 nKeyLen;                  /* Key size (Max 1GB) */
-	const void *pData;              /* Data */
 	sxu32 nDataLen;                 /* Data length (Max 4GB) */
+	sxu32 nChunk;                   /* Size of the chunk holding this record */
 	mem_hash_record *pNext,*pPrev;  /* Link to other records */
 	mem_hash_record *pNextHash,*pPrevHash; /* Collision link */
 };
+/*
+ * Inline key and data of a record.
+ */
+#define MEM_HASH_KEY(REC)  ((const void *)&(REC)[1])
+#define MEM_HASH_DATA(REC) ((void *)&((char *)&(REC)[1])[(REC)->nKeyLen])
+/*
+ * A released chunk waiting to be reused.
+ */
+typedef struct mem_arena_chunk mem_arena_chunk;
+struct mem_arena_chunk
+{
+	mem_arena_chunk *pNext; /* Next chunk of the same size class */
+};
+/*
+ * A slab. Chunks are carved right after this header.
+ */
+typedef struct mem_arena_slab mem_arena_slab;
+struct mem_arena_slab
+{
+	mem_arena_slab *pNext; /* Next slab */
+};
 /*
  * Each in-memory KV engine is represented by an instance
  * of the following structure.
@@ -51793,7 +55363,79 @@ struct mem_hash_kv_engine
 	mem_hash_record **apBucket; /* Hash bucket */
 	mem_hash_record *pFirst;    /* First inserted entry */
 	mem_hash_record *pLast;     /* Last inserted entry */
+	mem_hash_cursor *pCursor;   /* List of active cursors */
+	mem_arena_slab *pSlab;      /* List of slabs, chunks are carved from the first one */
+	char *zBump,*zEnd;          /* Unused space of the first slab */
+	mem_arena_chunk *apFree[MEM_ARENA_NCLASS]; /* Released chunks by size class */
+};
+/*
+ * Each public cursor is identified by an instance of this structure.
+ */
+struct mem_hash_cursor
+{
+	unqlite_kv_engine *pStore; /* Must be first */
+	/* Private fields */
+	mem_hash_record *pCur;     /* Current hash record */
+	mem_hash_cursor *pNext,*pPrev; /* List of active cursors */
 };
+/*
+ * Release a chunk obtained via [MemArenaAlloc()].
+ */
+static void MemArenaFree(mem_hash_kv_engine *pEngine,void *pChunk,sxu32 nByte)
+{
+	mem_arena_chunk *pFree = (mem_arena_chunk *)pChunk;
+	sxu32 iClass;
+	if( nByte > MEM_ARENA_MAX_CHUNK ){
+		/* Allocated on its own */
+		SyMemBackendFree(&pEngine->sAlloc,pChunk);
+		return;
+	}
+	iClass = (nByte / MEM_ARENA_ALIGN) - 1;
+	pFree->pNext = pEngine->apFree[iClass];
+	pEngine->apFree[iClass] = pFree;
+}
+/*
+ * Allocate a chunk of at least *pSize bytes.
+ * On success, *pSize is set to the real size of the chunk.
+ */
+static void * MemArenaAlloc(mem_hash_kv_engine *pEngine,sxu32 *pSize)
+{
+	sxu32 nByte = MEM_ARENA_ROUND(*pSize);
+	mem_arena_slab *pSlab;
+	mem_arena_chunk *pChunk;
+	sxu32 iClass;
+	*pSize = nByte;
+	if( nByte > MEM_ARENA_MAX_CHUNK ){
+		/* Large record */
+		return SyMemBackendAlloc(&pEngine->sAlloc,nByte);
+	}
+	iClass = (nByte / MEM_ARENA_ALIGN) - 1;
+	pChunk = pEngine->apFree[iClass];
+	if( pChunk ){
+		/* Reuse a released chunk */
+		pEngine->apFree[iClass] = pChunk->pNext;
+		return (void *)pChunk;
+	}
+	if( pEngine->zBump == 0 || (sxu32)(pEngine->zEnd - pEngine->zBump) < nByte ){
+		if( pEngine->zBump < pEngine->zEnd ){
+			/* Keep the tail of the current slab */
+			MemArenaFree(pEngine,pEngine->zBump,(sxu32)(pEngine->zEnd - pEngine->zBump));
+		}
+		/* Allocate a new slab */
+		pSlab = (mem_arena_slab *)SyMemBackendAlloc(&pEngine->sAlloc,MEM_ARENA_SLAB_SIZE);
+		if( pSlab == 0 ){
+			pEngine->zBump = pEngine->zEnd = 0;
+			return 0;
+		}
+		pSlab->pNext = pEngine->pSlab;
+		pEngine->pSlab = pSlab;
+		pEngine->zBump = &((char *)pSlab)[MEM_ARENA_ALIGN];
+		pEngine->zEnd = &((char *)pSlab)[MEM_ARENA_SLAB_SIZE];
+	}
+	pChunk = (mem_arena_chunk *)pEngine->zBump;
+	pEngine->zBump += nByte;
+	return (void *)pChunk;
+}
 /*
  * Allocate a new hash record.
  */
@@ -51804,39 +55446,212 @@ static mem_hash_record * MemHashNewRecord(
 	sxu32 nHash
 	)
 {
-	SyMemBackend *pAlloc = &pEngine->sAlloc;
 	mem_hash_record *pRecord;
-	void *pDupData;
 	sxu32 nByte;
-	char *zPtr;
-	
 	/* Total number of bytes to alloc */
-	nByte = sizeof(mem_hash_record) + nKey;
+	nByte = (sxu32)sizeof(mem_hash_record) + (sxu32)nKey + (sxu32)nData;
 	/* Allocate a new instance */
-	pRecord = (mem_hash_record *)SyMemBackendAlloc(pAlloc,nByte);
+	pRecord = (mem_hash_record *)MemArenaAlloc(pEngine,&nByte);
 	if( pRecord == 0 ){
 		return 0;
 	}
-	pDupData = (void *)SyMemBackendAlloc(pAlloc,(sxu32)nData);
-	if( pDupData == 0 ){
-		SyMemBackendFree(pAlloc,pRecord);
-		return 0;
+	/* Zero the structure */
+	SyZero(pRecord,sizeof(mem_hash_record));
+	/* Fill in the structure */
+	pRecord->nDataLen = (sxu32)nData;
+	pRecord->nKeyLen = (sxu32)nKey;
+	pRecord->nHash = nHash;
+	pRecord->nChunk = nByte;
+	SyMemcpy(pKey,(void *)MEM_HASH_KEY(pRecord),pRecord->nKeyLen);
+	SyMemcpy(pData,MEM_HASH_DATA(pRecord),pRecord->nDataLen);
+	/* All done */
+	return pRecord;
+}
+/*
+ * A record was moved to a new chunk, update the links pointing to it.
+ */
+static void MemHashRelinkRecord(mem_hash_kv_engine *pEngine,mem_hash_record *pOld,mem_hash_record *pNew)
+{
+	mem_hash_cursor *pCur;
+	if( pNew->pPrevHash ){
+		pNew->pPrevHash->pNextHash = pNew;
+	}else{
+		pEngine->apBucket[pNew->nHash & (pEngine->nBucket - 1)] = pNew;
+	}
+	if( pNew->pNextHash ){
+		pNew->pNextHash->pPrevHash = pNew;
+	}
+	if( pNew->pPrev ){
+		pNew->pPrev->pNext = pNew;
+	}
+	if( pNew->pNext ){
+		pNew->pNext->pPrev = pNew;
+	}
+	if( pEngine->pFirst == pOld ){
+		pEngine->pFirst = pNew;
+	}
+	if( pEngine->pLast == pOld ){
+		pEngine->pLast = pNew;
+	}
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		if( pCur->pCur == pOld ){
+			pCur->pCur = pNew;
+		}
+	}
+}
+/*
+ * Make room for nData bytes of data in a given record.
+ * The record is moved to a new chunk if it does not fit in its own
+ * or if the chunk would be mostly unused. The existing data is preserved
+ * (up to nData bytes) but the data length is left to the caller.
+ */
+static mem_hash_record * MemHashResizeRecord(mem_hash_kv_engine *pEngine,mem_hash_record *pRecord,sxu32 nData)
+{
+	sxu32 nByte = (sxu32)sizeof(mem_hash_record) + pRecord->nKeyLen + nData;
+	mem_hash_record *pNew;
+	if( nByte <= pRecord->nChunk && nByte >= (pRecord->nChunk >> 1) ){
+		/* Fit in place */
+		return pRecord;
+	}
+	pNew = (mem_hash_record *)MemArenaAlloc(pEngine,&nByte);
+	if( pNew == 0 ){
+		return 0;
+	}
+	/* Header, key and the surviving data */
+	SyMemcpy((const void *)pRecord,(void *)pNew,
+		(sxu32)sizeof(mem_hash_record) + pRecord->nKeyLen + (nData < pRecord->nDataLen ? nData : pRecord->nDataLen));
+	pNew->nChunk = nByte;
+	MemHashRelinkRecord(pEngine,pRecord,pNew);
+	MemArenaFree(pEngine,(void *)pRecord,pRecord->nChunk);
+	return pNew;
+}
+/*
+ * An old slab seen by [MemHashCompact()].
+ */
+typedef struct mem_arena_old_slab mem_arena_old_slab;
+struct mem_arena_old_slab
+{
+	mem_arena_slab *pSlab; /* The slab */
+	sxu32 nLive;           /* Records still living in this slab */
+	int bFree;             /* True once released */
+};
+/*
+ * Find the old slab holding a given chunk. The array is sorted by address.
+ */
+static mem_arena_old_slab * MemArenaFindSlab(mem_arena_old_slab *aOld,sxu32 nOld,const void *pChunk)
+{
+	sxu32 iLo = 0,iHi = nOld,iMid;
+	while( iLo < iHi ){
+		iMid = (iLo + iHi) >> 1;
+		if( (const char *)pChunk < (const char *)aOld[iMid].pSlab ){
+			iHi = iMid;
+		}else if( (const char *)pChunk >= &((const char *)aOld[iMid].pSlab)[MEM_ARENA_SLAB_SIZE] ){
+			iLo = iMid + 1;
+		}else{
+			return &aOld[iMid];
+		}
+	}
+	/* Cannot happen */
+	return 0;
+}
+/*
+ * Move the live records to fresh slabs and release the old ones
+ * together with the space held by the free lists.
+ * An old slab is released as soon as its last record is moved so
+ * the new slabs can reuse its memory.
+ */
+static int MemHashCompact(mem_hash_kv_engine *pEngine)
+{
+	mem_arena_old_slab *aOld,*pOld,sTmp;
+	mem_hash_record *pEntry,*pNext,*pNew;
+	mem_arena_slab *pSlab;
+	sxu32 nOld,i,j,nGap;
+	sxu32 nByte;
+	int rc = UNQLITE_OK;
+	nOld = 0;
+	for( pSlab = pEngine->pSlab ; pSlab ; pSlab = pSlab->pNext ){
+		nOld++;
+	}
+	if( nOld < 1 ){
+		/* Nothing to compact */
+		return UNQLITE_OK;
+	}
+	aOld = (mem_arena_old_slab *)SyMemBackendAlloc(&pEngine->sAlloc,nOld * (sxu32)sizeof(mem_arena_old_slab));
+	if( aOld == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	i = 0;
+	for( pSlab = pEngine->pSlab ; pSlab ; pSlab = pSlab->pNext ){
+		aOld[i].pSlab = pSlab;
+		aOld[i].nLive = 0;
+		aOld[i].bFree = 0;
+		i++;
+	}
+	/* Sort by address (Shell sort) */
+	for( nGap = nOld >> 1 ; nGap > 0 ; nGap >>= 1 ){
+		for( i = nGap ; i < nOld ; ++i ){
+			sTmp = aOld[i];
+			for( j = i ; j >= nGap && (char *)aOld[j - nGap].pSlab > (char *)sTmp.pSlab ; j -= nGap ){
+				aOld[j] = aOld[j - nGap];
+			}
+			aOld[j] = sTmp;
+		}
 	}
-	zPtr = (char *)pRecord;
-	zPtr += sizeof(mem_hash_record);
-	/* Zero the structure */
-	SyZero(pRecord,sizeof(mem_hash_record));
-	/* Fill in the structure */
-	pRecord->pEngine = pEngine;
-	pRecord->nDataLen = (sxu32)nData;
-	pRecord->nKeyLen = (sxu32)nKey;
-	pRecord->nHash = nHash;
-	SyMemcpy(pKey,zPtr,pRecord->nKeyLen);
-	pRecord->pKey = (const void *)zPtr;
-	SyMemcpy(pData,pDupData,pRecord->nDataLen);
-	pRecord->pData = pDupData;
-	/* All done */
-	return pRecord;
+	/* Count the records living in each slab */
+	for( pEntry = pEngine->pLast ; pEntry ; pEntry = pEntry->pNext ){
+		if( pEntry->nChunk <= MEM_ARENA_MAX_CHUNK ){
+			MemArenaFindSlab(aOld,nOld,(const void *)pEntry)->nLive++;
+		}
+	}
+	/* Start over with empty slabs */
+	pEngine->pSlab = 0;
+	pEngine->zBump = pEngine->zEnd = 0;
+	SyZero((void *)pEngine->apFree,sizeof(pEngine->apFree));
+	for( i = 0 ; i < nOld ; ++i ){
+		if( aOld[i].nLive < 1 ){
+			/* Free chunks only */
+			SyMemBackendFree(&pEngine->sAlloc,(void *)aOld[i].pSlab);
+			aOld[i].bFree = 1;
+		}
+	}
+	pEntry = pEngine->pFirst;
+	while( pEntry ){
+		pNext = pEntry->pPrev; /* Reverse link: Not a Bug */
+		if( pEntry->nChunk <= MEM_ARENA_MAX_CHUNK ){
+			pOld = MemArenaFindSlab(aOld,nOld,(const void *)pEntry);
+			/* Move to a new chunk of the exact size */
+			nByte = (sxu32)sizeof(mem_hash_record) + pEntry->nKeyLen + pEntry->nDataLen;
+			pNew = (mem_hash_record *)MemArenaAlloc(pEngine,&nByte);
+			if( pNew == 0 ){
+				rc = UNQLITE_NOMEM;
+				break;
+			}
+			SyMemcpy((const void *)pEntry,(void *)pNew,(sxu32)sizeof(mem_hash_record) + pEntry->nKeyLen + pEntry->nDataLen);
+			pNew->nChunk = nByte;
+			MemHashRelinkRecord(pEngine,pEntry,pNew);
+			pOld->nLive--;
+			if( pOld->nLive < 1 ){
+				/* Empty slab */
+				SyMemBackendFree(&pEngine->sAlloc,(void *)pOld->pSlab);
+				pOld->bFree = 1;
+			}
+		}
+		pEntry = pNext;
+	}
+	/* Keep the old slabs the remaining records still live in (out-of-memory only) */
+	for( i = 0 ; i < nOld ; ++i ){
+		if( !aOld[i].bFree ){
+			aOld[i].pSlab->pNext = 0;
+			if( pEngine->pSlab == 0 ){
+				pEngine->pSlab = aOld[i].pSlab;
+			}else{
+				for( pSlab = pEngine->pSlab ; pSlab->pNext ; pSlab = pSlab->pNext );
+				pSlab->pNext = aOld[i].pSlab;
+			}
+		}
+	}
+	SyMemBackendFree(&pEngine->sAlloc,(void *)aOld);
+	return rc;
 }
 /*
  * Install a given record in the hashtable.
@@ -51862,7 +55677,7 @@ static void MemHashLinkRecord(mem_hash_kv_engine *pEngine,mem_hash_record *pReco
 static void MemHashUnlinkRecord(mem_hash_kv_engine *pEngine,mem_hash_record *pEntry)
 {
 	sxu32 nBucket = pEntry->nHash & (pEngine->nBucket - 1);
-	SyMemBackend *pAlloc = &pEngine->sAlloc;
+	mem_hash_cursor *pCur;
 	if( pEntry->pPrevHash == 0 ){
 		pEngine->apBucket[nBucket] = pEntry->pNextHash;
 	}else{
@@ -51876,9 +55691,14 @@ static void MemHashUnlinkRecord(mem_hash_kv_engine *pEngine,mem_hash_record *pEn
 		pEngine->pFirst = pEntry->pPrev;
 	}
 	pEngine->nRecord--;
-	/* Release the entry */
-	SyMemBackendFree(pAlloc,(void *)pEntry->pData);
-	SyMemBackendFree(pAlloc,pEntry); /* Key is also stored here */
+	/* Cursors pointing to this entry move to the next one */
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		if( pCur->pCur == pEntry ){
+			pCur->pCur = pEntry->pPrev; /* Reverse link: Not a Bug */
+		}
+	}
+	/* Release the entry, key and data are also stored here */
+	MemArenaFree(pEngine,(void *)pEntry,pEntry->nChunk);
 }
 /*
  * Perform a lookup for a given entry.
@@ -51899,7 +55719,7 @@ static mem_hash_record * MemHashGetEntry(
 			break;
 		}
 		if( pEntry->nHash == nHash && pEntry->nKeyLen == (sxu32)nKeyLen && 
-			pEngine->xCmp(pEntry->pKey,pKey,pEntry->nKeyLen) == 0 ){
+			pEngine->xCmp(MEM_HASH_KEY(pEntry),pKey,pEntry->nKeyLen) == 0 ){
 				return pEntry;
 		}
 		pEntry = pEntry->pNextHash;
@@ -52003,257 +55823,911 @@ static int MemHashGrowTable(mem_hash_kv_engine *pEngine)
  * Exported Interfaces.
  */
 /*
- * Each public cursor is identified by an instance of this structure.
+ * Initialize the cursor.
+ */
+static void MemHashInitCursor(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 /* Point to the first inserted entry */
+	 pMem->pCur = pEngine->pFirst;
+	 /* Link to the list of active cursors */
+	 pMem->pPrev = 0;
+	 pMem->pNext = pEngine->pCursor;
+	 if( pEngine->pCursor ){
+		 pEngine->pCursor->pPrev = pMem;
+	 }
+	 pEngine->pCursor = pMem;
+}
+/*
+ * Release the cursor.
+ */
+static void MemHashReleaseCursor(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 /* Unlink from the list of active cursors */
+	 if( pMem->pPrev ){
+		 pMem->pPrev->pNext = pMem->pNext;
+	 }else if( pEngine->pCursor == pMem ){
+		 pEngine->pCursor = pMem->pNext;
+	 }
+	 if( pMem->pNext ){
+		 pMem->pNext->pPrev = pMem->pPrev;
+	 }
+	 pMem->pNext = pMem->pPrev = 0;
+	 pMem->pCur = 0;
+}
+/*
+ * Point to the first entry.
+ */
+static int MemHashCursorFirst(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 pMem->pCur = pEngine->pFirst;
+	 return UNQLITE_OK;
+}
+/*
+ * Point to the last entry.
+ */
+static int MemHashCursorLast(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 pMem->pCur = pEngine->pLast;
+	 return UNQLITE_OK;
+}
+/*
+ * is a Valid Cursor.
+ */
+static int MemHashCursorValid(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 return pMem->pCur != 0 ? 1 : 0;
+}
+/*
+ * Point to the next entry.
+ */
+static int MemHashCursorNext(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 if( pMem->pCur == 0){
+		 return UNQLITE_EOF;
+	 }
+	 pMem->pCur = pMem->pCur->pPrev; /* Reverse link: Not a Bug */
+	 return UNQLITE_OK;
+}
+/*
+ * Point to the previous entry.
+ */
+static int MemHashCursorPrev(unqlite_kv_cursor *pCursor)
+{
+	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	 if( pMem->pCur == 0){
+		 return UNQLITE_EOF;
+	 }
+	 pMem->pCur = pMem->pCur->pNext; /* Reverse link: Not a Bug */
+	 return UNQLITE_OK;
+}
+/*
+ * Return key length.
+ */
+static int MemHashCursorKeyLength(unqlite_kv_cursor *pCursor,int *pLen)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	if( pMem->pCur == 0){
+		 return UNQLITE_EOF;
+	}
+	*pLen = (int)pMem->pCur->nKeyLen;
+	return UNQLITE_OK;
+}
+/*
+ * Return data length.
+ */
+static int MemHashCursorDataLength(unqlite_kv_cursor *pCursor,unqlite_int64 *pLen)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	if( pMem->pCur == 0 ){
+		 return UNQLITE_EOF;
+	}
+	*pLen = pMem->pCur->nDataLen;
+	return UNQLITE_OK;
+}
+/*
+ * Consume the key.
+ */
+static int MemHashCursorKey(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	int rc;
+	if( pMem->pCur == 0){
+		 return UNQLITE_EOF;
+	}
+	/* Invoke the callback */
+	rc = xConsumer(MEM_HASH_KEY(pMem->pCur),pMem->pCur->nKeyLen,pUserData);
+	/* Callback result */
+	return rc;
+}
+/*
+ * Consume the data.
+ */
+static int MemHashCursorData(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	int rc;
+	if( pMem->pCur == 0){
+		 return UNQLITE_EOF;
+	}
+	/* Invoke the callback */
+	rc = xConsumer(MEM_HASH_DATA(pMem->pCur),pMem->pCur->nDataLen,pUserData);
+	/* Callback result */
+	return rc;
+}
+/*
+ * Reset the cursor.
+ */
+static void MemHashCursorReset(unqlite_kv_cursor *pCursor)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	pMem->pCur = ((mem_hash_kv_engine *)pCursor->pStore)->pFirst;
+}
+/*
+ * Remove a particular record.
+ */
+static int MemHashCursorDelete(unqlite_kv_cursor *pCursor)
+{
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	if( pMem->pCur == 0 ){
+		/* Cursor does not point to anything */
+		return UNQLITE_NOTFOUND;
+	}
+	/* Perform the deletion, the cursor point to the next entry */
+	MemHashUnlinkRecord((mem_hash_kv_engine *)pCursor->pStore,pMem->pCur);
+	return UNQLITE_OK;
+}
+/*
+ * Find a particular record.
+ */
+static int MemHashCursorSeek(unqlite_kv_cursor *pCursor,const void *pKey,int nByte,int iPos)
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
+	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	/* Perform the lookup */
+	pMem->pCur = MemHashGetEntry(pEngine,pKey,nByte);
+	if( pMem->pCur == 0 ){
+		if( iPos != UNQLITE_CURSOR_MATCH_EXACT ){
+			/* noop; */
+		}
+		/* No such record */
+		return UNQLITE_NOTFOUND;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Builtin hash function.
+ */
+static sxu32 MemHashFunc(const void *pSrc,sxu32 nLen)
+{
+	register unsigned char *zIn = (unsigned char *)pSrc;
+	unsigned char *zEnd;
+	sxu32 nH = 5381;
+	zEnd = &zIn[nLen];
+	for(;;){
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
+	}	
+	return nH;
+}
+/* Default bucket size */
+#define MEM_HASH_BUCKET_SIZE 64
+/* Default fill factor */
+#define MEM_HASH_FILL_FACTOR 4 /* or 3 */
+/*
+ * Initialize the in-memory storage engine.
+ */
+static int MemHashInit(unqlite_kv_engine *pKvEngine,int iPageSize)
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
+	/* Note that this instance is already zeroed */	
+	/* Memory backend */
+	SyMemBackendInitFromParent(&pEngine->sAlloc,unqliteExportMemBackend());
+#if defined(UNQLITE_ENABLE_THREADS)
+	/* Already protected by the upper layers */
+	SyMemBackendDisbaleMutexing(&pEngine->sAlloc);
+#endif
+	/* Default hash & comparison function */
+	pEngine->xHash = MemHashFunc;
+	pEngine->xCmp = SyMemcmp;
+	/* Allocate a new bucket */
+	pEngine->apBucket = (mem_hash_record **)SyMemBackendAlloc(&pEngine->sAlloc,MEM_HASH_BUCKET_SIZE * sizeof(mem_hash_record *));
+	if( pEngine->apBucket == 0 ){
+		SXUNUSED(iPageSize); /* cc warning */
+		return UNQLITE_NOMEM;
+	}
+	/* Zero the bucket */
+	SyZero(pEngine->apBucket,MEM_HASH_BUCKET_SIZE * sizeof(mem_hash_record *));
+	pEngine->nRecord = 0;
+	pEngine->nBucket = MEM_HASH_BUCKET_SIZE;
+	return UNQLITE_OK;
+}
+/*
+ * Release the in-memory storage engine.
+ */
+static void MemHashRelease(unqlite_kv_engine *pKvEngine)
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
+	mem_hash_cursor *pCur;
+	/* Records are about to be released, detach the cursors */
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		pCur->pCur = 0;
+	}
+	pEngine->pCursor = 0;
+	/* Release the private memory backend */
+	SyMemBackendRelease(&pEngine->sAlloc);
+}
+/*
+ * Configure the in-memory storage engine.
+ */
+static int MemHashConfigure(unqlite_kv_engine *pKvEngine,int iOp,va_list ap)
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
+	int rc = UNQLITE_OK;
+	switch(iOp){
+	case UNQLITE_KV_CONFIG_HASH_FUNC:{
+		/* Use a default hash function */
+		if( pEngine->nRecord > 0 ){
+			rc = UNQLITE_LOCKED;
+		}else{
+			ProcHash xHash = va_arg(ap,ProcHash);
+			if( xHash ){
+				pEngine->xHash = xHash;
+			}
+		}
+		break;
+									 }
+	case UNQLITE_KV_CONFIG_CMP_FUNC: {
+		/* Default comparison function */
+		ProcCmp xCmp = va_arg(ap,ProcCmp);
+		if( xCmp ){
+			pEngine->xCmp = xCmp;
+		}
+		break;
+									 }
+	case UNQLITE_KV_CONFIG_COMPACT:
+		/* Give the released space back */
+		rc = MemHashCompact(pEngine);
+		break;
+	default:
+		/* Unknown configuration option */
+		rc = UNQLITE_UNKNOWN;
+	}
+	return rc;
+}
+/*
+ * Replace method.
+ */
+static int MemHashReplace(
+	  unqlite_kv_engine *pKv,
+	  const void *pKey,int nKeyLen,
+	  const void *pData,unqlite_int64 nDataLen
+	  )
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKv;
+	mem_hash_record *pRecord;
+	if( nDataLen > (unqlite_int64)(SXU32_HIGH - sizeof(mem_hash_record)) - nKeyLen ){
+		/* Database limit, the whole record must fit in a single chunk */
+		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Record size limit reached");
+		return UNQLITE_LIMIT;
+	}
+	/* Fetch the record first */
+	pRecord = MemHashGetEntry(pEngine,pKey,nKeyLen);
+	if( pRecord == 0 ){
+		/* Allocate a new record */
+		pRecord = MemHashNewRecord(pEngine,
+			pKey,nKeyLen,
+			pData,nDataLen,
+			pEngine->xHash(pKey,nKeyLen)
+			);
+		if( pRecord == 0 ){
+			return UNQLITE_NOMEM;
+		}
+		/* Link the entry */
+		MemHashLinkRecord(pEngine,pRecord);
+		if( (pEngine->nRecord >= pEngine->nBucket * MEM_HASH_FILL_FACTOR) && pEngine->nRecord < 100000 ){
+			/* Rehash the table */
+			MemHashGrowTable(pEngine);
+		}
+	}else{
+		sxu32 nData = (sxu32)nDataLen;
+		/* Replace an existing record, reuse its chunk if possible */
+		pRecord = MemHashResizeRecord(pEngine,pRecord,nData);
+		if( pRecord == 0 ){
+			return UNQLITE_NOMEM;
+		}
+		/* Reflect the change */
+		pRecord->nDataLen = nData;
+		SyMemcpy(pData,MEM_HASH_DATA(pRecord),nData);
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Append method.
+ */
+static int MemHashAppend(
+	  unqlite_kv_engine *pKv,
+	  const void *pKey,int nKeyLen,
+	  const void *pData,unqlite_int64 nDataLen
+	  )
+{
+	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKv;
+	mem_hash_record *pRecord;
+	if( nDataLen > (unqlite_int64)(SXU32_HIGH - sizeof(mem_hash_record)) - nKeyLen ){
+		/* Database limit, the whole record must fit in a single chunk */
+		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Record size limit reached");
+		return UNQLITE_LIMIT;
+	}
+	/* Fetch the record first */
+	pRecord = MemHashGetEntry(pEngine,pKey,nKeyLen);
+	if( pRecord == 0 ){
+		/* Allocate a new record */
+		pRecord = MemHashNewRecord(pEngine,
+			pKey,nKeyLen,
+			pData,nDataLen,
+			pEngine->xHash(pKey,nKeyLen)
+			);
+		if( pRecord == 0 ){
+			return UNQLITE_NOMEM;
+		}
+		/* Link the entry */
+		MemHashLinkRecord(pEngine,pRecord);
+		if( pEngine->nRecord * MEM_HASH_FILL_FACTOR >= pEngine->nBucket && pEngine->nRecord < 100000 ){
+			/* Rehash the table */
+			MemHashGrowTable(pEngine);
+		}
+	}else{
+		unqlite_int64 nNew = pRecord->nDataLen + nDataLen;
+		sxu32 nData;
+		/* Append data to the existing record */
+		if( nNew > (unqlite_int64)(SXU32_HIGH - sizeof(mem_hash_record)) - nKeyLen ){
+			/* Overflow */
+			pEngine->pIo->xErr(pEngine->pIo->pHandle,"Append operation will cause data overflow");	
+			return UNQLITE_LIMIT;
+		}
+		nData = (sxu32)nNew;
+		/* Grow the record */
+		pRecord = MemHashResizeRecord(pEngine,pRecord,nData);
+		if( pRecord == 0 ){
+			return UNQLITE_NOMEM;
+		}
+		/* Reflect the change */
+		SyMemcpy(pData,&((char *)MEM_HASH_DATA(pRecord))[pRecord->nDataLen],(sxu32)nDataLen);
+		pRecord->nDataLen = nData;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Export the in-memory storage engine.
+ */
+UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportMemKvStorage(void)
+{
+	static const unqlite_kv_methods sMemStore = {
+		"mem",                      /* zName */
+		sizeof(mem_hash_kv_engine), /* szKv */
+		sizeof(mem_hash_cursor),    /* szCursor */
+		1,                          /* iVersion */
+		MemHashInit,                /* xInit */
+		MemHashRelease,             /* xRelease */
+		MemHashConfigure,           /* xConfig */
+		0,                          /* xOpen */
+		MemHashReplace,             /* xReplace */
+		MemHashAppend,              /* xAppend */
+		MemHashInitCursor,          /* xCursorInit */
+		MemHashCursorSeek,          /* xSeek */
+		MemHashCursorFirst,         /* xFirst */
+		MemHashCursorLast,          /* xLast */
+		MemHashCursorValid,         /* xValid */
+		MemHashCursorNext,          /* xNext */
+		MemHashCursorPrev,          /* xPrev */
+		MemHashCursorDelete,        /* xDelete */
+		MemHashCursorKeyLength,     /* xKeyLength */
+		MemHashCursorKey,           /* xKey */
+		MemHashCursorDataLength,    /* xDataLength */
+		MemHashCursorData,          /* xData */
+		MemHashCursorReset,         /* xReset */
+		MemHashReleaseCursor        /* xRelease */
+	};
+	return &sMemStore;
+}
+/*
+ * ----------------------------------------------------------
+ * File: skiplist_kv.c
+ * MD5: 942b9ccf43c62b8816aa5cdc6d425bab
+ * ----------------------------------------------------------
+ */
+/*
+ * Symisc unQLite: An Embeddable NoSQL (Post Modern) Database Engine.
+ * Copyright (C) 2012-2013, Symisc Systems http://unqlite.org/
+ * Version 1.1.6
+ * For information on licensing, redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES
+ * please contact Symisc Systems via:
+ *       legal@symisc.net
+ *       licensing@symisc.net
+ *       contact@symisc.net
+ * or visit:
+ *      http://unqlite.org/licensing.html
+ */
+#ifndef UNQLITE_AMALGAMATION
+#include "unqliteInt.h"
+#endif
+/*
+ * This file implements an ordered in-memory key value storage engine for unQLite.
+ * Unlike the hashtable of mem_kv.c, records are kept sorted by key in a skip list
+ * so that cursors walk the database in key order and seek operations honor
+ * the UNQLITE_CURSOR_MATCH_LE and UNQLITE_CURSOR_MATCH_GE positions.
+ * Lookups cost O(log n) key comparisons.
+ * Select this engine via unqlite_config(UNQLITE_CONFIG_KV_ENGINE,"skiplist")
+ * on an in-memory database before the first record is stored.
+ * Like the 'mem' engine, this storage engine does not support transactions.
+ *
+ * Each record is a single allocation holding its forward links followed by the key.
+ * A node is promoted to the next level with a probability of 1/4 so that a record
+ * carry 1.33 forward links on average plus a backward link used by reverse cursors.
+ */
+/*
+ * Maximum number of levels. Enough for 4^16 records.
+ */
+#define SKL_MAX_LEVEL 16
+/* Forward declaration */
+typedef struct skl_kv_engine skl_kv_engine;
+typedef struct skl_kv_cursor skl_kv_cursor;
+/*
+ * Each record is stored in an instance of the following structure.
+ */
+typedef struct skl_node skl_node;
+struct skl_node
+{
+	const void *pData;      /* Data */
+	skl_node *pPrev;        /* Previous record in key order */
+	sxu32 nKeyLen;          /* Key length */
+	sxu32 nDataLen;         /* Data length (Max 4GB) */
+	sxu32 nLevel;           /* Total number of forward links */
+	skl_node *apNext[1];    /* Forward links (nLevel entries) followed by the key */
+};
+/*
+ * Key of a given node.
+ */
+#define SKL_NODE_KEY(NODE) ((const void *)&(NODE)->apNext[(NODE)->nLevel])
+/*
+ * Each in-memory ordered KV engine is represented by an instance
+ * of the following structure.
+ */
+struct skl_kv_engine
+{
+	const unqlite_kv_io *pIo;       /* IO methods: MUST be first */
+	/* Private data */
+	SyMemBackend sAlloc;            /* Private memory allocator */
+	ProcCmp xCmp;                   /* Default comparison function */
+	sxu32 nRecord;                  /* Total number of records */
+	sxu32 nLevel;                   /* Current number of levels */
+	sxu32 iRandom;                  /* PRNG state used to pick node levels */
+	skl_node *apHead[SKL_MAX_LEVEL]; /* First record on each level */
+	skl_node *pLast;                /* Largest key */
+	skl_kv_cursor *pCursor;         /* List of active cursors */
+};
+/*
+ * Each public cursor is identified by an instance of this structure.
+ */
+struct skl_kv_cursor
+{
+	unqlite_kv_engine *pStore;   /* Must be first */
+	/* Private fields */
+	skl_node *pCur;              /* Current record */
+	skl_kv_cursor *pNext,*pPrev; /* List of active cursors */
+};
+/*
+ * Compare the key of a node with the given key.
+ * Shorter keys sort first when one is a prefix of the other.
+ */
+static int SklKeyCmp(skl_kv_engine *pEngine,skl_node *pNode,const void *pKey,sxu32 nKey)
+{
+	sxi32 rc;
+	rc = pEngine->xCmp(SKL_NODE_KEY(pNode),pKey,pNode->nKeyLen < nKey ? pNode->nKeyLen : nKey);
+	if( rc != 0 ){
+		return rc < 0 ? -1 : 1;
+	}
+	if( pNode->nKeyLen == nKey ){
+		return 0;
+	}
+	return pNode->nKeyLen < nKey ? -1 : 1;
+}
+/*
+ * Pick the level of a new node.
+ */
+static sxu32 SklRandomLevel(skl_kv_engine *pEngine)
+{
+	sxu32 iRand = pEngine->iRandom;
+	sxu32 nLevel = 1;
+	/* Xorshift */
+	iRand ^= iRand << 13;
+	iRand ^= iRand >> 17;
+	iRand ^= iRand << 5;
+	pEngine->iRandom = iRand;
+	/* Two random bits per level */
+	while( (iRand & 3) == 0 && nLevel < SKL_MAX_LEVEL ){
+		nLevel++;
+		iRand >>= 2;
+	}
+	return nLevel;
+}
+/*
+ * Return the first record whose key is greater than or equal to the given key.
+ * If apUpdate is not NULL, it is filled with the link to update on each level
+ * to insert or remove a record with that key.
+ */
+static skl_node * SklSeek(
+	skl_kv_engine *pEngine,
+	const void *pKey,sxu32 nKey,
+	skl_node ***apUpdate,
+	int *pExact
+	)
+{
+	skl_node **apLink = pEngine->apHead;
+	skl_node *pNext = 0;
+	sxi32 i;
+	for( i = (sxi32)pEngine->nLevel - 1 ; i >= 0 ; --i ){
+		for(;;){
+			pNext = apLink[i];
+			if( pNext == 0 || SklKeyCmp(pEngine,pNext,pKey,nKey) >= 0 ){
+				break;
+			}
+			apLink = pNext->apNext;
+		}
+		if( apUpdate ){
+			apUpdate[i] = &apLink[i];
+		}
+	}
+	*pExact = pNext && pNext->nKeyLen == nKey && SklKeyCmp(pEngine,pNext,pKey,nKey) == 0;
+	return pNext;
+}
+/*
+ * Allocate and link a new record.
+ */
+static int SklInsert(
+	skl_kv_engine *pEngine,
+	skl_node ***apUpdate,
+	const void *pKey,sxu32 nKey,
+	const void *pData,sxu32 nData
+	)
+{
+	SyMemBackend *pAlloc = &pEngine->sAlloc;
+	skl_node *pNode,*pSucc;
+	sxu32 nLevel,i;
+	void *pDup;
+	nLevel = SklRandomLevel(pEngine);
+	pNode = (skl_node *)SyMemBackendAlloc(pAlloc,(sxu32)(sizeof(skl_node) + (nLevel - 1) * sizeof(skl_node *)) + nKey);
+	if( pNode == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	pDup = SyMemBackendAlloc(pAlloc,nData);
+	if( pDup == 0 ){
+		SyMemBackendFree(pAlloc,pNode);
+		return UNQLITE_NOMEM;
+	}
+	/* Fill in the structure */
+	pNode->nLevel = nLevel;
+	pNode->nKeyLen = nKey;
+	pNode->nDataLen = nData;
+	SyMemcpy(pKey,(void *)SKL_NODE_KEY(pNode),nKey);
+	SyMemcpy(pData,pDup,nData);
+	pNode->pData = pDup;
+	/* Link on each level */
+	for( i = pEngine->nLevel ; i < nLevel ; ++i ){
+		apUpdate[i] = &pEngine->apHead[i];
+	}
+	if( nLevel > pEngine->nLevel ){
+		pEngine->nLevel = nLevel;
+	}
+	for( i = 0 ; i < nLevel ; ++i ){
+		pNode->apNext[i] = *apUpdate[i];
+		*apUpdate[i] = pNode;
+	}
+	/* Backward link */
+	pSucc = pNode->apNext[0];
+	if( pSucc ){
+		pNode->pPrev = pSucc->pPrev;
+		pSucc->pPrev = pNode;
+	}else{
+		pNode->pPrev = pEngine->pLast;
+		pEngine->pLast = pNode;
+	}
+	pEngine->nRecord++;
+	return UNQLITE_OK;
+}
+/*
+ * Unlink and release a given record.
+ * Cursors pointing to that record move to its successor.
+ */
+static void SklRemove(skl_kv_engine *pEngine,skl_node ***apUpdate,skl_node *pNode)
+{
+	SyMemBackend *pAlloc = &pEngine->sAlloc;
+	skl_kv_cursor *pCur;
+	sxu32 i;
+	for( i = 0 ; i < pEngine->nLevel ; ++i ){
+		if( *apUpdate[i] == pNode ){
+			*apUpdate[i] = pNode->apNext[i];
+		}
+	}
+	if( pNode->apNext[0] ){
+		pNode->apNext[0]->pPrev = pNode->pPrev;
+	}else{
+		pEngine->pLast = pNode->pPrev;
+	}
+	while( pEngine->nLevel > 1 && pEngine->apHead[pEngine->nLevel - 1] == 0 ){
+		pEngine->nLevel--;
+	}
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		if( pCur->pCur == pNode ){
+			pCur->pCur = pNode->apNext[0];
+		}
+	}
+	pEngine->nRecord--;
+	/* Release the record */
+	SyMemBackendFree(pAlloc,(void *)pNode->pData);
+	SyMemBackendFree(pAlloc,pNode); /* Key is also stored here */
+}
+/*
+ * Exported Interfaces.
+ */
+/*
+ * Initialize the cursor.
  */
-typedef struct mem_hash_cursor mem_hash_cursor;
-struct mem_hash_cursor
+static void SklCursorInit(unqlite_kv_cursor *pCursor)
 {
-	unqlite_kv_engine *pStore; /* Must be first */
-	/* Private fields */
-	mem_hash_record *pCur;     /* Current hash record */
-};
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	/* Point to the first entry */
+	pCur->pCur = pEngine->apHead[0];
+	/* Link to the list of active cursors */
+	pCur->pPrev = 0;
+	pCur->pNext = pEngine->pCursor;
+	if( pEngine->pCursor ){
+		pEngine->pCursor->pPrev = pCur;
+	}
+	pEngine->pCursor = pCur;
+}
 /*
- * Initialize the cursor.
+ * Release the cursor.
  */
-static void MemHashInitCursor(unqlite_kv_cursor *pCursor)
+static void SklCursorRelease(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 /* Point to the first inserted entry */
-	 pMem->pCur = pEngine->pFirst;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	/* Unlink from the list of active cursors */
+	if( pCur->pPrev ){
+		pCur->pPrev->pNext = pCur->pNext;
+	}else if( pEngine->pCursor == pCur ){
+		pEngine->pCursor = pCur->pNext;
+	}
+	if( pCur->pNext ){
+		pCur->pNext->pPrev = pCur->pPrev;
+	}
+	pCur->pNext = pCur->pPrev = 0;
+	pCur->pCur = 0;
 }
 /*
  * Point to the first entry.
  */
-static int MemHashCursorFirst(unqlite_kv_cursor *pCursor)
+static int SklCursorFirst(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 pMem->pCur = pEngine->pFirst;
-	 return UNQLITE_OK;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	pCur->pCur = pEngine->apHead[0];
+	return UNQLITE_OK;
 }
 /*
  * Point to the last entry.
  */
-static int MemHashCursorLast(unqlite_kv_cursor *pCursor)
+static int SklCursorLast(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 pMem->pCur = pEngine->pLast;
-	 return UNQLITE_OK;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	pCur->pCur = pEngine->pLast;
+	return UNQLITE_OK;
 }
 /*
  * is a Valid Cursor.
  */
-static int MemHashCursorValid(unqlite_kv_cursor *pCursor)
+static int SklCursorValid(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 return pMem->pCur != 0 ? 1 : 0;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	return pCur->pCur != 0 ? 1 : 0;
 }
 /*
  * Point to the next entry.
  */
-static int MemHashCursorNext(unqlite_kv_cursor *pCursor)
+static int SklCursorNext(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 if( pMem->pCur == 0){
-		 return UNQLITE_EOF;
-	 }
-	 pMem->pCur = pMem->pCur->pPrev; /* Reverse link: Not a Bug */
-	 return UNQLITE_OK;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
+	}
+	pCur->pCur = pCur->pCur->apNext[0];
+	return UNQLITE_OK;
 }
 /*
  * Point to the previous entry.
  */
-static int MemHashCursorPrev(unqlite_kv_cursor *pCursor)
+static int SklCursorPrev(unqlite_kv_cursor *pCursor)
 {
-	 mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	 if( pMem->pCur == 0){
-		 return UNQLITE_EOF;
-	 }
-	 pMem->pCur = pMem->pCur->pNext; /* Reverse link: Not a Bug */
-	 return UNQLITE_OK;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
+	}
+	pCur->pCur = pCur->pCur->pPrev;
+	return UNQLITE_OK;
 }
 /*
  * Return key length.
  */
-static int MemHashCursorKeyLength(unqlite_kv_cursor *pCursor,int *pLen)
+static int SklCursorKeyLength(unqlite_kv_cursor *pCursor,int *pLen)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	if( pMem->pCur == 0){
-		 return UNQLITE_EOF;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
 	}
-	*pLen = (int)pMem->pCur->nKeyLen;
+	*pLen = (int)pCur->pCur->nKeyLen;
 	return UNQLITE_OK;
 }
 /*
  * Return data length.
  */
-static int MemHashCursorDataLength(unqlite_kv_cursor *pCursor,unqlite_int64 *pLen)
+static int SklCursorDataLength(unqlite_kv_cursor *pCursor,unqlite_int64 *pLen)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	if( pMem->pCur == 0 ){
-		 return UNQLITE_EOF;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
 	}
-	*pLen = pMem->pCur->nDataLen;
+	*pLen = pCur->pCur->nDataLen;
 	return UNQLITE_OK;
 }
 /*
  * Consume the key.
  */
-static int MemHashCursorKey(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+static int SklCursorKey(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	int rc;
-	if( pMem->pCur == 0){
-		 return UNQLITE_EOF;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
 	}
 	/* Invoke the callback */
-	rc = xConsumer(pMem->pCur->pKey,pMem->pCur->nKeyLen,pUserData);
-	/* Callback result */
-	return rc;
+	return xConsumer(SKL_NODE_KEY(pCur->pCur),pCur->pCur->nKeyLen,pUserData);
 }
 /*
  * Consume the data.
  */
-static int MemHashCursorData(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
+static int SklCursorData(unqlite_kv_cursor *pCursor,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	int rc;
-	if( pMem->pCur == 0){
-		 return UNQLITE_EOF;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	if( pCur->pCur == 0 ){
+		return UNQLITE_EOF;
 	}
 	/* Invoke the callback */
-	rc = xConsumer(pMem->pCur->pData,pMem->pCur->nDataLen,pUserData);
-	/* Callback result */
-	return rc;
+	return xConsumer(pCur->pCur->pData,pCur->pCur->nDataLen,pUserData);
 }
 /*
  * Reset the cursor.
  */
-static void MemHashCursorReset(unqlite_kv_cursor *pCursor)
+static void SklCursorReset(unqlite_kv_cursor *pCursor)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	pMem->pCur = ((mem_hash_kv_engine *)pCursor->pStore)->pFirst;
+	SklCursorFirst(pCursor);
 }
 /*
  * Remove a particular record.
  */
-static int MemHashCursorDelete(unqlite_kv_cursor *pCursor)
+static int SklCursorDelete(unqlite_kv_cursor *pCursor)
 {
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
-	mem_hash_record *pNext;
-	if( pMem->pCur == 0 ){
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	skl_node **apUpdate[SKL_MAX_LEVEL];
+	skl_node *pNode;
+	int exact;
+	if( pCur->pCur == 0 ){
 		/* Cursor does not point to anything */
 		return UNQLITE_NOTFOUND;
 	}
-	pNext = pMem->pCur->pPrev;
-	/* Perform the deletion */
-	MemHashUnlinkRecord(pMem->pCur->pEngine,pMem->pCur);
-	/* Point to the next entry */
-	pMem->pCur = pNext;
+	/* Collect the links to the record */
+	pNode = SklSeek(pEngine,SKL_NODE_KEY(pCur->pCur),pCur->pCur->nKeyLen,apUpdate,&exact);
+	if( pNode != pCur->pCur ){
+		/* Can't happen */
+		return UNQLITE_CORRUPT;
+	}
+	/* Perform the deletion, the cursor point to the next entry */
+	SklRemove(pEngine,apUpdate,pNode);
 	return UNQLITE_OK;
 }
 /*
  * Find a particular record.
  */
-static int MemHashCursorSeek(unqlite_kv_cursor *pCursor,const void *pKey,int nByte,int iPos)
+static int SklCursorSeek(unqlite_kv_cursor *pCursor,const void *pKey,int nByte,int iPos)
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pCursor->pStore;
-	mem_hash_cursor *pMem = (mem_hash_cursor *)pCursor;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pCursor->pStore;
+	skl_kv_cursor *pCur = (skl_kv_cursor *)pCursor;
+	skl_node *pNode;
+	int exact;
 	/* Perform the lookup */
-	pMem->pCur = MemHashGetEntry(pEngine,pKey,nByte);
-	if( pMem->pCur == 0 ){
-		if( iPos != UNQLITE_CURSOR_MATCH_EXACT ){
-			/* noop; */
+	pNode = SklSeek(pEngine,pKey,(sxu32)nByte,0,&exact);
+	if( !exact ){
+		switch(iPos){
+		case UNQLITE_CURSOR_MATCH_GE:
+			/* Smallest key greater than the target */
+			break;
+		case UNQLITE_CURSOR_MATCH_LE:
+			/* Largest key smaller than the target */
+			pNode = pNode ? pNode->pPrev : pEngine->pLast;
+			break;
+		default:
+			pNode = 0;
+			break;
 		}
-		/* No such record */
-		return UNQLITE_NOTFOUND;
 	}
-	return UNQLITE_OK;
-}
-/*
- * Builtin hash function.
- */
-static sxu32 MemHashFunc(const void *pSrc,sxu32 nLen)
-{
-	register unsigned char *zIn = (unsigned char *)pSrc;
-	unsigned char *zEnd;
-	sxu32 nH = 5381;
-	zEnd = &zIn[nLen];
-	for(;;){
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-		if( zIn >= zEnd ){ break; } nH = nH * 33 + zIn[0] ; zIn++;
-	}	
-	return nH;
+	pCur->pCur = pNode;
+	return pNode ? UNQLITE_OK : UNQLITE_NOTFOUND;
 }
-/* Default bucket size */
-#define MEM_HASH_BUCKET_SIZE 64
-/* Default fill factor */
-#define MEM_HASH_FILL_FACTOR 4 /* or 3 */
 /*
- * Initialize the in-memory storage engine.
+ * Initialize the in-memory ordered storage engine.
  */
-static int MemHashInit(unqlite_kv_engine *pKvEngine,int iPageSize)
+static int SklInit(unqlite_kv_engine *pKvEngine,int iPageSize)
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
-	/* Note that this instance is already zeroed */	
-	/* Memory backend */
+	skl_kv_engine *pEngine = (skl_kv_engine *)pKvEngine;
+	/* Note that this instance is already zeroed */
 	SyMemBackendInitFromParent(&pEngine->sAlloc,unqliteExportMemBackend());
 #if defined(UNQLITE_ENABLE_THREADS)
 	/* Already protected by the upper layers */
 	SyMemBackendDisbaleMutexing(&pEngine->sAlloc);
 #endif
-	/* Default hash & comparison function */
-	pEngine->xHash = MemHashFunc;
+	/* Default comparison function */
 	pEngine->xCmp = SyMemcmp;
-	/* Allocate a new bucket */
-	pEngine->apBucket = (mem_hash_record **)SyMemBackendAlloc(&pEngine->sAlloc,MEM_HASH_BUCKET_SIZE * sizeof(mem_hash_record *));
-	if( pEngine->apBucket == 0 ){
-		SXUNUSED(iPageSize); /* cc warning */
-		return UNQLITE_NOMEM;
+	pEngine->nLevel = 1;
+	/* Any non-zero seed will do */
+	pEngine->iRandom = 0x9E3779B9 ^ (sxu32)SX_PTR_TO_INT(pEngine);
+	if( pEngine->iRandom == 0 ){
+		pEngine->iRandom = 0x9E3779B9;
 	}
-	/* Zero the bucket */
-	SyZero(pEngine->apBucket,MEM_HASH_BUCKET_SIZE * sizeof(mem_hash_record *));
-	pEngine->nRecord = 0;
-	pEngine->nBucket = MEM_HASH_BUCKET_SIZE;
+	SXUNUSED(iPageSize); /* cc warning */
 	return UNQLITE_OK;
 }
 /*
- * Release the in-memory storage engine.
+ * Release the in-memory ordered storage engine.
  */
-static void MemHashRelease(unqlite_kv_engine *pKvEngine)
+static void SklRelease(unqlite_kv_engine *pKvEngine)
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pKvEngine;
+	skl_kv_cursor *pCur;
+	/* Records are about to be released, detach the cursors */
+	for( pCur = pEngine->pCursor ; pCur ; pCur = pCur->pNext ){
+		pCur->pCur = 0;
+	}
+	pEngine->pCursor = 0;
 	/* Release the private memory backend */
 	SyMemBackendRelease(&pEngine->sAlloc);
 }
 /*
- * Configure the in-memory storage engine.
+ * Configure the in-memory ordered storage engine.
  */
-static int MemHashConfigure(unqlite_kv_engine *pKvEngine,int iOp,va_list ap)
+static int SklConfigure(unqlite_kv_engine *pKvEngine,int iOp,va_list ap)
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKvEngine;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pKvEngine;
 	int rc = UNQLITE_OK;
 	switch(iOp){
-	case UNQLITE_KV_CONFIG_HASH_FUNC:{
-		/* Use a default hash function */
-		if( pEngine->nRecord > 0 ){
-			rc = UNQLITE_LOCKED;
-		}else{
-			ProcHash xHash = va_arg(ap,ProcHash);
-			if( xHash ){
-				pEngine->xHash = xHash;
-			}
-		}
-		break;
-									 }
 	case UNQLITE_KV_CONFIG_CMP_FUNC: {
-		/* Default comparison function */
+		/* Default comparison function, must not change the order of existing records */
 		ProcCmp xCmp = va_arg(ap,ProcCmp);
-		if( xCmp ){
+		if( pEngine->nRecord > 0 ){
+			rc = UNQLITE_LOCKED;
+		}else if( xCmp ){
 			pEngine->xCmp = xCmp;
 		}
 		break;
@@ -52267,149 +56741,124 @@ static int MemHashConfigure(unqlite_kv_engine *pKvEngine,int iOp,va_list ap)
 /*
  * Replace method.
  */
-static int MemHashReplace(
+static int SklReplace(
 	  unqlite_kv_engine *pKv,
 	  const void *pKey,int nKeyLen,
 	  const void *pData,unqlite_int64 nDataLen
 	  )
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKv;
-	mem_hash_record *pRecord;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pKv;
+	skl_node **apUpdate[SKL_MAX_LEVEL];
+	skl_node *pNode;
+	sxu32 nData;
+	void *pNew;
+	int exact;
 	if( nDataLen > SXU32_HIGH ){
 		/* Database limit */
 		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Record size limit reached");
 		return UNQLITE_LIMIT;
 	}
+	nData = (sxu32)nDataLen;
 	/* Fetch the record first */
-	pRecord = MemHashGetEntry(pEngine,pKey,nKeyLen);
-	if( pRecord == 0 ){
-		/* Allocate a new record */
-		pRecord = MemHashNewRecord(pEngine,
-			pKey,nKeyLen,
-			pData,nDataLen,
-			pEngine->xHash(pKey,nKeyLen)
-			);
-		if( pRecord == 0 ){
-			return UNQLITE_NOMEM;
-		}
-		/* Link the entry */
-		MemHashLinkRecord(pEngine,pRecord);
-		if( (pEngine->nRecord >= pEngine->nBucket * MEM_HASH_FILL_FACTOR) && pEngine->nRecord < 100000 ){
-			/* Rehash the table */
-			MemHashGrowTable(pEngine);
-		}
+	pNode = SklSeek(pEngine,pKey,(sxu32)nKeyLen,apUpdate,&exact);
+	if( !exact ){
+		/* Insert a new record */
+		return SklInsert(pEngine,apUpdate,pKey,(sxu32)nKeyLen,pData,nData);
+	}
+	/* Replace an existing record */
+	if( nData == pNode->nDataLen ){
+		/* No need to free the old chunk */
+		pNew = (void *)pNode->pData;
 	}else{
-		sxu32 nData = (sxu32)nDataLen;
-		void *pNew;
-		/* Replace an existing record */
-		if( nData == pRecord->nDataLen ){
-			/* No need to free the old chunk */
-			pNew = (void *)pRecord->pData;
-		}else{
-			pNew = SyMemBackendAlloc(&pEngine->sAlloc,nData);
-			if( pNew == 0 ){
-				return UNQLITE_NOMEM;
-			}
-			/* Release the old data */
-			SyMemBackendFree(&pEngine->sAlloc,(void *)pRecord->pData);
+		pNew = SyMemBackendAlloc(&pEngine->sAlloc,nData);
+		if( pNew == 0 ){
+			return UNQLITE_NOMEM;
 		}
-		/* Reflect the change */
-		pRecord->nDataLen = nData;
-		SyMemcpy(pData,pNew,nData);
-		pRecord->pData = pNew;
+		/* Release the old data */
+		SyMemBackendFree(&pEngine->sAlloc,(void *)pNode->pData);
 	}
+	/* Reflect the change */
+	SyMemcpy(pData,pNew,nData);
+	pNode->pData = pNew;
+	pNode->nDataLen = nData;
 	return UNQLITE_OK;
 }
 /*
  * Append method.
  */
-static int MemHashAppend(
+static int SklAppend(
 	  unqlite_kv_engine *pKv,
 	  const void *pKey,int nKeyLen,
 	  const void *pData,unqlite_int64 nDataLen
 	  )
 {
-	mem_hash_kv_engine *pEngine = (mem_hash_kv_engine *)pKv;
-	mem_hash_record *pRecord;
+	skl_kv_engine *pEngine = (skl_kv_engine *)pKv;
+	skl_node **apUpdate[SKL_MAX_LEVEL];
+	unqlite_int64 nNew;
+	skl_node *pNode;
+	char *zNew;
+	int exact;
 	if( nDataLen > SXU32_HIGH ){
 		/* Database limit */
 		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Record size limit reached");
 		return UNQLITE_LIMIT;
 	}
 	/* Fetch the record first */
-	pRecord = MemHashGetEntry(pEngine,pKey,nKeyLen);
-	if( pRecord == 0 ){
-		/* Allocate a new record */
-		pRecord = MemHashNewRecord(pEngine,
-			pKey,nKeyLen,
-			pData,nDataLen,
-			pEngine->xHash(pKey,nKeyLen)
-			);
-		if( pRecord == 0 ){
-			return UNQLITE_NOMEM;
-		}
-		/* Link the entry */
-		MemHashLinkRecord(pEngine,pRecord);
-		if( pEngine->nRecord * MEM_HASH_FILL_FACTOR >= pEngine->nBucket && pEngine->nRecord < 100000 ){
-			/* Rehash the table */
-			MemHashGrowTable(pEngine);
-		}
-	}else{
-		unqlite_int64 nNew = pRecord->nDataLen + nDataLen;
-		void *pOld = (void *)pRecord->pData;
-		sxu32 nData;
-		char *zNew;
-		/* Append data to the existing record */
-		if( nNew > SXU32_HIGH ){
-			/* Overflow */
-			pEngine->pIo->xErr(pEngine->pIo->pHandle,"Append operation will cause data overflow");	
-			return UNQLITE_LIMIT;
-		}
-		nData = (sxu32)nNew;
-		/* Allocate bigger chunk */
-		zNew = (char *)SyMemBackendRealloc(&pEngine->sAlloc,pOld,nData);
-		if( zNew == 0 ){
-			return UNQLITE_NOMEM;
-		}
-		/* Reflect the change */
-		SyMemcpy(pData,&zNew[pRecord->nDataLen],(sxu32)nDataLen);
-		pRecord->pData = (const void *)zNew;
-		pRecord->nDataLen = nData;
+	pNode = SklSeek(pEngine,pKey,(sxu32)nKeyLen,apUpdate,&exact);
+	if( !exact ){
+		/* Insert a new record */
+		return SklInsert(pEngine,apUpdate,pKey,(sxu32)nKeyLen,pData,(sxu32)nDataLen);
+	}
+	/* Append data to the existing record */
+	nNew = pNode->nDataLen + nDataLen;
+	if( nNew > SXU32_HIGH ){
+		/* Overflow */
+		pEngine->pIo->xErr(pEngine->pIo->pHandle,"Append operation will cause data overflow");
+		return UNQLITE_LIMIT;
+	}
+	/* Allocate bigger chunk */
+	zNew = (char *)SyMemBackendRealloc(&pEngine->sAlloc,(void *)pNode->pData,(sxu32)nNew);
+	if( zNew == 0 ){
+		return UNQLITE_NOMEM;
 	}
+	/* Reflect the change */
+	SyMemcpy(pData,&zNew[pNode->nDataLen],(sxu32)nDataLen);
+	pNode->pData = (const void *)zNew;
+	pNode->nDataLen = (sxu32)nNew;
 	return UNQLITE_OK;
 }
 /*
- * Export the in-memory storage engine.
+ * Export the in-memory ordered storage engine.
  */
-UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportMemKvStorage(void)
+UNQLITE_PRIVATE const unqlite_kv_methods * unqliteExportSkipListKvStorage(void)
 {
-	static const unqlite_kv_methods sMemStore = {
-		"mem",                      /* zName */
-		sizeof(mem_hash_kv_engine), /* szKv */
-		sizeof(mem_hash_cursor),    /* szCursor */
+	static const unqlite_kv_methods sSkipListStore = {
+		"skiplist",                 /* zName */
+		sizeof(skl_kv_engine),      /* szKv */
+		sizeof(skl_kv_cursor),      /* szCursor */
 		1,                          /* iVersion */
-		MemHashInit,                /* xInit */
-		MemHashRelease,             /* xRelease */
-		MemHashConfigure,           /* xConfig */
+		SklInit,                    /* xInit */
+		SklRelease,                 /* xRelease */
+		SklConfigure,               /* xConfig */
 		0,                          /* xOpen */
-		MemHashReplace,             /* xReplace */
-		MemHashAppend,              /* xAppend */
-		MemHashInitCursor,          /* xCursorInit */
-		MemHashCursorSeek,          /* xSeek */
-		MemHashCursorFirst,         /* xFirst */
-		MemHashCursorLast,          /* xLast */
-		MemHashCursorValid,         /* xValid */
-		MemHashCursorNext,          /* xNext */
-		MemHashCursorPrev,          /* xPrev */
-		MemHashCursorDelete,        /* xDelete */
-		MemHashCursorKeyLength,     /* xKeyLength */
-		MemHashCursorKey,           /* xKey */
-		MemHashCursorDataLength,    /* xDataLength */
-		MemHashCursorData,          /* xData */
-		MemHashCursorReset,         /* xReset */
-		0        /* xRelease */                        
+		SklReplace,                 /* xReplace */
+		SklAppend,                  /* xAppend */
+		SklCursorInit,              /* xCursorInit */
+		SklCursorSeek,              /* xSeek */
+		SklCursorFirst,             /* xFirst */
+		SklCursorLast,              /* xLast */
+		SklCursorValid,             /* xValid */
+		SklCursorNext,              /* xNext */
+		SklCursorPrev,              /* xPrev */
+		SklCursorDelete,            /* xDelete */
+		SklCursorKeyLength,         /* xKeyLength */
+		SklCursorKey,               /* xKey */
+		SklCursorDataLength,        /* xDataLength */
+		SklCursorData,              /* xData */
+		SklCursorReset,             /* xReset */
+		SklCursorRelease            /* xRelease */
 	};
-	return &sMemStore;
+	return &sSkipListStore;
 }
 /*
  * ----------------------------------------------------------
@@ -52448,6 +56897,22 @@ UNQLITE_PRIVATE int unqliteOsWrite(unqlite_file *id, const void *pBuf, unqlite_i
 {
   return id->pMethods->xWrite(id, pBuf, amt, offset);
 }
+UNQLITE_PRIVATE int unqliteOsWritev(unqlite_file *id, const void * const *apBuf, int nBuf, unqlite_int64 iBufSize, unqlite_int64 offset)
+{
+  int rc = UNQLITE_OK;
+  int i;
+  if( id->pMethods->iVersion >= 3 && id->pMethods->xWritev ){
+    return id->pMethods->xWritev(id, apBuf, nBuf, iBufSize, offset);
+  }
+  /* One write per buffer */
+  for( i = 0 ; i < nBuf ; ++i ){
+    rc = id->pMethods->xWrite(id, apBuf[i], iBufSize, offset + i * iBufSize);
+    if( rc != UNQLITE_OK ){
+      break;
+    }
+  }
+  return rc;
+}
 UNQLITE_PRIVATE int unqliteOsTruncate(unqlite_file *id, unqlite_int64 size)
 {
   return id->pMethods->xTruncate(id, size);
@@ -53634,6 +58099,85 @@ static int unixWrite(
   return UNQLITE_OK;
 }
 /*
+** pwritev() is used to write runs of buffers with a single system call
+** where available. Compile with -DUNQLITE_DISABLE_PWRITEV to turn it off.
+*/
+#if !defined(UNQLITE_DISABLE_PWRITEV) && \
+    (defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__))
+# define UNQLITE_HAVE_PWRITEV 1
+#endif
+/*
+** Maximum number of buffers handed to a single pwritev() call.
+*/
+#ifndef UNIX_MAX_IOVEC
+# define UNIX_MAX_IOVEC 256
+#endif
+/*
+** Write nBuf buffers of bufSize bytes each into a file, back to back
+** starting at offset. Return UNQLITE_OK on success or some other
+** error code on failure.
+*/
+static int unixWritev(
+  unqlite_file *id,
+  const void * const *apBuf,
+  int nBuf,
+  unqlite_int64 bufSize,
+  unqlite_int64 offset
+){
+#if defined(UNQLITE_HAVE_PWRITEV)
+  unixFile *pFile = (unixFile*)id;
+  struct iovec aVec[UNIX_MAX_IOVEC];
+  unqlite_int64 partial;
+  ssize_t got;
+  int i, n;
+  int rc;
+
+  while( nBuf>0 ){
+    n = nBuf > UNIX_MAX_IOVEC ? UNIX_MAX_IOVEC : nBuf;
+    for( i=0 ; i<n ; i++ ){
+      aVec[i].iov_base = (void *)apBuf[i];
+      aVec[i].iov_len = (size_t)bufSize;
+    }
+    got = pwritev(pFile->h, aVec, n, (off_t)offset);
+    if( got<0 ){
+      pFile->lastErrno = errno;
+      return UNQLITE_IOERR;
+    }
+    if( got==0 ){
+      pFile->lastErrno = 0; /* not a system error */
+      return UNQLITE_FULL;
+    }
+    /* Skip the buffers written as a whole */
+    i = (int)(got / bufSize);
+    partial = (unqlite_int64)got - i * bufSize;
+    apBuf += i;
+    nBuf -= i;
+    offset += i * bufSize;
+    if( partial>0 ){
+      /* Short write in the middle of a buffer, complete it */
+      rc = unixWrite(id, &((const char *)apBuf[0])[partial], bufSize - partial, offset + partial);
+      if( rc!=UNQLITE_OK ){
+        return rc;
+      }
+      apBuf++;
+      nBuf--;
+      offset += bufSize;
+    }
+  }
+  return UNQLITE_OK;
+#else
+  int rc = UNQLITE_OK;
+  int i;
+  for( i=0 ; i<nBuf ; i++ ){
+    rc = unixWrite(id, apBuf[i], bufSize, offset + i * bufSize);
+    if( rc!=UNQLITE_OK ){
+      break;
+    }
+  }
+  return rc;
+#endif
+}
+/*
 ** We do not trust systems to provide a working fdatasync().  Some do.
 ** Others do no.  To be safe, we will stick with the (slower) fsync().
 ** If you know that your system does support fdatasync() correctly,
@@ -53824,11 +58368,24 @@ static int unixSectorSize(unqlite_file *NotUsed){
   return UNQLITE_DEFAULT_SECTOR_SIZE;
 }
 /*
+** Report the device and inode numbers of the file, that is the key
+** of the unixInodeInfo object shared by every descriptor open on it.
+*/
+static int unixGetFileId(unqlite_file *id, unqlite_int64 *pDev, unqlite_int64 *pIno){
+  unixFile *pFile = (unixFile *)id;
+  if( pFile->pInode == 0 ){
+    return UNQLITE_IOERR;
+  }
+  *pDev = (unqlite_int64)pFile->pInode->fileId.dev;
+  *pIno = (unqlite_int64)pFile->pInode->fileId.ino;
+  return UNQLITE_OK;
+}
+/*
 ** This vector defines all the methods that can operate on an
 ** unqlite_file for Windows systems.
 */
 static const unqlite_io_methods unixIoMethod = {
-  1,                              /* iVersion */
+  3,                              /* iVersion */
   unixClose,                       /* xClose */
   unixRead,                        /* xRead */
   unixWrite,                       /* xWrite */
@@ -53839,6 +58396,8 @@ static const unqlite_io_methods unixIoMethod = {
   unixUnlock,                      /* xUnlock */
   unixCheckReservedLock,           /* xCheckReservedLock */
   unixSectorSize,                  /* xSectorSize */
+  unixGetFileId,                   /* xFileId */
+  unixWritev,                      /* xWritev */
 };
 /****************************************************************************
 **************************** unqlite_vfs methods ****************************
@@ -54188,6 +58747,12 @@ static int unixDelete(
 ** might be greater than or equal to the argument, but not less
 ** than the argument.
 */
+#ifndef HAVE_USLEEP
+/* usleep() is available on every supported Unix flavor (The Jx9 VFS rely on it too)
+** and whole-second sleeps are far too coarse for the group commit window.
+*/
+#define HAVE_USLEEP 1
+#endif
 static int unixSleep(unqlite_vfs *NotUsed, int microseconds)
 {
 #if defined(HAVE_USLEEP) && HAVE_USLEEP
@@ -54889,6 +59454,8 @@ static const unqlite_io_methods winIoMethod = {
   winUnlock,                      /* xUnlock */
   winCheckReservedLock,           /* xCheckReservedLock */
   winSectorSize,                  /* xSectorSize */
+  0,                              /* xFileId */
+  0,                              /* xWritev */
 };
 /*
  * Windows VFS Methods.
@@ -55420,6 +59987,8 @@ static const unsigned char aJournalMagic[] = {
  * of the following structure.
  */
 typedef struct Page Page;
+typedef struct SharedPage SharedPage;
+typedef struct SharedCache SharedCache;
 struct Page {
   /* Must correspond to unqlite_page */
   unsigned char *zData;           /* Content of this page */
@@ -55437,6 +60006,8 @@ struct Page {
   Page *pDirtyPrev;             /* Previous element in list of dirty pages */
   Page *pNextCollide,*pPrevCollide; /* Collission chain */
   Page *pNextHot,*pPrevHot;    /* Hot dirty pages chain */
+  Page *pNextLru,*pPrevLru;    /* Clean page cache chain */
+  SharedPage *pShared;          /* Shared content this page point to if any (UNQLITE_OPEN_SHARED_CACHE) */
 };
 /* Bit values for Page.flags */
 #define PAGE_DIRTY             0x002  /* Page has changed */
@@ -55449,6 +60020,22 @@ struct Page {
 #define PAGE_DONT_MAKE_HOT     0x080  /* Dont make this page Hot. In other words,
 									   * do not link it to the hot dirty list.
 									   */
+#define PAGE_IN_CACHE          0x100  /* Unreferenced clean page kept in the page cache */
+#define PAGE_CACHE_HOT         0x200  /* Page re-referenced while cached (protected segment) */
+#define PAGE_NO_INLINE         0x400  /* Allocated without inline content: zData point to a shared page
+                                       * or to a separately allocated buffer.
+                                       */
+/*
+ * An entry of the in-memory write-ahead log index. Each entry map a page
+ * number to the offset of the latest committed frame holding its content.
+ */
+typedef struct WalEntry WalEntry;
+struct WalEntry
+{
+  pgno iPage;        /* Page number */
+  sxi64 iOfft;       /* Frame offset in the log or -1 if not yet committed */
+  WalEntry *pNext;   /* Collision chain */
+};
 /*
  * Each active database pager is represented by an instance of
  * the following structure.
@@ -55466,6 +60053,7 @@ struct Pager
   pgno dbOrigSize;               /* dbSize before the current change */
   sxi64 dbByteSize;              /* Database size in bytes */
   void *pMmap;                   /* Read-only Memory view (mmap) of the whole file if requested (UNQLITE_OPEN_MMAP). */
+                                 /* When pMmap is set, dbByteSize is the size of the view */
   sxu32 nRec;                    /* Number of pages written to the journal */
   SyPRNGCtx sPrng;               /* PRNG Context */
   sxu32 cksumInit;               /* Quasi-random value added to every checksum */
@@ -55498,10 +60086,88 @@ struct Pager
   sxu32 nSize;                   /* apHash[] size: Must be a power of two  */
   sxu32 nPage;                   /* Total number of page loaded in memory */
   sxu32 nCacheMax;               /* Maximum page to cache*/
+  unqlite_pager_stats sStats;    /* Cumulative statistics (UNQLITE_CONFIG_PAGER_STATS) */
+  Page *pProbation,*pProbationTail; /* Cached pages referenced once (MRU first) */
+  Page *pProtected,*pProtectedTail; /* Cached pages referenced more than once (MRU first) */
+  sxu32 nProbation;              /* Total number of pages in the probationary segment */
+  sxu32 nProtected;              /* Total number of pages in the protected segment */
+  char *zWal;                    /* Name of the write-ahead log file */
+  unqlite_file *pwfd;            /* Write-ahead log file descriptor */
+  int is_wal;                    /* TRUE when operating in write-ahead log mode */
+  WalEntry **apWal;              /* Write-ahead log index: page number to frame offset */
+  sxu32 nWalSize;                /* apWal[] size: Must be a power of two */
+  sxu32 nWalEntry;               /* Total number of entries in apWal[] */
+  sxu32 nWalFrame;               /* Total number of committed frames in the log */
+  sxu32 nWalCkpt;                /* Auto-checkpoint threshold in frames (0 to disable) */
+  sxu32 iWalSalt;                /* Salt of the current log generation */
+  sxi64 iWalOfft;                /* Offset past the last committed frame */
+  sxi64 iWalEnd;                 /* Log size as last seen by this connection */
+  pgno iWalDbSize;               /* Database size recorded by the last commit frame */
+  unsigned char *zWalFrame;      /* Frame buffer */
+  unqlite_snapshot *pSnapshot;   /* List of open snapshots */
+  ProcHash xKvHash;              /* Hash function installed on the KV engine, if any */
+  ProcCmp xKvCmp;                /* Comparison function installed on the KV engine, if any */
+  SharedCache *pShared;          /* Shared page cache this pager is attached to (UNQLITE_OPEN_SHARED_CACHE) */
+  unsigned char *zJournalBuf;    /* Journal records not yet written (see page_write()) */
+  sxu32 nJournalBuf;             /* Pending bytes in zJournalBuf */
+  sxu32 nJournalBufMax;          /* zJournalBuf[] size */
+  sxi64 iJournalBufOfft;         /* Journal offset of the first pending byte */
 };
+/*
+ * Journal records are buffered up to this many bytes before being written.
+ */
+#define PAGER_JOURNAL_BUFFER (256 * 1024)
+/*
+ * Maximum number of consecutive dirty pages written by a single vectored write.
+ */
+#define PAGER_MAX_RUN 256
 /* Control flags */
 #define PAGER_CTRL_COMMIT_ERR   0x001 /* Commit error */
 #define PAGER_CTRL_DIRTY_COMMIT 0x002 /* Dirty commit has been applied */ 
+#define PAGER_CTRL_WAL_STALE    0x004 /* Another connection committed to the write-ahead log */
+/*
+ * Concurrent readers (see [unqliteEnterShared()]) and snapshots (see [unqlite_snapshot_open()])
+ * share the page cache with the writer, every access to it is serialized on pReadMutex.
+ */
+#if defined(UNQLITE_ENABLE_THREADS)
+#define PAGER_READ_ENTER(PAGER) SyMutexEnter(sUnqlMPGlobal.pMutexMethods,(PAGER)->pDb->pReadMutex)
+#define PAGER_READ_LEAVE(PAGER) SyMutexLeave(sUnqlMPGlobal.pMutexMethods,(PAGER)->pDb->pReadMutex)
+#else
+#define PAGER_READ_ENTER(PAGER)
+#define PAGER_READ_LEAVE(PAGER)
+#endif
+/*
+ * A page as seen by a snapshot: either a copy of a committed page taken the
+ * first time the snapshot reference it or the content saved by the writer
+ * just before modifying the page (pre-image). Snapshot pages are kept until
+ * the snapshot is released.
+ */
+typedef struct SnapPage SnapPage;
+struct SnapPage {
+  /* Must correspond to unqlite_page */
+  unsigned char *zData;           /* Content of this page */
+  void *pUserData;                /* Extra content */
+  pgno pgno;                      /* Page number for this page */
+  /* Private fields */
+  SnapPage *pNextCollide,*pPrevCollide; /* Collission chain */
+};
+/*
+ * A read-only view of the database as it was committed when the snapshot was taken.
+ * Refer to [unqlite_snapshot_open()].
+ */
+struct unqlite_snapshot
+{
+  Pager *pPager;                 /* Pager this snapshot was taken from */
+  SyMemBackend sMem;             /* Private memory backend (pages and cursors) */
+  unqlite_kv_engine *pEngine;    /* Private instance of the underlying KV storage engine */
+  unqlite_kv_io sIo;             /* IO methods of the private engine */
+  pgno dbSize;                   /* Number of pages in the database when the snapshot was taken */
+  SnapPage **apHash;             /* Page table */
+  sxu32 nSize;                   /* apHash[] size: Must be a power of two  */
+  sxu32 nPage;                   /* Total number of pages in apHash[] */
+  unsigned char *zTmpPage;       /* Temporary page */
+  unqlite_snapshot *pNext,*pPrev; /* List of open snapshots */
+};
 /*
 ** Read a 32-bit integer from the given file descriptor. 
 ** All values are stored on disk as big-endian.
@@ -55544,14 +60210,33 @@ static int WriteInt32(unqlite_file *pFd,sxu32 iNum,sxi64 iOfft)
 	return rc;
 }
 /*
-** Write a 64-bit integer into the given file descriptor.
-*/
-static int WriteInt64(unqlite_file *pFd,sxu64 iNum,sxi64 iOfft)
+ * Current time in microseconds. Used to measure the cost of sync operations.
+ */
+static sxi64 pager_clock(void)
 {
-	unsigned char zBuf[8];
+#if defined(__WINNT__)
+	FILETIME sFt;
+	GetSystemTimeAsFileTime(&sFt);
+	return (sxi64)((((sxu64)sFt.dwHighDateTime << 32) | sFt.dwLowDateTime) / 10);
+#elif defined(__UNIXES__)
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return (sxi64)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+	return 0;
+#endif /* __WINNT__ */
+}
+/*
+ * Sync a file owned by the pager and update the sync statistics.
+ */
+static int pager_sync(Pager *pPager,unqlite_file *pFd,int flags)
+{
+	sxi64 iStart;
 	int rc;
-	SyBigEndianPack64(zBuf,iNum);
-	rc = unqliteOsWrite(pFd,zBuf,sizeof(zBuf),iOfft);
+	iStart = pager_clock();
+	rc = unqliteOsSync(pFd,flags);
+	pPager->sStats.nSync++;
+	pPager->sStats.iSyncTime += pager_clock() - iStart;
 	return rc;
 }
 /*
@@ -55630,6 +60315,307 @@ static Page * pager_alloc_page(Pager *pPager,pgno num_page)
 	pNew->pgno = num_page;
 	return pNew;
 }
+/*
+ * Shared page cache (UNQLITE_OPEN_SHARED_CACHE).
+ *
+ * Handles opened with the UNQLITE_OPEN_SHARED_CACHE flag on the same file (same device
+ * and inode as reported by the xFileId() method of the VFS) share a single copy of the
+ * clean pages they read from the database file. A shared page is never modified in place,
+ * the first change to a page gives the handle a private copy (see unqlitePageWrite()).
+ * This is safe because a handle keeps its SHARED lock on the database file for as long
+ * as it holds pages while the database file is only written under an EXCLUSIVE lock, so
+ * the file cannot change as long as a shared page is referenced. A shared page is released
+ * as soon as the last handle referencing it drops it from its own page cache.
+ * A handle rolled back outside of a write transaction drops its pages and its SHARED lock
+ * so that the other handles can commit, see pager_read_unlock().
+ */
+struct SharedPage {
+  unsigned char *zData;          /* Committed page content */
+  pgno pgno;                     /* Page number */
+  sxu32 nRef;                    /* Number of pages pointing to this content */
+  SharedPage *pNextCollide,*pPrevCollide; /* Collission chain */
+};
+struct SharedCache {
+  unqlite_int64 iDev,iIno;       /* Identity of the database file */
+  int iPageSize;                 /* Page size in bytes */
+  sxu32 nRef;                    /* Number of attached pagers */
+  SharedPage **apHash;           /* Page table */
+  sxu32 nSize;                   /* apHash[] size: Must be a power of two */
+  sxu32 nPage;                   /* Total number of shared pages */
+  SharedCache *pNext,*pPrev;     /* List of shared caches */
+};
+/* List of the shared caches of this process */
+static SharedCache *pSharedCacheList = 0;
+/*
+ * Every access to the shared caches is serialized on a static mutex.
+ */
+static void pager_shared_enter(void)
+{
+#if defined(UNQLITE_ENABLE_THREADS)
+	const SyMutexMethods *pMutexMethods = SyMutexExportMethods();
+	if( pMutexMethods ){
+		SyMutex *pMutex = pMutexMethods->xNew(SXMUTEX_TYPE_STATIC_4); /* pre-allocated, never fail */
+		SyMutexEnter(pMutexMethods,pMutex);
+	}
+#endif
+}
+static void pager_shared_leave(void)
+{
+#if defined(UNQLITE_ENABLE_THREADS)
+	const SyMutexMethods *pMutexMethods = SyMutexExportMethods();
+	if( pMutexMethods ){
+		SyMutex *pMutex = pMutexMethods->xNew(SXMUTEX_TYPE_STATIC_4); /* pre-allocated, never fail */
+		SyMutexLeave(pMutexMethods,pMutex);
+	}
+#endif
+}
+/*
+ * Lookup a shared page. The shared mutex must be held.
+ */
+static SharedPage * pager_shared_lookup(SharedCache *pCache,pgno iPage)
+{
+	SharedPage *pEntry;
+	pEntry = pCache->apHash[PAGE_HASH(iPage) & (pCache->nSize - 1)];
+	while( pEntry ){
+		if( pEntry->pgno == iPage ){
+			return pEntry;
+		}
+		pEntry = pEntry->pNextCollide;
+	}
+	return 0;
+}
+/*
+ * Install a freshly read page in the shared cache. The shared mutex must be held.
+ */
+static void pager_shared_install(SharedCache *pCache,SharedPage *pEntry)
+{
+	sxu32 nBucket;
+	nBucket = PAGE_HASH(pEntry->pgno) & (pCache->nSize - 1);
+	pEntry->pPrevCollide = 0;
+	pEntry->pNextCollide = pCache->apHash[nBucket];
+	if( pCache->apHash[nBucket] ){
+		pCache->apHash[nBucket]->pPrevCollide = pEntry;
+	}
+	pCache->apHash[nBucket] = pEntry;
+	pCache->nPage++;
+	if( pCache->nPage >= pCache->nSize * 4 && pCache->nPage < 100000 ){
+		/* Grow the hashtable */
+		sxu32 nNewSize = pCache->nSize << 1;
+		SharedPage *pNext,**apNew;
+		sxu32 n;
+		apNew = (SharedPage **)SyMemBackendAlloc(&sUnqlMPGlobal.sAllocator,nNewSize * sizeof(SharedPage *));
+		if( apNew ){
+			SyZero((void *)apNew,nNewSize * sizeof(SharedPage *));
+			/* Rehash all entries */
+			for( n = 0 ; n < pCache->nSize ; ++n ){
+				pEntry = pCache->apHash[n];
+				while( pEntry ){
+					pNext = pEntry->pNextCollide;
+					nBucket = PAGE_HASH(pEntry->pgno) & (nNewSize - 1);
+					pEntry->pPrevCollide = 0;
+					pEntry->pNextCollide = apNew[nBucket];
+					if( apNew[nBucket] ){
+						apNew[nBucket]->pPrevCollide = pEntry;
+					}
+					apNew[nBucket] = pEntry;
+					pEntry = pNext;
+				}
+			}
+			/* Release the old table and reflect the change */
+			SyMemBackendFree(&sUnqlMPGlobal.sAllocator,(void *)pCache->apHash);
+			pCache->apHash = apNew;
+			pCache->nSize = nNewSize;
+		}
+	}
+}
+/*
+ * Drop a reference to a shared page and release it when no longer used.
+ */
+static void pager_shared_unref(SharedCache *pCache,SharedPage *pEntry)
+{
+	pager_shared_enter();
+	pEntry->nRef--;
+	if( pEntry->nRef < 1 ){
+		/* Unlink from the page table */
+		if( pEntry->pNextCollide ){
+			pEntry->pNextCollide->pPrevCollide = pEntry->pPrevCollide;
+		}
+		if( pEntry->pPrevCollide ){
+			pEntry->pPrevCollide->pNextCollide = pEntry->pNextCollide;
+		}else{
+			pCache->apHash[PAGE_HASH(pEntry->pgno) & (pCache->nSize - 1)] = pEntry->pNextCollide;
+		}
+		pCache->nPage--;
+		SyMemBackendFree(&sUnqlMPGlobal.sAllocator,pEntry);
+	}
+	pager_shared_leave();
+}
+/*
+ * Allocate a page whose content is served by the shared cache, reading it from
+ * the database file and publishing it for the other handles if not yet shared.
+ */
+static int pager_shared_page(Pager *pPager,pgno iPage,Page **ppPage)
+{
+	SharedCache *pCache = pPager->pShared;
+	SharedPage *pEntry,*pNew;
+	Page *pPage;
+	int rc;
+	pPage = (Page *)SyMemBackendPoolAlloc(pPager->pAllocator,sizeof(Page));
+	if( pPage == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	SyZero(pPage,sizeof(Page));
+	pPage->pPager = pPager;
+	pPage->nRef = 1;
+	pPage->pgno = iPage;
+	pPage->flags = PAGE_NO_INLINE;
+	pager_shared_enter();
+	pEntry = pager_shared_lookup(pCache,iPage);
+	if( pEntry ){
+		pEntry->nRef++;
+	}
+	pager_shared_leave();
+	if( pEntry == 0 ){
+		/* Read the page outside the shared mutex */
+		pNew = (SharedPage *)SyMemBackendAlloc(&sUnqlMPGlobal.sAllocator,sizeof(SharedPage)+pPager->iPageSize);
+		if( pNew == 0 ){
+			SyMemBackendPoolFree(pPager->pAllocator,pPage);
+			return UNQLITE_NOMEM;
+		}
+		SyZero(pNew,sizeof(SharedPage));
+		pNew->zData = (unsigned char *)&pNew[1];
+		pNew->pgno = iPage;
+		pNew->nRef = 1;
+		rc = unqliteOsRead(pPager->pfd,pNew->zData,pPager->iPageSize,iPage * pPager->iPageSize);
+		if( rc != UNQLITE_OK ){
+			SyMemBackendFree(&sUnqlMPGlobal.sAllocator,pNew);
+			SyMemBackendPoolFree(pPager->pAllocator,pPage);
+			return rc;
+		}
+		pPager->sStats.nPageRead++;
+		pager_shared_enter();
+		/* Another handle may have published the same page meanwhile */
+		pEntry = pager_shared_lookup(pCache,iPage);
+		if( pEntry ){
+			pEntry->nRef++;
+		}else{
+			pager_shared_install(pCache,pNew);
+			pEntry = pNew;
+			pNew = 0;
+		}
+		pager_shared_leave();
+		if( pNew ){
+			SyMemBackendFree(&sUnqlMPGlobal.sAllocator,pNew);
+		}
+	}else{
+		pPager->sStats.nSharedHit++;
+	}
+	pPage->pShared = pEntry;
+	pPage->zData = pEntry->zData;
+	*ppPage = pPage;
+	return UNQLITE_OK;
+}
+/*
+ * Give a page served by the shared cache a private copy of its content.
+ */
+static int pager_page_unshare(Pager *pPager,Page *pPage)
+{
+	unsigned char *zBuf;
+	zBuf = (unsigned char *)SyMemBackendPoolAlloc(pPager->pAllocator,(sxu32)pPager->iPageSize);
+	if( zBuf == 0 ){
+		unqliteGenOutofMem(pPager->pDb);
+		return UNQLITE_NOMEM;
+	}
+	SyMemcpy((const void *)pPage->zData,(void *)zBuf,(sxu32)pPager->iPageSize);
+	pager_shared_unref(pPager->pShared,pPage->pShared);
+	pPage->pShared = 0;
+	pPage->zData = zBuf;
+	return UNQLITE_OK;
+}
+/*
+ * Attach a pager to the shared cache of its database file, creating it if this is
+ * the first handle opened with the UNQLITE_OPEN_SHARED_CACHE flag on the file.
+ * In-memory databases, write-ahead log mode (the committed content may live in the log)
+ * and memory views (already shared by the OS) are not eligible.
+ */
+static void pager_shared_attach(Pager *pPager)
+{
+	const unqlite_io_methods *pMethods = pPager->pfd->pMethods;
+	unqlite_int64 iDev,iIno;
+	SharedCache *pCache;
+	if( pPager->pShared ){
+		/* Already attached */
+		return;
+	}
+	if( pPager->is_mem || pPager->is_wal || (pPager->iOpenFlags & UNQLITE_OPEN_MMAP)
+		|| pMethods->iVersion < 2 || pMethods->xFileId == 0
+		|| pMethods->xFileId(pPager->pfd,&iDev,&iIno) != UNQLITE_OK ){
+			/* Each handle keeps its own pages */
+			pPager->iOpenFlags &= ~UNQLITE_OPEN_SHARED_CACHE;
+			return;
+	}
+	pager_shared_enter();
+	for( pCache = pSharedCacheList ; pCache ; pCache = pCache->pNext ){
+		if( pCache->iDev == iDev && pCache->iIno == iIno && pCache->iPageSize == pPager->iPageSize ){
+			break;
+		}
+	}
+	if( pCache == 0 ){
+		pCache = (SharedCache *)SyMemBackendAlloc(&sUnqlMPGlobal.sAllocator,sizeof(SharedCache));
+		if( pCache ){
+			SyZero(pCache,sizeof(SharedCache));
+			pCache->nSize = 64;
+			pCache->apHash = (SharedPage **)SyMemBackendAlloc(&sUnqlMPGlobal.sAllocator,pCache->nSize * sizeof(SharedPage *));
+			if( pCache->apHash == 0 ){
+				SyMemBackendFree(&sUnqlMPGlobal.sAllocator,pCache);
+				pCache = 0;
+			}else{
+				SyZero((void *)pCache->apHash,pCache->nSize * sizeof(SharedPage *));
+				pCache->iDev = iDev;
+				pCache->iIno = iIno;
+				pCache->iPageSize = pPager->iPageSize;
+				MACRO_LD_PUSH(pSharedCacheList,pCache);
+			}
+		}
+	}
+	if( pCache ){
+		pCache->nRef++;
+	}
+	pager_shared_leave();
+	pPager->pShared = pCache;
+	if( pCache == 0 ){
+		/* Out of memory, each handle keeps its own pages */
+		pPager->iOpenFlags &= ~UNQLITE_OPEN_SHARED_CACHE;
+	}
+}
+/*
+ * Drop the shared pages still referenced by a pager and detach it from the shared cache.
+ */
+static void pager_shared_detach(Pager *pPager)
+{
+	SharedCache *pCache = pPager->pShared;
+	Page *pPage;
+	if( pCache == 0 ){
+		return;
+	}
+	for( pPage = pPager->pAll ; pPage ; pPage = pPage->pNext ){
+		if( pPage->pShared ){
+			pager_shared_unref(pCache,pPage->pShared);
+			pPage->pShared = 0;
+			pPage->zData = 0;
+		}
+	}
+	pager_shared_enter();
+	pCache->nRef--;
+	if( pCache->nRef < 1 ){
+		/* Last handle on this file, every shared page is gone by now */
+		MACRO_LD_REMOVE(pSharedCacheList,pCache);
+		SyMemBackendFree(&sUnqlMPGlobal.sAllocator,(void *)pCache->apHash);
+		SyMemBackendFree(&sUnqlMPGlobal.sAllocator,pCache);
+	}
+	pager_shared_leave();
+	pPager->pShared = 0;
+}
 /*
  * Increment the reference count of a given page.
  */
@@ -55649,6 +60635,12 @@ static int pager_release_page(Pager *pPager,Page *pPage)
 			pPager->xPageUnpin(pPage->pUserData);
 		}
 		pPage->pUserData = 0;
+		if( pPage->pShared ){
+			pager_shared_unref(pPager->pShared,pPage->pShared);
+		}else if( pPage->flags & PAGE_NO_INLINE ){
+			/* Private copy of a formerly shared page */
+			SyMemBackendPoolFree(pPager->pAllocator,pPage->zData);
+		}
 		SyMemBackendPoolFree(pPager->pAllocator,pPage);
 	}else{
 		/* Dirty page, it will be released later when a dirty commit
@@ -55660,6 +60652,7 @@ static int pager_release_page(Pager *pPager,Page *pPage)
 }
 /* Forward declaration */
 static int pager_unlink_page(Pager *pPager,Page *pPage);
+static void pager_cache_park(Pager *pPager,Page *pPage);
 /*
  * Decrement the reference count of a given page.
  */
@@ -55669,9 +60662,8 @@ static void page_unref(Page *pPage)
 	if( pPage->nRef < 1	){
 		Pager *pPager = pPage->pPager;
 		if( !(pPage->flags & PAGE_DIRTY)  ){
-			pager_unlink_page(pPager,pPage);
-			/* Release the page */
-			pager_release_page(pPager,pPage);
+			/* Keep the page in the cache, it is released on eviction */
+			pager_cache_park(pPager,pPage);
 		}else{
 			if( pPage->flags & PAGE_DONT_MAKE_HOT ){
 				/* Do not add this page to the hot dirty list */
@@ -55767,6 +60759,113 @@ static int pager_unlink_page(Pager *pPager,Page *pPage)
 	pPager->nPage--;
 	return UNQLITE_OK;
 }
+/*
+ * Page cache.
+ *
+ * Unreferenced clean pages are not released immediately but kept in memory
+ * up to nCacheMax pages (UNQLITE_CONFIG_MAX_PAGE_CACHE) so that later lookups
+ * hit the cache instead of the disk. Replacement is driven by a segmented
+ * LRU policy (a simplified 2Q):
+ *
+ *  - A page released for the first time enter the probationary segment.
+ *  - A page acquired again while cached is promoted to the protected segment.
+ *  - The protected segment is capped to 3/4 of the cache, its least recently
+ *    used pages are demoted back to the probationary segment.
+ *  - Eviction pick the least recently used probationary page first.
+ *
+ * A full scan (i.e. a cursor walk) touch each page once, so it only cycles
+ * through the probationary segment and does not flush the working set of
+ * repeated point lookups.
+ */
+static void pager_cache_remove(Pager *pPager,Page *pPage)
+{
+	Page **ppHead,**ppTail;
+	if( pPage->flags & PAGE_CACHE_HOT ){
+		ppHead = &pPager->pProtected;
+		ppTail = &pPager->pProtectedTail;
+		pPager->nProtected--;
+	}else{
+		ppHead = &pPager->pProbation;
+		ppTail = &pPager->pProbationTail;
+		pPager->nProbation--;
+	}
+	if( pPage->pPrevLru ){
+		pPage->pPrevLru->pNextLru = pPage->pNextLru;
+	}else{
+		*ppHead = pPage->pNextLru;
+	}
+	if( pPage->pNextLru ){
+		pPage->pNextLru->pPrevLru = pPage->pPrevLru;
+	}else{
+		*ppTail = pPage->pPrevLru;
+	}
+	pPage->pNextLru = pPage->pPrevLru = 0;
+	pPage->flags &= ~PAGE_IN_CACHE;
+}
+/*
+ * Install an unreferenced page at the head (most recently used end) of its segment.
+ */
+static void pager_cache_push(Pager *pPager,Page *pPage)
+{
+	Page **ppHead,**ppTail;
+	if( pPage->flags & PAGE_CACHE_HOT ){
+		ppHead = &pPager->pProtected;
+		ppTail = &pPager->pProtectedTail;
+		pPager->nProtected++;
+	}else{
+		ppHead = &pPager->pProbation;
+		ppTail = &pPager->pProbationTail;
+		pPager->nProbation++;
+	}
+	pPage->pPrevLru = 0;
+	pPage->pNextLru = *ppHead;
+	if( *ppHead ){
+		(*ppHead)->pPrevLru = pPage;
+	}else{
+		*ppTail = pPage;
+	}
+	*ppHead = pPage;
+	pPage->flags |= PAGE_IN_CACHE;
+}
+/*
+ * Evict cached pages until the total number of in-memory pages fit in nCacheMax.
+ * Referenced and dirty pages are never cached and thus never evicted.
+ */
+static void pager_cache_evict(Pager *pPager)
+{
+	sxu32 nMaxProtected = pPager->nCacheMax - (pPager->nCacheMax >> 2);
+	Page *pPage;
+	/* Demote the least recently used protected pages */
+	while( pPager->nProtected > nMaxProtected ){
+		pPage = pPager->pProtectedTail;
+		pager_cache_remove(pPager,pPage);
+		pPage->flags &= ~PAGE_CACHE_HOT;
+		pager_cache_push(pPager,pPage);
+	}
+	while( pPager->nPage > pPager->nCacheMax ){
+		pPage = pPager->pProbationTail;
+		if( pPage == 0 ){
+			pPage = pPager->pProtectedTail;
+			if( pPage == 0 ){
+				/* Every in-memory page is in use */
+				break;
+			}
+		}
+		pager_cache_remove(pPager,pPage);
+		pager_unlink_page(pPager,pPage);
+		/* Release the page */
+		pager_release_page(pPager,pPage);
+		pPager->sStats.nCacheEvict++;
+	}
+}
+/*
+ * Move a clean page whose reference count reach zero to the page cache.
+ */
+static void pager_cache_park(Pager *pPager,Page *pPage)
+{
+	pager_cache_push(pPager,pPage);
+	pager_cache_evict(pPager);
+}
 /*
  * Update the content of a cached page.
  */
@@ -55778,11 +60877,23 @@ static int pager_fill_page(Pager *pPager,pgno iNum,void *pContents)
 	if( pPage == 0 ){
 		return SXERR_NOTFOUND;
 	}
+	if( pPage->pShared ){
+		/* Stop sharing the page, the other handles keep their content */
+		int rc = pager_page_unshare(pPager,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}else if( !(pPage->flags & PAGE_NO_INLINE) && pPage->zData != (unsigned char *)&pPage[1] ){
+		/* Served from the memory view which already reflect the write */
+		return UNQLITE_OK;
+	}
 	/* Reflect the change */
 	SyMemcpy(pContents,pPage->zData,pPager->iPageSize);
 
 	return UNQLITE_OK;
 }
+/* Forward declaration */
+static int pager_wal_read(Pager *pPager,pgno iPage,void *pBuf,int nByte);
 /*
  * Read the content of a page from disk.
  */
@@ -55794,13 +60905,26 @@ static int pager_get_page_contents(Pager *pPager,Page *pPage,int noContent)
 		SyZero(pPage->zData,pPager->iPageSize);
 		return UNQLITE_OK;
 	}
-	if( (pPager->iOpenFlags & UNQLITE_OPEN_MMAP) && (pPager->pMmap /* Paranoid edition */) ){
+	if( pPager->nWalEntry > 0 ){
+		/* The latest committed version may live in the write-ahead log */
+		rc = pager_wal_read(pPager,pPage->pgno,pPage->zData,pPager->iPageSize);
+		if( rc != SXERR_NOTFOUND ){
+			if( rc == UNQLITE_OK ){
+				pPager->sStats.nPageRead++;
+			}
+			return rc;
+		}
+		rc = UNQLITE_OK;
+	}
+	if( (pPager->iOpenFlags & UNQLITE_OPEN_MMAP) && (pPager->pMmap /* Paranoid edition */)
+		&& (sxi64)(pPage->pgno + 1) * pPager->iPageSize <= pPager->dbByteSize ){
 		unsigned char *zMap = (unsigned char *)pPager->pMmap;
 		pPage->zData = &zMap[pPage->pgno * pPager->iPageSize];
 	}else{
 		/* Read content */
 		rc = unqliteOsRead(pPager->pfd,pPage->zData,pPager->iPageSize,pPage->pgno * pPager->iPageSize);
 	}
+	pPager->sStats.nPageRead++;
 	return rc;
 }
 /*
@@ -56214,6 +61338,7 @@ static int pager_play_back_one_page(Pager *pPager,sxi64 *pOfft,unsigned char *zT
 	/* playback */
 	rc = unqliteOsWrite(pPager->pfd,zData,pPager->iPageSize,iNum * pPager->iPageSize);
 	if( rc == UNQLITE_OK ){
+		pPager->sStats.nPageWrite++;
 		/* Flush the cache */
 		pager_fill_page(pPager,iNum,zData);
 	}
@@ -56309,7 +61434,7 @@ end_playback:
 	SyMemBackendFree(pPager->pAllocator,(void *)zTmp);
 	if( rc == UNQLITE_OK ){
 		/* Sync the database file */
-		unqliteOsSync(pPager->pfd,UNQLITE_SYNC_FULL);
+		pager_sync(pPager,pPager->pfd,UNQLITE_SYNC_FULL);
 	}
 	if( rc == UNQLITE_DONE ){
 		rc = UNQLITE_OK;
@@ -56500,7 +61625,7 @@ static int pager_journal_rollback(Pager *pPager,int check_hot)
 		goto fail;
 	}
 	/* Sync the journal file */
-	unqliteOsSync(pPager->pjfd,UNQLITE_SYNC_NORMAL);
+	pager_sync(pPager,pPager->pjfd,UNQLITE_SYNC_NORMAL);
 	/* Finally rollback the database */
 	rc = pager_playback(pPager);
 	/* Switch back to shared lock */
@@ -56515,6 +61640,533 @@ fail:
 	}
 	return rc;
 }
+/*
+** Write-ahead log (UNQLITE_OPEN_WAL).
+**
+** When operating in WAL mode, committed pages are not written back to the
+** database file. Instead, they are appended to the write-ahead log as
+** frames and the log is synced once per commit. The database file is left
+** untouched until a checkpoint transfer the latest version of each logged
+** page back into it.
+**
+** The log starts with a 16 byte header:
+**
+**   4 bytes: Magic number (WAL_MAGIC)
+**   4 bytes: Page size
+**   4 bytes: Salt of the current log generation
+**   4 bytes: Reserved for future use
+**
+** Followed by zero or more frames, each holding a full page:
+**
+**   8 bytes: Page number
+**   8 bytes: Database size in pages for a commit frame, zero otherwise
+**   4 bytes: Salt copied from the log header
+**   4 bytes: Checksum of the frame header and the page content
+**   N bytes: Page content
+**
+** A transaction is committed when its last frame (the commit frame) reach
+** the disk. On recovery, the log is scanned from the start and stops at the
+** first invalid frame, trailing frames not followed by a valid commit frame
+** are ignored. Frames left over from a previous log generation are rejected
+** by their salt.
+**
+** Readers consult the in-memory log index (page number to latest frame offset)
+** before falling back to the database file. The index is private to each
+** connection and is rebuilt from the log when the database is opened.
+** Since the writer needs only a RESERVED lock, readers holding a SHARED lock
+** are never blocked behind it. A connection that detect a commit made by another
+** connection since its snapshot was taken refuse to write until the transaction
+** is rolled back, which refresh the snapshot.
+**
+** A checkpoint need an EXCLUSIVE lock and is attempted without waiting after a
+** commit grow the log past the auto-checkpoint threshold, and when the database
+** is closed. If the lock cannot be obtained, the checkpoint is retried later.
+*/
+#define WAL_MAGIC          0xA7D3E5C1
+#define WAL_HEADER_SZ      16
+#define WAL_FRAME_HDR_SZ   24
+#define WAL_AUTOCHECKPOINT 1000 /* Default auto-checkpoint threshold in frames */
+/*
+ * Compute the checksum of a single frame.
+ */
+static sxu32 pager_wal_cksum(sxu32 iSalt,const unsigned char *zFrame,int iPageSize)
+{
+	const unsigned char *zEnd;
+	sxu32 s1 = iSalt;
+	sxu32 s2 = 0;
+	/* Frame header minus the checksum field */
+	for( zEnd = &zFrame[20] ; zFrame < zEnd ; zFrame++ ){
+		s1 += zFrame[0];
+		s2 += s1;
+	}
+	/* Page content */
+	zFrame += WAL_FRAME_HDR_SZ - 20;
+	for( zEnd = &zFrame[iPageSize] ; zFrame < zEnd ; zFrame++ ){
+		s1 += zFrame[0];
+		s2 += s1;
+	}
+	return s1 ^ (s2 << 16 | s2 >> 16);
+}
+/*
+ * Return the frame buffer, allocate it if not yet done.
+ */
+static unsigned char * pager_wal_buffer(Pager *pPager)
+{
+	if( pPager->zWalFrame == 0 ){
+		pPager->zWalFrame = (unsigned char *)SyMemBackendAlloc(pPager->pAllocator,(sxu32)(WAL_FRAME_HDR_SZ + pPager->iPageSize));
+		if( pPager->zWalFrame == 0 ){
+			unqliteGenOutofMem(pPager->pDb);
+		}
+	}
+	return pPager->zWalFrame;
+}
+/*
+ * Lookup a page in the write-ahead log index.
+ */
+static WalEntry * pager_wal_lookup(Pager *pPager,pgno iPage)
+{
+	WalEntry *pEntry;
+	if( pPager->nWalEntry < 1 ){
+		/* Don't bother hashing */
+		return 0;
+	}
+	pEntry = pPager->apWal[PAGE_HASH(iPage) & (pPager->nWalSize - 1)];
+	for(;;){
+		if( pEntry == 0 ){
+			break;
+		}
+		if( pEntry->iPage == iPage ){
+			return pEntry;
+		}
+		/* Point to the next entry in the colission chain */
+		pEntry = pEntry->pNext;
+	}
+	/* No such page */
+	return 0;
+}
+/*
+ * Map a page number to a frame offset in the write-ahead log index.
+ */
+static int pager_wal_insert(Pager *pPager,pgno iPage,sxi64 iOfft)
+{
+	WalEntry *pEntry;
+	sxu32 iBucket;
+	pEntry = pager_wal_lookup(pPager,iPage);
+	if( pEntry ){
+		/* Newer frame */
+		pEntry->iOfft = iOfft;
+		return UNQLITE_OK;
+	}
+	if( pPager->apWal == 0 || pPager->nWalEntry >= pPager->nWalSize * 2 ){
+		sxu32 nNew = pPager->nWalSize > 0 ? pPager->nWalSize << 1 : 128;
+		WalEntry **apNew,*pNext;
+		sxu32 n;
+		/* Grow the index */
+		apNew = (WalEntry **)SyMemBackendAlloc(pPager->pAllocator,nNew * sizeof(WalEntry *));
+		if( apNew == 0 ){
+			if( pPager->apWal == 0 ){
+				unqliteGenOutofMem(pPager->pDb);
+				return UNQLITE_NOMEM;
+			}
+			/* Not so fatal, longer collision chains */
+		}else{
+			SyZero(apNew,nNew * sizeof(WalEntry *));
+			/* Rehash */
+			for( n = 0 ; n < pPager->nWalSize ; ++n ){
+				pEntry = pPager->apWal[n];
+				while( pEntry ){
+					pNext = pEntry->pNext;
+					iBucket = PAGE_HASH(pEntry->iPage) & (nNew - 1);
+					pEntry->pNext = apNew[iBucket];
+					apNew[iBucket] = pEntry;
+					pEntry = pNext;
+				}
+			}
+			if( pPager->apWal ){
+				SyMemBackendFree(pPager->pAllocator,pPager->apWal);
+			}
+			pPager->apWal = apNew;
+			pPager->nWalSize = nNew;
+		}
+	}
+	pEntry = (WalEntry *)SyMemBackendPoolAlloc(pPager->pAllocator,sizeof(WalEntry));
+	if( pEntry == 0 ){
+		unqliteGenOutofMem(pPager->pDb);
+		return UNQLITE_NOMEM;
+	}
+	pEntry->iPage = iPage;
+	pEntry->iOfft = iOfft;
+	iBucket = PAGE_HASH(iPage) & (pPager->nWalSize - 1);
+	pEntry->pNext = pPager->apWal[iBucket];
+	pPager->apWal[iBucket] = pEntry;
+	pPager->nWalEntry++;
+	return UNQLITE_OK;
+}
+/*
+ * Discard the write-ahead log index. Release the bucket array too
+ * if bRelease is TRUE.
+ */
+static void pager_wal_reset_index(Pager *pPager,int bRelease)
+{
+	WalEntry *pEntry,*pNext;
+	sxu32 n;
+	for( n = 0 ; n < pPager->nWalSize ; ++n ){
+		pEntry = pPager->apWal[n];
+		while( pEntry ){
+			pNext = pEntry->pNext;
+			SyMemBackendPoolFree(pPager->pAllocator,pEntry);
+			pEntry = pNext;
+		}
+		pPager->apWal[n] = 0;
+	}
+	if( bRelease && pPager->apWal ){
+		SyMemBackendFree(pPager->pAllocator,pPager->apWal);
+		pPager->apWal = 0;
+		pPager->nWalSize = 0;
+	}
+	pPager->nWalEntry = 0;
+	pPager->nWalFrame = 0;
+	pPager->iWalDbSize = 0;
+}
+/*
+ * Read the logged content of a page. Return SXERR_NOTFOUND if the page
+ * is not in the write-ahead log.
+ */
+static int pager_wal_read(Pager *pPager,pgno iPage,void *pBuf,int nByte)
+{
+	WalEntry *pEntry;
+	pEntry = pager_wal_lookup(pPager,iPage);
+	if( pEntry == 0 || pEntry->iOfft < 0 ){
+		return SXERR_NOTFOUND;
+	}
+	return unqliteOsRead(pPager->pwfd,pBuf,nByte,pEntry->iOfft + WAL_FRAME_HDR_SZ);
+}
+/*
+ * Scan the write-ahead log starting from the last known commit frame and
+ * register each newly committed frame in the log index.
+ */
+static int pager_wal_recover(Pager *pPager)
+{
+	unsigned char zHeader[WAL_HEADER_SZ];
+	unsigned char *zFrame;
+	sxi64 iOfft,nSize = 0;
+	int iPageSize,nFrame;
+	sxu32 iSalt,nPending;
+	SySet sPending;
+	WalEntry sEntry;
+	int rc;
+	rc = unqliteOsFileSize(pPager->pwfd,&nSize);
+	if( rc != UNQLITE_OK ){
+		unqliteGenErrorFormat(pPager->pDb,"IO error while reading write-ahead log: %s",pPager->zWal);
+		return rc;
+	}
+	pPager->iWalEnd = nSize;
+	iPageSize = pPager->iPageSize;
+	iSalt = pPager->iWalSalt;
+	iOfft = pPager->iWalOfft;
+	if( iOfft < WAL_HEADER_SZ ){
+		sxu32 iMagic,iSize;
+		/* Fresh scan, validate the log header first */
+		if( nSize < WAL_HEADER_SZ + WAL_FRAME_HDR_SZ + UNQLITE_MIN_PAGE_SIZE ){
+			/* Empty log */
+			return UNQLITE_OK;
+		}
+		rc = unqliteOsRead(pPager->pwfd,zHeader,sizeof(zHeader),0);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		SyBigEndianUnpack32(zHeader,&iMagic);
+		SyBigEndianUnpack32(&zHeader[4],&iSize);
+		SyBigEndianUnpack32(&zHeader[8],&iSalt);
+		if( iMagic != WAL_MAGIC || iSize < UNQLITE_MIN_PAGE_SIZE || iSize > UNQLITE_MAX_PAGE_SIZE ){
+			/* Not a valid log, it will be overwritten by the next commit */
+			return UNQLITE_OK;
+		}
+		iPageSize = (int)iSize;
+		iOfft = WAL_HEADER_SZ;
+	}
+	nFrame = WAL_FRAME_HDR_SZ + iPageSize;
+	zFrame = (unsigned char *)SyMemBackendAlloc(pPager->pAllocator,(sxu32)nFrame);
+	if( zFrame == 0 ){
+		unqliteGenOutofMem(pPager->pDb);
+		return UNQLITE_NOMEM;
+	}
+	SySetInit(&sPending,pPager->pAllocator,sizeof(WalEntry));
+	sEntry.pNext = 0;
+	while( iOfft + nFrame <= nSize ){
+		sxu64 iPage,nCommit;
+		sxu32 iFrameSalt,cksum;
+		rc = unqliteOsRead(pPager->pwfd,zFrame,nFrame,iOfft);
+		if( rc != UNQLITE_OK ){
+			break;
+		}
+		SyBigEndianUnpack64(zFrame,&iPage);
+		SyBigEndianUnpack64(&zFrame[8],&nCommit);
+		SyBigEndianUnpack32(&zFrame[16],&iFrameSalt);
+		SyBigEndianUnpack32(&zFrame[20],&cksum);
+		if( iFrameSalt != iSalt || cksum != pager_wal_cksum(iSalt,zFrame,iPageSize) ){
+			/* Torn or stale frame, end of the log */
+			break;
+		}
+		sEntry.iPage = (pgno)iPage;
+		sEntry.iOfft = iOfft;
+		if( SXRET_OK != SySetPut(&sPending,(const void *)&sEntry) ){
+			rc = UNQLITE_NOMEM;
+			break;
+		}
+		iOfft += nFrame;
+		if( nCommit > 0 ){
+			WalEntry *aPending = (WalEntry *)SySetBasePtr(&sPending);
+			/* Commit frame, the whole transaction is valid */
+			for( nPending = 0 ; nPending < SySetUsed(&sPending) ; ++nPending ){
+				rc = pager_wal_insert(pPager,aPending[nPending].iPage,aPending[nPending].iOfft);
+				if( rc != UNQLITE_OK ){
+					break;
+				}
+			}
+			if( rc != UNQLITE_OK ){
+				break;
+			}
+			pPager->nWalFrame += SySetUsed(&sPending);
+			SySetReset(&sPending);
+			pPager->iWalOfft = iOfft;
+			pPager->iWalSalt = iSalt;
+			pPager->iWalDbSize = (pgno)nCommit;
+			pPager->iPageSize = iPageSize;
+		}
+	}
+	SySetRelease(&sPending);
+	SyMemBackendFree(pPager->pAllocator,zFrame);
+	if( rc == UNQLITE_IOERR ){
+		/* Short read of a trailing frame, not an error */
+		rc = UNQLITE_OK;
+	}
+	return rc;
+}
+/*
+ * Return TRUE if another connection appended to the write-ahead log
+ * since this connection last read or wrote it.
+ */
+static int pager_wal_changed(Pager *pPager)
+{
+	sxi64 nSize = 0;
+	if( unqliteOsFileSize(pPager->pwfd,&nSize) != UNQLITE_OK ){
+		return FALSE;
+	}
+	return nSize > pPager->iWalEnd;
+}
+/*
+ * Open the write-ahead log. If the pager is not operating in WAL mode but
+ * a non-empty log is found (left by a connection operating in WAL mode),
+ * switch to WAL mode so that the logged transactions are honoured.
+ */
+static int pager_wal_open(Pager *pPager)
+{
+	int rc;
+	if( pPager->is_mem || pPager->pwfd ){
+		return UNQLITE_OK;
+	}
+	if( !pPager->is_wal || pPager->is_rdonly ){
+		int iExists = 0;
+		rc = unqliteOsAccess(pPager->pVfs,pPager->zWal,UNQLITE_ACCESS_EXISTS,&iExists);
+		if( rc != UNQLITE_OK || !iExists ){
+			/* Nothing to read, read-only handles do not create the log */
+			pPager->is_wal = 0;
+			return UNQLITE_OK;
+		}
+	}
+	rc = unqliteOsOpen(pPager->pVfs,pPager->pAllocator,pPager->zWal,&pPager->pwfd,
+		pPager->is_rdonly ? UNQLITE_OPEN_READONLY : UNQLITE_OPEN_CREATE|UNQLITE_OPEN_READWRITE);
+	if( rc != UNQLITE_OK ){
+		unqliteGenErrorFormat(pPager->pDb,"IO error while opening write-ahead log: %s",pPager->zWal);
+		pPager->pwfd = 0;
+		return rc;
+	}
+	pPager->is_wal = 1;
+	/* The rollback journal is not used in WAL mode */
+	pPager->no_jrnl = 1;
+	/* Build the log index */
+	rc = pager_wal_recover(pPager);
+	return rc;
+}
+/*
+ * Append the dirty pages to the write-ahead log and sync the log.
+ * This replace the journal based commit when operating in WAL mode.
+ * Note that pages marked PAGE_DONT_WRITE are logged anyway since the
+ * database file may not hold them yet.
+ */
+static int pager_wal_commit(Pager *pPager)
+{
+	unsigned char *zFrame;
+	Page *pDirty,*pPtr,*pNext;
+	sxi64 iOfft;
+	sxu32 nFrame,n;
+	int rc = UNQLITE_OK;
+	zFrame = pager_wal_buffer(pPager);
+	if( zFrame == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	/* Get the dirty pages */
+	pDirty = pager_get_dirty_pages(pPager);
+	nFrame = 0;
+	for( pPtr = pDirty ; pPtr ; pPtr = pPtr->pDirtyPrev ){
+		/* Reserve the index entry now so that publishing the frames cannot fail */
+		if( pager_wal_lookup(pPager,pPtr->pgno) == 0 ){
+			rc = pager_wal_insert(pPager,pPtr->pgno,-1);
+			if( rc != UNQLITE_OK ){
+				goto fail;
+			}
+		}
+		nFrame++;
+	}
+	if( nFrame < 1 ){
+		return UNQLITE_OK;
+	}
+	if( pPager->iWalOfft < WAL_HEADER_SZ ){
+		unsigned char zHeader[WAL_HEADER_SZ];
+		/* Start a new log generation */
+		SyRandomness(&pPager->sPrng,(void *)&pPager->iWalSalt,sizeof(sxu32));
+		SyBigEndianPack32(zHeader,WAL_MAGIC);
+		SyBigEndianPack32(&zHeader[4],(sxu32)pPager->iPageSize);
+		SyBigEndianPack32(&zHeader[8],pPager->iWalSalt);
+		SyBigEndianPack32(&zHeader[12],0);
+		rc = unqliteOsWrite(pPager->pwfd,zHeader,sizeof(zHeader),0);
+		if( rc != UNQLITE_OK ){
+			goto fail;
+		}
+		pPager->iWalOfft = WAL_HEADER_SZ;
+	}
+	/* Append the frames, the last one is the commit frame */
+	iOfft = pPager->iWalOfft;
+	n = 0;
+	for( pPtr = pDirty ; pPtr ; pPtr = pPtr->pDirtyPrev ){
+		n++;
+		SyBigEndianPack64(zFrame,pPtr->pgno);
+		SyBigEndianPack64(&zFrame[8],n == nFrame ? pPager->dbSize : 0);
+		SyBigEndianPack32(&zFrame[16],pPager->iWalSalt);
+		SyMemcpy(pPtr->zData,&zFrame[WAL_FRAME_HDR_SZ],(sxu32)pPager->iPageSize);
+		SyBigEndianPack32(&zFrame[20],pager_wal_cksum(pPager->iWalSalt,zFrame,pPager->iPageSize));
+		rc = unqliteOsWrite(pPager->pwfd,zFrame,WAL_FRAME_HDR_SZ + pPager->iPageSize,iOfft);
+		if( rc != UNQLITE_OK ){
+			goto fail;
+		}
+		pPager->sStats.nPageWrite++;
+		iOfft += WAL_FRAME_HDR_SZ + pPager->iPageSize;
+	}
+	/* A single sequential sync make the transaction durable */
+	rc = pager_sync(pPager,pPager->pwfd,UNQLITE_SYNC_NORMAL);
+	if( rc != UNQLITE_OK ){
+		goto fail;
+	}
+	/* Publish the new frames */
+	iOfft = pPager->iWalOfft;
+	for( pPtr = pDirty ; pPtr ; pPtr = pNext ){
+		pNext = pPtr->pDirtyPrev; /* Not a bug: Reverse link */
+		pager_wal_lookup(pPager,pPtr->pgno)->iOfft = iOfft;
+		iOfft += WAL_FRAME_HDR_SZ + pPager->iPageSize;
+		/* Remove stale flags */
+		pPtr->flags &= ~(PAGE_DIRTY|PAGE_DONT_WRITE|PAGE_NEED_SYNC|PAGE_IN_JOURNAL|PAGE_HOT_DIRTY);
+		if( pPtr->nRef < 1 ){
+			/* The page is now clean and unused, move it to the page cache */
+			pager_cache_park(pPager,pPtr);
+		}
+	}
+	pPager->pDirty = pPager->pFirstDirty = 0;
+	pPager->pHotDirty = pPager->pFirstHot = 0;
+	pPager->nHot = 0;
+	pPager->nWalFrame += nFrame;
+	pPager->iWalOfft = iOfft;
+	pPager->iWalDbSize = pPager->dbSize;
+	if( iOfft > pPager->iWalEnd ){
+		pPager->iWalEnd = iOfft;
+	}
+	return UNQLITE_OK;
+fail:
+	/* Rollback your DB */
+	pPager->iFlags |= PAGER_CTRL_COMMIT_ERR;
+	pPager->pFirstDirty = pDirty;
+	unqliteGenError(pPager->pDb,"IO error while writing the write-ahead log, rollback your database");
+	return rc;
+}
+/*
+ * Transfer the content of the write-ahead log to the database file and
+ * restart the log. An EXCLUSIVE lock is required, UNQLITE_BUSY is returned
+ * without waiting if it cannot be obtained.
+ * If bClose is TRUE, the log file is closed and deleted while the lock is still held.
+ */
+static int pager_wal_checkpoint(Pager *pPager,int bClose)
+{
+	unsigned char *zFrame;
+	WalEntry *pEntry;
+	sxu32 n;
+	int rc;
+	if( pPager->pwfd == 0 || pPager->is_rdonly ){
+		return UNQLITE_OK;
+	}
+	if( pPager->iState != PAGER_READER ){
+		/* A write transaction is active */
+		return UNQLITE_LOCKED;
+	}
+	zFrame = pager_wal_buffer(pPager);
+	if( zFrame == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	/* No reader may depend on the log while it is transferred */
+	rc = unqliteOsLock(pPager->pfd,EXCLUSIVE_LOCK);
+	if( rc != UNQLITE_OK ){
+		/* Drop any pending lock obtained on the way */
+		unqliteOsUnlock(pPager->pfd,SHARED_LOCK);
+		return UNQLITE_BUSY;
+	}
+	pPager->iLock = EXCLUSIVE_LOCK;
+	if( pager_wal_changed(pPager) ){
+		/* The log hold transactions this connection does not know about yet.
+		 * Refuse to checkpoint until the snapshot is refreshed.
+		 */
+		pPager->iFlags |= PAGER_CTRL_WAL_STALE;
+		rc = UNQLITE_BUSY;
+		goto done;
+	}
+	if( pPager->nWalFrame > 0 ){
+		/* Copy the latest version of each logged page */
+		for( n = 0 ; n < pPager->nWalSize ; ++n ){
+			for( pEntry = pPager->apWal[n] ; pEntry ; pEntry = pEntry->pNext ){
+				if( pEntry->iOfft < 0 || pEntry->iPage >= pPager->iWalDbSize ){
+					continue;
+				}
+				rc = unqliteOsRead(pPager->pwfd,zFrame,pPager->iPageSize,pEntry->iOfft + WAL_FRAME_HDR_SZ);
+				if( rc == UNQLITE_OK ){
+					rc = unqliteOsWrite(pPager->pfd,zFrame,pPager->iPageSize,pEntry->iPage * pPager->iPageSize);
+					pPager->sStats.nPageWrite++;
+				}
+				if( rc != UNQLITE_OK ){
+					unqliteGenError(pPager->pDb,"IO error while checkpointing the write-ahead log");
+					goto done;
+				}
+			}
+		}
+		unqliteOsTruncate(pPager->pfd,pPager->iPageSize * pPager->iWalDbSize);
+		rc = pager_sync(pPager,pPager->pfd,UNQLITE_SYNC_FULL);
+		if( rc != UNQLITE_OK ){
+			goto done;
+		}
+	}
+	/* The database file is durable, restart the log. The header is
+	 * rewritten with a fresh salt by the next commit.
+	 */
+	pager_wal_reset_index(pPager,FALSE);
+	unqliteOsTruncate(pPager->pwfd,0);
+	pPager->iWalOfft = pPager->iWalEnd = 0;
+	if( bClose ){
+		unqliteOsCloseFree(pPager->pAllocator,pPager->pwfd);
+		pPager->pwfd = 0;
+		unqliteOsDelete(pPager->pVfs,pPager->zWal,0);
+	}
+done:
+	/* Switch back to shared lock */
+	pager_unlock_db(pPager,SHARED_LOCK);
+	return rc;
+}
 /*
  * Write the unqlite header (First page). (Big-Endian)
  */
@@ -56603,6 +62255,10 @@ static int pager_extract_header(Pager *pPager,const unsigned char *zRaw,sxu32 nB
 	if( nLen > (sxu16)(zEnd - zRaw) ){
 		nLen = (sxu16)(zEnd - zRaw);
 	}
+	if( pPager->sKv.nByte == nLen && SyMemcmp(pPager->sKv.zString,zRaw,nLen) == 0 ){
+		/* Header read again after the lock was released */
+		return UNQLITE_OK;
+	}
 	zKv = (char *)SyMemBackendDup(pPager->pAllocator,(const char *)zRaw,nLen);
 	if( zKv == 0 ){
 		return UNQLITE_NOMEM;
@@ -56624,6 +62280,10 @@ static int pager_read_db_header(Pager *pPager)
 		return rc;
 	}
 	pPager->dbByteSize = n;
+	if( pPager->iWalDbSize > 0 ){
+		/* Committed pages are held in the write-ahead log */
+		n = (sxi64)pPager->iWalDbSize * pPager->iPageSize;
+	}
 	if( n > 0 ){
 		unqlite_kv_methods *pMethods;
 		SyString *pKv;
@@ -56634,7 +62294,10 @@ static int pager_read_db_header(Pager *pPager)
 			return UNQLITE_CORRUPT;
 		}
 		/* Read the database header */
-		rc = unqliteOsRead(pPager->pfd,zRaw,sizeof(zRaw),0);
+		rc = pager_wal_read(pPager,0,zRaw,(int)sizeof(zRaw));
+		if( rc == SXERR_NOTFOUND ){
+			rc = unqliteOsRead(pPager->pfd,zRaw,sizeof(zRaw),0);
+		}
 		if( rc != UNQLITE_OK ){
 			unqliteGenError(pPager->pDb,"IO error while reading database header");
 			return rc;
@@ -56650,6 +62313,10 @@ static int pager_read_db_header(Pager *pPager)
 		if( nPage==0 && n>0 ){
 			nPage = 1;
 		}
+		if( pPager->iWalDbSize > 0 ){
+			/* Size recorded by the last commit frame */
+			nPage = pPager->iWalDbSize;
+		}
 		pPager->dbSize = nPage;
 		/* Laod the target Key/Value storage engine */
 		pKv = &pPager->sKv;
@@ -56670,6 +62337,10 @@ static int pager_read_db_header(Pager *pPager)
 		SyStringInitFromBuf(&pPager->sKv,pPager->pEngine->pIo->pMethods->zName,SyStrlen(pPager->pEngine->pIo->pMethods->zName));
 		pPager->dbSize = 0;
 	}
+	if( pPager->zTmpPage ){
+		/* Header read again after the lock was released */
+		return UNQLITE_OK;
+	}
 	/* Allocate a temporary page size */
 	pPager->zTmpPage = (unsigned char *)SyMemBackendAlloc(pPager->pAllocator,(sxu32)pPager->iPageSize);
 	if( pPager->zTmpPage == 0 ){
@@ -56723,13 +62394,15 @@ static int pager_shared_lock(Pager *pPager)
 	int rc = UNQLITE_OK;
 	if( pPager->iState == PAGER_OPEN ){
 		unqlite_kv_methods *pMethods;
-		/* Open the target database */
-		rc = unqliteOsOpen(pPager->pVfs,pPager->pAllocator,pPager->zFilename,&pPager->pfd,pPager->iOpenFlags);
-		if( rc != UNQLITE_OK ){
-			unqliteGenErrorFormat(pPager->pDb,
-				"IO error while opening the target database file: %s",pPager->zFilename
-				);
-			return rc;
+		if( pPager->pfd == 0 ){
+			/* Open the target database, it stays open when the lock is released */
+			rc = unqliteOsOpen(pPager->pVfs,pPager->pAllocator,pPager->zFilename,&pPager->pfd,pPager->iOpenFlags);
+			if( rc != UNQLITE_OK ){
+				unqliteGenErrorFormat(pPager->pDb,
+					"IO error while opening the target database file: %s",pPager->zFilename
+					);
+				return rc;
+			}
 		}
 		/* Try to obtain a shared lock */
 		rc = pager_wait_on_lock(pPager,SHARED_LOCK);
@@ -56741,6 +62414,11 @@ static int pager_shared_lock(Pager *pPager)
 					return rc;
 				}
 			}
+			/* Open the write-ahead log and build its index if any */
+			rc = pager_wal_open(pPager);
+			if( rc != UNQLITE_OK ){
+				return rc;
+			}
 			/* Read the database header */
 			rc = pager_read_db_header(pPager);
 			if( rc != UNQLITE_OK ){
@@ -56765,6 +62443,10 @@ static int pager_shared_lock(Pager *pPager)
 					}
 				}
 			}
+			if( pPager->iOpenFlags & UNQLITE_OPEN_SHARED_CACHE ){
+				/* Share clean pages with the other handles opened on this file */
+				pager_shared_attach(pPager);
+			}
 			/* Update the pager state */
 			pPager->iState = PAGER_READER;
 			/* Invoke the xOpen methods if available */
@@ -56791,7 +62473,7 @@ static int pager_shared_lock(Pager *pPager)
 ** Begin a write-transaction on the specified pager object. If a 
 ** write-transaction has already been opened, this function is a no-op.
 */
-UNQLITE_PRIVATE int unqlitePagerBegin(Pager *pPager)
+static int pager_begin(Pager *pPager)
 {
 	int rc;
 	/* Obtain a shared lock on the database first */
@@ -56810,6 +62492,13 @@ UNQLITE_PRIVATE int unqlitePagerBegin(Pager *pPager)
 	/* Obtain a reserved lock on the database */
 	rc = pager_wait_on_lock(pPager,RESERVED_LOCK);
 	if( rc == UNQLITE_OK ){
+		if( pPager->is_wal && pager_wal_changed(pPager) ){
+			/* Another connection committed to the log since our snapshot was taken */
+			pPager->iFlags |= PAGER_CTRL_WAL_STALE;
+			unqliteGenError(pPager->pDb,"Database modified by another connection, rollback to refresh your snapshot");
+			rc = UNQLITE_BUSY;
+			goto fail;
+		}
 		/* Create the bitvec */
 		pPager->pVec = unqliteBitvecCreate(pPager->pAllocator,pPager->dbSize);
 		if( pPager->pVec == 0 ){
@@ -56839,6 +62528,25 @@ fail:
 	pager_unlock_db(pPager,SHARED_LOCK);
 	return rc;
 }
+/*
+ * Refer to [pager_begin()].
+ */
+UNQLITE_PRIVATE int unqlitePagerBegin(Pager *pPager)
+{
+	int rc;
+	PAGER_READ_ENTER(pPager);
+	rc = pager_begin(pPager);
+	PAGER_READ_LEAVE(pPager);
+	return rc;
+}
+/*
+ * Return TRUE if a write-transaction is open on the given pager.
+ * In-memory databases do not support transactions.
+ */
+UNQLITE_PRIVATE int unqlitePagerInWriteTransaction(Pager *pPager)
+{
+	return !pPager->is_mem && pPager->iState >= PAGER_WRITER_LOCKED;
+}
 /*
 ** This function is called at the start of every write transaction.
 ** There must already be a RESERVED or EXCLUSIVE lock on the database 
@@ -56877,6 +62585,7 @@ static int unqliteOpenJournal(Pager *pPager)
 	rc = unqliteOsWrite(pPager->pjfd,zHeader,pPager->iSectorSize,0);
 	/* Offset to start writing from */
 	pPager->iJournalOfft = pPager->iSectorSize;
+	pPager->sStats.nJournalByte += pPager->iSectorSize;
 	/* All done, journal will be synced later */
 	SyMemBackendFree(pPager->pAllocator,zHeader);
 finish:
@@ -56891,6 +62600,23 @@ fail:
 	pPager->pjfd = 0;
 	return rc;
 }
+/*
+ * Write the journal records buffered by page_write() with a single write.
+ * This must be done before the journal is synced, so before the database
+ * file is modified.
+ */
+static int pager_journal_flush(Pager *pPager)
+{
+	int rc;
+	if( pPager->nJournalBuf < 1 ){
+		return UNQLITE_OK;
+	}
+	rc = unqliteOsWrite(pPager->pjfd,pPager->zJournalBuf,pPager->nJournalBuf,pPager->iJournalBufOfft);
+	if( rc == UNQLITE_OK ){
+		pPager->nJournalBuf = 0;
+	}
+	return rc;
+}
 /*
 ** Sync the journal. In other words, make sure all the pages that have
 ** been written to the journal have actually reached the surface of the
@@ -56913,6 +62639,11 @@ static int unqliteFinalizeJournal(Pager *pPager,int *pRetry,int close_jrnl)
 		/* Journaling is omitted, return immediately */
 		return UNQLITE_OK;
 	}
+	/* Write the buffered journal records */
+	rc = pager_journal_flush(pPager);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
 	/* Write the total number of database records */
 	rc = WriteInt32(pPager->pjfd,pPager->nRec,8 /* sizeof(aJournalRec) */);
 	if( rc != UNQLITE_OK ){
@@ -56924,7 +62655,7 @@ static int unqliteFinalizeJournal(Pager *pPager,int *pRetry,int close_jrnl)
 		}
 	}
 	/* Sync the journal and close it */
-	rc = unqliteOsSync(pPager->pjfd,UNQLITE_SYNC_NORMAL);
+	rc = pager_sync(pPager,pPager->pjfd,UNQLITE_SYNC_NORMAL);
 	if( close_jrnl ){
 		/* close the journal file */
 		if( UNQLITE_OK != unqliteOsCloseFree(pPager->pAllocator,pPager->pjfd) ){
@@ -56952,25 +62683,47 @@ static int page_write(Pager *pPager,Page *pPage)
 	if( !pPager->is_mem && !pPager->no_jrnl ){
 		/* Write the page to the transaction journal */
 		if( pPage->pgno < pPager->dbOrigSize && !unqliteBitvecTest(pPager->pVec,pPage->pgno) ){
+			sxu32 nRecSize = 8 /* page num */ + (sxu32)pPager->iPageSize + 4 /* cksum */;
+			unsigned char *zRec;
 			sxu32 cksum;
 			if( pPager->nRec == SXU32_HIGH ){
 				/* Journal Limit reached */
 				unqliteGenError(pPager->pDb,"Journal record limit reached, commit your changes");
 				return UNQLITE_LIMIT;
 			}
-			/* Write the page number */
-			rc = WriteInt64(pPager->pjfd,pPage->pgno,pPager->iJournalOfft);
-			if( rc != UNQLITE_OK ){ return rc; }
-			/* Write the raw page */
+			if( pPager->zJournalBuf == 0 ){
+				/* Records are buffered and written in batches */
+				pPager->nJournalBufMax = (PAGER_JOURNAL_BUFFER / nRecSize) * nRecSize;
+				if( pPager->nJournalBufMax < nRecSize ){
+					pPager->nJournalBufMax = nRecSize;
+				}
+				pPager->zJournalBuf = (unsigned char *)SyMemBackendAlloc(pPager->pAllocator,pPager->nJournalBufMax);
+				if( pPager->zJournalBuf == 0 ){
+					unqliteGenOutofMem(pPager->pDb);
+					return UNQLITE_NOMEM;
+				}
+			}
+			if( pPager->nJournalBuf + nRecSize > pPager->nJournalBufMax ){
+				/* Make room */
+				rc = pager_journal_flush(pPager);
+				if( rc != UNQLITE_OK ){ return rc; }
+			}
+			if( pPager->nJournalBuf < 1 ){
+				pPager->iJournalBufOfft = pPager->iJournalOfft;
+			}
+			zRec = &pPager->zJournalBuf[pPager->nJournalBuf];
+			/* The page number */
+			SyBigEndianPack64(zRec,pPage->pgno);
+			/* The raw page */
 			/** CODEC */
-			rc = unqliteOsWrite(pPager->pjfd,pPage->zData,pPager->iPageSize,pPager->iJournalOfft + 8);
-			if( rc != UNQLITE_OK ){ return rc; }
-			/* Compute the checksum */
+			SyMemcpy((const void *)pPage->zData,(void *)&zRec[8],(sxu32)pPager->iPageSize);
+			/* The checksum */
 			cksum = pager_cksum(pPager,pPage->zData);
-			rc = WriteInt32(pPager->pjfd,cksum,pPager->iJournalOfft + 8 + pPager->iPageSize);
-			if( rc != UNQLITE_OK ){ return rc; }
+			SyBigEndianPack32(&zRec[8 + pPager->iPageSize],cksum);
+			pPager->nJournalBuf += nRecSize;
 			/* Update the journal offset */
-			pPager->iJournalOfft += 8 /* page num */ + pPager->iPageSize + 4 /* cksum */;
+			pPager->iJournalOfft += nRecSize;
+			pPager->sStats.nJournalByte += nRecSize;
 			pPager->nRec++;
 			/* Mark as journalled  */
 			unqliteBitvecSet(pPager->pVec,pPage->pgno);
@@ -56988,6 +62741,44 @@ static int page_write(Pager *pPager,Page *pPage)
 	}	
 	return UNQLITE_OK;
 }
+/*
+ * Write a list of dirty pages sorted by page number (see pager_get_dirty_pages() and
+ * pager_get_hot_pages()) to the database file. Runs of consecutive pages are written
+ * with a single vectored write (see unqliteOsWritev()) instead of one write per page.
+ */
+static int pager_write_sorted_pages(Pager *pPager,Page *pList,int bHot)
+{
+	const void *apRun[PAGER_MAX_RUN];
+	pgno iFirst = 0;
+	int nRun = 0;
+	int rc = UNQLITE_OK;
+	for(;;){
+		if( pList && (pList->flags & PAGE_DONT_WRITE) ){
+			/* Skip this page */
+			pList = bHot ? pList->pPrevHot : pList->pDirtyPrev; /* Not a bug: Reverse link */
+			continue;
+		}
+		if( nRun > 0 && (pList == 0 || nRun >= PAGER_MAX_RUN || pList->pgno != iFirst + nRun) ){
+			/* End of the run, write it */
+			rc = unqliteOsWritev(pPager->pfd,apRun,nRun,pPager->iPageSize,iFirst * pPager->iPageSize);
+			if( rc != UNQLITE_OK ){
+				break;
+			}
+			pPager->sStats.nPageWrite += nRun;
+			nRun = 0;
+		}
+		if( pList == 0 ){
+			break;
+		}
+		if( nRun < 1 ){
+			iFirst = pList->pgno;
+		}
+		apRun[nRun++] = pList->zData;
+		/* Point to the next page */
+		pList = bHot ? pList->pPrevHot : pList->pDirtyPrev; /* Not a bug: Reverse link */
+	}
+	return rc;
+}
 /*
 ** The argument is the first in a linked list of dirty pages connected
 ** by the PgHdr.pDirty pointer. This function writes each one of the
@@ -57002,28 +62793,21 @@ static int page_write(Pager *pPager,Page *pPage)
 */
 static int pager_write_dirty_pages(Pager *pPager,Page *pDirty)
 {
-	int rc = UNQLITE_OK;
+	int rc;
 	Page *pNext;
+	/* Write the pages first */
+	rc = pager_write_sorted_pages(pPager,pDirty,FALSE);
 	for(;;){
-		if( pDirty == 0 ){
+		if( pDirty == 0 || rc != UNQLITE_OK /* A rollback should be done */ ){
 			break;
 		}
 		/* Point to the next dirty page */
 		pNext = pDirty->pDirtyPrev; /* Not a bug: Reverse link */
-		if( (pDirty->flags & PAGE_DONT_WRITE) == 0 ){
-			rc = unqliteOsWrite(pPager->pfd,pDirty->zData,pPager->iPageSize,pDirty->pgno * pPager->iPageSize);
-			if( rc != UNQLITE_OK ){
-				/* A rollback should be done */
-				break;
-			}
-		}
 		/* Remove stale flags */
 		pDirty->flags &= ~(PAGE_DIRTY|PAGE_DONT_WRITE|PAGE_NEED_SYNC|PAGE_IN_JOURNAL|PAGE_HOT_DIRTY);
 		if( pDirty->nRef < 1 ){
-			/* Unlink the page now it is unused */
-			pager_unlink_page(pPager,pDirty);
-			/* Release the page */
-			pager_release_page(pPager,pDirty);
+			/* The page is now clean and unused, move it to the page cache */
+			pager_cache_park(pPager,pDirty);
 		}
 		/* Point to the next page */
 		pDirty = pNext;
@@ -57047,20 +62831,20 @@ static int pager_write_dirty_pages(Pager *pPager,Page *pDirty)
 */
 static int pager_write_hot_dirty_pages(Pager *pPager,Page *pDirty)
 {
-	int rc = UNQLITE_OK;
+	int rc;
 	Page *pNext;
+	/* Write the pages first */
+	rc = pager_write_sorted_pages(pPager,pDirty,TRUE);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
 	for(;;){
 		if( pDirty == 0 ){
 			break;
 		}
 		/* Point to the next page */
 		pNext = pDirty->pPrevHot; /* Not a bug: Reverse link */
-		if( (pDirty->flags & PAGE_DONT_WRITE) == 0 ){
-			rc = unqliteOsWrite(pPager->pfd,pDirty->zData,pPager->iPageSize,pDirty->pgno * pPager->iPageSize);
-			if( rc != UNQLITE_OK ){
-				break;
-			}
-		}
+		pPager->sStats.nHotFlush++;
 		/* Remove stale flags */
 		pDirty->flags &= ~(PAGE_DIRTY|PAGE_DONT_WRITE|PAGE_NEED_SYNC|PAGE_IN_JOURNAL|PAGE_HOT_DIRTY);
 		/* Unlink from the list of dirty pages */
@@ -57074,10 +62858,10 @@ static int pager_write_hot_dirty_pages(Pager *pPager,Page *pDirty)
 		}else{
 			pPager->pFirstDirty = pDirty->pDirtyPrev;
 		}
-		/* Discard */
-		pager_unlink_page(pPager,pDirty);
-		/* Release the page */
-		pager_release_page(pPager,pDirty);
+		if( pDirty->nRef < 1 ){
+			/* Move to the page cache */
+			pager_cache_park(pPager,pDirty);
+		}
 		/* Next hot page */
 		pDirty = pNext;
 	}
@@ -57104,6 +62888,10 @@ static int pager_commit_phase1(Pager *pPager)
 		unqliteGenError(pPager->pDb,"Read-Only database");
 		return UNQLITE_READ_ONLY;
 	}
+	if( pPager->is_wal ){
+		/* Append the dirty pages to the write-ahead log */
+		return pager_wal_commit(pPager);
+	}
 	/* Finalize the journal file */
 	rc = unqliteFinalizeJournal(pPager,&get_excl,1);
 	if( rc != UNQLITE_OK ){
@@ -57121,7 +62909,7 @@ static int pager_commit_phase1(Pager *pPager)
 	}
 	if( pPager->iFlags & PAGER_CTRL_DIRTY_COMMIT ){
 		/* Synce the database first if a dirty commit have been applied */
-		unqliteOsSync(pPager->pfd,UNQLITE_SYNC_NORMAL);
+		pager_sync(pPager,pPager->pfd,UNQLITE_SYNC_NORMAL);
 	}
 	/* Write the dirty pages */
 	rc = pager_write_dirty_pages(pPager,pDirty);
@@ -57139,7 +62927,7 @@ static int pager_commit_phase1(Pager *pPager)
 		unqliteOsTruncate(pPager->pfd,pPager->iPageSize * pPager->dbSize);
 	}
 	/* Sync the database file */
-	unqliteOsSync(pPager->pfd,UNQLITE_SYNC_FULL);
+	pager_sync(pPager,pPager->pfd,UNQLITE_SYNC_FULL);
 	/* Remove stale flags */
 	pPager->iJournalOfft = 0;
 	pPager->nRec = 0;
@@ -57215,6 +63003,67 @@ static int pager_dirty_commit(Pager *pPager)
 	 */
 	return UNQLITE_OK;
 }
+/*
+ * Refresh the memory view of a read-write memory mapped database after the
+ * file grew (or shrunk) so that new pages are served from the view too.
+ * Pages pointing to the old view are moved to the new one.
+ */
+static void pager_mmap_refresh(Pager *pPager)
+{
+	const jx9_vfs *pVfs = jx9ExportBuiltinVfs();
+	unsigned char *zOld = (unsigned char *)pPager->pMmap;
+	sxi64 nOld = pPager->dbByteSize;
+	sxi64 nNew = 0;
+	void *pNew = 0;
+	sxi64 iOfft;
+	Page *pPage;
+	sxu32 n;
+	if( (pPager->iOpenFlags & UNQLITE_OPEN_MMAP) == 0 || pPager->is_rdonly || pPager->is_mem ){
+		return;
+	}
+	if( unqliteOsFileSize(pPager->pfd,&nNew) != UNQLITE_OK || nNew < 1 ||
+		(zOld && nNew == nOld) ){
+		/* Nothing to map or nothing changed */
+		return;
+	}
+	if( pVfs == 0 || pVfs->xMmap == 0 || pVfs->xMmap(pPager->zFilename,&pNew,&nNew) != JX9_OK ){
+		pNew = 0;
+		nNew = 0;
+		if( zOld == 0 ){
+			/* Keep reading through the pager */
+			return;
+		}
+		unqliteGenError(pPager->pDb,"Cannot refresh the memory view of the target database");
+		pPager->iOpenFlags &= ~UNQLITE_OPEN_MMAP;
+	}
+	if( zOld ){
+		pPage = pPager->pAll;
+		for( n = 0 ; n < pPager->nPage ; ++n ){
+			if( pPage->zData != (unsigned char *)&pPage[1] ){
+				iOfft = (sxi64)(pPage->zData - zOld);
+				if( pNew && iOfft + pPager->iPageSize <= nNew ){
+					/* Same page in the new view */
+					pPage->zData = &((unsigned char *)pNew)[iOfft];
+				}else{
+					if( iOfft + pPager->iPageSize <= nNew || pNew == 0 ){
+						/* Private copy */
+						SyMemcpy((const void *)pPage->zData,(void *)&pPage[1],(sxu32)pPager->iPageSize);
+					}else{
+						/* Page past the end of the file */
+						SyZero((void *)&pPage[1],(sxu32)pPager->iPageSize);
+					}
+					pPage->zData = (unsigned char *)&pPage[1];
+				}
+			}
+			pPage = pPage->pNext;
+		}
+		if( pVfs && pVfs->xUnmap ){
+			pVfs->xUnmap(zOld,nOld);
+		}
+	}
+	pPager->pMmap = pNew;
+	pPager->dbByteSize = nNew;
+}
 /*
 ** Commit a transaction and sync the database file for the pager pPager.
 **
@@ -57226,7 +63075,7 @@ static int pager_dirty_commit(Pager *pPager)
 **   * the database file synced.
 **   * the journal file is deleted.
 */
-UNQLITE_PRIVATE int unqlitePagerCommit(Pager *pPager)
+static int pager_commit(Pager *pPager)
 {
 	int rc;
 	/* Commit: Phase One */
@@ -57241,6 +63090,12 @@ UNQLITE_PRIVATE int unqlitePagerCommit(Pager *pPager)
 	}
 	/* Remove stale flags */
 	pPager->iFlags &= ~PAGER_CTRL_COMMIT_ERR;
+	if( pPager->is_wal && pPager->nWalCkpt > 0 && pPager->nWalFrame >= pPager->nWalCkpt ){
+		/* Auto-checkpoint, not fatal if the log is in use by another connection */
+		pager_wal_checkpoint(pPager,FALSE);
+	}
+	/* Map the pages appended by this transaction */
+	pager_mmap_refresh(pPager);
 	/* All done */
 	return UNQLITE_OK;
 fail:
@@ -57248,6 +63103,17 @@ fail:
 	pPager->pDb->iFlags |= UNQLITE_FL_DISABLE_AUTO_COMMIT;
 	return rc;
 }
+/*
+ * Refer to [pager_commit()].
+ */
+UNQLITE_PRIVATE int unqlitePagerCommit(Pager *pPager)
+{
+	int rc;
+	PAGER_READ_ENTER(pPager);
+	rc = pager_commit(pPager);
+	PAGER_READ_LEAVE(pPager);
+	return rc;
+}
 /*
  * Reset the pager to its initial state. This is caused by
  * a rollback operation.
@@ -57262,6 +63128,8 @@ static int pager_reset_state(Pager *pPager,int bResetKvEngine)
 	pPager->iFlags &= ~(PAGER_CTRL_COMMIT_ERR|PAGER_CTRL_DIRTY_COMMIT);
 	pPager->iJournalOfft = 0;
 	pPager->nRec = 0;
+	/* Buffered journal records are useless now */
+	pPager->nJournalBuf = 0;
 	/* Database original size */
 	pPager->dbSize = pPager->dbOrigSize;
 	/* Discard all in-memory pages */
@@ -57282,6 +63150,9 @@ static int pager_reset_state(Pager *pPager,int bResetKvEngine)
 	pPager->pDirty = pPager->pFirstDirty = 0;
 	pPager->pHotDirty = pPager->pFirstHot = 0;
 	pPager->nHot = 0;
+	pPager->pProbation = pPager->pProbationTail = 0;
+	pPager->pProtected = pPager->pProtectedTail = 0;
+	pPager->nProbation = pPager->nProtected = 0;
 	if( pPager->apHash ){
 		/* Zero the table */
 		SyZero((void *)pPager->apHash,sizeof(Page *) * pPager->nSize);
@@ -57322,6 +63193,38 @@ static int pager_reset_state(Pager *pPager,int bResetKvEngine)
 	/* All done */
 	return UNQLITE_OK;
 }
+/*
+ * Release the SHARED lock of a pager outside of a write transaction.
+ * Cached pages and the state of the KV engine may be outdated once the lock
+ * is released, they are discarded and reloaded on the next access.
+ */
+static int pager_read_unlock(Pager *pPager)
+{
+	unqlite_kv_engine *pEngine = pPager->pEngine;
+	const unqlite_kv_io *pIo = pEngine->pIo;
+	int rc;
+	/* Discard the cached pages */
+	rc = pager_reset_state(pPager,FALSE);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Reset the KV engine, its xOpen() method is invoked again by pager_shared_lock() */
+	if( pIo->pMethods->xRelease ){
+		pIo->pMethods->xRelease(pEngine);
+	}
+	SyZero(pEngine,(sxu32)pIo->pMethods->szKv);
+	pEngine->pIo = pIo;
+	if( pIo->pMethods->xInit ){
+		rc = pIo->pMethods->xInit(pEngine,pPager->iPageSize);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	/* Release the lock, the file stays open */
+	pager_unlock_db(pPager,NO_LOCK);
+	pPager->iState = PAGER_OPEN;
+	return UNQLITE_OK;
+}
 /*
 ** If a write transaction is open, then all changes made within the 
 ** transaction are reverted and the current write-transaction is closed.
@@ -57340,9 +63243,26 @@ static int pager_reset_state(Pager *pPager,int bResetKvEngine)
 ** rollback is successful.
 **
 */
-UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine)
+static int pager_rollback(Pager *pPager,int bResetKvEngine)
 {
 	int rc = UNQLITE_OK;
+	if( pPager->is_wal && pPager->iState == PAGER_READER && pager_wal_changed(pPager) ){
+		pPager->iFlags |= PAGER_CTRL_WAL_STALE;
+	}
+	if( (pPager->iFlags & PAGER_CTRL_WAL_STALE) && pPager->iState == PAGER_READER ){
+		/* Pick up the transactions committed to the log by other connections */
+		pPager->iFlags &= ~PAGER_CTRL_WAL_STALE;
+		rc = pager_wal_recover(pPager);
+		if( rc == UNQLITE_OK ){
+			pPager->dbOrigSize = pPager->iWalDbSize > 0 ? pPager->iWalDbSize : pPager->dbSize;
+			rc = pager_reset_state(pPager,bResetKvEngine);
+		}
+		return rc;
+	}
+	if( pPager->pShared && pPager->iState == PAGER_READER && pPager->pSnapshot == 0 ){
+		/* Let the other handles sharing the cache commit */
+		return pager_read_unlock(pPager);
+	}
 	if( pPager->iState < PAGER_WRITER_LOCKED ){
 		/* A write transaction must be opened */
 		return UNQLITE_OK;
@@ -57361,7 +63281,7 @@ UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine)
 			/* Close any outstanding joural file */
 			if( pPager->pjfd ){
 				/* Sync the journal file */
-				unqliteOsSync(pPager->pjfd,UNQLITE_SYNC_NORMAL);
+				pager_sync(pPager,pPager->pjfd,UNQLITE_SYNC_NORMAL);
 			}
 			unqliteOsCloseFree(pPager->pAllocator,pPager->pjfd);
 			pPager->pjfd = 0;
@@ -57385,6 +63305,8 @@ UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine)
 			unqliteGenError(pPager->pDb,"Error while reseting pager to its initial state");
 			return rc;
 		}
+		/* The rollback may have truncated the file */
+		pager_mmap_refresh(pPager);
 	}else{
 		/* Downgrade to shared lock */
 		pager_unlock_db(pPager,SHARED_LOCK);
@@ -57392,6 +63314,17 @@ UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine)
 	}
 	return UNQLITE_OK;
 }
+/*
+ * Refer to [pager_rollback()].
+ */
+UNQLITE_PRIVATE int unqlitePagerRollback(Pager *pPager,int bResetKvEngine)
+{
+	int rc;
+	PAGER_READ_ENTER(pPager);
+	rc = pager_rollback(pPager,bResetKvEngine);
+	PAGER_READ_LEAVE(pPager);
+	return rc;
+}
 /*
  *  Mark a data page as non writeable.
  */
@@ -57403,6 +63336,8 @@ static int unqlitePagerDontWrite(unqlite_page *pMyPage)
 	}
 	return UNQLITE_OK;
 }
+/* Forward declaration */
+static int pager_snapshot_preimage(Pager *pPager,Page *pPage);
 /*
 ** Mark a data page as writeable. This routine must be called before 
 ** making changes to a page. The caller must check the return value 
@@ -57415,10 +63350,23 @@ static int unqlitePageWrite(unqlite_page *pMyPage)
 	Pager *pPager = pPage->pPager;
 	int rc;
 	/* Begin the write transaction */
-	rc = unqlitePagerBegin(pPager);
+	rc = pager_begin(pPager);
 	if( rc != UNQLITE_OK ){
 		return rc;
 	}
+#if defined(UNQLITE_ENABLE_THREADS)
+	if( pPager->pDb->nCommitWindow > 0 ){
+		/* Let the group commit know which threads are writing */
+		unqliteCommitNoteWriter(pPager->pDb);
+	}
+#endif
+	if( pPager->pSnapshot && !(pPage->flags & PAGE_DIRTY) ){
+		/* First change to this page, save its committed content for the open snapshots */
+		rc = pager_snapshot_preimage(pPager,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
 	if( pPager->iState == PAGER_WRITER_LOCKED ){
 		/* The journal file needs to be opened. Higher level routines have already
 		 ** obtained the necessary locks to begin the write-transaction, but the
@@ -57429,8 +63377,10 @@ static int unqlitePageWrite(unqlite_page *pMyPage)
 			return rc;
 		}
 	}
-	if( pPager->nHot > 127 ){
-		/* Write hot dirty pages */
+	if( pPager->nHot > 127 && !pPager->is_wal ){
+		/* Write hot dirty pages. In WAL mode, they are kept in memory
+		 * until commit since the database file must not see them.
+		 */
 		rc = pager_dirty_commit(pPager);
 		if( rc != UNQLITE_OK ){
 			/* A rollback must be done */
@@ -57438,6 +63388,21 @@ static int unqlitePageWrite(unqlite_page *pMyPage)
 			return rc;
 		}
 	}
+	if( pPage->pShared ){
+		/* Page served by the shared cache: work on a private copy from now on,
+		 * the shared content is never modified.
+		 */
+		rc = pager_page_unshare(pPager,pPage);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}else if( !(pPage->flags & PAGE_NO_INLINE) && pPage->zData != (unsigned char *)&pPage[1] ){
+		/* Page served from the memory view: work on a private copy from now on,
+		 * the view is only updated by the regular file writes at commit time.
+		 */
+		SyMemcpy((const void *)pPage->zData,(void *)&pPage[1],(sxu32)pPager->iPageSize);
+		pPage->zData = (unsigned char *)&pPage[1];
+	}
 	/* Write the page to the journal file */
 	rc = page_write(pPager,pPage);
 	return rc;
@@ -57475,22 +63440,42 @@ static int unqlitePagerAcquire(
 		return pPage ? UNQLITE_OK : UNQLITE_NOTFOUND;
 	}
 	if( pPage == 0 ){
-		/* Allocate a new page */
-		pPage = pager_alloc_page(pPager,pgno);
-		if( pPage == 0 ){
-			unqliteGenOutofMem(pPager->pDb);
-			return UNQLITE_NOMEM;
-		}
-		/* Read page contents */
-		rc = pager_get_page_contents(pPager,pPage,noContent);
-		if( rc != UNQLITE_OK ){
-			SyMemBackendPoolFree(pPager->pAllocator,pPage);
-			return rc;
+		pPager->sStats.nCacheMiss++;
+		if( pPager->pShared && !noContent && pgno > 0 && pgno < pPager->dbSize ){
+			/* Committed page, share its content with the other handles */
+			rc = pager_shared_page(pPager,pgno,&pPage);
+			if( rc != UNQLITE_OK ){
+				if( rc == UNQLITE_NOMEM ){
+					unqliteGenOutofMem(pPager->pDb);
+				}
+				return rc;
+			}
+		}else{
+			/* Allocate a new page */
+			pPage = pager_alloc_page(pPager,pgno);
+			if( pPage == 0 ){
+				unqliteGenOutofMem(pPager->pDb);
+				return UNQLITE_NOMEM;
+			}
+			/* Read page contents */
+			rc = pager_get_page_contents(pPager,pPage,noContent);
+			if( rc != UNQLITE_OK ){
+				SyMemBackendPoolFree(pPager->pAllocator,pPage);
+				return rc;
+			}
 		}
 		/* Link the page */
 		pager_link_page(pPager,pPage);
+		/* Make room in the page cache if needed */
+		pager_cache_evict(pPager);
 	}else{
+		pPager->sStats.nCacheHit++;
 		if( ppPage ){
+			if( pPage->flags & PAGE_IN_CACHE ){
+				/* Cache hit on an unused page, promote it to the protected segment */
+				pager_cache_remove(pPager,pPage);
+				pPage->flags |= PAGE_CACHE_HOT;
+			}
 			page_ref(pPage);
 		}
 	}
@@ -57581,11 +63566,19 @@ static void pager_release_kv_engine(Pager *pPager)
 {
 	unqlite_kv_engine *pEngine = pPager->pEngine;
 	unqlite_db *pStorage = &pPager->pDb->sDB;
+	unqlite_kv_cursor **apCur;
+	sxu32 n;
 	if( pStorage->pCursor ){
 		/* Release the associated cursor */
 		unqliteReleaseCursor(pPager->pDb,pStorage->pCursor);
 		pStorage->pCursor = 0;
 	}
+	/* Release the idle cursors of concurrent readers */
+	apCur = (unqlite_kv_cursor **)SySetBasePtr(&pStorage->aReadCursor);
+	for( n = 0 ; n < SySetUsed(&pStorage->aReadCursor) ; ++n ){
+		unqliteReleaseCursor(pPager->pDb,apCur[n]);
+	}
+	SySetReset(&pStorage->aReadCursor);
 	if( pEngine->pIo->pMethods->xRelease ){
 		pEngine->pIo->pMethods->xRelease(pEngine);
 	}
@@ -57593,9 +63586,41 @@ static void pager_release_kv_engine(Pager *pPager)
 	SyMemBackendFree(&pPager->pDb->sMem,(void *)pEngine->pIo);
 	SyMemBackendFree(&pPager->pDb->sMem,(void *)pEngine);
 	pPager->pEngine = 0;
+	pPager->xKvHash = 0;
+	pPager->xKvCmp = 0;
 }
 /* Forward declaration */
 static int pager_kv_io_init(Pager *pPager,unqlite_kv_methods *pMethods,unqlite_kv_io *pIo);
+/*
+ * Select the KV storage engine before the target database is accessed.
+ * Existing databases are always reopened with the engine recorded in their header.
+ * In-memory databases accept engines that keep their records themselves (i.e. without
+ * an xOpen() method) as long as no record was stored yet.
+ */
+UNQLITE_PRIVATE int unqlitePagerSetKvEngine(Pager *pPager,unqlite_kv_methods *pMethods)
+{
+	if( pPager->is_mem ){
+		unqlite_kv_cursor *pCur = pPager->pDb->sDB.pCursor;
+		if( pMethods->xOpen ){
+			unqliteGenError(pPager->pDb,"In-memory databases require an in-memory Key/Value storage engine such as 'mem' or 'skiplist'");
+			return UNQLITE_NOTIMPLEMENTED;
+		}
+		if( pCur && pCur->pStore->pIo->pMethods != pMethods ){
+			const unqlite_kv_methods *pOld = pCur->pStore->pIo->pMethods;
+			pOld->xFirst(pCur);
+			if( pOld->xValid(pCur) ){
+				unqliteGenError(pPager->pDb,"The Key/Value storage engine must be selected before the first record is stored");
+				return UNQLITE_LOCKED;
+			}
+		}
+		return unqlitePagerRegisterKvEngine(pPager,pMethods);
+	}
+	if( pPager->iState != PAGER_OPEN ){
+		unqliteGenError(pPager->pDb,"The Key/Value storage engine must be selected before the first database access");
+		return UNQLITE_LOCKED;
+	}
+	return unqlitePagerRegisterKvEngine(pPager,pMethods);
+}
 /*
  * Allocate, initialize and register a new KV storage engine
  * within this database instance.
@@ -57662,7 +63687,14 @@ fail:
  */
 UNQLITE_PRIVATE unqlite_kv_engine * unqlitePagerGetKvEngine(unqlite *pDb)
 {
-	return pDb->sDB.pPager->pEngine;
+	Pager *pPager = pDb->sDB.pPager;
+	if( pPager->iState == PAGER_OPEN ){
+		/* Read the database header first so that the storage engine
+		 * recorded there is installed before it is handed to the caller.
+		 */
+		pager_shared_lock(pPager);
+	}
+	return pPager->pEngine;
 }
 /*
 * Allocate and initialize a new Pager object. The pager should
@@ -57748,7 +63780,7 @@ UNQLITE_PRIVATE int unqlitePagerOpen(
 	SyRandomnessInit(&pPager->sPrng,0,0);
 	SyRandomness(&pPager->sPrng,(void *)&pPager->cksumInit,sizeof(sxu32));
 	/* Unlimited cache size */
-	pPager->nCacheMax = SXU32_HIGH;
+	pPager->nCacheMax = UNQLITE_DEFAULT_PAGE_CACHE;
 	/* Copy filename and journal name */
 	if( !is_mem ){
 		pPager->zFilename = (char *)&pPager[1];
@@ -57775,6 +63807,18 @@ UNQLITE_PRIVATE int unqlitePagerOpen(
 		SyMemcpy(UNQLITE_JOURNAL_FILE_SUFFIX,&pPager->zJournal[nLen],sizeof(UNQLITE_JOURNAL_FILE_SUFFIX)-1);
 		/* Append the nul terminator to the journal path */
 		pPager->zJournal[nLen + ( sizeof(UNQLITE_JOURNAL_FILE_SUFFIX) - 1)] = 0;
+		/* Same for the write-ahead log */
+		pPager->zWal = (char *) SyMemBackendAlloc(pPager->pAllocator,nLen + sizeof(UNQLITE_WAL_FILE_SUFFIX) + sizeof(char));
+		if( pPager->zWal == 0 ){
+			rc = UNQLITE_NOMEM;
+			goto fail;
+		}
+		SyMemcpy(pPager->zFilename,pPager->zWal,nLen);
+		SyMemcpy(UNQLITE_WAL_FILE_SUFFIX,&pPager->zWal[nLen],sizeof(UNQLITE_WAL_FILE_SUFFIX)-1);
+		pPager->zWal[nLen + ( sizeof(UNQLITE_WAL_FILE_SUFFIX) - 1)] = 0;
+		/* WAL mode if requested, the log is opened later with the database file */
+		pPager->is_wal = (iFlags & UNQLITE_OPEN_WAL) != 0;
+		pPager->nWalCkpt = WAL_AUTOCHECKPOINT;
 	}
 	/* Finally, register the selected KV engine */
 	rc = unqlitePagerRegisterKvEngine(pPager,pMethods);
@@ -57796,31 +63840,161 @@ fail:
 	return rc;
 }
 /*
- * Set a cache limit. Note that, this is a simple hint, the pager is not
- * forced to honor this limit.
+ * Set a cache limit. Unused clean pages are evicted past this limit while
+ * pages in use or dirty pages are always kept in memory, so the pager may
+ * temporarily exceed it.
  */
 UNQLITE_PRIVATE int unqlitePagerSetCachesize(Pager *pPager,int mxPage)
 {
 	if( mxPage < 256 ){
 		return UNQLITE_INVALID;
 	}
+	PAGER_READ_ENTER(pPager);
 	pPager->nCacheMax = mxPage;
+	/* Shrink the cache if needed */
+	pager_cache_evict(pPager);
+	PAGER_READ_LEAVE(pPager);
 	return UNQLITE_OK;
 }
+/*
+ * Copy the pager statistics to pStats and optionally reset the cumulative counters.
+ */
+UNQLITE_PRIVATE int unqlitePagerStats(Pager *pPager,unqlite_pager_stats *pStats,int bReset)
+{
+	if( pStats == 0 ){
+		return UNQLITE_INVALID;
+	}
+	SyMemcpy((const void *)&pPager->sStats,(void *)pStats,sizeof(unqlite_pager_stats));
+	pStats->nPage = pPager->nPage;
+	pStats->nHot = pPager->nHot;
+	pStats->nCacheMax = pPager->nCacheMax;
+	if( bReset ){
+		SyZero(&pPager->sStats,sizeof(unqlite_pager_stats));
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Set the write-ahead log auto-checkpoint threshold (in frames).
+ * Zero disable auto-checkpointing.
+ */
+UNQLITE_PRIVATE int unqlitePagerSetWalAutoCheckpoint(Pager *pPager,int nFrame)
+{
+	if( nFrame < 0 ){
+		return UNQLITE_INVALID;
+	}
+	pPager->nWalCkpt = (sxu32)nFrame;
+	return UNQLITE_OK;
+}
+/*
+ * Transfer the content of the write-ahead log to the database file.
+ */
+UNQLITE_PRIVATE int unqlitePagerWalCheckpoint(Pager *pPager)
+{
+	int rc;
+	if( !pPager->is_wal ){
+		/* Nothing to checkpoint */
+		return UNQLITE_OK;
+	}
+	PAGER_READ_ENTER(pPager);
+	rc = pager_wal_checkpoint(pPager,FALSE);
+	if( rc == UNQLITE_OK ){
+		pager_mmap_refresh(pPager);
+	}
+	PAGER_READ_LEAVE(pPager);
+	if( rc == UNQLITE_BUSY ){
+		unqliteGenError(pPager->pDb,"Another connection is using the write-ahead log, try again later");
+	}else if( rc == UNQLITE_LOCKED ){
+		unqliteGenError(pPager->pDb,"Cannot checkpoint while a write transaction is active, commit your changes first");
+	}
+	return rc;
+}
+/*
+ * Background write-back step (UNQLITE_CONFIG_WRITE_BACK).
+ * In rollback journal mode, write the hot dirty pages of the active transaction once at
+ * least nMinPage of them accumulated. This is a dirty commit (see pager_dirty_commit())
+ * performed ahead of the one unqlitePageWrite() would trigger, so that the final commit
+ * only has to write the residue. In WAL mode, checkpoint the log between transactions.
+ */
+UNQLITE_PRIVATE int unqlitePagerWriteBack(Pager *pPager,int nMinPage,int *pnPage)
+{
+	sxu32 nBefore;
+	int rc = UNQLITE_OK;
+	if( pnPage ){
+		*pnPage = 0;
+	}
+	if( pPager->is_mem || pPager->is_rdonly ){
+		/* Nothing to write back */
+		return UNQLITE_OK;
+	}
+	if( nMinPage < 1 ){
+		nMinPage = 1;
+	}
+	PAGER_READ_ENTER(pPager);
+	if( pPager->is_wal ){
+		nBefore = pPager->nWalFrame;
+		if( pPager->iState == PAGER_READER && nBefore >= (sxu32)nMinPage ){
+			rc = pager_wal_checkpoint(pPager,FALSE);
+			if( rc == UNQLITE_OK ){
+				pager_mmap_refresh(pPager);
+				if( pnPage ){
+					*pnPage = (int)nBefore;
+				}
+			}else if( rc == UNQLITE_BUSY ){
+				/* The log is in use by another connection, try again later */
+				rc = UNQLITE_OK;
+			}
+		}
+	}else if( pPager->iState >= PAGER_WRITER_CACHEMOD && pPager->iState < PAGER_WRITER_FINISHED
+		&& (pPager->iFlags & PAGER_CTRL_COMMIT_ERR) == 0 && pPager->nHot >= (sxu32)nMinPage ){
+		nBefore = pPager->nHot;
+		rc = pager_dirty_commit(pPager);
+		if( rc == UNQLITE_OK && pnPage ){
+			*pnPage = (int)(nBefore - pPager->nHot);
+		}
+	}
+	PAGER_READ_LEAVE(pPager);
+	return rc;
+}
 /*
  * Shutdown the page cache. Free all memory and close the database file.
  */
 UNQLITE_PRIVATE int unqlitePagerClose(Pager *pPager)
 {
+	/* Release the snapshots left open */
+	while( pPager->pSnapshot ){
+		unqlitePagerSnapshotRelease(pPager->pSnapshot);
+	}
+	if( pPager->pwfd ){
+		/* Transfer the write-ahead log to the database file and remove it
+		 * if no other connection is using it.
+		 */
+		pager_wal_checkpoint(pPager,TRUE);
+		if( pPager->pwfd ){
+			unqliteOsCloseFree(pPager->pAllocator,pPager->pwfd);
+			pPager->pwfd = 0;
+		}
+	}
+	pager_wal_reset_index(pPager,TRUE);
+	if( pPager->zWalFrame ){
+		SyMemBackendFree(pPager->pAllocator,pPager->zWalFrame);
+		pPager->zWalFrame = 0;
+	}
+	if( pPager->zJournalBuf ){
+		SyMemBackendFree(pPager->pAllocator,pPager->zJournalBuf);
+		pPager->zJournalBuf = 0;
+		pPager->nJournalBuf = pPager->nJournalBufMax = 0;
+	}
 	/* Release the KV engine */
 	pager_release_kv_engine(pPager);
+	/* Drop the pages shared with the other handles */
+	pager_shared_detach(pPager);
 	if( pPager->iOpenFlags & UNQLITE_OPEN_MMAP ){
 		const jx9_vfs *pVfs = jx9ExportBuiltinVfs();
 		if( pVfs && pVfs->xUnmap && pPager->pMmap ){
 			pVfs->xUnmap(pPager->pMmap,pPager->dbByteSize);
 		}
 	}
-	if( !pPager->is_mem && pPager->iState > PAGER_OPEN ){
+	if( !pPager->is_mem && pPager->pfd ){
 		/* Release all lock on this database handle */
 		pager_unlock_db(pPager,NO_LOCK);
 		/* Close the file  */
@@ -57861,8 +64035,11 @@ UNQLITE_PRIVATE sxu32 unqlitePagerRandomNum(Pager *pPager)
  */
 static int unqliteKvIoPageGet(unqlite_kv_handle pHandle,pgno iNum,unqlite_page **ppPage)
 {
+	Pager *pPager = (Pager *)pHandle;
 	int rc;
-	rc = unqlitePagerAcquire((Pager *)pHandle,iNum,ppPage,0,0);
+	PAGER_READ_ENTER(pPager);
+	rc = unqlitePagerAcquire(pPager,iNum,ppPage,0,0);
+	PAGER_READ_LEAVE(pPager);
 	return rc;
 }
 /* 
@@ -57870,8 +64047,11 @@ static int unqliteKvIoPageGet(unqlite_kv_handle pHandle,pgno iNum,unqlite_page *
  */
 static int unqliteKvIoPageLookup(unqlite_kv_handle pHandle,pgno iNum,unqlite_page **ppPage)
 {
+	Pager *pPager = (Pager *)pHandle;
 	int rc;
-	rc = unqlitePagerAcquire((Pager *)pHandle,iNum,ppPage,1,0);
+	PAGER_READ_ENTER(pPager);
+	rc = unqlitePagerAcquire(pPager,iNum,ppPage,1,0);
+	PAGER_READ_LEAVE(pPager);
 	return rc;
 }
 /* 
@@ -57881,6 +64061,7 @@ static int unqliteKvIoNewPage(unqlite_kv_handle pHandle,unqlite_page **ppPage)
 {
 	Pager *pPager = (Pager *)pHandle;
 	int rc;
+	PAGER_READ_ENTER(pPager);
 	/* 
 	 * Acquire a reader-lock first so that pPager->dbSize get initialized.
 	 */
@@ -57888,6 +64069,7 @@ static int unqliteKvIoNewPage(unqlite_kv_handle pHandle,unqlite_page **ppPage)
 	if( rc == UNQLITE_OK ){
 		rc = unqlitePagerAcquire(pPager,pPager->dbSize == 0 ? /* Page 0 is reserved */ 1 : pPager->dbSize ,ppPage,0,0);
 	}
+	PAGER_READ_LEAVE(pPager);
 	return rc;
 }
 /* 
@@ -57895,12 +64077,16 @@ static int unqliteKvIoNewPage(unqlite_kv_handle pHandle,unqlite_page **ppPage)
  */
 static int unqliteKvIopageWrite(unqlite_page *pPage)
 {
+	Pager *pPager;
 	int rc;
 	if( pPage == 0 ){
 		/* TICKET 1433-0348 */
 		return UNQLITE_OK;
 	}
+	pPager = ((Page *)pPage)->pPager;
+	PAGER_READ_ENTER(pPager);
 	rc = unqlitePageWrite(pPage);
+	PAGER_READ_LEAVE(pPager);
 	return rc;
 }
 /* 
@@ -57955,7 +64141,10 @@ static int unqliteKvIoPageDontMakeHot(unqlite_page *pRaw)
 static int unqliteKvIopage_ref(unqlite_page *pPage)
 {
 	if( pPage ){
+		Pager *pPager = ((Page *)pPage)->pPager;
+		PAGER_READ_ENTER(pPager);
 		page_ref((Page *)pPage);
+		PAGER_READ_LEAVE(pPager);
 	}
 	return UNQLITE_OK;
 }
@@ -57965,7 +64154,10 @@ static int unqliteKvIopage_ref(unqlite_page *pPage)
 static int unqliteKvIoPageUnRef(unqlite_page *pPage)
 {
 	if( pPage ){
+		Pager *pPager = ((Page *)pPage)->pPager;
+		PAGER_READ_ENTER(pPager);
 		page_unref((Page *)pPage);
+		PAGER_READ_LEAVE(pPager);
 	}
 	return UNQLITE_OK;
 }
@@ -58015,7 +64207,9 @@ static void unqliteKvIoPageReload(unqlite_kv_handle pHandle,void (*xPageReload)(
 static void unqliteKvIoErr(unqlite_kv_handle pHandle,const char *zErr)
 {
 	Pager *pPager = (Pager *)pHandle;
+	PAGER_READ_ENTER(pPager);
 	unqliteGenError(pPager->pDb,zErr);
+	PAGER_READ_LEAVE(pPager);
 }
 /*
  * Init an instance of the [unqlite_kv_io] structure.
@@ -58049,6 +64243,549 @@ static int pager_kv_io_init(Pager *pPager,unqlite_kv_methods *pMethods,unqlite_k
 
 	return UNQLITE_OK;
 }
+/*
+ * Snapshots.
+ *
+ * A snapshot drive a private instance of the KV storage engine through the
+ * read-only IO methods below. A page is copied from the page cache (or read
+ * from the database without being loaded in the cache) the first time the
+ * snapshot reference it, while the writer save the committed content of a
+ * page into every open snapshot just before modifying it for the first time
+ * [pager_snapshot_preimage()]. Snapshot cursors thus never wait for a write
+ * transaction and are never invalidated by one.
+ * Unlike the page cache, a snapshot never evict its pages: The storage engine
+ * keep its parsed state (overflow chains, cells...) attached to them and the
+ * committed content of a page may no longer be available once dropped.
+ * Pages are copied and pre-images are saved under pReadMutex.
+ */
+/*
+ * Fetch a page from the snapshot page table.
+ */
+static SnapPage * pager_snapshot_fetch_page(unqlite_snapshot *pSnap,pgno page_num)
+{
+	SnapPage *pEntry;
+	if( pSnap->nPage < 1 ){
+		/* Don't bother hashing */
+		return 0;
+	}
+	/* Perform the lookup */
+	pEntry = pSnap->apHash[PAGE_HASH(page_num) & (pSnap->nSize - 1)];
+	for(;;){
+		if( pEntry == 0 ){
+			break;
+		}
+		if( pEntry->pgno == page_num ){
+			return pEntry;
+		}
+		/* Point to the next entry in the colission chain */
+		pEntry = pEntry->pNextCollide;
+	}
+	/* No such page */
+	return 0;
+}
+/*
+ * Allocate a new snapshot page and link it to the page table.
+ */
+static SnapPage * pager_snapshot_alloc_page(unqlite_snapshot *pSnap,pgno num_page)
+{
+	SnapPage *pNew,*pEntry,*pNext,**apNew;
+	sxu32 nNew,iBucket,n;
+	if( pSnap->nPage >= pSnap->nSize * 2 ){
+		/* Grow the page table (not fatal on failure) */
+		nNew = pSnap->nSize << 1;
+		apNew = (SnapPage **)SyMemBackendAlloc(&pSnap->sMem,nNew * sizeof(SnapPage *));
+		if( apNew ){
+			SyZero((void *)apNew,nNew * sizeof(SnapPage *));
+			/* Rehash */
+			for( n = 0 ; n < pSnap->nSize ; ++n ){
+				pEntry = pSnap->apHash[n];
+				while( pEntry ){
+					pNext = pEntry->pNextCollide;
+					iBucket = PAGE_HASH(pEntry->pgno) & (nNew - 1);
+					pEntry->pPrevCollide = 0;
+					pEntry->pNextCollide = apNew[iBucket];
+					if( apNew[iBucket] ){
+						apNew[iBucket]->pPrevCollide = pEntry;
+					}
+					apNew[iBucket] = pEntry;
+					pEntry = pNext;
+				}
+			}
+			SyMemBackendFree(&pSnap->sMem,(void *)pSnap->apHash);
+			pSnap->apHash = apNew;
+			pSnap->nSize = nNew;
+		}
+	}
+	pNew = (SnapPage *)SyMemBackendPoolAlloc(&pSnap->sMem,sizeof(SnapPage) + pSnap->pPager->iPageSize);
+	if( pNew == 0 ){
+		return 0;
+	}
+	/* Zero the structure */
+	SyZero(pNew,sizeof(SnapPage));
+	/* Fill in the structure */
+	pNew->zData = (unsigned char *)&pNew[1];
+	pNew->pgno = num_page;
+	/* Link to the page table */
+	iBucket = PAGE_HASH(num_page) & (pSnap->nSize - 1);
+	pNew->pNextCollide = pSnap->apHash[iBucket];
+	if( pSnap->apHash[iBucket] ){
+		pSnap->apHash[iBucket]->pPrevCollide = pNew;
+	}
+	pSnap->apHash[iBucket] = pNew;
+	pSnap->nPage++;
+	return pNew;
+}
+/*
+ * Unlink and release a snapshot page that could not be read.
+ */
+static void pager_snapshot_release_page(unqlite_snapshot *pSnap,SnapPage *pPage)
+{
+	/* Unlink from the page table */
+	if( pPage->pNextCollide ){
+		pPage->pNextCollide->pPrevCollide = pPage->pPrevCollide;
+	}
+	if( pPage->pPrevCollide ){
+		pPage->pPrevCollide->pNextCollide = pPage->pNextCollide;
+	}else{
+		pSnap->apHash[PAGE_HASH(pPage->pgno) & (pSnap->nSize - 1)] = pPage->pNextCollide;
+	}
+	pSnap->nPage--;
+	SyMemBackendPoolFree(&pSnap->sMem,pPage);
+}
+/*
+ * Read the committed content of a page that was not modified since the snapshot was taken.
+ */
+static int pager_snapshot_read_page(unqlite_snapshot *pSnap,SnapPage *pCopy)
+{
+	Pager *pPager = pSnap->pPager;
+	Page *pPage,sPage;
+	int rc;
+	if( pCopy->pgno >= pSnap->dbSize ){
+		/* Page created after the snapshot was taken */
+		SyZero(pCopy->zData,(sxu32)pPager->iPageSize);
+		return UNQLITE_OK;
+	}
+	/* No pre-image, the cached or on-disk content is the committed one */
+	pPage = pager_fetch_page(pPager,pCopy->pgno);
+	if( pPage ){
+		SyMemcpy((const void *)pPage->zData,(void *)pCopy->zData,(sxu32)pPager->iPageSize);
+		return UNQLITE_OK;
+	}
+	/* Read the content without loading the page in the cache */
+	SyZero(&sPage,sizeof(Page));
+	sPage.pgno = pCopy->pgno;
+	sPage.zData = pCopy->zData;
+	rc = pager_get_page_contents(pPager,&sPage,0);
+	if( rc == UNQLITE_OK && sPage.zData != pCopy->zData ){
+		/* Page served from the memory view */
+		SyMemcpy((const void *)sPage.zData,(void *)pCopy->zData,(sxu32)pPager->iPageSize);
+	}
+	return rc;
+}
+/*
+ * Save the committed content of a page into the open snapshots before
+ * the writer modify it. Called from [unqlitePageWrite()] on the first
+ * change to a clean page.
+ */
+static int pager_snapshot_preimage(Pager *pPager,Page *pPage)
+{
+	unqlite_snapshot *pSnap;
+	SnapPage *pCopy;
+	for( pSnap = pPager->pSnapshot ; pSnap ; pSnap = pSnap->pNext ){
+		if( pPage->pgno >= pSnap->dbSize ){
+			/* Page created after the snapshot was taken */
+			continue;
+		}
+		if( pager_snapshot_fetch_page(pSnap,pPage->pgno) ){
+			/* Committed content already copied */
+			continue;
+		}
+		pCopy = pager_snapshot_alloc_page(pSnap,pPage->pgno);
+		if( pCopy == 0 ){
+			unqliteGenOutofMem(pPager->pDb);
+			return UNQLITE_NOMEM;
+		}
+		SyMemcpy((const void *)pPage->zData,(void *)pCopy->zData,(sxu32)pPager->iPageSize);
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Snapshot KV IO Methods.
+ * Refer to [unqliteKvIoPageGet()].
+ */
+static int unqliteSnapshotPageGet(unqlite_kv_handle pHandle,pgno iNum,unqlite_page **ppPage)
+{
+	unqlite_snapshot *pSnap = (unqlite_snapshot *)pHandle;
+	SnapPage *pPage;
+	int rc = UNQLITE_OK;
+	if( ppPage == 0 ){
+		/* Nothing to preload */
+		return UNQLITE_OK;
+	}
+	PAGER_READ_ENTER(pSnap->pPager);
+	pPage = pager_snapshot_fetch_page(pSnap,iNum);
+	if( pPage == 0 ){
+		pPage = pager_snapshot_alloc_page(pSnap,iNum);
+		if( pPage == 0 ){
+			rc = UNQLITE_NOMEM;
+		}else{
+			rc = pager_snapshot_read_page(pSnap,pPage);
+			if( rc != UNQLITE_OK ){
+				pager_snapshot_release_page(pSnap,pPage);
+			}
+		}
+	}
+	if( rc == UNQLITE_OK ){
+		*ppPage = (unqlite_page *)pPage;
+	}
+	PAGER_READ_LEAVE(pSnap->pPager);
+	return rc;
+}
+/*
+ * Refer to [unqliteKvIoPageLookup()].
+ */
+static int unqliteSnapshotPageLookup(unqlite_kv_handle pHandle,pgno iNum,unqlite_page **ppPage)
+{
+	unqlite_snapshot *pSnap = (unqlite_snapshot *)pHandle;
+	SnapPage *pPage;
+	PAGER_READ_ENTER(pSnap->pPager);
+	pPage = pager_snapshot_fetch_page(pSnap,iNum);
+	PAGER_READ_LEAVE(pSnap->pPager);
+	if( ppPage ){
+		*ppPage = (unqlite_page *)pPage;
+	}
+	return pPage ? UNQLITE_OK : UNQLITE_NOTFOUND;
+}
+/*
+ * Snapshots are read-only.
+ */
+static int unqliteSnapshotNewPage(unqlite_kv_handle pHandle,unqlite_page **ppPage)
+{
+	SXUNUSED(pHandle);
+	SXUNUSED(ppPage);
+	return UNQLITE_READ_ONLY;
+}
+/*
+ * Snapshots are read-only.
+ */
+static int unqliteSnapshotPageWrite(unqlite_page *pPage)
+{
+	SXUNUSED(pPage);
+	return UNQLITE_READ_ONLY;
+}
+/*
+ * Nothing is journaled by a snapshot and its pages live as long
+ * as the snapshot so references are not counted.
+ */
+static int unqliteSnapshotPageNoop(unqlite_page *pPage)
+{
+	SXUNUSED(pPage);
+	return UNQLITE_OK;
+}
+/*
+ * Snapshots are read-only.
+ */
+static int unqliteSnapshotReadOnly(unqlite_kv_handle pHandle)
+{
+	SXUNUSED(pHandle);
+	return 1;
+}
+/*
+ * Refer to [unqliteKvIoPageSize()].
+ */
+static int unqliteSnapshotPageSize(unqlite_kv_handle pHandle)
+{
+	return ((unqlite_snapshot *)pHandle)->pPager->iPageSize;
+}
+/*
+ * Refer to [unqliteKvIoTempPage()].
+ */
+static unsigned char * unqliteSnapshotTempPage(unqlite_kv_handle pHandle)
+{
+	return ((unqlite_snapshot *)pHandle)->zTmpPage;
+}
+/*
+ * Snapshot pages are never unpinned nor reloaded, their extra content
+ * is released together with the engine instance.
+ */
+static void unqliteSnapshotPageUnpin(unqlite_kv_handle pHandle,void (*xPageUnpin)(void *))
+{
+	SXUNUSED(pHandle);
+	SXUNUSED(xPageUnpin);
+}
+/*
+ * The error log of the database handle belong to the writer,
+ * snapshot errors are reported through their return code only.
+ */
+static void unqliteSnapshotErr(unqlite_kv_handle pHandle,const char *zErr)
+{
+	SXUNUSED(pHandle);
+	SXUNUSED(zErr);
+}
+/*
+ * Init the [unqlite_kv_io] structure of a snapshot.
+ */
+static void pager_snapshot_io_init(unqlite_snapshot *pSnap,unqlite_kv_methods *pMethods)
+{
+	unqlite_kv_io *pIo = &pSnap->sIo;
+	pIo->pHandle =  pSnap;
+	pIo->pMethods = pMethods;
+
+	pIo->xGet    = unqliteSnapshotPageGet;
+	pIo->xLookup = unqliteSnapshotPageLookup;
+	pIo->xNew    = unqliteSnapshotNewPage;
+
+	pIo->xWrite     = unqliteSnapshotPageWrite;
+	pIo->xDontWrite = unqliteSnapshotPageWrite;
+	pIo->xDontJournal = unqliteSnapshotPageNoop;
+	pIo->xDontMkHot = unqliteSnapshotPageNoop;
+
+	pIo->xPageRef   = unqliteSnapshotPageNoop;
+	pIo->xPageUnref = unqliteSnapshotPageNoop;
+
+	pIo->xPageSize = unqliteSnapshotPageSize;
+	pIo->xReadOnly = unqliteSnapshotReadOnly;
+
+	pIo->xTmpPage =  unqliteSnapshotTempPage;
+
+	pIo->xSetUnpin = unqliteSnapshotPageUnpin;
+	pIo->xSetReload = unqliteSnapshotPageUnpin;
+
+	pIo->xErr = unqliteSnapshotErr;
+}
+/*
+ * Record a callback successfully installed on the KV engine by [unqlite_kv_config()].
+ */
+UNQLITE_PRIVATE void unqlitePagerSaveKvConfig(Pager *pPager,int iOp,va_list ap)
+{
+	switch(iOp){
+	case UNQLITE_KV_CONFIG_HASH_FUNC: {
+		ProcHash xHash = va_arg(ap,ProcHash);
+		if( xHash ){
+			pPager->xKvHash = xHash;
+		}
+		break;
+									  }
+	case UNQLITE_KV_CONFIG_CMP_FUNC: {
+		ProcCmp xCmp = va_arg(ap,ProcCmp);
+		if( xCmp ){
+			pPager->xKvCmp = xCmp;
+		}
+		break;
+									 }
+	default:
+		break;
+	}
+}
+/*
+ * Invoke the xConfig() method of a snapshot engine.
+ */
+static int pager_snapshot_kv_config(unqlite_kv_engine *pEngine,int iOp,...)
+{
+	va_list ap;
+	int rc;
+	va_start(ap,iOp);
+	rc = pEngine->pIo->pMethods->xConfig(pEngine,iOp,ap);
+	va_end(ap);
+	return rc;
+}
+/*
+ * Take a snapshot of the last committed state of the database.
+ * Refer to [unqlite_snapshot_open()].
+ */
+UNQLITE_PRIVATE int unqlitePagerSnapshotOpen(Pager *pPager,unqlite_snapshot **ppOut)
+{
+	unqlite_kv_methods *pMethods;
+	unqlite_snapshot *pSnap;
+	unqlite_kv_engine *pEngine;
+	int rc = UNQLITE_OK;
+	if( pPager->is_mem ){
+		unqliteGenError(pPager->pDb,"Snapshots are not supported by in-memory databases");
+		return UNQLITE_NOTIMPLEMENTED;
+	}
+	PAGER_READ_ENTER(pPager);
+	if( pPager->iState == PAGER_OPEN ){
+		/* Obtain a shared lock and install the storage engine recorded in the header */
+		rc = pager_shared_lock(pPager);
+		if( rc != UNQLITE_OK ){
+			goto leave;
+		}
+	}
+	if( pPager->iState >= PAGER_WRITER_CACHEMOD ){
+		unqliteGenError(pPager->pDb,"Cannot take a snapshot while a write transaction is active, commit your changes first");
+		rc = UNQLITE_LOCKED;
+		goto leave;
+	}
+	if( pPager->dbSize < 1 ){
+		unqliteGenError(pPager->pDb,"Empty database, nothing to snapshot");
+		rc = UNQLITE_EMPTY;
+		goto leave;
+	}
+	pMethods = pPager->pEngine->pIo->pMethods;
+	/* Allocate a new instance */
+	pSnap = (unqlite_snapshot *)SyMemBackendAlloc(pPager->pAllocator,sizeof(unqlite_snapshot));
+	if( pSnap == 0 ){
+		unqliteGenOutofMem(pPager->pDb);
+		rc = UNQLITE_NOMEM;
+		goto leave;
+	}
+	/* Zero the structure */
+	SyZero(pSnap,sizeof(unqlite_snapshot));
+	/* Fill in */
+	pSnap->pPager = pPager;
+	pSnap->dbSize = pPager->dbSize;
+	SyMemBackendInitFromParent(&pSnap->sMem,pPager->pAllocator);
+	pSnap->nSize = 64; /* Must be a power of two */
+	pSnap->apHash = (SnapPage **)SyMemBackendAlloc(&pSnap->sMem,pSnap->nSize * sizeof(SnapPage *));
+	pSnap->zTmpPage = (unsigned char *)SyMemBackendAlloc(&pSnap->sMem,(sxu32)pPager->iPageSize);
+	pEngine = (unqlite_kv_engine *)SyMemBackendAlloc(&pSnap->sMem,(sxu32)pMethods->szKv);
+	if( pSnap->apHash == 0 || pSnap->zTmpPage == 0 || pEngine == 0 ){
+		unqliteGenOutofMem(pPager->pDb);
+		rc = UNQLITE_NOMEM;
+		goto fail;
+	}
+	SyZero(pSnap->apHash,pSnap->nSize * sizeof(SnapPage *));
+	SyZero(pSnap->zTmpPage,(sxu32)pPager->iPageSize);
+	SyZero(pEngine,(sxu32)pMethods->szKv);
+	/* Private engine instance reading through the snapshot */
+	pager_snapshot_io_init(pSnap,pMethods);
+	pEngine->pIo = &pSnap->sIo;
+	if( pMethods->xInit ){
+		rc = pMethods->xInit(pEngine,pPager->iPageSize);
+		if( rc != UNQLITE_OK ){
+			goto fail;
+		}
+		pEngine->pIo = &pSnap->sIo;
+	}
+	pSnap->pEngine = pEngine;
+	/* Use the callbacks installed on the live engine */
+	if( pPager->xKvHash ){
+		rc = pager_snapshot_kv_config(pEngine,UNQLITE_KV_CONFIG_HASH_FUNC,pPager->xKvHash);
+	}
+	if( rc == UNQLITE_OK && pPager->xKvCmp ){
+		rc = pager_snapshot_kv_config(pEngine,UNQLITE_KV_CONFIG_CMP_FUNC,pPager->xKvCmp);
+	}
+	if( rc != UNQLITE_OK ){
+		unqliteGenErrorFormat(pPager->pDb,
+			"Cannot install the hash or comparison function of the underlying KV engine '%z' on a snapshot",&pPager->sKv);
+		if( pMethods->xRelease ){
+			pMethods->xRelease(pEngine);
+		}
+		goto fail;
+	}
+	if( pMethods->xOpen ){
+		rc = pMethods->xOpen(pEngine,pSnap->dbSize);
+		if( rc != UNQLITE_OK ){
+			unqliteGenErrorFormat(pPager->pDb,
+				"xOpen() method of the underlying KV engine '%z' failed while taking a snapshot",&pPager->sKv);
+			if( pMethods->xRelease ){
+				pMethods->xRelease(pEngine);
+			}
+			goto fail;
+		}
+	}
+	/* Receive the pre-images from now on */
+	pSnap->pNext = pPager->pSnapshot;
+	if( pPager->pSnapshot ){
+		pPager->pSnapshot->pPrev = pSnap;
+	}
+	pPager->pSnapshot = pSnap;
+	*ppOut = pSnap;
+	PAGER_READ_LEAVE(pPager);
+	return UNQLITE_OK;
+fail:
+	SyMemBackendRelease(&pSnap->sMem);
+	SyMemBackendFree(pPager->pAllocator,pSnap);
+leave:
+	PAGER_READ_LEAVE(pPager);
+	return rc;
+}
+/*
+ * Release a snapshot together with its pages and its cursors.
+ */
+UNQLITE_PRIVATE int unqlitePagerSnapshotRelease(unqlite_snapshot *pSnap)
+{
+	Pager *pPager = pSnap->pPager;
+	unqlite_kv_engine *pEngine = pSnap->pEngine;
+	/* Stop receiving pre-images */
+	PAGER_READ_ENTER(pPager);
+	if( pSnap->pNext ){
+		pSnap->pNext->pPrev = pSnap->pPrev;
+	}
+	if( pSnap->pPrev ){
+		pSnap->pPrev->pNext = pSnap->pNext;
+	}else{
+		pPager->pSnapshot = pSnap->pNext;
+	}
+	PAGER_READ_LEAVE(pPager);
+	if( pEngine->pIo->pMethods->xRelease ){
+		pEngine->pIo->pMethods->xRelease(pEngine);
+	}
+	/* Release the pages, the cursors and the engine instance */
+	SyMemBackendRelease(&pSnap->sMem);
+	SyMemBackendFree(pPager->pAllocator,pSnap);
+	return UNQLITE_OK;
+}
+/*
+ * Allocate a new cursor on a snapshot.
+ * Refer to [unqliteInitCursor()].
+ */
+UNQLITE_PRIVATE int unqliteSnapshotInitCursor(unqlite_snapshot *pSnap,unqlite_kv_cursor **ppOut)
+{
+	unqlite_kv_methods *pMethods = pSnap->sIo.pMethods;
+	unqlite_kv_cursor *pCur;
+	sxu32 nByte;
+	if( pMethods->szCursor < 1 ){
+		/* Implementation does not supprt cursors */
+		return UNQLITE_NOTIMPLEMENTED;
+	}
+	nByte = pMethods->szCursor;
+	if( nByte < sizeof(unqlite_kv_cursor) ){
+		nByte += sizeof(unqlite_kv_cursor);
+	}
+	pCur = (unqlite_kv_cursor *)SyMemBackendPoolAlloc(&pSnap->sMem,nByte);
+	if( pCur == 0 ){
+		return UNQLITE_NOMEM;
+	}
+	/* Zero the structure */
+	SyZero(pCur,nByte);
+	/* Save the cursor */
+	pCur->pStore = pSnap->pEngine;
+	/* Invoke the initialization callback if any */
+	if( pMethods->xCursorInit ){
+		pMethods->xCursorInit(pCur);
+	}
+	/* All done */
+	*ppOut = pCur;
+	return UNQLITE_OK;
+}
+/*
+ * Release a snapshot cursor.
+ */
+UNQLITE_PRIVATE int unqliteSnapshotReleaseCursor(unqlite_snapshot *pSnap,unqlite_kv_cursor *pCur)
+{
+	unqlite_kv_methods *pMethods = pSnap->sIo.pMethods;
+	/* Invoke the release callback if available */
+	if( pMethods->xCursorRelease ){
+		pMethods->xCursorRelease(pCur);
+	}
+	/* Finally, free the whole instance */
+	SyMemBackendPoolFree(&pSnap->sMem,pCur);
+	return UNQLITE_OK;
+}
+/*
+ * Return the database handle that own the given cursor or NULL
+ * for a snapshot cursor which does not need the handle locks.
+ */
+UNQLITE_PRIVATE unqlite * unqliteCursorDb(unqlite_kv_cursor *pCursor)
+{
+	const unqlite_kv_io *pIo = pCursor->pStore->pIo;
+	if( pIo->xGet == unqliteSnapshotPageGet ){
+		/* Snapshot cursor */
+		return 0;
+	}
+	return ((Pager *)pIo->pHandle)->pDb;
+}
 /*
  * ----------------------------------------------------------
  * File: unqlite_vm.c
@@ -58104,24 +64841,123 @@ static unqlite_col_record * CollectionCacheFetchRecord(
 	/* No such record */
 	return 0;
 }
+/*
+ * Link a cached record at the head (most recently used end) of the VM LRU list.
+ */
+static void CollectionCacheLinkLru(unqlite_vm *pVm,unqlite_col_record *pRecord)
+{
+	pRecord->pLruPrev = 0;
+	pRecord->pLruNext = pVm->pRecLru;
+	if( pVm->pRecLru ){
+		pVm->pRecLru->pLruPrev = pRecord;
+	}
+	pVm->pRecLru = pRecord;
+	if( pVm->pRecTail == 0 ){
+		pVm->pRecTail = pRecord;
+	}
+}
+/*
+ * Unlink a cached record from the VM LRU list.
+ */
+static void CollectionCacheUnlinkLru(unqlite_vm *pVm,unqlite_col_record *pRecord)
+{
+	if( pRecord->pLruPrev ){
+		pRecord->pLruPrev->pLruNext = pRecord->pLruNext;
+	}else{
+		pVm->pRecLru = pRecord->pLruNext;
+	}
+	if( pRecord->pLruNext ){
+		pRecord->pLruNext->pLruPrev = pRecord->pLruPrev;
+	}else{
+		pVm->pRecTail = pRecord->pLruPrev;
+	}
+	pRecord->pLruNext = pRecord->pLruPrev = 0;
+}
+/*
+ * Mark a cached record as the most recently used one.
+ */
+static void CollectionCacheTouchRecord(unqlite_vm *pVm,unqlite_col_record *pRecord)
+{
+	if( pVm->pRecLru != pRecord ){
+		CollectionCacheUnlinkLru(pVm,pRecord);
+		CollectionCacheLinkLru(pVm,pRecord);
+	}
+}
+/*
+ * Unlink a record from its collection and the VM LRU list and release it.
+ */
+static void CollectionCacheDiscardRecord(unqlite_col_record *pRecord)
+{
+	unqlite_col *pCol = pRecord->pCol;
+	unqlite_vm *pVm = pCol->pVm;
+	if( pRecord->pPrevCol ){
+		pRecord->pPrevCol->pNextCol = pRecord->pNextCol;
+	}else{
+		sxu32 iBucket = COL_RECORD_HASH(pRecord->nId) & (pCol->nRecSize - 1);
+		pCol->apRecord[iBucket] = pRecord->pNextCol;
+	}
+	if( pRecord->pNextCol ){
+		pRecord->pNextCol->pPrevCol = pRecord->pPrevCol;
+	}
+	/* Unlink */
+	MACRO_LD_REMOVE(pCol->pList,pRecord);
+	pCol->nRec--;
+	CollectionCacheUnlinkLru(pVm,pRecord);
+	pVm->nRecCached--;
+	pVm->nRecByte -= pRecord->nByte;
+	/* Release the record */
+	jx9MemObjRelease(&pRecord->sValue);
+	SyMemBackendPoolFree(&pVm->sAlloc,(void *)pRecord);
+}
+/*
+ * Evict the least recently used records of a VM until the cached records
+ * fit in nMaxByte bytes.
+ */
+UNQLITE_PRIVATE void unqliteVmEvictRecords(unqlite_vm *pVm,sxu32 nMaxByte)
+{
+	while( pVm->pRecTail && pVm->nRecByte > nMaxByte ){
+		CollectionCacheDiscardRecord(pVm->pRecTail);
+		pVm->nRecEvict++;
+	}
+}
 /*
  * Install a freshly created record in a given collection. 
+ * nByte is the size of the encoded record, used to estimate how much
+ * memory the decoded value holds.
  */
 static int CollectionCacheInstallRecord(
 	unqlite_col *pCol, /* Target collection */
 	jx9_int64 nId,     /* Unique record ID */
-	jx9_value *pValue  /* JSON value */
+	jx9_value *pValue, /* JSON value */
+	sxu32 nByte        /* Encoded record size */
 	)
 {
+	unqlite_vm *pVm = pCol->pVm;
 	unqlite_col_record *pRecord;
 	sxu32 iBucket;
+	/* Account for the bookkeeping overhead */
+	nByte += (sxu32)sizeof(unqlite_col_record);
 	/* Fetch the record first */
 	pRecord = CollectionCacheFetchRecord(pCol,nId);
+	if( nByte > pVm->nRecMax ){
+		/* Too large for the cache (or the cache is disabled), drop any stale copy */
+		if( pRecord ){
+			CollectionCacheDiscardRecord(pRecord);
+		}
+		return UNQLITE_OK;
+	}
 	if( pRecord ){
 		/* Record already installed, overwrite its old value  */
 		jx9MemObjStore(pValue,&pRecord->sValue);
+		pVm->nRecByte = pVm->nRecByte - pRecord->nByte + nByte;
+		pRecord->nByte = nByte;
+		CollectionCacheTouchRecord(pVm,pRecord);
+		/* Stay within the budget */
+		unqliteVmEvictRecords(pVm,pVm->nRecMax);
 		return UNQLITE_OK;
 	}
+	/* Make room first */
+	unqliteVmEvictRecords(pVm,pVm->nRecMax - nByte);
 	/* Allocate a new instance */
 	pRecord = (unqlite_col_record *)SyMemBackendPoolAlloc(&pCol->pVm->sAlloc,sizeof(unqlite_col_record));
 	if( pRecord == 0 ){
@@ -58133,6 +64969,7 @@ static int CollectionCacheInstallRecord(
 	jx9MemObjInit(pCol->pVm->pJx9Vm,&pRecord->sValue);
 	jx9MemObjStore(pValue,&pRecord->sValue);
 	pRecord->nId = nId;
+	pRecord->nByte = nByte;
 	pRecord->pCol = pCol;
 	/* Install in the corresponding bucket */
 	iBucket = COL_RECORD_HASH(nId) & (pCol->nRecSize - 1);
@@ -58144,6 +64981,9 @@ static int CollectionCacheInstallRecord(
 	/* Link */
 	MACRO_LD_PUSH(pCol->pList,pRecord);
 	pCol->nRec++;
+	CollectionCacheLinkLru(pVm,pRecord);
+	pVm->nRecCached++;
+	pVm->nRecByte += nByte;
 	if( (pCol->nRec >= pCol->nRecSize * 3) && pCol->nRec < 100000 ){
 		/* Allocate a new larger table */
 		sxu32 nNewSize = pCol->nRecSize << 1;
@@ -58199,18 +65039,8 @@ UNQLITE_PRIVATE int unqliteCollectionCacheRemoveRecord(
 		/* No such record */
 		return UNQLITE_NOTFOUND;
 	}
-	if( pRecord->pPrevCol ){
-		pRecord->pPrevCol->pNextCol = pRecord->pNextCol;
-	}else{
-		sxu32 iBucket = COL_RECORD_HASH(nId) & (pCol->nRecSize - 1);
-		pCol->apRecord[iBucket] = pRecord->pNextCol;
-	}
-	if( pRecord->pNextCol ){
-		pRecord->pNextCol->pPrevCol = pRecord->pPrevCol;
-	}
-	/* Unlink */
-	MACRO_LD_REMOVE(pCol->pList,pRecord);
-	pCol->nRec--;
+	/* Unlink and release */
+	CollectionCacheDiscardRecord(pRecord);
 	return UNQLITE_OK;
 }
 /*
@@ -58224,6 +65054,9 @@ static int CollectionCacheRelease(unqlite_col *pCol)
 	/* Discard all records */
 	for( n = 0 ; n < pCol->nRec ; ++n ){
 		pNext = pRec->pNext;
+		CollectionCacheUnlinkLru(pVm,pRec);
+		pVm->nRecCached--;
+		pVm->nRecByte -= pRec->nByte;
 		jx9MemObjRelease(&pRec->sValue);
 		SyMemBackendPoolFree(&pVm->sAlloc,(void *)pRec);
 		/* Point to the next record */
@@ -58472,6 +65305,124 @@ static int CollectionLoadHeader(unqlite_col *pCol)
 	}
 	return UNQLITE_OK;
 }
+/*
+ * Record stores only update the in-memory counters of a collection (see
+ * CollectionStore()), the header is written once per VM execution or
+ * before an explicit commit. If a transaction was nevertheless committed
+ * with a stale header, records exist past the last record ID it holds:
+ * find them and recompute the counters.
+ */
+static void CollectionRecoverHeader(unqlite_col *pCol)
+{
+	SyBlob *pWorker = &pCol->sWorker;
+	int rc;
+	for(;;){
+		/* Prepare the unique ID of the next record */
+		SyBlobReset(pWorker);
+		SyBlobFormat(pWorker,"%z_%qd",&pCol->sName,pCol->nLastid);
+		/* Reset the cursor */
+		unqlite_kv_cursor_reset(pCol->pCursor);
+		/* Check whether it exists */
+		rc = unqlite_kv_cursor_seek(pCol->pCursor,
+			SyBlobData(pWorker),SyBlobLength(pWorker),
+			UNQLITE_CURSOR_MATCH_EXACT
+			);
+		if( rc != UNQLITE_OK ){
+			break;
+		}
+		pCol->nLastid++;
+		pCol->nTotRec++;
+	}
+	/* The header is fixed by the next write to the collection, so that
+	 * read-only handles can load it too.
+	 */
+}
+/*
+ * Write the record counters of a collection to its header if they
+ * changed since the last write.
+ */
+static int CollectionSyncHeader(unqlite_col *pCol)
+{
+	int rc;
+	if( (pCol->iFlags & UNQLITE_COL_HEADER_DIRTY) == 0 ){
+		/* Nothing to write */
+		return UNQLITE_OK;
+	}
+	rc = CollectionSetHeader(0,pCol,pCol->nLastid,pCol->nTotRec,0);
+	if( rc == UNQLITE_OK ){
+		pCol->iFlags &= ~UNQLITE_COL_HEADER_DIRTY;
+	}
+	return rc;
+}
+/*
+ * Write the deferred headers of the collections loaded by a given VM.
+ * This must be done before the underlying transaction is committed.
+ */
+UNQLITE_PRIVATE int unqliteVmSyncCollections(unqlite_vm *pVm)
+{
+	unqlite_col *pCol;
+	int rc = UNQLITE_OK;
+	sxu32 n;
+	pCol = pVm->pCol;
+	for( n = 0 ; n < pVm->iCol ; ++n ){
+		int rc2 = CollectionSyncHeader(pCol);
+		if( rc2 != UNQLITE_OK ){
+			rc = rc2;
+		}
+		/* Point to the next entry */
+		pCol = pCol->pNext;
+	}
+	return rc;
+}
+/* Forward declaration */
+static int CollectionIndexLoad(unqlite_col *pCol);
+static void CollectionIndexRelease(unqlite_col *pCol);
+/*
+ * Discard the in-memory state of the collections loaded by a given VM
+ * after the underlying transaction was rolled back: the deferred record
+ * counters are dropped and the headers and the lists of indexed fields
+ * are reloaded from disk, cached records may have been rolled back too.
+ */
+UNQLITE_PRIVATE void unqliteVmRollbackCollections(unqlite_vm *pVm)
+{
+	unqlite_col *pCol;
+	SyString *pName;
+	sxu32 n;
+	int rc;
+	pCol = pVm->pCol;
+	for( n = 0 ; n < pVm->iCol ; ++n ){
+		pCol->iFlags &= ~UNQLITE_COL_HEADER_DIRTY;
+		/* Discard the cached records */
+		while( pCol->pList ){
+			CollectionCacheDiscardRecord(pCol->pList);
+		}
+		/* Reload the header */
+		pName = &pCol->sName;
+		unqlite_kv_cursor_reset(pCol->pCursor);
+		rc = unqlite_kv_cursor_seek(pCol->pCursor,pName->zString,(int)pName->nByte,UNQLITE_CURSOR_MATCH_EXACT);
+		if( rc == UNQLITE_OK ){
+			rc = CollectionLoadHeader(pCol);
+		}
+		if( rc != UNQLITE_OK ){
+			/* Collection created by the rolled back transaction */
+			pCol->nLastid = pCol->nTotRec = 0;
+		}else{
+			jx9_int64 nLastid = pCol->nLastid;
+			/* Records survive a rollback of an in-memory database */
+			CollectionRecoverHeader(pCol);
+			if( pCol->nLastid != nLastid ){
+				pCol->iFlags |= UNQLITE_COL_HEADER_DIRTY;
+			}
+		}
+		/* Reload the list of indexed fields */
+		CollectionIndexRelease(pCol);
+		SyBlobInit(&pCol->sIndexKey,&pVm->sAlloc);
+		SySetInit(&pCol->aIndex,&pVm->sAlloc,sizeof(SyString));
+		CollectionIndexLoad(pCol);
+		/* Point to the next entry */
+		pCol = pCol->pNext;
+	}
+}
 /*
  * Load or create a binary collection.
  */
@@ -58518,6 +65469,8 @@ static int unqliteVmLoadCollection(
 	/* Fill in the structure */
 	SyBlobInit(&pCol->sWorker,&pVm->sAlloc);
 	SyBlobInit(&pCol->sHeader,&pVm->sAlloc);
+	SyBlobInit(&pCol->sIndexKey,&pVm->sAlloc);
+	SySetInit(&pCol->aIndex,&pVm->sAlloc,sizeof(SyString));
 	pCol->pVm = pVm;
 	pCol->pCursor = pCursor;
 	/* Duplicate collection name */
@@ -58562,6 +65515,14 @@ static int unqliteVmLoadCollection(
 			unqliteGenErrorFormat(pDb,"Corrupt collection '%z' header",&pCol->sName);
 			goto fail;
 		}
+		/* Read the list of indexed fields */
+		rc = CollectionIndexLoad(pCol);
+		if( rc != UNQLITE_OK ){
+			unqliteGenErrorFormat(pDb,"Corrupt collection '%z' index list",&pCol->sName);
+			goto fail;
+		}
+		/* Account for records stored past the header, if any */
+		CollectionRecoverHeader(pCol);
 	}
 	/* Finally install the collection */
 	unqliteVmInstallCollection(pVm,pCol);
@@ -58581,6 +65542,7 @@ fail:
 		}
 		SyBlobRelease(&pCol->sHeader);
 		SyBlobRelease(&pCol->sWorker);
+		CollectionIndexRelease(pCol);
 		jx9MemObjRelease(&pCol->sSchema);
 		SyMemBackendPoolFree(&pVm->sAlloc,pCol);
 	}
@@ -58640,12 +65602,14 @@ UNQLITE_PRIVATE void unqliteCollectionResetRecordCursor(unqlite_col *pCol)
 	pCol->nCurid = 0;
 }
 /*
- * Fetch a record by its unique ID.
+ * Fetch a record by its unique ID and install it in the record cache
+ * if bCache is set.
  */
-UNQLITE_PRIVATE int unqliteCollectionFetchRecordById(
+static int CollectionFetchRecord(
 	unqlite_col *pCol, /* Target collection */
 	jx9_int64 nId,     /* Unique record ID */
-	jx9_value *pValue  /* OUT: record value */
+	jx9_value *pValue, /* OUT: record value */
+	int bCache         /* True to cache the decoded record */
 	)
 {
 	SyBlob *pWorker = &pCol->sWorker;
@@ -58657,8 +65621,11 @@ UNQLITE_PRIVATE int unqliteCollectionFetchRecordById(
 	if( pRec ){
 		/* Copy record value */
 		jx9MemObjStore(&pRec->sValue,pValue);
+		CollectionCacheTouchRecord(pCol->pVm,pRec);
+		pCol->pVm->nRecHit++;
 		return UNQLITE_OK;
 	}
+	pCol->pVm->nRecMiss++;
 	/* Reset the working buffer */
 	SyBlobReset(pWorker);
 	/* Generate the unique ID */
@@ -58684,15 +65651,28 @@ UNQLITE_PRIVATE int unqliteCollectionFetchRecordById(
 	}else{
 		/* Decode the binary JSON */
 		rc = FastJsonDecode(SyBlobData(pWorker),SyBlobLength(pWorker),pValue,0,0);
-		if( rc == UNQLITE_OK ){
+		if( rc == UNQLITE_OK && bCache ){
 			/* Install the record in the cache */
-			CollectionCacheInstallRecord(pCol,nId,pValue);
+			CollectionCacheInstallRecord(pCol,nId,pValue,SyBlobLength(pWorker));
 		}
 	}
 	return rc;
 }
+/*
+ * Fetch a record by its unique ID.
+ */
+UNQLITE_PRIVATE int unqliteCollectionFetchRecordById(
+	unqlite_col *pCol, /* Target collection */
+	jx9_int64 nId,     /* Unique record ID */
+	jx9_value *pValue  /* OUT: record value */
+	)
+{
+	return CollectionFetchRecord(pCol,nId,pValue,1);
+}
 /*
  * Fetch the next record from a given collection.
+ * Records are decoded one at a time and are not installed in the record
+ * cache so that walking a large collection does not grow memory usage.
  */ 
 UNQLITE_PRIVATE int unqliteCollectionFetchNextRecord(unqlite_col *pCol,jx9_value *pValue)
 {
@@ -58704,7 +65684,7 @@ UNQLITE_PRIVATE int unqliteCollectionFetchNextRecord(unqlite_col *pCol,jx9_value
 			/* Return to the caller */
 			return SXERR_EOF;
 		}
-		rc = unqliteCollectionFetchRecordById(pCol,pCol->nCurid,pValue);
+		rc = CollectionFetchRecord(pCol,pCol->nCurid,pValue,0);
 		/* Increment the record ID */
 		pCol->nCurid++;
 		/* Lookup result */
@@ -58746,6 +65726,480 @@ UNQLITE_PRIVATE int unqliteCollectionSetSchema(unqlite_col *pCol,jx9_value *pVal
 	rc = CollectionSetHeader(0,pCol,-1,-1,pValue);
 	return rc;
 }
+/*
+ * Secondary indexes.
+ * An index maps the value of a top-level field of the stored JSON objects
+ * to the unique IDs of the records holding that value. Each distinct value
+ * is stored in the underlying KV engine as a posting list of big-endian
+ * 64-bit record IDs (in insertion order) under the following key:
+ *
+ *   <collection>_idx<field length>_<field><encoded value>
+ *
+ * where the encoded value is produced by CollectionIndexValue() below.
+ * The list of indexed fields is saved under the '<collection>_index' key
+ * so that it survives the VM that created it.
+ * Only scalar values (null, boolean, number and string) are indexed.
+ */
+/*
+ * Append the index encoding of a given scalar value to the target blob.
+ * Integral reals are encoded as integers so that 10 and 10.0 compare equal.
+ */
+static int CollectionIndexValue(SyBlob *pOut,jx9_value *pValue)
+{
+	if( jx9_value_is_null(pValue) ){
+		return SyBlobAppend(pOut,"n",sizeof(char));
+	}else if( jx9_value_is_bool(pValue) ){
+		return SyBlobAppend(pOut,jx9_value_to_bool(pValue) ? "b1" : "b0",2*sizeof(char));
+	}else if( jx9_value_is_int(pValue) ){
+		SyBlobFormat(pOut,"i%qd",jx9_value_to_int64(pValue));
+		return UNQLITE_OK;
+	}else if( jx9_value_is_float(pValue) ){
+		double r = jx9_value_to_double(pValue);
+		if( r > -9223372036854775808.0 && r < 9223372036854775807.0 && (double)(jx9_int64)r == r ){
+			SyBlobFormat(pOut,"i%qd",(jx9_int64)r);
+			return UNQLITE_OK;
+		}
+		SyBlobAppend(pOut,"r",sizeof(char));
+		return SyBlobAppend(pOut,(const void *)&r,sizeof(double));
+	}else if( jx9_value_is_string(pValue) ){
+		const char *zData;
+		int nByte;
+		zData = jx9_value_to_string(pValue,&nByte);
+		SyBlobAppend(pOut,"s",sizeof(char));
+		return SyBlobAppend(pOut,(const void *)zData,(sxu32)nByte);
+	}
+	/* JSON arrays and objects are not indexed */
+	return UNQLITE_NOTFOUND;
+}
+/*
+ * Prepare in sIndexKey the posting list key of a given field value.
+ * pValue is either a record (bRecord is set) or the field value itself.
+ */
+static int CollectionIndexKey(unqlite_col *pCol,const SyString *pField,jx9_value *pValue,int bRecord)
+{
+	SyBlob *pKey = &pCol->sIndexKey;
+	if( bRecord ){
+		if( !jx9_value_is_json_object(pValue) ){
+			return UNQLITE_NOTFOUND;
+		}
+		/* Extract the indexed field */
+		pValue = jx9_array_fetch(pValue,pField->zString,(int)pField->nByte);
+		if( pValue == 0 ){
+			/* No such field */
+			return UNQLITE_NOTFOUND;
+		}
+	}
+	SyBlobReset(pKey);
+	SyBlobFormat(pKey,"%z_idx%u_%z",&pCol->sName,pField->nByte,pField);
+	return CollectionIndexValue(pKey,pValue);
+}
+/*
+ * Position the collection cursor on the posting list whose key is held
+ * in sIndexKey and copy the list in the given blob if pOut is not null.
+ */
+static int CollectionIndexSeek(unqlite_col *pCol,SyBlob *pOut)
+{
+	SyBlob *pKey = &pCol->sIndexKey;
+	int rc;
+	/* Reset the cursor */
+	unqlite_kv_cursor_reset(pCol->pCursor);
+	/* Seek the cursor to the desired location */
+	rc = unqlite_kv_cursor_seek(pCol->pCursor,
+		SyBlobData(pKey),SyBlobLength(pKey),
+		UNQLITE_CURSOR_MATCH_EXACT
+		);
+	if( rc == UNQLITE_OK && pOut ){
+		SyBlobReset(pOut);
+		rc = unqlite_kv_cursor_data_callback(pCol->pCursor,unqliteDataConsumer,pOut);
+	}
+	return rc;
+}
+/*
+ * Return the slot of a given field in the list of indexed fields. -1 otherwise.
+ */
+static sxi32 CollectionIndexFind(unqlite_col *pCol,const SyString *pField)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	sxu32 n;
+	for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+		if( SyStringCmp(&aField[n],pField,SyMemcmp) == 0 ){
+			return (sxi32)n;
+		}
+	}
+	/* Not indexed */
+	return -1;
+}
+/*
+ * Add a record ID to the posting list of a given indexed field.
+ */
+static int CollectionIndexAppend(unqlite_col *pCol,const SyString *pField,jx9_value *pRecord,jx9_int64 nId)
+{
+	SyBlob *pKey = &pCol->sIndexKey;
+	unqlite_kv_engine *pEngine;
+	unsigned char zId[8];
+	if( CollectionIndexKey(pCol,pField,pRecord,TRUE) != UNQLITE_OK ){
+		/* Field not present or not indexable */
+		return UNQLITE_OK;
+	}
+	/* Point to the underlying KV store */
+	pEngine = unqlitePagerGetKvEngine(pCol->pVm->pDb);
+	SyBigEndianPack64(zId,(sxu64)nId);
+	return pEngine->pIo->pMethods->xAppend(pEngine,
+		SyBlobData(pKey),(int)SyBlobLength(pKey),
+		(const void *)zId,sizeof(zId)
+		);
+}
+/*
+ * Add a record ID to the posting lists of all the indexed fields of a given record.
+ */
+static int CollectionIndexInsert(unqlite_col *pCol,jx9_value *pRecord,jx9_int64 nId)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	sxu32 n;
+	int rc;
+	for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+		rc = CollectionIndexAppend(pCol,&aField[n],pRecord,nId);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Remove a record ID from the posting lists of the indexed fields of a given record.
+ */
+static int CollectionIndexRemove(unqlite_col *pCol,jx9_value *pRecord,jx9_int64 nId)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	SyBlob *pWorker = &pCol->sWorker;
+	SyBlob *pKey = &pCol->sIndexKey;
+	unqlite_kv_engine *pEngine;
+	unsigned char zId[8];
+	unsigned char *zList;
+	sxu32 n,nByte,i;
+	int rc;
+	/* Point to the underlying KV store */
+	pEngine = unqlitePagerGetKvEngine(pCol->pVm->pDb);
+	SyBigEndianPack64(zId,(sxu64)nId);
+	for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+		if( CollectionIndexKey(pCol,&aField[n],pRecord,TRUE) != UNQLITE_OK ){
+			continue;
+		}
+		if( CollectionIndexSeek(pCol,pWorker) != UNQLITE_OK ){
+			/* No such posting list */
+			continue;
+		}
+		zList = (unsigned char *)SyBlobData(pWorker);
+		nByte = SyBlobLength(pWorker) & ~7;
+		for( i = 0 ; i < nByte ; i += 8 ){
+			if( SyMemcmp(&zList[i],zId,sizeof(zId)) == 0 ){
+				break;
+			}
+		}
+		if( i >= nByte ){
+			/* Record ID not in the list */
+			continue;
+		}
+		if( nByte <= 8 ){
+			/* Last entry, drop the posting list */
+			rc = unqlite_kv_cursor_delete_entry(pCol->pCursor);
+		}else{
+			/* Shift the remaining IDs and save the list */
+			for( ; i + 8 < nByte ; ++i ){
+				zList[i] = zList[i + 8];
+			}
+			rc = pEngine->pIo->pMethods->xReplace(pEngine,
+				SyBlobData(pKey),(int)SyBlobLength(pKey),
+				(const void *)zList,nByte - 8
+				);
+		}
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Save the list of indexed fields in the underlying KV engine.
+ */
+static int CollectionIndexSave(unqlite_col *pCol)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	SyBlob *pKey = &pCol->sIndexKey;
+	unqlite_kv_engine *pEngine;
+	sxu32 nKeyLen,n;
+	int rc;
+	/* Point to the underlying KV store */
+	pEngine = unqlitePagerGetKvEngine(pCol->pVm->pDb);
+	SyBlobReset(pKey);
+	SyBlobFormat(pKey,"%z_index",&pCol->sName);
+	nKeyLen = SyBlobLength(pKey);
+	if( SySetUsed(&pCol->aIndex) < 1 ){
+		/* No more indexes, remove the entry */
+		rc = CollectionIndexSeek(pCol,0);
+		if( rc == UNQLITE_OK ){
+			rc = unqlite_kv_cursor_delete_entry(pCol->pCursor);
+		}
+		return rc == UNQLITE_NOTFOUND ? UNQLITE_OK : rc;
+	}
+	/* Length prefixed field names */
+	for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+		SyBlobAppendBig32(pKey,aField[n].nByte);
+		rc = SyBlobAppend(pKey,(const void *)aField[n].zString,aField[n].nByte);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	rc = pEngine->pIo->pMethods->xReplace(pEngine,
+		SyBlobData(pKey),(int)nKeyLen,
+		SyBlobDataAt(pKey,nKeyLen),SyBlobLength(pKey) - nKeyLen
+		);
+	return rc;
+}
+/*
+ * Load the list of indexed fields of a freshly loaded collection.
+ */
+static int CollectionIndexLoad(unqlite_col *pCol)
+{
+	SyBlob *pWorker = &pCol->sWorker;
+	unsigned char *zRaw,*zEnd;
+	SyString sField;
+	sxu32 nByte;
+	char *zDup;
+	int rc;
+	SyBlobReset(&pCol->sIndexKey);
+	SyBlobFormat(&pCol->sIndexKey,"%z_index",&pCol->sName);
+	rc = CollectionIndexSeek(pCol,pWorker);
+	if( rc != UNQLITE_OK ){
+		/* No indexes */
+		return rc == UNQLITE_NOTFOUND ? UNQLITE_OK : rc;
+	}
+	zRaw = (unsigned char *)SyBlobData(pWorker);
+	zEnd = &zRaw[SyBlobLength(pWorker)];
+	while( zRaw < zEnd ){
+		if( zEnd - zRaw < 4 ){
+			return UNQLITE_CORRUPT;
+		}
+		SyBigEndianUnpack32(zRaw,&nByte);
+		zRaw += 4;
+		if( nByte < 1 || (sxu32)(zEnd - zRaw) < nByte ){
+			return UNQLITE_CORRUPT;
+		}
+		zDup = SyMemBackendStrDup(&pCol->pVm->sAlloc,(const char *)zRaw,nByte);
+		if( zDup == 0 ){
+			return UNQLITE_NOMEM;
+		}
+		SyStringInitFromBuf(&sField,zDup,nByte);
+		SySetPut(&pCol->aIndex,(const void *)&sField);
+		zRaw += nByte;
+	}
+	return UNQLITE_OK;
+}
+/*
+ * Release the in-memory list of indexed fields.
+ */
+static void CollectionIndexRelease(unqlite_col *pCol)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	sxu32 n;
+	for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+		SyMemBackendFree(&pCol->pVm->sAlloc,(void *)aField[n].zString);
+	}
+	SySetRelease(&pCol->aIndex);
+	SyBlobRelease(&pCol->sIndexKey);
+}
+/*
+ * Remove the posting lists of a given indexed field or of all indexed fields
+ * if pField is null. Records are read without being cached.
+ */
+static int CollectionIndexPurge(unqlite_col *pCol,const SyString *pField)
+{
+	SyString *aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	jx9_value sRecord;
+	jx9_int64 nId;
+	sxu32 n;
+	int rc = UNQLITE_OK;
+	jx9MemObjInit(pCol->pVm->pJx9Vm,&sRecord);
+	for( nId = 0 ; nId < pCol->nLastid ; ++nId ){
+		if( CollectionFetchRecord(pCol,nId,&sRecord,0) != UNQLITE_OK ){
+			/* Deleted record */
+			continue;
+		}
+		for( n = 0 ; n < SySetUsed(&pCol->aIndex) ; ++n ){
+			if( pField && SyStringCmp(&aField[n],pField,SyMemcmp) != 0 ){
+				continue;
+			}
+			if( CollectionIndexKey(pCol,&aField[n],&sRecord,TRUE) != UNQLITE_OK ){
+				continue;
+			}
+			/* Drop the whole posting list (Already dropped lists are ignored) */
+			if( CollectionIndexSeek(pCol,0) == UNQLITE_OK ){
+				rc = unqlite_kv_cursor_delete_entry(pCol->pCursor);
+				if( rc != UNQLITE_OK ){
+					break;
+				}
+			}
+		}
+		if( rc != UNQLITE_OK ){
+			break;
+		}
+	}
+	jx9MemObjRelease(&sRecord);
+	return rc;
+}
+/*
+ * Create an index on a top-level field of a given collection and populate
+ * it from the records already stored.
+ */
+UNQLITE_PRIVATE int unqliteCollectionCreateIndex(unqlite_col *pCol,const SyString *pField)
+{
+	unqlite_kv_engine *pEngine;
+	jx9_value sRecord;
+	SyString sField;
+	jx9_int64 nId;
+	char *zDup;
+	int rc;
+	if( CollectionIndexFind(pCol,pField) >= 0 ){
+		/* Already indexed */
+		return UNQLITE_OK;
+	}
+	/* Point to the underlying KV store */
+	pEngine = unqlitePagerGetKvEngine(pCol->pVm->pDb);
+	if( pEngine->pIo->pMethods->xReplace == 0 || pEngine->pIo->pMethods->xAppend == 0 ){
+		unqliteGenErrorFormat(pCol->pVm->pDb,
+				"Cannot index collection '%z' due to a read-only Key/Value storage engine",
+				&pCol->sName
+			);
+		return UNQLITE_READ_ONLY;
+	}
+	zDup = SyMemBackendStrDup(&pCol->pVm->sAlloc,pField->zString,pField->nByte);
+	if( zDup == 0 ){
+		unqliteGenOutofMem(pCol->pVm->pDb);
+		return UNQLITE_NOMEM;
+	}
+	SyStringInitFromBuf(&sField,zDup,pField->nByte);
+	rc = SySetPut(&pCol->aIndex,(const void *)&sField);
+	if( rc != UNQLITE_OK ){
+		SyMemBackendFree(&pCol->pVm->sAlloc,zDup);
+		unqliteGenOutofMem(pCol->pVm->pDb);
+		return UNQLITE_NOMEM;
+	}
+	/* Index the existing records */
+	jx9MemObjInit(pCol->pVm->pJx9Vm,&sRecord);
+	for( nId = 0 ; nId < pCol->nLastid ; ++nId ){
+		if( CollectionFetchRecord(pCol,nId,&sRecord,0) != UNQLITE_OK ){
+			continue;
+		}
+		rc = CollectionIndexAppend(pCol,&sField,&sRecord,nId);
+		if( rc != UNQLITE_OK ){
+			break;
+		}
+	}
+	jx9MemObjRelease(&sRecord);
+	if( rc == UNQLITE_OK ){
+		/* Persist the index definition */
+		rc = CollectionIndexSave(pCol);
+	}
+	if( rc != UNQLITE_OK ){
+		unqliteGenErrorFormat(pCol->pVm->pDb,
+				"IO error while indexing field '%z' of collection '%z'",
+				&sField,&pCol->sName
+			);
+		/* Forget about this index */
+		pCol->aIndex.nUsed--;
+		SyMemBackendFree(&pCol->pVm->sAlloc,zDup);
+	}
+	return rc;
+}
+/*
+ * Drop the index on a given field of a collection.
+ */
+UNQLITE_PRIVATE int unqliteCollectionDropIndex(unqlite_col *pCol,const SyString *pField)
+{
+	SyString *aField;
+	sxi32 iSlot;
+	sxu32 n;
+	int rc;
+	iSlot = CollectionIndexFind(pCol,pField);
+	if( iSlot < 0 ){
+		/* No such index */
+		return UNQLITE_NOTFOUND;
+	}
+	/* Remove the posting lists */
+	rc = CollectionIndexPurge(pCol,pField);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	/* Forget about the field */
+	aField = (SyString *)SySetBasePtr(&pCol->aIndex);
+	SyMemBackendFree(&pCol->pVm->sAlloc,(void *)aField[iSlot].zString);
+	for( n = (sxu32)iSlot ; n + 1 < SySetUsed(&pCol->aIndex) ; ++n ){
+		aField[n] = aField[n + 1];
+	}
+	pCol->aIndex.nUsed--;
+	return CollectionIndexSave(pCol);
+}
+/*
+ * Fetch the records of a given collection whose top-level field pField
+ * equals pValue and append them to the pArray JSON array.
+ * The posting list is used if the field is indexed. Otherwise the whole
+ * collection is scanned.
+ */
+UNQLITE_PRIVATE int unqliteCollectionFetchByValue(
+	unqlite_col *pCol,       /* Target collection */
+	const SyString *pField,  /* Field name */
+	jx9_value *pValue,       /* Field value */
+	jx9_value *pArray        /* OUT: Matching records */
+	)
+{
+	jx9_value sRecord;
+	SyBlob sData;
+	int rc;
+	rc = CollectionIndexKey(pCol,pField,pValue,FALSE);
+	if( rc != UNQLITE_OK ){
+		/* Non scalar value, nothing can match */
+		return UNQLITE_OK;
+	}
+	jx9MemObjInit(pCol->pVm->pJx9Vm,&sRecord);
+	SyBlobInit(&sData,&pCol->pVm->sAlloc);
+	if( CollectionIndexFind(pCol,pField) >= 0 ){
+		const unsigned char *zList;
+		sxu32 nByte,i;
+		sxu64 nId;
+		/* Load the posting list */
+		rc = CollectionIndexSeek(pCol,&sData);
+		if( rc == UNQLITE_OK ){
+			zList = (const unsigned char *)SyBlobData(&sData);
+			nByte = SyBlobLength(&sData) & ~7;
+			for( i = 0 ; i < nByte ; i += 8 ){
+				SyBigEndianUnpack64(&zList[i],&nId);
+				if( unqliteCollectionFetchRecordById(pCol,(jx9_int64)nId,&sRecord) == UNQLITE_OK ){
+					jx9_array_add_elem(pArray,0,&sRecord);
+				}
+			}
+		}else if( rc == UNQLITE_NOTFOUND ){
+			/* No record with this value */
+			rc = UNQLITE_OK;
+		}
+	}else{
+		jx9_int64 nId;
+		/* Not indexed, compare the encoded field of each record */
+		SyBlobDup(&pCol->sIndexKey,&sData);
+		for( nId = 0 ; nId < pCol->nLastid ; ++nId ){
+			if( CollectionFetchRecord(pCol,nId,&sRecord,0) != UNQLITE_OK ){
+				continue;
+			}
+			if( CollectionIndexKey(pCol,pField,&sRecord,TRUE) == UNQLITE_OK &&
+				SyBlobLength(&pCol->sIndexKey) == SyBlobLength(&sData) &&
+				SyMemcmp(SyBlobData(&pCol->sIndexKey),SyBlobData(&sData),SyBlobLength(&sData)) == 0 ){
+					jx9_array_add_elem(pArray,0,&sRecord);
+			}
+		}
+	}
+	SyBlobRelease(&sData);
+	jx9MemObjRelease(&sRecord);
+	return rc;
+}
 /*
  * Perform a store operation on a given collection.
  */
@@ -58806,12 +66260,16 @@ static int CollectionStore(
 		);
 	if( rc == UNQLITE_OK ){
 		/* Save the value in the cache */
-		CollectionCacheInstallRecord(pCol,pCol->nLastid,pValue);
+		CollectionCacheInstallRecord(pCol,pCol->nLastid,pValue,SyBlobLength(pWorker)-nKeyLen);
+		/* Update the secondary indexes */
+		rc = CollectionIndexInsert(pCol,pValue,pCol->nLastid);
+	}
+	if( rc == UNQLITE_OK ){
 		/* Increment the unique __id */
 		pCol->nLastid++;
 		pCol->nTotRec++;
-		/* Reflect the change */
-		rc = CollectionSetHeader(0,pCol,pCol->nLastid,pCol->nTotRec,0);
+		/* The header is written once for the whole batch, see unqliteVmSyncCollections() */
+		pCol->iFlags |= UNQLITE_COL_HEADER_DIRTY;
 	}
 	if( rc != UNQLITE_OK ){
 		unqliteGenErrorFormat(pCol->pVm->pDb,
@@ -58862,7 +66320,17 @@ UNQLITE_PRIVATE int unqliteCollectionDropRecord(
 	)
 {
 	SyBlob *pWorker = &pCol->sWorker;
+	jx9_value sRecord;
+	int bIndexed = 0;
 	int rc;		
+	if( SySetUsed(&pCol->aIndex) > 0 ){
+		/* Grab the record content so that its index entries can be removed */
+		jx9MemObjInit(pCol->pVm->pJx9Vm,&sRecord);
+		bIndexed = CollectionFetchRecord(pCol,nId,&sRecord,0) == UNQLITE_OK;
+		if( !bIndexed ){
+			jx9MemObjRelease(&sRecord);
+		}
+	}
 	/* Reset the working buffer */
 	SyBlobReset(pWorker);
 	/* Prepare the unique ID for this record */
@@ -58875,17 +66343,28 @@ UNQLITE_PRIVATE int unqliteCollectionDropRecord(
 		UNQLITE_CURSOR_MATCH_EXACT
 		);
 	if( rc != UNQLITE_OK ){
+		if( bIndexed ){
+			jx9MemObjRelease(&sRecord);
+		}
 		return rc;
 	}
 	/* Remove the record from the storage engine */
 	rc = unqlite_kv_cursor_delete_entry(pCol->pCursor);
 	/* Finally, Remove the record from the cache */
 	unqliteCollectionCacheRemoveRecord(pCol,nId);
+	if( bIndexed ){
+		if( rc == UNQLITE_OK ){
+			/* Remove the record ID from the posting lists */
+			rc = CollectionIndexRemove(pCol,&sRecord,nId);
+		}
+		jx9MemObjRelease(&sRecord);
+	}
 	if( rc == UNQLITE_OK ){
 		pCol->nTotRec--;
+		pCol->iFlags |= UNQLITE_COL_HEADER_DIRTY;
 		if( wr_header ){
-			/* Relect in the collection header */
-			rc = CollectionSetHeader(0,pCol,-1,pCol->nTotRec,0);
+			/* Relect in the collection header together with the deferred stores */
+			rc = CollectionSyncHeader(pCol);
 		}
 	}else if( rc == UNQLITE_NOTIMPLEMENTED ){
 		if( log_err ){
@@ -58924,6 +66403,12 @@ UNQLITE_PRIVATE int unqliteDropCollection(unqlite_col *pCol)
 			);
 		return rc;
 	}
+	if( SySetUsed(&pCol->aIndex) > 0 ){
+		/* Drop the posting lists and the index definitions */
+		CollectionIndexPurge(pCol,0);
+		CollectionIndexRelease(pCol);
+		CollectionIndexSave(pCol);
+	}
 	/* Drop collection records */
 	for( nId = 0 ; nId < pCol->nLastid ; ++nId ){
 		unqliteCollectionDropRecord(pCol,nId,0,0);
@@ -58932,6 +66417,7 @@ UNQLITE_PRIVATE int unqliteDropCollection(unqlite_col *pCol)
 	CollectionCacheRelease(pCol);
 	SyBlobRelease(&pCol->sHeader);
 	SyBlobRelease(&pCol->sWorker);
+	CollectionIndexRelease(pCol);
 	SyMemBackendFree(&pVm->sAlloc,(void *)SyStringData(&pCol->sName));
 	unqliteReleaseCursor(pVm->pDb,pCol->pCursor);
 	/* Unlink */
@@ -59123,10 +66609,11 @@ static int unqliteBuiltin_collection_create(jx9_context *pCtx,int argc,jx9_value
 	return JX9_OK;
 }
 /*
- * value db_fetch(string $col_name)
- * value db_get(string $col_name)
+ * value db_fetch(string $col_name,[callback filter_callback])
+ * value db_get(string $col_name,[callback filter_callback])
  *   Fetch the current record from a given collection and advance
- *   the record cursor.
+ *   the record cursor. If a filter callback is given, records are
+ *   skipped until the callback returns TRUE.
  * Parameter
  *   col_name: Collection name
  * Return
@@ -59161,14 +66648,37 @@ static int unqliteBuiltin_db_fetch_next(jx9_context *pCtx,int argc,jx9_value **a
 	pCol = unqliteCollectionFetch(pVm,&sName,UNQLITE_VM_AUTO_LOAD);
 	if( pCol ){
 		/* Fetch the current record */
-		jx9_value *pValue;
+		jx9_value *pValue,*pCallback = 0;
 		pValue = jx9_context_new_scalar(pCtx);
 		if( pValue == 0 ){
 			jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Jx9 is running out of memory");
 			jx9_result_null(pCtx);
 			return JX9_OK;
 		}else{
-			rc = unqliteCollectionFetchNextRecord(pCol,pValue);
+			if( argc > 1 && jx9_value_is_callable(argv[1]) ){
+				pCallback = argv[1];
+			}
+			for(;;){
+				jx9_value *apArg[2];
+				jx9_value sResult; /* Callback result */
+				rc = unqliteCollectionFetchNextRecord(pCol,pValue);
+				if( rc != UNQLITE_OK || pCallback == 0 ){
+					break;
+				}
+				/* Invoke the filter callback */
+				jx9MemObjInit(pCtx->pVm,&sResult);
+				apArg[0] = pValue;
+				rc = jx9VmCallUserFunction(pCtx->pVm,pCallback,1,apArg,&sResult);
+				if( rc != JX9_OK || jx9_value_to_bool(&sResult) ){
+					/* Record accepted */
+					jx9MemObjRelease(&sResult);
+					rc = UNQLITE_OK;
+					break;
+				}
+				jx9MemObjRelease(&sResult);
+				/* Discard the record and try the next one */
+				jx9_value_null(pValue);
+			}
 			if( rc == UNQLITE_OK ){
 				jx9_result_value(pCtx,pValue);
 				/* pValue will be automatically released as soon we return from this function */
@@ -59313,7 +66823,6 @@ static int unqliteBuiltin_db_fetch_all(jx9_context *pCtx,int argc,jx9_value **ar
 					iResult = jx9_value_to_bool(&sResult);
 					if( !iResult ){
 						/* Discard the result */
-						unqliteCollectionCacheRemoveRecord(pCol,unqliteCollectionCurrentRecordId(pCol) - 1);
 						continue;
 					}
 				}
@@ -59335,6 +66844,78 @@ static int unqliteBuiltin_db_fetch_all(jx9_context *pCtx,int argc,jx9_value **ar
 	}
 	return JX9_OK;
 }
+/*
+ * array db_fetch_by(string $col_name,string $field,value $value)
+ * array db_get_by(string $col_name,string $field,value $value)
+ *   Retrieve the records of a given collection whose top-level field
+ *   equals the given scalar value. The index on this field is used
+ *   if available (Refer to db_create_index()), otherwise the whole
+ *   collection is scanned.
+ * Parameter
+ *   col_name: Collection name
+ *   field: Field name
+ *   value: Field value (null, boolean, number or string)
+ * Return
+ *    Matching records (JSON array) on success. NULL on failure.
+ */
+static int unqliteBuiltin_db_fetch_by(jx9_context *pCtx,int argc,jx9_value **argv)
+{
+	unqlite_col *pCol;
+	const char *zName;
+	unqlite_vm *pVm;
+	SyString sName,sField;
+	int nByte;
+	int rc;
+	/* Extract collection name */
+	if( argc < 3 ){
+		/* Missing arguments */
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Missing collection name, field name and/or field value");
+		/* Return NULL */
+		jx9_result_null(pCtx);
+		return JX9_OK;
+	}
+	zName = jx9_value_to_string(argv[0],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid collection name");
+		/* Return NULL */
+		jx9_result_null(pCtx);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sName,zName,nByte);
+	/* Extract the field name */
+	zName = jx9_value_to_string(argv[1],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid field name");
+		/* Return NULL */
+		jx9_result_null(pCtx);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sField,zName,nByte);
+	pVm = (unqlite_vm *)jx9_context_user_data(pCtx);
+	/* Fetch the collection */
+	pCol = unqliteCollectionFetch(pVm,&sName,UNQLITE_VM_AUTO_LOAD);
+	if( pCol ){
+		jx9_value *pArray;
+		/* Allocate an empty JSON array */
+		pArray = jx9_context_new_array(pCtx);
+		if( pArray == 0 ){
+			jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Jx9 is running out of memory");
+			jx9_result_null(pCtx);
+			return JX9_OK;
+		}
+		/* Collect the matching records */
+		rc = unqliteCollectionFetchByValue(pCol,&sField,argv[2],pArray);
+		if( rc == UNQLITE_OK ){
+			jx9_result_value(pCtx,pArray);
+		}else{
+			jx9_result_null(pCtx);
+		}
+	}else{
+		/* No such collection, return null */
+		jx9_result_null(pCtx);
+	}
+	return JX9_OK;
+}
 /*
  * int64 db_last_record_id(string $col_name)
  *   Return the ID of the last inserted record.
@@ -59710,6 +67291,122 @@ static int unqliteBuiltin_db_drop_record(jx9_context *pCtx,int argc,jx9_value **
 	jx9_result_bool(pCtx,rc == UNQLITE_OK);
 	return JX9_OK;
 }
+/*
+ * bool db_create_index(string $col_name,string $field)
+ *   Index a top-level field of the records of a given collection.
+ *   The index is built from the records already stored and is then
+ *   maintained by db_store() and db_drop_record().
+ * Parameter
+ *   col_name: Collection name.
+ *   field: Name of the field to be indexed.
+ * Return
+ *    TRUE on success. FALSE on failure.
+ */
+static int unqliteBuiltin_db_create_index(jx9_context *pCtx,int argc,jx9_value **argv)
+{
+	unqlite_col *pCol;
+	const char *zName;
+	unqlite_vm *pVm;
+	SyString sName,sField;
+	int nByte;
+	int rc;
+	/* Extract collection name */
+	if( argc < 2 ){
+		/* Missing arguments */
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Missing collection name and/or field name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	zName = jx9_value_to_string(argv[0],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid collection name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sName,zName,nByte);
+	/* Extract the field name */
+	zName = jx9_value_to_string(argv[1],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid field name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sField,zName,nByte);
+	pVm = (unqlite_vm *)jx9_context_user_data(pCtx);
+	/* Fetch the collection */
+	pCol = unqliteCollectionFetch(pVm,&sName,UNQLITE_VM_AUTO_LOAD);
+	if( pCol == 0 ){
+		jx9_context_throw_error_format(pCtx,JX9_CTX_ERR,"No such collection '%z'",&sName);
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	/* Create the index */
+	rc = unqliteCollectionCreateIndex(pCol,&sField);
+	/* Processing result */
+	jx9_result_bool(pCtx,rc == UNQLITE_OK);
+	return JX9_OK;
+}
+/*
+ * bool db_drop_index(string $col_name,string $field)
+ *   Remove the index on a given field of a collection.
+ * Parameter
+ *   col_name: Collection name.
+ *   field: Name of the indexed field.
+ * Return
+ *    TRUE on success. FALSE on failure (No such index).
+ */
+static int unqliteBuiltin_db_drop_index(jx9_context *pCtx,int argc,jx9_value **argv)
+{
+	unqlite_col *pCol;
+	const char *zName;
+	unqlite_vm *pVm;
+	SyString sName,sField;
+	int nByte;
+	int rc;
+	/* Extract collection name */
+	if( argc < 2 ){
+		/* Missing arguments */
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Missing collection name and/or field name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	zName = jx9_value_to_string(argv[0],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid collection name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sName,zName,nByte);
+	/* Extract the field name */
+	zName = jx9_value_to_string(argv[1],&nByte);
+	if( nByte < 1){
+		jx9_context_throw_error(pCtx,JX9_CTX_ERR,"Invalid field name");
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	SyStringInitFromBuf(&sField,zName,nByte);
+	pVm = (unqlite_vm *)jx9_context_user_data(pCtx);
+	/* Fetch the collection */
+	pCol = unqliteCollectionFetch(pVm,&sName,UNQLITE_VM_AUTO_LOAD);
+	if( pCol == 0 ){
+		jx9_context_throw_error_format(pCtx,JX9_CTX_ERR,"No such collection '%z'",&sName);
+		/* Return false */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+	/* Drop the index */
+	rc = unqliteCollectionDropIndex(pCol,&sField);
+	/* Processing result */
+	jx9_result_bool(pCtx,rc == UNQLITE_OK);
+	return JX9_OK;
+}
 /*
  * bool db_set_schema(string $col_name, object $json_object)
  *   Set a schema for a given collection.
@@ -59856,8 +67553,12 @@ static int unqliteBuiltin_db_commit(jx9_context *pCtx,int argc,jx9_value **argv)
 	pVm = (unqlite_vm *)jx9_context_user_data(pCtx);
 	/* Point to the underlying database handle  */
 	pDb = pVm->pDb;
-	/* Commit the transaction if any */
-	rc = unqlitePagerCommit(pDb->sDB.pPager);
+	/* Write the deferred collection headers first */
+	rc = unqliteVmSyncCollections(pVm);
+	if( rc == UNQLITE_OK ){
+		/* Commit the transaction if any */
+		rc = unqlitePagerCommit(pDb->sDB.pPager);
+	}
 	/* Commit result */
 	jx9_result_bool(pCtx,rc == UNQLITE_OK );
 	return JX9_OK;
@@ -59881,8 +67582,17 @@ static int unqliteBuiltin_db_rollback(jx9_context *pCtx,int argc,jx9_value **arg
 	pVm = (unqlite_vm *)jx9_context_user_data(pCtx);
 	/* Point to the underlying database handle  */
 	pDb = pVm->pDb;
+#if defined(UNQLITE_ENABLE_THREADS)
+	if( pDb->bCommitLeader ){
+		/* A group commit is gathering, its changes must not be discarded */
+		jx9_result_bool(pCtx,0);
+		return JX9_OK;
+	}
+#endif
 	/* Rollback the transaction if any */
 	rc = unqlitePagerRollback(pDb->sDB.pPager,TRUE);
+	/* The in-memory collection headers are stale now */
+	unqliteVmRollbackCollections(pVm);
 	/* Rollback result */
 	jx9_result_bool(pCtx,rc == UNQLITE_OK );
 	return JX9_OK;
@@ -59908,6 +67618,8 @@ UNQLITE_PRIVATE int unqliteRegisterJx9Functions(unqlite_vm *pVm)
 		{ "db_get_by_id",      unqliteBuiltin_db_fetch_by_id    },
 		{ "db_fetch_all",      unqliteBuiltin_db_fetch_all      },
 		{ "db_get_all",        unqliteBuiltin_db_fetch_all      },
+		{ "db_fetch_by",       unqliteBuiltin_db_fetch_by       },
+		{ "db_get_by",         unqliteBuiltin_db_fetch_by       },
 		{ "db_last_record_id", unqliteBuiltin_db_last_record_id },
 		{ "db_current_record_id", unqliteBuiltin_db_current_record_id },
 		{ "db_reset_record_cursor", unqliteBuiltin_db_reset_record_cursor },
@@ -59918,6 +67630,8 @@ UNQLITE_PRIVATE int unqliteRegisterJx9Functions(unqlite_vm *pVm)
 		{ "db_drop_collection", unqliteBuiltin_db_drop_col      },
 		{ "collection_delete", unqliteBuiltin_db_drop_col       },
 		{ "db_drop_record",    unqliteBuiltin_db_drop_record    },
+		{ "db_create_index",   unqliteBuiltin_db_create_index   },
+		{ "db_drop_index",     unqliteBuiltin_db_drop_index     },
 		{ "db_set_schema",     unqliteBuiltin_db_set_schema     },
 		{ "db_get_schema",     unqliteBuiltin_db_get_schema     },
 		{ "db_begin",          unqliteBuiltin_db_begin          },
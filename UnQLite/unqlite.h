@@ -97,6 +97,10 @@ typedef struct jx9_value unqlite_value;
 typedef struct unqlite_vfs unqlite_vfs;
 typedef struct unqlite_vm unqlite_vm;
 typedef struct unqlite unqlite;
+typedef struct unqlite_pager_stats unqlite_pager_stats;
+typedef struct unqlite_mem_stats unqlite_mem_stats;
+typedef struct unqlite_record_cache_stats unqlite_record_cache_stats;
+typedef struct unqlite_snapshot unqlite_snapshot;
 /*
  * ------------------------------
  * Compile time directives
@@ -389,6 +393,91 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_CONFIG_KV_ENGINE           4  /* ONE ARGUMENT: const char *zKvName */
 #define UNQLITE_CONFIG_DISABLE_AUTO_COMMIT 5  /* NO ARGUMENTS */
 #define UNQLITE_CONFIG_GET_KV_NAME         6  /* ONE ARGUMENT: const char **pzPtr */
+#define UNQLITE_CONFIG_WAL_AUTOCHECKPOINT  7  /* ONE ARGUMENT: int nFrame */
+#define UNQLITE_CONFIG_WAL_CHECKPOINT      8  /* NO ARGUMENTS */
+#define UNQLITE_CONFIG_COMMIT_WINDOW       9  /* ONE ARGUMENT: int nMicroSec */
+#define UNQLITE_CONFIG_PAGER_STATS        10  /* TWO ARGUMENTS: unqlite_pager_stats *pStats, int bReset */
+#define UNQLITE_CONFIG_WRITE_BACK         11  /* TWO ARGUMENTS: int nMinPage, int *pnPage */
+#define UNQLITE_CONFIG_IN_WRITE_TRANSACTION 12 /* ONE ARGUMENT: int *pbOpen */
+#define UNQLITE_CONFIG_BEGIN_NEW          13  /* NO ARGUMENTS */
+/*
+ * Background write-back.
+ *
+ * Dirty pages are normally written to the database file by the thread committing
+ * the transaction. When invoked periodically from a background thread (multi-thread
+ * mode) with the UNQLITE_CONFIG_WRITE_BACK verb, [unqlite_config()] writes the unused
+ * dirty pages of the active transaction (sorted by page number) once at least nMinPage
+ * of them accumulated, so that the commit only has to write the residue. In write-ahead
+ * log mode, it checkpoints the log instead once it holds at least nMinPage frames and
+ * no write transaction is active. The number of pages written is stored in *pnPage
+ * (may be NULL). This is never an error to find nothing to write or a busy log.
+ */
+/*
+ * Write transaction state.
+ *
+ * When invoked with the UNQLITE_CONFIG_IN_WRITE_TRANSACTION verb, [unqlite_config()]
+ * stores a non-zero value in *pbOpen if a write transaction is open on the handle,
+ * zero otherwise. A handle opened with UNQLITE_OPEN_SHARED_CACHE releases its read
+ * lock when [unqlite_rollback()] is called outside of a write transaction, so that
+ * the other handles opened on the same file can commit.
+ * The UNQLITE_CONFIG_BEGIN_NEW verb opens a write transaction like [unqlite_begin()]
+ * but fails with UNQLITE_LOCKED instead of joining a write transaction already open,
+ * so that a caller sharing the handle never commits changes it did not make.
+ * In-memory databases have no write transaction.
+ */
+/*
+ * Pager statistics.
+ *
+ * An instance of the following structure is filled by [unqlite_config()] when
+ * invoked with the UNQLITE_CONFIG_PAGER_STATS verb. Counters are cumulative since
+ * the database was opened or since the last call with a non-zero bReset argument.
+ */
+struct unqlite_pager_stats
+{
+  unqlite_int64 nCacheHit;    /* Page requests served from memory */
+  unqlite_int64 nCacheMiss;   /* Page requests that had to load the page */
+  unqlite_int64 nCacheEvict;  /* Unused pages evicted from the page cache */
+  unqlite_int64 nPageRead;    /* Pages read from the database file or the write-ahead log */
+  unqlite_int64 nSharedHit;   /* Pages served by another handle (UNQLITE_OPEN_SHARED_CACHE) */
+  unqlite_int64 nPageWrite;   /* Pages written to the database file or the write-ahead log */
+  unqlite_int64 nHotFlush;    /* Hot dirty pages flushed before commit time */
+  unqlite_int64 nJournalByte; /* Bytes written to the rollback journal */
+  unqlite_int64 nSync;        /* Total number of sync operations */
+  unqlite_int64 iSyncTime;    /* Time spent in sync operations (microseconds) */
+  unsigned int nPage;         /* Pages currently in memory */
+  unsigned int nHot;          /* Hot dirty pages currently in memory */
+  unsigned int nCacheMax;     /* Page cache limit (UNQLITE_CONFIG_MAX_PAGE_CACHE) */
+};
+/*
+ * Page cache.
+ *
+ * Clean pages no longer referenced by the storage engine are kept in memory, up to
+ * UNQLITE_CONFIG_MAX_PAGE_CACHE pages (2048 by default). Pages looked up repeatedly
+ * are protected from the pages only touched once, so that a full cursor scan does not
+ * evict the working set of point lookups. Only the pages released by the storage engine
+ * are subject to this limit: the linear hash engine ("hash", the default) keeps the
+ * bucket pages it loads referenced while the database is open, so neither the limit
+ * nor the scan resistance apply to them. The B+Tree engine ("btree") releases its
+ * clean pages between calls.
+ */
+/*
+ * Memory allocator statistics.
+ *
+ * In multi-thread mode, the allocators shared by several threads keep a small cache
+ * of free chunks per thread so that most allocations do not lock the shared pools.
+ * An instance of the following structure is filled by [unqlite_lib_mem_stats()]
+ * with the counters of these caches, summed over the whole library. Counters are
+ * cumulative since the library was initialized or since the last call with a
+ * non-zero bReset argument. They are always zero in single-thread mode.
+ */
+struct unqlite_mem_stats
+{
+  unqlite_int64 nCacheHit;  /* Allocations served by a per-thread cache */
+  unqlite_int64 nRefill;    /* Batches of chunks taken from the shared pools */
+  unqlite_int64 nFlush;     /* Batches of chunks given back to the shared pools */
+  unqlite_int64 nLockWait;  /* Times a shared pool was locked by another thread */
+  unsigned int nCached;     /* Chunks currently held by the per-thread caches */
+};
 /*
  * UnQLite/Jx9 Virtual Machine Configuration Commands.
  *
@@ -419,6 +508,28 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_VM_CONFIG_IO_STREAM       11  /* ONE ARGUMENT: const unqlite_io_stream *pStream */
 #define UNQLITE_VM_CONFIG_ARGV_ENTRY      12  /* ONE ARGUMENT: const char *zValue */
 #define UNQLITE_VM_CONFIG_EXTRACT_OUTPUT  13  /* TWO ARGUMENTS: const void **ppOut, unsigned int *pOutputLen */
+#define UNQLITE_VM_CONFIG_RECORD_CACHE    14  /* ONE ARGUMENT: unsigned int nMaxByte */
+#define UNQLITE_VM_CONFIG_RECORD_CACHE_STATS 15 /* TWO ARGUMENTS: unqlite_record_cache_stats *pStats, int bReset */
+/*
+ * Collection record cache statistics.
+ *
+ * Each virtual machine keeps the collection records it fetched or stored in decoded
+ * form, so that they are not read and decoded again. The cache holds at most
+ * UNQLITE_VM_CONFIG_RECORD_CACHE bytes (4MB by default, zero disables it), the least
+ * recently used records being evicted first. An instance of the following structure
+ * is filled by [unqlite_vm_config()] when invoked with the UNQLITE_VM_CONFIG_RECORD_CACHE_STATS
+ * verb. Counters are cumulative since the script was compiled or since the last call
+ * with a non-zero bReset argument.
+ */
+struct unqlite_record_cache_stats
+{
+  unqlite_int64 nHit;       /* Record lookups served from the cache */
+  unqlite_int64 nMiss;      /* Record lookups that had to read and decode the record */
+  unqlite_int64 nEvict;     /* Records evicted to stay within the budget */
+  unsigned int nRecord;     /* Records currently cached */
+  unsigned int nByte;       /* Estimated size of the cached records */
+  unsigned int nMaxByte;    /* Cache budget (UNQLITE_VM_CONFIG_RECORD_CACHE) */
+};
 /*
  * Storage engine configuration commands.
  *
@@ -434,6 +545,9 @@ typedef sxi64 unqlite_int64;
  */
 #define UNQLITE_KV_CONFIG_HASH_FUNC  1 /* ONE ARGUMENT: unsigned int (*xHash)(const void *,unsigned int) */
 #define UNQLITE_KV_CONFIG_CMP_FUNC   2 /* ONE ARGUMENT: int (*xCmp)(const void *,const void *,unsigned int) */
+#define UNQLITE_KV_CONFIG_GET_BUCKET 3 /* THREE ARGUMENTS: const void *pKey,int nKeyLen,unqlite_int64 *pBucket */
+#define UNQLITE_KV_CONFIG_HASH_SEED  4 /* ONE ARGUMENT: unsigned int nSeed */
+#define UNQLITE_KV_CONFIG_COMPACT    5 /* NO ARGUMENTS */
 /*
  * Global Library Configuration Commands.
  *
@@ -479,6 +593,8 @@ typedef sxi64 unqlite_int64;
 #define UNQLITE_OPEN_OMIT_JOURNALING  0x00000040  /* Omit journaling for this database. Ok for [unqlite_open] */
 #define UNQLITE_OPEN_IN_MEMORY        0x00000080  /* An in memory database. Ok for [unqlite_open]*/
 #define UNQLITE_OPEN_MMAP             0x00000100  /* Obtain a memory view of the whole file. Ok for [unqlite_open] */
+#define UNQLITE_OPEN_WAL              0x00000200  /* Write-ahead log journaling. Ok for [unqlite_open] */
+#define UNQLITE_OPEN_SHARED_CACHE     0x00000400  /* Share clean pages with the other handles opened on the same file. Ok for [unqlite_open] */
 /*
  * Synchronization Type Flags
  *
@@ -559,9 +675,18 @@ struct unqlite_file {
  * the file. The sector size is the minimum write that can be performed without
  * disturbing other bytes in the file.
  *
+ * The xFileId() method (iVersion 2 and later, may be NULL) reports the device and inode
+ * numbers of the file. Handles opened with the [UNQLITE_OPEN_SHARED_CACHE] flag use them
+ * to recognize each other. Without it, each handle keeps its own pages.
+ *
+ * The xWritev() method (iVersion 3 and later, may be NULL) writes nBuf buffers of iBufSize
+ * bytes each, back to back starting at offset iOfst, with as few system calls as possible.
+ * It is used to write runs of consecutive pages. Without it, each buffer is written
+ * by a separate call to xWrite().
+ *
  */
 struct unqlite_io_methods {
-  int iVersion;                 /* Structure version number (currently 1) */
+  int iVersion;                 /* Structure version number (currently 3) */
   int (*xClose)(unqlite_file*);
   int (*xRead)(unqlite_file*, void*, unqlite_int64 iAmt, unqlite_int64 iOfst);
   int (*xWrite)(unqlite_file*, const void*, unqlite_int64 iAmt, unqlite_int64 iOfst);
@@ -572,6 +697,8 @@ struct unqlite_io_methods {
   int (*xUnlock)(unqlite_file*, int);
   int (*xCheckReservedLock)(unqlite_file*, int *pResOut);
   int (*xSectorSize)(unqlite_file*);
+  int (*xFileId)(unqlite_file*, unqlite_int64 *pDev, unqlite_int64 *pIno);
+  int (*xWritev)(unqlite_file*, const void * const *apBuf, int nBuf, unqlite_int64 iBufSize, unqlite_int64 iOfst);
 };
 /*
  * CAPIREF: OS Interface Object
@@ -720,9 +847,14 @@ struct unqlite_kv_cursor
  * UnQLite works with run-time interchangeable storage engines (i.e. Hash, B+Tree, R+Tree, LSM, etc.).
  * The storage engine works with key/value pairs where both the key
  * and the value are byte arrays of arbitrary length and with no restrictions on content.
- * UnQLite come with two built-in KV storage engine: A Virtual Linear Hash (VLH) storage
- * engine is used for persistent on-disk databases with O(1) lookup time and an in-memory
- * hash-table or Red-black tree storage engine is used for in-memory databases.
+ * UnQLite come with four built-in KV storage engine: A Virtual Linear Hash (VLH) storage
+ * engine is used by default for persistent on-disk databases with O(1) lookup time,
+ * an ordered B+Tree storage engine named "btree" with O(log n) lookups and range cursors
+ * can be selected for a fresh database via [unqlite_config()] with a configuration verb
+ * set to UNQLITE_CONFIG_KV_ENGINE and an in-memory
+ * hash-table storage engine is used for in-memory databases. An ordered in-memory
+ * skip list named "skiplist" can be selected the same way before the first record
+ * of an in-memory database is stored.
  * Future versions of UnQLite might add other built-in storage engines (i.e. LSM). 
  * Registration of a Key/Value storage engine at run-time is done via [unqlite_lib_config()]
  * with a configuration verb set to UNQLITE_LIB_CONFIG_STORAGE_ENGINE.
@@ -782,6 +914,12 @@ struct unqlite_kv_methods
 #ifndef UNQLITE_JOURNAL_FILE_SUFFIX
 #define UNQLITE_JOURNAL_FILE_SUFFIX "_unqlite_journal"
 #endif
+/*
+ * UnQLite write-ahead log file suffix (UNQLITE_OPEN_WAL).
+ */
+#ifndef UNQLITE_WAL_FILE_SUFFIX
+#define UNQLITE_WAL_FILE_SUFFIX "_unqlite_wal"
+#endif
 /*
  * Call Context - Error Message Serverity Level.
  *
@@ -812,6 +950,10 @@ UNQLITE_APIEXPORT int unqlite_kv_fetch(unqlite *pDb,const void *pKey,int nKeyLen
 UNQLITE_APIEXPORT int unqlite_kv_fetch_callback(unqlite *pDb,const void *pKey,
 	                    int nKeyLen,int (*xConsumer)(const void *,unsigned int,void *),void *pUserData);
 UNQLITE_APIEXPORT int unqlite_kv_delete(unqlite *pDb,const void *pKey,int nKeyLen);
+UNQLITE_APIEXPORT int unqlite_kv_store_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,
+	                    const void **apData,const unqlite_int64 *anDataLen);
+UNQLITE_APIEXPORT int unqlite_kv_fetch_batch(unqlite *pDb,int nEntry,const void **apKey,const int *anKeyLen,
+	                    int (*xConsumer)(int,const void *,unsigned int,void *),void *pUserData,int *aRc);
 UNQLITE_APIEXPORT int unqlite_kv_config(unqlite *pDb,int iOp,...);
 
 /* Document (JSON) Store Interfaces powered by the Jx9 Scripting Language */
@@ -840,6 +982,12 @@ UNQLITE_APIEXPORT int unqlite_kv_cursor_data_callback(unqlite_kv_cursor *pCursor
 UNQLITE_APIEXPORT int unqlite_kv_cursor_delete_entry(unqlite_kv_cursor *pCursor);
 UNQLITE_APIEXPORT int unqlite_kv_cursor_reset(unqlite_kv_cursor *pCursor);
 
+/* Snapshot (Consistent Read) Interfaces */
+UNQLITE_APIEXPORT int unqlite_snapshot_open(unqlite *pDb,unqlite_snapshot **ppOut);
+UNQLITE_APIEXPORT int unqlite_snapshot_release(unqlite *pDb,unqlite_snapshot *pSnap);
+UNQLITE_APIEXPORT int unqlite_snapshot_cursor_init(unqlite_snapshot *pSnap,unqlite_kv_cursor **ppOut);
+UNQLITE_APIEXPORT int unqlite_snapshot_cursor_release(unqlite_snapshot *pSnap,unqlite_kv_cursor *pCur);
+
 /* Manual Transaction Manager */
 UNQLITE_APIEXPORT int unqlite_begin(unqlite *pDb);
 UNQLITE_APIEXPORT int unqlite_commit(unqlite *pDb);
@@ -941,6 +1089,7 @@ UNQLITE_APIEXPORT int unqlite_lib_config(int nConfigOp,...);
 UNQLITE_APIEXPORT int unqlite_lib_init(void);
 UNQLITE_APIEXPORT int unqlite_lib_shutdown(void);
 UNQLITE_APIEXPORT int unqlite_lib_is_threadsafe(void);
+UNQLITE_APIEXPORT int unqlite_lib_mem_stats(unqlite_mem_stats *pStats,int bReset);
 UNQLITE_APIEXPORT const char * unqlite_lib_version(void);
 UNQLITE_APIEXPORT const char * unqlite_lib_signature(void);
 UNQLITE_APIEXPORT const char * unqlite_lib_ident(void);
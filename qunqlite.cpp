@@ -24,12 +24,30 @@
  */
 
 #include "qunqlite.h"
+#include "qunqlitecollectioncursor.h"
 #include "qunqlitecursor.h"
+#include "qunqlitesnapshot.h"
+#include "qunqlitestatement.h"
+
+#include <QFutureInterface>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <cstring>
 
 class QUnQLite::Private
 {
 public:
-    Private(QUnQLite * q_ptr) : q(q_ptr) {}
+    Private(QUnQLite * q_ptr) : q(q_ptr), borrowed(false), running(false), closing(false), backgroundWriter(NULL)
+    {
+        // A single worker keeps the requests in order
+        workers.setMaxThreadCount(1);
+    }
 
     void setResultCode(int rc)
     {
@@ -41,13 +59,322 @@ public:
         return resultCode == QUnQLite::Ok;
     }
 
+    void releaseStatements()
+    {
+        const QList<QUnQLiteCollectionCursor *> cursors = collectionCursors;
+        collectionCursors.clear();
+        qDeleteAll(cursors);
+        const QList<QUnQLiteStatement *> prepared = statements.values();
+        statements.clear();
+        qDeleteAll(prepared);
+    }
+
     QUnQLite::ResultCode resultCode;
     unqlite *db;
+    bool borrowed; // Handle is owned by a QUnQLitePool
+    QHash<QString, QUnQLiteStatement *> statements;
+    QList<QUnQLiteCollectionCursor *> collectionCursors;
+
+    /*
+     * A request of the asynchronous API, see storeAsync().
+     */
+    struct Request
+    {
+        enum Type { Store, Append, Remove, Commit, Fetch };
+
+        bool isWrite() const { return type != Fetch; }
+
+        Type type;
+        QByteArray key;
+        QByteArray value;
+        QFutureInterface<bool> done;
+        QFutureInterface<QByteArray> record;
+    };
+
+    class Worker : public QRunnable
+    {
+    public:
+        Worker(Private *d_ptr) : d(d_ptr) {}
+        void run() { d->runRequests(); }
+
+    private:
+        Private *d;
+    };
+
+    void post(const Request &request);
+    void runRequests();
+    int beginWrites();
+    void runWrites(QList<Request> &batch);
+    void runFetch(Request &request);
+    void transactionEnded();
+    void finishRequests();
+
+    QThreadPool workers;
+    QMutex queueMutex;
+    QQueue<Request> queue;
+    bool running;
+    bool closing; // close() is waiting for the requests
+    QWaitCondition noTransaction; // See beginWrites()
+
+    /*
+     * Writes dirty pages back every interval milliseconds, see setBackgroundWriter().
+     */
+    class BackgroundWriter : public QThread
+    {
+    public:
+        BackgroundWriter(unqlite *db_ptr, int interval, int minPages) :
+            db(db_ptr), interval(interval), minPages(minPages), stopped(false) {}
+        void stop();
+
+    protected:
+        void run();
+
+    private:
+        unqlite *db;
+        int interval;
+        int minPages;
+        bool stopped;
+        QMutex mutex;
+        QWaitCondition wakeUp;
+    };
+
+    void stopBackgroundWriter();
+
+    BackgroundWriter *backgroundWriter;
 
 private:
     Q_POINTER(QUnQLite)
 };
 
+/*
+ * Data consumers handed to unqlite_kv_fetch_callback().
+ * The storage engine invokes them once per chunk of record data,
+ * so a record is read with a single lookup and without intermediate copies.
+ */
+struct ByteArrayConsumer
+{
+    QByteArray *buffer;
+    int length;
+};
+
+static int byteArrayConsumer(const void *data, unsigned int length, void *userData)
+{
+    ByteArrayConsumer *consumer = static_cast<ByteArrayConsumer *>(userData);
+    const int required = consumer->length + static_cast<int>(length);
+    if(consumer->buffer->size() < required) {
+        consumer->buffer->resize(qMax(required, consumer->length * 2));
+    }
+    memcpy(consumer->buffer->data() + consumer->length, data, length);
+    consumer->length = required;
+    return UNQLITE_OK;
+}
+
+struct BufferConsumer
+{
+    char *buffer;
+    qint64 capacity;
+    qint64 length;
+};
+
+static int bufferConsumer(const void *data, unsigned int length, void *userData)
+{
+    BufferConsumer *consumer = static_cast<BufferConsumer *>(userData);
+    if(consumer->length < consumer->capacity) {
+        const qint64 n = qMin<qint64>(length, consumer->capacity - consumer->length);
+        memcpy(consumer->buffer + consumer->length, data, n);
+    }
+    consumer->length += length;
+    return UNQLITE_OK;
+}
+
+/*
+ * Data consumer handed to unqlite_kv_fetch_batch(). Data is appended to
+ * the record matching the index of the key in the batch.
+ */
+static int batchConsumer(int index, const void *data, unsigned int length, void *userData)
+{
+    QVector<QByteArray> *records = static_cast<QVector<QByteArray> *>(userData);
+    (*records)[index].append(static_cast<const char *>(data), length);
+    return UNQLITE_OK;
+}
+
+/*
+ * Queue a request of the asynchronous API and wake the worker up.
+ */
+void QUnQLite::Private::post(const Request &request)
+{
+    QMutexLocker locker(&queueMutex);
+    queue.enqueue(request);
+    if(!running) {
+        running = true;
+        workers.start(new Worker(this));
+    }
+}
+
+/*
+ * Worker loop: requests are run in order. Writes queued back to back
+ * are run as one batch, see runWrites().
+ */
+void QUnQLite::Private::runRequests()
+{
+    forever {
+        QList<Request> batch;
+        {
+            QMutexLocker locker(&queueMutex);
+            if(queue.isEmpty()) {
+                running = false;
+                return;
+            }
+            batch.append(queue.dequeue());
+            while(batch.first().isWrite() && !queue.isEmpty() && queue.head().isWrite()) {
+                batch.append(queue.dequeue());
+            }
+        }
+        if(batch.first().isWrite()) {
+            runWrites(batch);
+        } else {
+            runFetch(batch.first());
+        }
+    }
+}
+
+/*
+ * Begin the write-transaction of a batch. The changes of the blocking functions
+ * not committed yet are not part of it: wait for them to be committed or rolled
+ * back, unless the database is being closed, which ends their transaction anyway.
+ */
+int QUnQLite::Private::beginWrites()
+{
+    forever {
+        const int rc = unqlite_config(db, UNQLITE_CONFIG_BEGIN_NEW);
+        if(rc != UNQLITE_LOCKED) {
+            return rc;
+        }
+        QMutexLocker locker(&queueMutex);
+        if(closing) {
+            return unqlite_begin(db);
+        }
+        // Also polled, storeBatch() or a script may end the transaction too
+        noTransaction.wait(&queueMutex, 10);
+    }
+}
+
+/*
+ * Run a batch of writes within a single write-transaction committed at the end.
+ * If a write fails, the transaction is rolled back and every write of
+ * the batch reports a failure. Removing a missing key only fails that request.
+ * A batch holding a commitAsync() request also commits the pending changes
+ * of the blocking functions.
+ */
+void QUnQLite::Private::runWrites(QList<Request> &batch)
+{
+    QVector<bool> results(batch.size(), true);
+    bool commitAll = false;
+    foreach(const Request &request, batch) {
+        commitAll |= request.type == Request::Commit;
+    }
+    int rc = commitAll ? unqlite_begin(db) : beginWrites();
+    for(int i = 0; i < batch.size() && rc == UNQLITE_OK; ++i) {
+        const Request &request = batch.at(i);
+        switch(request.type) {
+        case Request::Store:
+            rc = unqlite_kv_store(db, request.key.constData(), request.key.size(),
+                                  request.value.constData(), request.value.size());
+            break;
+        case Request::Append:
+            rc = unqlite_kv_append(db, request.key.constData(), request.key.size(),
+                                   request.value.constData(), request.value.size());
+            break;
+        case Request::Remove:
+            rc = unqlite_kv_delete(db, request.key.constData(), request.key.size());
+            if(rc == UNQLITE_NOTFOUND) {
+                results[i] = false;
+                rc = UNQLITE_OK;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if(rc == UNQLITE_OK) {
+        rc = unqlite_commit(db);
+    } else {
+        unqlite_rollback(db);
+    }
+    for(int i = 0; i < batch.size(); ++i) {
+        Request &request = batch[i];
+        const bool ok = rc == UNQLITE_OK && results.at(i);
+        request.done.reportResult(ok);
+        request.done.reportFinished();
+    }
+}
+
+void QUnQLite::Private::runFetch(Request &request)
+{
+    QByteArray buffer;
+    ByteArrayConsumer consumer = { &buffer, 0 };
+    const int rc = unqlite_kv_fetch_callback(db, request.key.constData(), request.key.size(),
+                                             byteArrayConsumer, &consumer);
+    buffer.resize(rc == UNQLITE_OK ? consumer.length : 0);
+    request.record.reportResult(buffer);
+    request.record.reportFinished();
+}
+
+/*
+ * Wake the worker up, it may be waiting for a transaction to end.
+ */
+void QUnQLite::Private::transactionEnded()
+{
+    QMutexLocker locker(&queueMutex);
+    noTransaction.wakeAll();
+}
+
+/*
+ * Block until every request queued is completed, the worker no longer waits
+ * for the transaction of the blocking functions to end.
+ */
+void QUnQLite::Private::finishRequests()
+{
+    {
+        QMutexLocker locker(&queueMutex);
+        closing = true;
+        noTransaction.wakeAll();
+    }
+    workers.waitForDone();
+}
+
+void QUnQLite::Private::BackgroundWriter::stop()
+{
+    QMutexLocker locker(&mutex);
+    stopped = true;
+    wakeUp.wakeOne();
+}
+
+void QUnQLite::Private::BackgroundWriter::run()
+{
+    QMutexLocker locker(&mutex);
+    while(!stopped) {
+        wakeUp.wait(&mutex, interval);
+        if(stopped) {
+            break;
+        }
+        locker.unlock();
+        // Nothing to write and a busy log are not errors
+        unqlite_config(db, UNQLITE_CONFIG_WRITE_BACK, minPages, static_cast<int *>(NULL));
+        locker.relock();
+    }
+}
+
+void QUnQLite::Private::stopBackgroundWriter()
+{
+    if(backgroundWriter) {
+        backgroundWriter->stop();
+        backgroundWriter->wait();
+        delete backgroundWriter;
+        backgroundWriter = NULL;
+    }
+}
+
 /*!
  * \class QUnQLite
  * \brief UnQLite database handle.
@@ -69,9 +396,14 @@ QUnQLite::QUnQLite() :
 
 /*!
  * \brief Destructs the instance.
+ *
+ * Prepared statements and collection cursors are destroyed too.
  */
 QUnQLite::~QUnQLite()
 {
+    d->stopBackgroundWriter();
+    d->finishRequests();
+    d->releaseStatements();
 }
 
 /*!
@@ -96,12 +428,25 @@ QUnQLite::ResultCode QUnQLite::lastErrorCode() const
  * \note This function does not open the target database file.
  * It merely initialize and prepare the database object handle for later usage.
  *
+ * With \c CreateWithWAL or \c ReadWriteWithWAL, committed pages are appended to
+ * a write-ahead log (the database name suffixed with "_unqlite_wal") instead of
+ * overwriting the database file: a commit costs a single sequential sync and
+ * readers are not blocked by a writer. The log is transferred back to the database
+ * file by \c checkpoint(), automatically once it grows past 1000 pages, and when
+ * the database is closed.
+ *
  * You could get database return code by \c lastErrorCode() .
  *
+ * \note Handles given by a QUnQLitePool cannot be reopened.
  * \return True if success.
  */
 bool QUnQLite::open(const QString &name, OpenMode mode)
 {
+    if(d->borrowed) {
+        d->setResultCode(UNQLITE_PERM);
+        return false;
+    }
+    d->closing = false;
     d->setResultCode(unqlite_open(&d->db, name.toUtf8().constData(), mode));
     return d->isSuccess();
 }
@@ -113,15 +458,49 @@ bool QUnQLite::open(const QString &name, OpenMode mode)
  * automatically committed unless database is set to be disable auto commit.
  * In which case, the database is rolled back.
  *
+ * The background writer is stopped, pending asynchronous requests are completed,
+ * then prepared statements and collection cursors are destroyed. Asynchronous
+ * writes no longer wait for the changes of the blocking functions, they are
+ * committed together.
+ *
+ * \note Handles given by a QUnQLitePool must be released to the pool instead.
  * \return True if the unqlite object is successfully destroyed
  * and all associated resources are deallocated.
  */
 bool QUnQLite::close()
 {
+    if(d->borrowed) {
+        d->setResultCode(UNQLITE_PERM);
+        return false;
+    }
+    d->stopBackgroundWriter();
+    d->finishRequests();
+    d->releaseStatements();
     d->setResultCode(unqlite_close(d->db));
     return d->isSuccess();
 }
 
+/*!
+ * \brief Select the key/value storage engine named \a name.
+ *
+ * Built-in disk engines are "hash" (default, O(1) lookups, unordered)
+ * and "btree" (O(log n) lookups, records sorted by key so that
+ * QUnQLiteCursor iterates in key order and honors
+ * QUnQLiteCursor::Le and QUnQLiteCursor::Ge).
+ * In-memory databases use "mem" (default, unordered) or "skiplist"
+ * (ordered like "btree").
+ *
+ * This function must be called after \c open() and before the first read or write.
+ * An existing database is always reopened with the engine it was created with.
+ *
+ * \return True if success.
+ */
+bool QUnQLite::setStorageEngine(const QString &name)
+{
+    d->setResultCode(unqlite_config(d->db, UNQLITE_CONFIG_KV_ENGINE, name.toUtf8().constData()));
+    return d->isSuccess();
+}
+
 /*!
  * \brief Write a new record \a value with \a key into the database.
  *
@@ -129,13 +508,40 @@ bool QUnQLite::close()
  * is appended to the end of the old chunk.
  * You can switch to \c store() for an overwrite operation.
  *
+ * \a value is stored as UTF-8.
+ *
  * \return True if success.
  */
-bool QUnQLite::append(const QString &key, const QString &value)
+bool QUnQLite::append(const QUnQLiteKey &key, const QString &value)
+{
+    return append(key, value.toUtf8());
+}
+
+/*!
+ * \brief Write a new record \a value with \a key into the database.
+ *
+ * This is an overloaded function. \a value is stored as raw bytes.
+ */
+bool QUnQLite::append(const QUnQLiteKey &key, const QByteArray &value)
 {
+    return append(key, value.constData(), value.size());
+}
+
+/*!
+ * \brief Write a new record of \a length bytes pointed to by \a data
+ * with \a key into the database.
+ *
+ * This is an overloaded function. If \a length is negative, \a data is
+ * assumed to be a null-terminated string.
+ */
+bool QUnQLite::append(const QUnQLiteKey &key, const char *data, qint64 length)
+{
+    if(length < 0) {
+        length = data ? strlen(data) : 0;
+    }
     d->setResultCode(unqlite_kv_append(d->db,
-                                       key.toUtf8().constData(), key.size(),
-                                       value.toUtf8().constData(), value.size()));
+                                       key.data(), key.size(),
+                                       data, length));
     return d->isSuccess();
 }
 
@@ -146,36 +552,100 @@ bool QUnQLite::append(const QString &key, const QString &value)
  * That is, the new data overwrite the old data.
  * You can switch to \c append() for an append operation.
  *
+ * \a value is stored as UTF-8.
+ *
  * \return True if success.
  */
-bool QUnQLite::store(const QString &key, const QString &value)
+bool QUnQLite::store(const QUnQLiteKey &key, const QString &value)
+{
+    return store(key, value.toUtf8());
+}
+
+/*!
+ * \brief Write a new record \a value with \a key into the database.
+ *
+ * This is an overloaded function. \a value is stored as raw bytes.
+ */
+bool QUnQLite::store(const QUnQLiteKey &key, const QByteArray &value)
+{
+    return store(key, value.constData(), value.size());
+}
+
+/*!
+ * \brief Write a new record of \a length bytes pointed to by \a data
+ * with \a key into the database.
+ *
+ * This is an overloaded function. If \a length is negative, \a data is
+ * assumed to be a null-terminated string.
+ */
+bool QUnQLite::store(const QUnQLiteKey &key, const char *data, qint64 length)
 {
+    if(length < 0) {
+        length = data ? strlen(data) : 0;
+    }
     d->setResultCode(unqlite_kv_store(d->db,
-                                      key.toUtf8().constData(), key.size(),
-                                      value.toUtf8().constData(), value.size()));
+                                      key.data(), key.size(),
+                                      data, length));
     return d->isSuccess();
 }
 
 /*!
  * \brief Fetch a record with \a key from the database.
  *
+ * The record is located with a single lookup and its data is streamed
+ * directly into the returned array.
+ *
  * \return Record data, empty if no such record or something wrong.
  * You could check \c lastErrorCode() to find out if any error.
  */
-QByteArray QUnQLite::fetch(const QString &key)
+QByteArray QUnQLite::fetch(const QUnQLiteKey &key)
 {
-    qint64 length;
-    d->setResultCode(unqlite_kv_fetch(d->db,
-                                      key.toUtf8().constData(), key.size(),
-                                      NULL, &length));
+    QByteArray record;
+    fetch(key, record);
+    return record;
+}
+
+/*!
+ * \brief Fetch a record with \a key from the database into \a buffer.
+ *
+ * The record is located with a single lookup and its data is written
+ * directly into \a buffer, which is resized to the record length.
+ * Memory already held by \a buffer is reused, so calling this function
+ * repeatedly with the same buffer avoids an allocation per fetch.
+ *
+ * \return True if success. On failure \a buffer is left empty.
+ */
+bool QUnQLite::fetch(const QUnQLiteKey &key, QByteArray &buffer)
+{
+    ByteArrayConsumer consumer = { &buffer, 0 };
+    d->setResultCode(unqlite_kv_fetch_callback(d->db,
+                                               key.data(), key.size(),
+                                               byteArrayConsumer, &consumer));
+    buffer.resize(d->isSuccess() ? consumer.length : 0);
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Fetch a record with \a key from the database into
+ * the caller-owned \a buffer.
+ *
+ * On input, \a length holds the capacity of \a buffer in bytes.
+ * On output, it holds the full length of the record. If the record does not
+ * fit, only the first bytes up to the capacity are copied, so the caller
+ * can compare \a length against its capacity and retry with a larger buffer.
+ *
+ * \return True if success.
+ */
+bool QUnQLite::fetch(const QUnQLiteKey &key, char *buffer, qint64 &length)
+{
+    BufferConsumer consumer = { buffer, length, 0 };
+    d->setResultCode(unqlite_kv_fetch_callback(d->db,
+                                               key.data(), key.size(),
+                                               bufferConsumer, &consumer));
     if(d->isSuccess()) {
-        QByteArray record(length, 0);
-        d->setResultCode(unqlite_kv_fetch(d->db,
-                                          key.toUtf8().constData(), key.size(),
-                                          record.data(), &length));
-        return record;
+        length = consumer.length;
     }
-    return QByteArray();
+    return d->isSuccess();
 }
 
 /*!
@@ -184,13 +654,188 @@ QByteArray QUnQLite::fetch(const QString &key)
  *
  * \return True if success.
  */
-bool QUnQLite::remove(const QString &key)
+bool QUnQLite::remove(const QUnQLiteKey &key)
 {
     d->setResultCode(unqlite_kv_delete(d->db,
-                                       key.toUtf8().constData(), key.size()));
+                                       key.data(), key.size()));
     return d->isSuccess();
 }
 
+/*!
+ * \brief Write a new record \a value with \a key into the database
+ * without blocking the calling thread.
+ *
+ * Asynchronous requests run in order on a worker thread owned by this
+ * database. Writes queued back to back (\c storeAsync(), \c appendAsync(),
+ * \c removeAsync() and \c commitAsync()) are merged into a single
+ * write-transaction which is committed before their futures finish, so that
+ * a burst of writes costs one commit. If one of them fails, the whole
+ * transaction is rolled back and all of them report false.
+ *
+ * \note The changes made by the blocking functions and not committed yet are
+ * not part of the transaction: the writes wait for them to be committed or
+ * rolled back, so do not wait for their futures while holding a transaction.
+ * Only \c commitAsync() commits those changes too. Using this database from
+ * several threads at the same time requires the library to be built with
+ * \c UNQLITE_ENABLE_THREADS.
+ * \return A future holding true once the record is committed.
+ */
+QFuture<bool> QUnQLite::storeAsync(const QUnQLiteKey &key, const QByteArray &value)
+{
+    Private::Request request;
+    request.type = Private::Request::Store;
+    request.key = QByteArray(key.data(), key.size());
+    request.value = value;
+    request.done.reportStarted();
+    d->post(request);
+    return request.done.future();
+}
+
+/*!
+ * \brief Append \a value to the record with \a key without blocking
+ * the calling thread.
+ *
+ * See \c storeAsync() for how asynchronous writes are run.
+ * \return A future holding true once the change is committed.
+ */
+QFuture<bool> QUnQLite::appendAsync(const QUnQLiteKey &key, const QByteArray &value)
+{
+    Private::Request request;
+    request.type = Private::Request::Append;
+    request.key = QByteArray(key.data(), key.size());
+    request.value = value;
+    request.done.reportStarted();
+    d->post(request);
+    return request.done.future();
+}
+
+/*!
+ * \brief Remove the record with \a key without blocking the calling thread.
+ *
+ * See \c storeAsync() for how asynchronous writes are run.
+ * \return A future holding true once the removal is committed,
+ * false if there is no such record or something wrong.
+ */
+QFuture<bool> QUnQLite::removeAsync(const QUnQLiteKey &key)
+{
+    Private::Request request;
+    request.type = Private::Request::Remove;
+    request.key = QByteArray(key.data(), key.size());
+    request.done.reportStarted();
+    d->post(request);
+    return request.done.future();
+}
+
+/*!
+ * \brief Fetch the record with \a key without blocking the calling thread.
+ *
+ * The fetch runs after the asynchronous requests queued before it,
+ * so it sees their changes.
+ * \return A future holding the record data, empty if no such record
+ * or something wrong.
+ */
+QFuture<QByteArray> QUnQLite::fetchAsync(const QUnQLiteKey &key)
+{
+    Private::Request request;
+    request.type = Private::Request::Fetch;
+    request.key = QByteArray(key.data(), key.size());
+    request.record.reportStarted();
+    d->post(request);
+    return request.record.future();
+}
+
+/*!
+ * \brief Commit all changes without blocking the calling thread.
+ *
+ * The commit is merged with the asynchronous writes queued right before
+ * or after it, see \c storeAsync(). Unlike them, it does not wait for the
+ * changes of the blocking functions and commits them too.
+ * \return A future holding true once the changes are committed.
+ */
+QFuture<bool> QUnQLite::commitAsync()
+{
+    Private::Request request;
+    request.type = Private::Request::Commit;
+    request.done.reportStarted();
+    d->post(request);
+    return request.done.future();
+}
+
+/*!
+ * \brief Block until all the asynchronous requests queued so far are completed.
+ *
+ * Asynchronous writes wait for the changes of the blocking functions to be
+ * committed or rolled back, do it before calling this function.
+ */
+void QUnQLite::waitForAsync()
+{
+    d->workers.waitForDone();
+}
+
+/*!
+ * \brief Write all \a records, given as key/value pairs, into the database.
+ *
+ * Existing records are replaced, just like \c store().
+ * The whole batch is stored within a single write-transaction
+ * and the database handle is locked only once, so this function is
+ * much faster than calling \c store() for each record.
+ * If any record fails, the transaction is rolled back and none of the
+ * records are stored.
+ *
+ * If a write-transaction is already open, for example after \c begin()
+ * or a previous \c store(), the batch joins it instead: nothing is
+ * committed or rolled back, use \c commit() or \c rollback() as usual.
+ * Empty keys are rejected before any record is stored, but if a record
+ * fails for another reason the records stored before it stay in that
+ * transaction.
+ * \return True if success.
+ */
+bool QUnQLite::storeBatch(const QVector<QPair<QByteArray, QByteArray> > &records)
+{
+    const int count = records.size();
+    QVector<const void *> keys(count);
+    QVector<int> keyLengths(count);
+    QVector<const void *> values(count);
+    QVector<qint64> valueLengths(count);
+    for(int i = 0; i < count; ++i) {
+        const QPair<QByteArray, QByteArray> &record = records.at(i);
+        keys[i] = record.first.constData();
+        keyLengths[i] = record.first.size();
+        values[i] = record.second.constData();
+        valueLengths[i] = record.second.size();
+    }
+    d->setResultCode(unqlite_kv_store_batch(d->db, count,
+                                            keys.data(), keyLengths.constData(),
+                                            values.data(), valueLengths.constData()));
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Fetch the records with \a keys from the database.
+ *
+ * The database handle is locked only once for the whole batch and lookups
+ * are performed in storage order, so that each database page is visited once
+ * no matter the order of \a keys.
+ *
+ * \return Record data in the same order as \a keys. The entry of a key that
+ * does not exist is empty. You could check \c lastErrorCode() to find out if any error.
+ */
+QVector<QByteArray> QUnQLite::fetchMany(const QVector<QByteArray> &keys)
+{
+    const int count = keys.size();
+    QVector<const void *> rawKeys(count);
+    QVector<int> keyLengths(count);
+    for(int i = 0; i < count; ++i) {
+        rawKeys[i] = keys.at(i).constData();
+        keyLengths[i] = keys.at(i).size();
+    }
+    QVector<QByteArray> records(count);
+    d->setResultCode(unqlite_kv_fetch_batch(d->db, count,
+                                            rawKeys.data(), keyLengths.constData(),
+                                            batchConsumer, &records, NULL));
+    return records;
+}
+
 /*!
  * \brief Create a cursor to this database.
  */
@@ -199,6 +844,123 @@ QUnQLiteCursor * QUnQLite::cursor() const
     return new QUnQLiteCursor(const_cast<QUnQLite *>(this));
 }
 
+/*!
+ * \brief Take a snapshot of the last committed state of this database.
+ *
+ * Cursors created from the snapshot keep seeing the records as they were
+ * when it was taken while this database is modified and committed.
+ * The caller owns the snapshot and must delete it before \c close().
+ *
+ * \note A snapshot cannot be taken while changes are not committed
+ * (QUnQLite::Locked). Custom hash or comparison functions installed on
+ * the storage engine are not used by snapshots.
+ * \sa QUnQLiteSnapshot
+ * \return The new snapshot, or NULL if something wrong.
+ * You could check \c lastErrorCode() to find out the error.
+ */
+QUnQLiteSnapshot * QUnQLite::snapshot() const
+{
+    unqlite_snapshot *snapshot;
+    d->setResultCode(unqlite_snapshot_open(d->db, &snapshot));
+    if(!d->isSuccess()) {
+        return NULL;
+    }
+    return new QUnQLiteSnapshot(const_cast<QUnQLite *>(this), d->db, snapshot);
+}
+
+/*!
+ * \brief Compile the Jx9 \a script and return it as a statement that can be
+ * executed many times.
+ *
+ * Statements are cached by script: preparing the same script again returns
+ * the same statement without compiling it again. The statement is owned by
+ * this database and lives until it is deleted or the database is closed.
+ * On failure, NULL is returned and \c lastErrorCode() reports the error
+ * (\c CompileError for a syntax error).
+ */
+QUnQLiteStatement * QUnQLite::prepare(const QString &script)
+{
+    QUnQLiteStatement *statement = d->statements.value(script);
+    if(statement) {
+        d->setResultCode(UNQLITE_OK);
+        return statement;
+    }
+    statement = compile(script);
+    if(statement) {
+        d->statements.insert(script, statement);
+    }
+    return statement;
+}
+
+/*!
+ * \brief Open a cursor over the records of the Jx9 collection \a collection.
+ *
+ * The cursor decodes one record at a time, so walking a large collection
+ * does not load it in memory as \c db_fetch_all() does. If \a filter is set,
+ * it is called with each record and only the records for which it returns
+ * true are returned, for example:
+ *
+ * \code
+ * db->collectionCursor("users", [](const QVariant &record) {
+ *     return record.toMap().value("age").toInt() > 30;
+ * });
+ * \endcode
+ *
+ * The cursor is owned by this database and lives until it is deleted or the
+ * database is closed. On failure, NULL is returned and \c lastErrorCode()
+ * reports the error.
+ */
+QUnQLiteCollectionCursor * QUnQLite::collectionCursor(const QString &collection, const RecordFilter &filter)
+{
+    // The collection name is bound, never spliced into the script
+    const QString script("if($rewind){ db_reset_record_cursor($collection); }\n"
+                         "$record = db_fetch($collection);");
+    QUnQLiteStatement *statement = compile(script);
+    if(statement == NULL) {
+        return NULL;
+    }
+    if(!statement->bind(QString("collection"), collection)) {
+        d->setResultCode(statement->lastErrorCode());
+        delete statement;
+        return NULL;
+    }
+    QUnQLiteCollectionCursor *cursor = new QUnQLiteCollectionCursor(this, statement, collection, filter);
+    d->collectionCursors.append(cursor);
+    return cursor;
+}
+
+/*
+ * Compile a statement that is not cached.
+ */
+QUnQLiteStatement * QUnQLite::compile(const QString &script)
+{
+    unqlite_vm *vm;
+    const QByteArray source = script.toUtf8();
+    d->setResultCode(unqlite_compile(d->db, source.constData(), source.size(), &vm));
+    if(!d->isSuccess()) {
+        return NULL;
+    }
+    return new QUnQLiteStatement(this, vm, script);
+}
+
+/*
+ * Forget a statement being destroyed.
+ */
+void QUnQLite::removeStatement(QUnQLiteStatement *statement)
+{
+    if(d->statements.value(statement->script()) == statement) {
+        d->statements.remove(statement->script());
+    }
+}
+
+/*
+ * Forget a collection cursor being destroyed.
+ */
+void QUnQLite::removeCollectionCursor(QUnQLiteCollectionCursor *cursor)
+{
+    d->collectionCursors.removeOne(cursor);
+}
+
 /*!
  * \brief Begin a write-transaction on the specified database handle.
  *
@@ -206,6 +968,8 @@ QUnQLiteCursor * QUnQLite::cursor() const
  * \note For maximum concurrency, it is preferable to let UnQLite start the transaction
  * for you automatically. An automatic transaction is started each time upper-layers
  * or client code request a store, delete or an append operation.
+ * \note Each handle of a \c QUnQLitePool has its own write-transaction,
+ * other handles fail to write with \c Busy until it is committed or rolled back.
  * \return True if success.
  */
 bool QUnQLite::begin()
@@ -228,11 +992,15 @@ bool QUnQLite::begin()
  * manually as soon as you have no more insertions. Also, for very large insertions (More than 20000),
  * you should call unqlite_commit() periodically to free some memory
  * (A new transaction is started automatically in the next insertion).
+ *
+ * \note On a handle acquired from a \c QUnQLitePool, this fails with \c Busy
+ * while another handle of the pool is reading, the changes are kept.
  * \return True if success.
  */
 bool QUnQLite::commit()
 {
     d->setResultCode(unqlite_commit(d->db));
+    d->transactionEnded();
     return d->isSuccess();
 }
 
@@ -240,15 +1008,202 @@ bool QUnQLite::commit()
  * \brief If a write transaction is open, then all changes made within the transaction
  * are reverted and the current write-transaction is closed
  * (Dropping all exclusive locks on the target database,
- * deletion of the journal file, etc.). Otherwise this routine is a no-op.
+ * deletion of the journal file, etc.). Otherwise this routine is a no-op,
+ * except in WAL mode where it picks up the transactions committed by other connections.
+ *
+ * \note Outside of a transaction, a handle acquired from a \c QUnQLitePool or
+ * opened with a shared cache stops reading, so that the other handles can commit.
+ *
+ * \note This function fails with \c Busy while another thread sharing this handle
+ * is gathering a group commit (see setGroupCommitWindow()).
  * \return True if success.
  */
 bool QUnQLite::rollback()
 {
     d->setResultCode(unqlite_rollback(d->db));
+    d->transactionEnded();
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Transfer the write-ahead log of a database opened with \c CreateWithWAL
+ * or \c ReadWriteWithWAL back to the database file.
+ *
+ * This function fails with \c Busy if another connection is using the log,
+ * and with \c Locked while a write transaction is open.
+ * It is a no-op if the database is not operating in WAL mode.
+ * \return True if success.
+ */
+bool QUnQLite::checkpoint()
+{
+    d->setResultCode(unqlite_config(d->db, UNQLITE_CONFIG_WAL_CHECKPOINT));
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Merge the commits requested within \a microseconds of each other.
+ *
+ * When several threads share this handle (the library must be built with
+ * \c UNQLITE_ENABLE_THREADS and configured with \c UNQLITE_THREAD_LEVEL_MULTI),
+ * the first thread calling \c commit() waits for \a microseconds so that the other
+ * threads can join it. A single journal flush and a single sync is then performed
+ * on behalf of all of them and each caller gets the result of that commit.
+ * Zero (the default) commits immediately. A thread which is the only one to have
+ * changed the database since the last commit does not wait either.
+ * While the first thread waits, rollback() fails with \c Busy and close() waits
+ * for the commit.
+ * \return True if success.
+ */
+bool QUnQLite::setGroupCommitWindow(int microseconds)
+{
+    d->setResultCode(unqlite_config(d->db, UNQLITE_CONFIG_COMMIT_WINDOW, microseconds));
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Write dirty pages back to the database file every \a interval milliseconds
+ * from a background thread.
+ *
+ * Dirty pages no longer in use by the storage engine are written (sorted by page
+ * number) once at least \a minPages of them accumulated, so that a large transaction
+ * does not stall on \c commit() writing all of them at once. In WAL mode, the log is
+ * checkpointed between transactions once it holds at least \a minPages pages.
+ * The library must be built with \c UNQLITE_ENABLE_THREADS and configured with
+ * \c UNQLITE_THREAD_LEVEL_MULTI before the database is opened.
+ * Zero (the default) stops the background writer.
+ * \return True if success.
+ */
+bool QUnQLite::setBackgroundWriter(int interval, int minPages)
+{
+    if(interval < 0 || minPages < 1) {
+        d->setResultCode(UNQLITE_INVALID);
+        return false;
+    }
+    d->stopBackgroundWriter();
+    if(interval > 0) {
+        d->backgroundWriter = new Private::BackgroundWriter(d->db, interval, minPages);
+        d->backgroundWriter->start(QThread::LowPriority);
+    }
+    d->setResultCode(UNQLITE_OK);
+    return true;
+}
+
+/*!
+ * \brief Set the maximum number of database pages kept in memory to \a pages.
+ *
+ * Pages no longer in use stay cached up to this limit (2048 by default).
+ * Pages looked up repeatedly are protected from the pages only touched
+ * once, so a full cursor scan does not evict the working set of point lookups.
+ * The minimum accepted value is 256.
+ *
+ * \note The default "hash" storage engine keeps the bucket pages it reads in use
+ * while the database is open, so this limit only applies to the pages of
+ * the "btree" engine and to the overflow pages of the "hash" engine.
+ * \return True if success.
+ */
+bool QUnQLite::setPageCacheSize(int pages)
+{
+    d->setResultCode(unqlite_config(d->db, UNQLITE_CONFIG_MAX_PAGE_CACHE, pages));
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Give the memory released by removed or shrunk records back to the system.
+ *
+ * The default in-memory storage engine (\c "mem") keeps records in large slabs and
+ * reuses the space of removed records for new ones of a similar size. This function
+ * moves the live records to fresh slabs so that the space left unused is released.
+ * Open cursors stay on their current record.
+ * It fails with \c UnknownError on the other storage engines.
+ * \return True if success.
+ */
+bool QUnQLite::compact()
+{
+    d->setResultCode(unqlite_kv_config(d->db, UNQLITE_KV_CONFIG_COMPACT));
     return d->isSuccess();
 }
 
+/*!
+ * \brief Return the page cache, IO and sync counters of the underlying pager.
+ *
+ * Counters are cumulative since the database was opened. If \a reset is true,
+ * they start again from zero after this call.
+ * Compare \c cacheMisses with \c syncTime to tell whether a slowdown comes from
+ * reading pages or from making commits durable.
+ * On failure, all fields are zero and \c lastErrorCode() reports the error.
+ */
+QUnQLite::PagerStats QUnQLite::pagerStats(bool reset) const
+{
+    PagerStats stats;
+    unqlite_pager_stats raw;
+    std::memset(&raw, 0, sizeof(raw));
+    d->setResultCode(unqlite_config(d->db, UNQLITE_CONFIG_PAGER_STATS, &raw, reset ? 1 : 0));
+    stats.cacheHits = raw.nCacheHit;
+    stats.cacheMisses = raw.nCacheMiss;
+    stats.cacheEvictions = raw.nCacheEvict;
+    stats.pagesRead = raw.nPageRead;
+    stats.sharedPageHits = raw.nSharedHit;
+    stats.pagesWritten = raw.nPageWrite;
+    stats.hotDirtyFlushes = raw.nHotFlush;
+    stats.journalBytes = raw.nJournalByte;
+    stats.syncs = raw.nSync;
+    stats.syncTime = raw.iSyncTime;
+    stats.pages = raw.nPage;
+    stats.hotDirtyPages = raw.nHot;
+    stats.cacheSize = raw.nCacheMax;
+    return stats;
+}
+
+/*!
+ * \class QUnQLite::PagerStats
+ * \brief Counters returned by \c pagerStats().
+ *
+ * \c cacheHits and \c cacheMisses count page requests served from memory or
+ * loaded from storage, \c cacheEvictions counts unused pages dropped from the
+ * page cache. \c pagesRead and \c pagesWritten count database and write-ahead log
+ * page IO, \c sharedPageHits the pages served by another handle opened on the
+ * same file with a shared cache mode. \c hotDirtyFlushes counts dirty pages
+ * written before commit time and \c journalBytes the bytes written to the
+ * rollback journal. \c syncs and
+ * \c syncTime (in microseconds) measure the sync operations.
+ * \c pages, \c hotDirtyPages and \c cacheSize are the current number of
+ * in-memory pages, hot dirty pages and the page cache limit.
+ */
+
+/*!
+ * \brief Return the counters of the per-thread allocation caches of the library.
+ *
+ * In multi-thread mode, the memory allocators shared by several threads keep
+ * a small cache of free chunks for each thread, so that most allocations do not
+ * lock the shared pools. Counters are summed over the whole library and are
+ * cumulative since it was initialized. If \a reset is true, they start again
+ * from zero after this call. All fields are zero in single-thread mode.
+ */
+QUnQLite::MemoryStats QUnQLite::memoryStats(bool reset)
+{
+    MemoryStats stats;
+    unqlite_mem_stats raw;
+    std::memset(&raw, 0, sizeof(raw));
+    unqlite_lib_mem_stats(&raw, reset ? 1 : 0);
+    stats.cacheHits = raw.nCacheHit;
+    stats.refills = raw.nRefill;
+    stats.flushes = raw.nFlush;
+    stats.lockWaits = raw.nLockWait;
+    stats.cachedChunks = raw.nCached;
+    return stats;
+}
+
+/*!
+ * \class QUnQLite::MemoryStats
+ * \brief Counters returned by \c memoryStats().
+ *
+ * \c cacheHits counts the allocations served by a per-thread cache, \c refills
+ * and \c flushes the batches of chunks moved from and to the shared pools.
+ * \c lockWaits counts the times a shared pool was locked by another thread and
+ * should stay low compared to \c cacheHits. \c cachedChunks is the current
+ * number of chunks held by the per-thread caches.
+ */
+
 /*!
  * \enum QUnQLite::OpenMode
  * \brief These values are intended for use in the 3rd parameter to
@@ -286,6 +1241,49 @@ bool QUnQLite::rollback()
  * but your database is still read-only.
  */
 
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::CreateWithMMap
+ * \brief Same as \c Create but clean pages are read straight from a shared
+ * memory view of the database.
+ *
+ * Modified pages are copied out of the view before they are changed and are
+ * written back through the journal as usual, so transactions behave exactly
+ * as in \c Create mode. The view is remapped when the database grows.
+ */
+
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::ReadWriteWithMMap
+ * \brief Same as \c CreateWithMMap but the database must already exist.
+ */
+
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::CreateWithWAL
+ * \brief Same as \c Create but commits go to a write-ahead log.
+ *
+ * A connection that finds another connection committed to the log since
+ * its snapshot was taken fails to write with \c Busy until \c rollback()
+ * is called, which refreshes the snapshot.
+ */
+
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::ReadWriteWithWAL
+ * \brief Same as \c ReadWrite but commits go to a write-ahead log.
+ */
+
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::CreateWithSharedCache
+ * \brief Same as \c Create but clean pages are shared with the other handles
+ * of this process opened on the same file with a shared cache mode.
+ *
+ * Memory then stays flat as handles are added, each handle only keeps a private
+ * copy of the pages it modifies. Ignored with a write-ahead log.
+ */
+
+/*!
+ * \var QUnQLite::OpenMode QUnQLite::ReadWriteWithSharedCache
+ * \brief Same as \c CreateWithSharedCache but the database must already exist.
+ */
+
 /*!
  * \enum QUnQLite::ResultCode
  * \brief Most of the UnQLite public interfaces return an integer result code
@@ -26,16 +26,26 @@
 #ifndef QUNQLITE_H
 #define QUNQLITE_H
 
+#include <QFuture>
 #include <QObject>
+#include <QPair>
+#include <QVariant>
+#include <QVector>
+
+#include <functional>
 
 #include "dpointer.h"
+#include "qunqlitekey.h"
 
 extern "C" {
 #include "UnQLite/UnQLite.h"
 }
 
+class QUnQLiteCollectionCursor;
 class QUnQLiteCursor;
 class QUnQLiteCursorPrivate;
+class QUnQLiteSnapshot;
+class QUnQLiteStatement;
 
 class QUnQLite : public QObject
 {
@@ -46,7 +56,13 @@ public:
         Create           = UNQLITE_OPEN_CREATE,
         ReadWrite        = UNQLITE_OPEN_READWRITE,
         ReadOnly         = UNQLITE_OPEN_READONLY,
-        ReadOnlyWithMMap = UNQLITE_OPEN_READONLY | UNQLITE_OPEN_MMAP
+        ReadOnlyWithMMap = UNQLITE_OPEN_READONLY | UNQLITE_OPEN_MMAP,
+        CreateWithMMap   = UNQLITE_OPEN_CREATE | UNQLITE_OPEN_MMAP,
+        ReadWriteWithMMap = UNQLITE_OPEN_READWRITE | UNQLITE_OPEN_MMAP,
+        CreateWithWAL    = UNQLITE_OPEN_CREATE | UNQLITE_OPEN_WAL,
+        ReadWriteWithWAL = UNQLITE_OPEN_READWRITE | UNQLITE_OPEN_WAL,
+        CreateWithSharedCache    = UNQLITE_OPEN_CREATE | UNQLITE_OPEN_SHARED_CACHE,
+        ReadWriteWithSharedCache = UNQLITE_OPEN_READWRITE | UNQLITE_OPEN_SHARED_CACHE
     };
 
     enum ResultCode
@@ -78,6 +94,34 @@ public:
         LockingError    = UNQLITE_LOCKERR
     };
 
+    struct PagerStats
+    {
+        qint64 cacheHits;
+        qint64 cacheMisses;
+        qint64 cacheEvictions;
+        qint64 pagesRead;
+        qint64 sharedPageHits;
+        qint64 pagesWritten;
+        qint64 hotDirtyFlushes;
+        qint64 journalBytes;
+        qint64 syncs;
+        qint64 syncTime;
+        int pages;
+        int hotDirtyPages;
+        int cacheSize;
+    };
+
+    struct MemoryStats
+    {
+        qint64 cacheHits;
+        qint64 refills;
+        qint64 flushes;
+        qint64 lockWaits;
+        int cachedChunks;
+    };
+
+    typedef std::function<bool (const QVariant &record)> RecordFilter;
+
     QUnQLite();
     ~QUnQLite();
 
@@ -86,22 +130,57 @@ public:
     bool open(const QString &name, OpenMode mode);
     bool close();
 
-    bool append(const QString &key, const QString &value);
-    bool store(const QString &key, const QString &value);
+    bool setStorageEngine(const QString &name);
+
+    bool append(const QUnQLiteKey &key, const QString &value);
+    bool append(const QUnQLiteKey &key, const QByteArray &value);
+    bool append(const QUnQLiteKey &key, const char *data, qint64 length = -1);
+    bool store(const QUnQLiteKey &key, const QString &value);
+    bool store(const QUnQLiteKey &key, const QByteArray &value);
+    bool store(const QUnQLiteKey &key, const char *data, qint64 length = -1);
 
-    QByteArray fetch(const QString &key);
+    QByteArray fetch(const QUnQLiteKey &key);
+    bool fetch(const QUnQLiteKey &key, QByteArray &buffer);
+    bool fetch(const QUnQLiteKey &key, char *buffer, qint64 &length);
 
-    bool remove(const QString &key);
+    bool remove(const QUnQLiteKey &key);
+
+    QFuture<bool> storeAsync(const QUnQLiteKey &key, const QByteArray &value);
+    QFuture<bool> appendAsync(const QUnQLiteKey &key, const QByteArray &value);
+    QFuture<bool> removeAsync(const QUnQLiteKey &key);
+    QFuture<QByteArray> fetchAsync(const QUnQLiteKey &key);
+    QFuture<bool> commitAsync();
+    void waitForAsync();
+
+    bool storeBatch(const QVector<QPair<QByteArray, QByteArray> > &records);
+    QVector<QByteArray> fetchMany(const QVector<QByteArray> &keys);
 
     QUnQLiteCursor * cursor() const;
+    QUnQLiteSnapshot * snapshot() const;
+    QUnQLiteStatement * prepare(const QString &script);
+    QUnQLiteCollectionCursor * collectionCursor(const QString &collection, const RecordFilter &filter = RecordFilter());
 
     bool begin();
     bool commit();
     bool rollback();
+    bool checkpoint();
+    bool setGroupCommitWindow(int microseconds);
+    bool setBackgroundWriter(int interval, int minPages = 32);
+    bool setPageCacheSize(int pages);
+    bool compact();
+    PagerStats pagerStats(bool reset = false) const;
+    static MemoryStats memoryStats(bool reset = false);
 
 private:
+    QUnQLiteStatement * compile(const QString &script);
+    void removeStatement(QUnQLiteStatement *statement);
+    void removeCollectionCursor(QUnQLiteCollectionCursor *cursor);
+
+    friend class QUnQLiteCollectionCursor;
+    friend class QUnQLitePool;
     friend class QUnQLiteCursor;
     friend class QUnQLiteCursorPrivate;
+    friend class QUnQLiteStatement;
 
     D_POINTER
 };
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qunqlitecollectioncursor.h"
+#include "qunqlitestatement.h"
+
+class QUnQLiteCollectionCursor::Private
+{
+public:
+    Private(QUnQLiteCollectionCursor * q_ptr) : q(q_ptr) {}
+
+    void setResultCode(int rc)
+    {
+        resultCode = static_cast<QUnQLite::ResultCode>(rc);
+    }
+
+    bool isSuccess() const
+    {
+        return resultCode == QUnQLite::Ok;
+    }
+
+    bool fetch(bool rewind);
+
+    QUnQLite *q_unqlite;
+    QUnQLiteStatement *statement;
+    QString collection;
+    QUnQLite::RecordFilter filter;
+    QVariant record;
+    QUnQLite::ResultCode resultCode;
+
+    Q_POINTER(QUnQLiteCollectionCursor)
+};
+
+/*
+ * Run the cursor script until it decodes a record accepted by the filter,
+ * starting from the first record if rewind is true.
+ */
+bool QUnQLiteCollectionCursor::Private::fetch(bool rewind)
+{
+    for(;;) {
+        record = QVariant();
+        if(!statement->bind(QString("rewind"), rewind) || !statement->exec()) {
+            setResultCode(statement->lastErrorCode());
+            return false;
+        }
+        record = statement->value(QString("record"));
+        if(!record.isValid()) {
+            setResultCode(UNQLITE_DONE);
+            return false;
+        }
+        if(!filter || filter(record)) {
+            setResultCode(UNQLITE_OK);
+            return true;
+        }
+        rewind = false;
+    }
+}
+
+/*!
+ * \class QUnQLiteCollectionCursor
+ * \brief A forward cursor over the records of a Jx9 collection.
+ *
+ * Records are decoded one at a time as the cursor moves, so that memory usage
+ * does not depend on the size of the collection. The filter, if any, is applied
+ * to each record as it is read.
+ *
+ * Cursors are created by database instances, see \c QUnQLite::collectionCursor().
+ * A cursor is owned by its database and destroyed when the database is closed.
+ */
+
+/*!
+ * \brief Constructs an instance of QUnQLiteCollectionCursor running \a statement.
+ *
+ * The cursor is a child of \a db and takes the ownership of \a statement.
+ */
+QUnQLiteCollectionCursor::QUnQLiteCollectionCursor(QUnQLite *db, QUnQLiteStatement *statement,
+                                                   const QString &collection,
+                                                   const QUnQLite::RecordFilter &filter) :
+    QObject(db),
+    d(this)
+{
+    d->q_unqlite = db;
+    d->statement = statement;
+    d->collection = collection;
+    d->filter = filter;
+    d->setResultCode(UNQLITE_OK);
+}
+
+/*!
+ * \brief Destructs the instance.
+ */
+QUnQLiteCollectionCursor::~QUnQLiteCollectionCursor()
+{
+    d->q_unqlite->removeCollectionCursor(this);
+    delete d->statement;
+}
+
+/*!
+ * \brief Get the database this cursor was opened on.
+ */
+QUnQLite * QUnQLiteCollectionCursor::database() const
+{
+    return d->q_unqlite;
+}
+
+/*!
+ * \brief Get the name of the collection.
+ */
+QString QUnQLiteCollectionCursor::collection() const
+{
+    return d->collection;
+}
+
+/*!
+ * \brief Get the record filter, empty if every record is returned.
+ */
+QUnQLite::RecordFilter QUnQLiteCollectionCursor::filter() const
+{
+    return d->filter;
+}
+
+/*!
+ * \brief Get the result code of the last operation on this cursor.
+ *
+ * \c Done is reported once the end of the collection is reached.
+ */
+QUnQLite::ResultCode QUnQLiteCollectionCursor::lastErrorCode() const
+{
+    return d->resultCode;
+}
+
+/*!
+ * \brief Move to the first record accepted by the filter.
+ * \return True if such a record exists.
+ */
+bool QUnQLiteCollectionCursor::first()
+{
+    return d->fetch(true);
+}
+
+/*!
+ * \brief Move to the next record accepted by the filter.
+ *
+ * Calling this function on a cursor that was never moved is the same
+ * as calling \c first().
+ * \return True if such a record exists.
+ */
+bool QUnQLiteCollectionCursor::next()
+{
+    return d->fetch(false);
+}
+
+/*!
+ * \brief Get the current record as a QVariantMap.
+ *
+ * An invalid QVariant is returned if the cursor does not point to a record.
+ */
+QVariant QUnQLiteCollectionCursor::value() const
+{
+    return d->record;
+}
+
+/*!
+ * \brief Check whether the cursor points to a record.
+ */
+bool QUnQLiteCollectionCursor::isValid() const
+{
+    return d->record.isValid();
+}
@@ -25,6 +25,7 @@
 
 #include "qunqlite.h"
 #include "qunqlitecursor.h"
+#include "qunqlitesnapshot.h"
 #include "qunqlite.cpp"
 
 class QUnQLiteCursor::Private
@@ -44,6 +45,7 @@ public:
 
     QUnQLite *q_unqlite;
     unqlite *db;
+    QUnQLiteSnapshot *snapshot;
     unqlite_kv_cursor *cursor;
 
     Q_POINTER(QUnQLiteCursor)
@@ -55,7 +57,7 @@ public:
  * the records in a database. Using cursors, you can seek, fetch,
  * move, and delete database records.
  *
- * Cursors can be created by database instances.
+ * Cursors can be created by database instances or by snapshots.
  */
 
 /*!
@@ -68,15 +70,36 @@ QUnQLiteCursor::QUnQLiteCursor(QUnQLite *db) :
 {
     d->q_unqlite = db;
     d->db = db->d->db;
+    d->snapshot = 0;
     d->setResultCode(unqlite_kv_cursor_init(d->db, &d->cursor));
 }
 
+/*!
+ * \brief Constructs an instance of QUnQLiteCursor iterating over \a snapshot.
+ *
+ * The cursor is a child of the snapshot.
+ * This function is rarely called, use \c QUnQLiteSnapshot::cursor() instead.
+ */
+QUnQLiteCursor::QUnQLiteCursor(QUnQLiteSnapshot *snapshot) :
+    QObject(snapshot),
+    d(this)
+{
+    d->q_unqlite = snapshot->database();
+    d->db = d->q_unqlite->d->db;
+    d->snapshot = snapshot;
+    d->setResultCode(unqlite_snapshot_cursor_init(snapshot->handle(), &d->cursor));
+}
+
 /*!
  * \brief Destructs the instance.
  */
 QUnQLiteCursor::~QUnQLiteCursor()
 {
-    d->setResultCode(unqlite_kv_cursor_release(d->db, d->cursor));
+    if(d->snapshot) {
+        d->setResultCode(unqlite_snapshot_cursor_release(d->snapshot->handle(), d->cursor));
+    } else {
+        d->setResultCode(unqlite_kv_cursor_release(d->db, d->cursor));
+    }
 }
 
 /*!
@@ -97,14 +120,14 @@ bool QUnQLiteCursor::reset()
  * \sa QUnQLiteCursor::SeekDirection
  * \note QUnQLiteCursor::Le and QUnQLiteCursor::Ge have sense only if
  * the underlying key/value storage subsystem support range search
- * (i.e: B+Tree, R+Tree, etc.). Otherwise this option is ignored
- * and an exact match is performed.
+ * (i.e: the "btree" engine, see QUnQLite::setStorageEngine()).
+ * Otherwise this option is ignored and an exact match is performed.
  * \return True if success.
  */
-bool QUnQLiteCursor::seek(const QString &key, QUnQLiteCursor::SeekDirection sd)
+bool QUnQLiteCursor::seek(const QUnQLiteKey &key, QUnQLiteCursor::SeekDirection sd)
 {
     d->setResultCode(unqlite_kv_cursor_seek(d->cursor,
-                                            key.toUtf8().constData(), key.size(),
+                                            key.data(), key.size(),
                                             sd));
     return d->isSuccess();
 }
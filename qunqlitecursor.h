@@ -29,12 +29,14 @@
 #include <QObject>
 
 #include "dpointer.h"
+#include "qunqlitekey.h"
 
 extern "C" {
 #include "unqlite/unqlite.h"
 }
 
 class QUnQLite;
+class QUnQLiteSnapshot;
 class QUnQLiteCursorPrivate;
 
 class QUnQLiteCursor : public QObject
@@ -49,11 +51,12 @@ public:
     };
 
     explicit QUnQLiteCursor(QUnQLite *db);
+    explicit QUnQLiteCursor(QUnQLiteSnapshot *snapshot);
     ~QUnQLiteCursor();
 
     bool reset();
 
-    bool seek(const QString &key, SeekDirection sd);
+    bool seek(const QUnQLiteKey &key, SeekDirection sd);
     bool first();
     bool last();
 
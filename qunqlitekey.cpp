@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qunqlitekey.h"
+
+#include <cstring>
+
+/*!
+ * \class QUnQLiteKey
+ * \brief A non-owning view of the raw bytes of a record key.
+ *
+ * Keys are passed to UnQLite as raw bytes. QUnQLiteKey refers to
+ * the bytes of a QByteArray or a plain character buffer without copying them,
+ * so binary keys can be used in tight loops without any allocation.
+ * The referenced data must stay alive as long as the key is in use.
+ *
+ * A QString key is converted to UTF-8 once and the converted bytes are kept
+ * by the key itself.
+ */
+
+/*!
+ * \brief Constructs a key referring to the null-terminated string \a key.
+ */
+QUnQLiteKey::QUnQLiteKey(const char *key) :
+    m_data(key),
+    m_size(key ? static_cast<int>(strlen(key)) : 0)
+{
+}
+
+/*!
+ * \brief Constructs a key referring to the first \a size bytes of \a key.
+ */
+QUnQLiteKey::QUnQLiteKey(const char *key, int size) :
+    m_data(key),
+    m_size(size)
+{
+}
+
+/*!
+ * \brief Constructs a key referring to the bytes of \a key.
+ */
+QUnQLiteKey::QUnQLiteKey(const QByteArray &key) :
+    m_data(key.constData()),
+    m_size(key.size())
+{
+}
+
+/*!
+ * \brief Constructs a key holding the UTF-8 representation of \a key.
+ */
+QUnQLiteKey::QUnQLiteKey(const QString &key) :
+    m_utf8(key.toUtf8()),
+    m_data(m_utf8.constData()),
+    m_size(m_utf8.size())
+{
+}
+
+/*!
+ * \fn const char * QUnQLiteKey::data() const
+ * \brief Returns a pointer to the key bytes.
+ */
+
+/*!
+ * \fn int QUnQLiteKey::size() const
+ * \brief Returns the number of bytes in the key.
+ */
+
+/*!
+ * \fn bool QUnQLiteKey::isEmpty() const
+ * \brief Returns true if the key has no bytes.
+ */
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qunqlitepool.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <climits>
+
+class QUnQLitePool::Private
+{
+public:
+    Private(QUnQLitePool * q_ptr) : q(q_ptr), opened(false), maxHandles(0), closing(false) {}
+
+    void setResultCode(int rc)
+    {
+        resultCode = static_cast<QUnQLite::ResultCode>(rc);
+    }
+
+    bool isSuccess() const
+    {
+        return resultCode == QUnQLite::Ok;
+    }
+
+    /*
+     * A thread blocked in acquire(). Released handles are given to
+     * waiters in arrival order.
+     */
+    struct Waiter
+    {
+        QWaitCondition ready;
+        QUnQLite *handle;
+    };
+
+    struct Handle
+    {
+        QUnQLite *db;
+        QElapsedTimer held;
+        HandleStats stats;
+    };
+
+    QUnQLite * newHandle();
+    Handle * find(QUnQLite *handle);
+    void lease(QUnQLite *handle, qint64 waitTime, bool waited);
+
+    QUnQLite::ResultCode resultCode;
+    bool opened;
+    QString name;
+    QUnQLite::OpenMode mode;
+    int maxHandles;
+    QVector<Handle> handles;
+    QList<QUnQLite *> idle;
+    QQueue<Waiter *> waiters;
+    bool closing; // The pool is being destroyed
+    QWaitCondition drained; // A waiter left or a handle was released while closing
+    mutable QMutex mutex;
+
+    Q_POINTER(QUnQLitePool)
+};
+
+/*
+ * Open a new connection to the database, returns NULL on failure.
+ * Connections share their clean pages but each one has its own transaction.
+ */
+QUnQLite * QUnQLitePool::Private::newHandle()
+{
+    Handle handle;
+    handle.db = new QUnQLite;
+    if(!handle.db->open(name, static_cast<QUnQLite::OpenMode>(mode | UNQLITE_OPEN_SHARED_CACHE))) {
+        setResultCode(handle.db->lastErrorCode());
+        delete handle.db;
+        return NULL;
+    }
+    handle.db->d->borrowed = true;
+    handle.stats.acquisitions = handle.stats.waits = 0;
+    handle.stats.waitTime = handle.stats.holdTime = 0;
+    handles.append(handle);
+    return handle.db;
+}
+
+QUnQLitePool::Private::Handle * QUnQLitePool::Private::find(QUnQLite *handle)
+{
+    for(int i = 0; i < handles.size(); ++i) {
+        if(handles.at(i).db == handle) {
+            return &handles[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Account for a handle given to a caller.
+ */
+void QUnQLitePool::Private::lease(QUnQLite *handle, qint64 waitTime, bool waited)
+{
+    Handle *entry = find(handle);
+    entry->stats.acquisitions++;
+    if(waited) {
+        entry->stats.waits++;
+        entry->stats.waitTime += waitTime;
+    }
+    entry->held.start();
+}
+
+/*!
+ * \class QUnQLitePool
+ * \brief A bounded pool of database handles shared by several threads.
+ *
+ * Each handle of a pool is a connection to the database file opened with a
+ * shared cache (see \c QUnQLite::CreateWithSharedCache), so the handles share
+ * the clean pages they read instead of duplicating them.
+ * Each handle keeps its own transaction, prepared statements, collection cursors
+ * and asynchronous queue, and must only be used by the thread that acquired it:
+ * it is moved to that thread by \c acquire().
+ *
+ * Handles are opened on demand up to the pool size. When all of them are
+ * in use, \c acquire() blocks and released handles are given to the waiting
+ * threads in the order they arrived.
+ *
+ * \c commit() and \c rollback() on a handle only apply or discard the changes
+ * made through that handle. A write-transaction still locks the database file:
+ * while a handle has uncommitted changes, writing through another handle fails
+ * with \c Busy, and a commit fails with \c Busy while another handle is reading.
+ * The transaction is kept and the commit can be retried. A handle stops reading
+ * when it is released, or when \c rollback() is called outside of a transaction.
+ * Changes left uncommitted on release stay with the handle until its next user
+ * commits them or the pool is closed. With \c CreateWithWAL or \c ReadWriteWithWAL,
+ * readers never block a commit.
+ *
+ * In-memory databases cannot be pooled: each connection would get its own database.
+ *
+ * \note The library must be built with \c UNQLITE_ENABLE_THREADS.
+ */
+
+/*!
+ * \brief Constructs an instance of QUnQLitePool.
+ */
+QUnQLitePool::QUnQLitePool(QObject *parent) :
+    QObject(parent),
+    d(this)
+{
+    d->setResultCode(UNQLITE_OK);
+}
+
+/*!
+ * \brief Destructs the instance, closing the database if still open.
+ *
+ * Threads waiting in \c acquire() get NULL. The destructor then blocks until
+ * every acquired handle is released, so it must not run in a thread that still
+ * holds one.
+ */
+QUnQLitePool::~QUnQLitePool()
+{
+    QMutexLocker locker(&d->mutex);
+    d->closing = true;
+    foreach(Private::Waiter *waiter, d->waiters) {
+        waiter->ready.wakeOne();
+    }
+    while(!d->waiters.isEmpty() || d->idle.size() != d->handles.size()) {
+        d->drained.wait(&d->mutex);
+    }
+    locker.unlock();
+    close();
+}
+
+/*!
+ * \brief Get the result code of the last operation.
+ */
+QUnQLite::ResultCode QUnQLitePool::lastErrorCode() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->resultCode;
+}
+
+/*!
+ * \brief Open the database \a name with \a mode as open mode, for at most
+ * \a maxHandles handles.
+ *
+ * The library is switched to multi-thread mode first, if it is not
+ * initialized yet. The first handle is opened right away so that errors
+ * are reported here. In-memory databases are refused with \c Invalid.
+ * \return True if success.
+ */
+bool QUnQLitePool::open(const QString &name, QUnQLite::OpenMode mode, int maxHandles)
+{
+    QMutexLocker locker(&d->mutex);
+    if(d->opened) {
+        d->setResultCode(UNQLITE_LOCKED);
+        return false;
+    }
+    if(maxHandles < 1 || name.isEmpty() || name == QLatin1String(":mem:")) {
+        d->setResultCode(UNQLITE_INVALID);
+        return false;
+    }
+    // Fails harmlessly once the library is initialized
+    unqlite_lib_config(UNQLITE_LIB_CONFIG_THREAD_LEVEL_MULTI);
+    d->name = name;
+    d->mode = mode;
+    d->maxHandles = maxHandles;
+    QUnQLite *handle = d->newHandle();
+    if(handle == NULL) {
+        d->maxHandles = 0;
+        return false;
+    }
+    // Idle handles belong to no thread, see release()
+    handle->moveToThread(NULL);
+    d->idle.append(handle);
+    d->opened = true;
+    d->setResultCode(UNQLITE_OK);
+    return true;
+}
+
+/*!
+ * \brief Close and destroy all the handles.
+ *
+ * Every handle must have been released. Threads still waiting in
+ * \c acquire() get NULL.
+ * \return True if success.
+ */
+bool QUnQLitePool::close()
+{
+    QMutexLocker locker(&d->mutex);
+    if(!d->opened) {
+        d->setResultCode(UNQLITE_OK);
+        return true;
+    }
+    if(d->idle.size() != d->handles.size()) {
+        d->setResultCode(UNQLITE_BUSY);
+        return false;
+    }
+    while(!d->waiters.isEmpty()) {
+        d->waiters.dequeue()->ready.wakeOne();
+    }
+    int rc = UNQLITE_OK;
+    foreach(const Private::Handle &handle, d->handles) {
+        handle.db->d->borrowed = false;
+        if(!handle.db->close() && rc == UNQLITE_OK) {
+            rc = handle.db->lastErrorCode();
+        }
+        delete handle.db;
+    }
+    d->handles.clear();
+    d->idle.clear();
+    d->setResultCode(rc);
+    d->opened = false;
+    d->maxHandles = 0;
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Get the maximum number of handles of this pool.
+ */
+int QUnQLitePool::maxHandles() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->maxHandles;
+}
+
+/*!
+ * \brief Get the number of handles that can be acquired without waiting.
+ */
+int QUnQLitePool::availableHandles() const
+{
+    QMutexLocker locker(&d->mutex);
+    if(!d->waiters.isEmpty()) {
+        return 0;
+    }
+    return d->idle.size() + d->maxHandles - d->handles.size();
+}
+
+/*!
+ * \brief Take a handle from the pool, waiting at most \a timeout milliseconds
+ * for one to be released. A negative \a timeout waits forever.
+ *
+ * The handle must be given back with \c release() and must not be closed
+ * nor deleted.
+ * \return The handle, or NULL if none was released in time (\c Busy) or the
+ * pool is closed.
+ */
+QUnQLite * QUnQLitePool::acquire(int timeout)
+{
+    QMutexLocker locker(&d->mutex);
+    if(!d->opened || d->closing) {
+        d->setResultCode(UNQLITE_CORRUPT);
+        return NULL;
+    }
+    QUnQLite *handle = NULL;
+    if(d->waiters.isEmpty()) {
+        if(!d->idle.isEmpty()) {
+            // Reuse the most recently released handle
+            handle = d->idle.takeLast();
+        } else if(d->handles.size() < d->maxHandles) {
+            handle = d->newHandle();
+            if(handle == NULL) {
+                return NULL;
+            }
+        }
+    }
+    if(handle) {
+        d->lease(handle, 0, false);
+        d->setResultCode(UNQLITE_OK);
+        locker.unlock();
+        handle->moveToThread(QThread::currentThread());
+        return handle;
+    }
+    Private::Waiter waiter;
+    waiter.handle = NULL;
+    d->waiters.enqueue(&waiter);
+    QElapsedTimer timer;
+    timer.start();
+    while(waiter.handle == NULL && d->opened && !d->closing) {
+        unsigned long wait = ULONG_MAX;
+        if(timeout >= 0) {
+            const qint64 left = timeout - timer.elapsed();
+            if(left <= 0) {
+                break;
+            }
+            wait = static_cast<unsigned long>(left);
+        }
+        waiter.ready.wait(&d->mutex, wait);
+    }
+    if(waiter.handle == NULL) {
+        d->waiters.removeOne(&waiter);
+        d->setResultCode(d->opened && !d->closing ? UNQLITE_BUSY : UNQLITE_CORRUPT);
+        if(d->closing) {
+            d->drained.wakeAll();
+        }
+        return NULL;
+    }
+    d->lease(waiter.handle, timer.elapsed(), true);
+    d->setResultCode(UNQLITE_OK);
+    locker.unlock();
+    waiter.handle->moveToThread(QThread::currentThread());
+    return waiter.handle;
+}
+
+/*!
+ * \brief Give \a db back to the pool.
+ *
+ * This must be called by the thread that acquired the handle.
+ * The handle goes to the thread waiting the longest, if any.
+ * Its prepared statements are kept for the next user.
+ * Unless it has uncommitted changes, the handle stops reading so that
+ * the other handles can commit.
+ */
+void QUnQLitePool::release(QUnQLite *db)
+{
+    int inTransaction = 0;
+    unqlite_config(db->d->db, UNQLITE_CONFIG_IN_WRITE_TRANSACTION, &inTransaction);
+    if(!inTransaction) {
+        // Outside of a transaction, this only releases the read lock
+        unqlite_rollback(db->d->db);
+    }
+    // Detach the handle (and its statements) from this thread so that
+    // the next thread can take it over
+    db->moveToThread(NULL);
+    QMutexLocker locker(&d->mutex);
+    Private::Handle *entry = d->find(db);
+    if(entry == NULL || d->idle.contains(db)) {
+        d->setResultCode(UNQLITE_INVALID);
+        return;
+    }
+    entry->stats.holdTime += entry->held.elapsed();
+    d->setResultCode(UNQLITE_OK);
+    if(!d->waiters.isEmpty() && !d->closing) {
+        Private::Waiter *waiter = d->waiters.dequeue();
+        waiter->handle = db;
+        waiter->ready.wakeOne();
+        return;
+    }
+    d->idle.append(db);
+    if(d->closing) {
+        d->drained.wakeAll();
+    }
+}
+
+/*!
+ * \brief Return the counters of each handle created by this pool.
+ *
+ * Counters are cumulative since the handle was created. If \a reset is true,
+ * they start again from zero after this call.
+ */
+QVector<QUnQLitePool::HandleStats> QUnQLitePool::handleStats(bool reset) const
+{
+    QMutexLocker locker(&d->mutex);
+    QVector<HandleStats> stats;
+    for(int i = 0; i < d->handles.size(); ++i) {
+        Private::Handle &handle = d->handles[i];
+        stats.append(handle.stats);
+        if(reset) {
+            handle.stats.acquisitions = handle.stats.waits = 0;
+            handle.stats.waitTime = handle.stats.holdTime = 0;
+        }
+    }
+    return stats;
+}
+
+/*!
+ * \class QUnQLitePool::HandleStats
+ * \brief Counters returned by \c handleStats().
+ *
+ * \c acquisitions counts how many times the handle was acquired and \c waits
+ * how many of them had to wait for it to be released. \c waitTime and
+ * \c holdTime are the milliseconds spent waiting for the handle and holding it.
+ */
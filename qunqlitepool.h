@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QUNQLITEPOOL_H
+#define QUNQLITEPOOL_H
+
+#include <QObject>
+#include <QVector>
+
+#include "dpointer.h"
+#include "qunqlite.h"
+
+class QUnQLitePool : public QObject
+{
+    Q_OBJECT
+public:
+    struct HandleStats
+    {
+        qint64 acquisitions;
+        qint64 waits;
+        qint64 waitTime;
+        qint64 holdTime;
+    };
+
+    explicit QUnQLitePool(QObject *parent = 0);
+    ~QUnQLitePool();
+
+    QUnQLite::ResultCode lastErrorCode() const;
+
+    bool open(const QString &name, QUnQLite::OpenMode mode, int maxHandles);
+    bool close();
+
+    int maxHandles() const;
+    int availableHandles() const;
+
+    QUnQLite * acquire(int timeout = -1);
+    void release(QUnQLite *db);
+
+    QVector<HandleStats> handleStats(bool reset = false) const;
+
+private:
+    D_POINTER
+};
+
+#endif // QUNQLITEPOOL_H
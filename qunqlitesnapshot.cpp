@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qunqlitesnapshot.h"
+#include "qunqlitecursor.h"
+
+class QUnQLiteSnapshot::Private
+{
+public:
+    Private(QUnQLiteSnapshot * q_ptr) : q(q_ptr) {}
+
+    QUnQLite *q_unqlite;
+    unqlite *db;
+    unqlite_snapshot *snapshot;
+
+    Q_POINTER(QUnQLiteSnapshot)
+};
+
+/*!
+ * \class QUnQLiteSnapshot
+ * \brief A read-only view of the database as it was committed
+ * when the snapshot was taken.
+ *
+ * Cursors created from a snapshot never block writers and are never
+ * invalidated by them: records stored, updated or removed after the
+ * snapshot was taken, committed or not, are not visible.
+ * Only changes made through the database handle the snapshot was taken
+ * from are isolated, not the ones made by other processes.
+ *
+ * Snapshots can be created by database instances, see \c QUnQLite::snapshot().
+ * A snapshot must be destroyed before its database is closed.
+ */
+
+/*!
+ * \brief Constructs an instance of QUnQLiteSnapshot.
+ */
+QUnQLiteSnapshot::QUnQLiteSnapshot(QUnQLite *db, unqlite *handle, unqlite_snapshot *snapshot) :
+    d(this)
+{
+    d->q_unqlite = db;
+    d->db = handle;
+    d->snapshot = snapshot;
+}
+
+/*!
+ * \brief Destructs the instance.
+ *
+ * Cursors created from this snapshot are destroyed too.
+ */
+QUnQLiteSnapshot::~QUnQLiteSnapshot()
+{
+    qDeleteAll(findChildren<QUnQLiteCursor *>());
+    unqlite_snapshot_release(d->db, d->snapshot);
+}
+
+/*!
+ * \brief Get the database this snapshot was taken from.
+ */
+QUnQLite * QUnQLiteSnapshot::database() const
+{
+    return d->q_unqlite;
+}
+
+/*!
+ * \brief Create a cursor to this snapshot.
+ *
+ * The cursor is owned by the snapshot. Deleting a record through it fails
+ * with QUnQLite::IsReadOnly.
+ */
+QUnQLiteCursor * QUnQLiteSnapshot::cursor()
+{
+    return new QUnQLiteCursor(this);
+}
+
+unqlite_snapshot * QUnQLiteSnapshot::handle() const
+{
+    return d->snapshot;
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qunqlitestatement.h"
+
+#include <QStringList>
+
+#include <cstring>
+
+class QUnQLiteStatement::Private
+{
+public:
+    Private(QUnQLiteStatement * q_ptr) : q(q_ptr) {}
+
+    void setResultCode(int rc)
+    {
+        resultCode = static_cast<QUnQLite::ResultCode>(rc);
+    }
+
+    bool isSuccess() const
+    {
+        return resultCode == QUnQLite::Ok;
+    }
+
+    unqlite_value * newValue(const QVariant &value);
+
+    QUnQLite *q_unqlite;
+    unqlite_vm *vm;
+    QString script;
+    QByteArray output;
+    bool executed;
+    QUnQLite::ResultCode resultCode;
+
+    Q_POINTER(QUnQLiteStatement)
+};
+
+/*
+ * Output consumer installed on the virtual machine, see output().
+ */
+static int outputConsumer(const void *data, unsigned int length, void *userData)
+{
+    QByteArray *output = static_cast<QByteArray *>(userData);
+    output->append(static_cast<const char *>(data), length);
+    return UNQLITE_OK;
+}
+
+/*
+ * Convert a Jx9 value to a QVariant. JSON arrays and objects become
+ * QVariantList and QVariantMap.
+ */
+static QVariant toVariant(unqlite_value *value);
+
+static int listWalker(unqlite_value *key, unqlite_value *value, void *userData)
+{
+    Q_UNUSED(key);
+    static_cast<QVariantList *>(userData)->append(toVariant(value));
+    return UNQLITE_OK;
+}
+
+static int mapWalker(unqlite_value *key, unqlite_value *value, void *userData)
+{
+    int length;
+    const char *name = unqlite_value_to_string(key, &length);
+    static_cast<QVariantMap *>(userData)->insert(QString::fromUtf8(name, length), toVariant(value));
+    return UNQLITE_OK;
+}
+
+static QVariant toVariant(unqlite_value *value)
+{
+    if(value == NULL || unqlite_value_is_null(value)) {
+        return QVariant();
+    } else if(unqlite_value_is_bool(value)) {
+        return QVariant(unqlite_value_to_bool(value) != 0);
+    } else if(unqlite_value_is_int(value)) {
+        return QVariant(static_cast<qint64>(unqlite_value_to_int64(value)));
+    } else if(unqlite_value_is_float(value)) {
+        return QVariant(unqlite_value_to_double(value));
+    } else if(unqlite_value_is_json_object(value)) {
+        QVariantMap map;
+        unqlite_array_walk(value, mapWalker, &map);
+        return map;
+    } else if(unqlite_value_is_json_array(value)) {
+        QVariantList list;
+        unqlite_array_walk(value, listWalker, &list);
+        return list;
+    }
+    int length;
+    const char *string = unqlite_value_to_string(value, &length);
+    return QVariant(QString::fromUtf8(string, length));
+}
+
+/*
+ * Convert a QVariant to a new Jx9 value. Lists and maps become
+ * JSON arrays and objects.
+ * The returned value must be released with unqlite_vm_release_value().
+ */
+unqlite_value * QUnQLiteStatement::Private::newValue(const QVariant &value)
+{
+    unqlite_value *result;
+    switch(value.type()) {
+    case QVariant::List:
+    case QVariant::StringList:
+    {
+        result = unqlite_vm_new_array(vm);
+        if(result == NULL) {
+            return NULL;
+        }
+        foreach(const QVariant &item, value.toList()) {
+            unqlite_value *element = newValue(item);
+            if(element == NULL) {
+                unqlite_vm_release_value(vm, result);
+                return NULL;
+            }
+            unqlite_array_add_elem(result, NULL, element);
+            unqlite_vm_release_value(vm, element);
+        }
+        return result;
+    }
+    case QVariant::Map:
+    {
+        result = unqlite_vm_new_array(vm);
+        if(result == NULL) {
+            return NULL;
+        }
+        const QVariantMap map = value.toMap();
+        for(QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            unqlite_value *element = newValue(it.value());
+            if(element == NULL) {
+                unqlite_vm_release_value(vm, result);
+                return NULL;
+            }
+            unqlite_array_add_strkey_elem(result, it.key().toUtf8().constData(), element);
+            unqlite_vm_release_value(vm, element);
+        }
+        return result;
+    }
+    default:
+        break;
+    }
+    result = unqlite_vm_new_scalar(vm);
+    if(result == NULL) {
+        return NULL;
+    }
+    switch(value.type()) {
+    case QVariant::Invalid:
+        unqlite_value_null(result);
+        break;
+    case QVariant::Bool:
+        unqlite_value_bool(result, value.toBool() ? 1 : 0);
+        break;
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        unqlite_value_int64(result, value.toLongLong());
+        break;
+    case QVariant::Double:
+        unqlite_value_double(result, value.toDouble());
+        break;
+    default:
+    {
+        const QByteArray string = value.type() == QVariant::ByteArray ? value.toByteArray() : value.toString().toUtf8();
+        unqlite_value_string(result, string.constData(), string.size());
+        break;
+    }
+    }
+    return result;
+}
+
+/*!
+ * \class QUnQLiteStatement
+ * \brief A compiled Jx9 script that can be executed many times.
+ *
+ * Compiling a script (lexing, parsing and bytecode generation) is done
+ * once, when the statement is prepared. Each call to \c exec() then runs
+ * the bytecode again. Values are passed to the script with \c bind() and
+ * read back after execution with \c value().
+ *
+ * Statements are created and cached by database instances, see
+ * \c QUnQLite::prepare(). A statement is owned by its database and destroyed
+ * when the database is closed. Deleting a statement removes it from the cache.
+ * A statement must not be executed by several threads at the same time.
+ */
+
+/*!
+ * \brief Constructs an instance of QUnQLiteStatement.
+ *
+ * The statement is a child of \a db.
+ */
+QUnQLiteStatement::QUnQLiteStatement(QUnQLite *db, unqlite_vm *vm, const QString &script) :
+    QObject(db),
+    d(this)
+{
+    d->q_unqlite = db;
+    d->vm = vm;
+    d->script = script;
+    d->executed = false;
+    d->setResultCode(unqlite_vm_config(d->vm, UNQLITE_VM_CONFIG_OUTPUT, outputConsumer, &d->output));
+}
+
+/*!
+ * \brief Destructs the instance and releases the compiled script.
+ */
+QUnQLiteStatement::~QUnQLiteStatement()
+{
+    d->q_unqlite->removeStatement(this);
+    unqlite_vm_release(d->vm);
+}
+
+/*!
+ * \brief Get the database this statement was prepared on.
+ */
+QUnQLite * QUnQLiteStatement::database() const
+{
+    return d->q_unqlite;
+}
+
+/*!
+ * \brief Get the source of the compiled script.
+ */
+QString QUnQLiteStatement::script() const
+{
+    return d->script;
+}
+
+/*!
+ * \brief Get the result code of the last operation on this statement.
+ */
+QUnQLite::ResultCode QUnQLiteStatement::lastErrorCode() const
+{
+    return d->resultCode;
+}
+
+/*!
+ * \brief Set the global variable \a name of the script to \a value.
+ *
+ * Lists and maps are converted to JSON arrays and objects, other values
+ * to scalars. The variable keeps its value across executions until it is
+ * bound again.
+ * \return True if success.
+ */
+bool QUnQLiteStatement::bind(const QString &name, const QVariant &value)
+{
+    unqlite_value *converted = d->newValue(value);
+    if(converted == NULL) {
+        d->setResultCode(UNQLITE_NOMEM);
+        return false;
+    }
+    d->setResultCode(unqlite_vm_config(d->vm, UNQLITE_VM_CONFIG_CREATE_VAR, name.toUtf8().constData(), converted));
+    unqlite_vm_release_value(d->vm, converted);
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Execute the script.
+ *
+ * The virtual machine is reset first if the script was already executed, the
+ * output and the variables of the previous execution are then discarded, except
+ * the global variables the script does not assign.
+ * \return True if success.
+ */
+bool QUnQLiteStatement::exec()
+{
+    if(d->executed) {
+        d->setResultCode(unqlite_vm_reset(d->vm));
+        if(!d->isSuccess()) {
+            return false;
+        }
+        d->executed = false;
+    }
+    d->output.clear();
+    d->setResultCode(unqlite_vm_exec(d->vm));
+    d->executed = d->isSuccess();
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Get the value of the global variable \a name after \c exec().
+ *
+ * JSON arrays and objects are returned as QVariantList and QVariantMap.
+ * An invalid QVariant is returned if the variable does not exist.
+ */
+QVariant QUnQLiteStatement::value(const QString &name) const
+{
+    unqlite_value *value = unqlite_vm_extract_variable(d->vm, name.toUtf8().constData());
+    d->setResultCode(value ? UNQLITE_OK : UNQLITE_NOTFOUND);
+    return toVariant(value);
+}
+
+/*!
+ * \brief Get what the last execution of the script printed.
+ */
+QByteArray QUnQLiteStatement::output() const
+{
+    return d->output;
+}
+
+/*!
+ * \brief Set the size in bytes of the collection record cache of this statement.
+ *
+ * Records fetched or stored by the script are kept decoded in this cache, the
+ * least recently used ones being evicted once it is full. It keeps its content
+ * across executions. The default is 4MB, zero disables the cache.
+ * \return True if success.
+ */
+bool QUnQLiteStatement::setRecordCacheSize(int bytes)
+{
+    d->setResultCode(unqlite_vm_config(d->vm, UNQLITE_VM_CONFIG_RECORD_CACHE, static_cast<unsigned int>(qMax(bytes, 0))));
+    return d->isSuccess();
+}
+
+/*!
+ * \brief Return the counters of the collection record cache of this statement.
+ *
+ * Counters are cumulative since the statement was prepared. If \a reset is
+ * true, they start again from zero after this call.
+ * On failure, all fields are zero and \c lastErrorCode() reports the error.
+ */
+QUnQLiteStatement::RecordCacheStats QUnQLiteStatement::recordCacheStats(bool reset) const
+{
+    RecordCacheStats stats;
+    unqlite_record_cache_stats raw;
+    std::memset(&raw, 0, sizeof(raw));
+    d->setResultCode(unqlite_vm_config(d->vm, UNQLITE_VM_CONFIG_RECORD_CACHE_STATS, &raw, reset ? 1 : 0));
+    stats.hits = raw.nHit;
+    stats.misses = raw.nMiss;
+    stats.evictions = raw.nEvict;
+    stats.records = raw.nRecord;
+    stats.bytes = raw.nByte;
+    stats.cacheSize = raw.nMaxByte;
+    return stats;
+}
+
+/*!
+ * \class QUnQLiteStatement::RecordCacheStats
+ * \brief Counters returned by \c recordCacheStats().
+ *
+ * \c hits and \c misses count record lookups served from the cache or read
+ * and decoded again, \c evictions counts records dropped to stay within the
+ * cache size. \c records, \c bytes and \c cacheSize are the current number of
+ * cached records, their estimated size and the cache size.
+ */
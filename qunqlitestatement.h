@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QUNQLITESTATEMENT_H
+#define QUNQLITESTATEMENT_H
+
+#include <QObject>
+#include <QVariant>
+
+#include "dpointer.h"
+#include "qunqlite.h"
+
+class QUnQLiteStatement : public QObject
+{
+    Q_OBJECT
+public:
+    struct RecordCacheStats
+    {
+        qint64 hits;
+        qint64 misses;
+        qint64 evictions;
+        int records;
+        int bytes;
+        int cacheSize;
+    };
+
+    ~QUnQLiteStatement();
+
+    QUnQLite * database() const;
+    QString script() const;
+    QUnQLite::ResultCode lastErrorCode() const;
+
+    bool bind(const QString &name, const QVariant &value);
+    bool exec();
+
+    QVariant value(const QString &name) const;
+    QByteArray output() const;
+
+    bool setRecordCacheSize(int bytes);
+    RecordCacheStats recordCacheStats(bool reset = false) const;
+
+private:
+    QUnQLiteStatement(QUnQLite *db, unqlite_vm *vm, const QString &script);
+
+    friend class QUnQLite;
+
+    D_POINTER
+};
+
+#endif // QUNQLITESTATEMENT_H
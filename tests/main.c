@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Behavior tests of the UnQLite engine. Run all of them, or only those
+ * named on the command line:
+ *
+ *   unqlite_tests [test_name...]
+ *
+ * Databases are created in the working directory and removed afterwards.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unqlite_test.h"
+
+static const struct {
+	const char *zName;
+	int (*xTest)(void);
+} aTest[] = {
+	{ "kv_store_batch",      test_kv_store_batch      },
+	{ "kv_begin_new",        test_kv_begin_new        },
+	{ "btree_order",         test_btree_order         },
+	{ "btree_cursor_stability", test_btree_cursor_stability },
+	{ "wal_recovery",        test_wal_recovery        },
+	{ "wal_rollback",        test_wal_rollback        },
+	{ "group_commit",        test_group_commit        },
+	{ "group_commit_rollback", test_group_commit_rollback },
+	{ "pager_scan_resistance", test_pager_scan_resistance },
+	{ "pager_stats",         test_pager_stats         },
+	{ "pager_mmap",          test_pager_mmap          },
+	{ "pager_shared_cache",  test_pager_shared_cache  },
+	{ "pager_write_back",    test_pager_write_back    },
+	{ "pager_vectored_write", test_pager_vectored_write },
+	{ "hash_seed",           test_hash_seed           },
+	{ "concurrent_readers",  test_concurrent_readers  },
+	{ "snapshot_cursor",     test_snapshot_cursor     },
+	{ "snapshot_callbacks",  test_snapshot_callbacks  },
+	{ "mem_skiplist",        test_mem_skiplist        },
+	{ "mem_compact",         test_mem_compact         },
+	{ "concurrent_alloc",    test_concurrent_alloc    },
+	{ "collection_rollback", test_collection_rollback },
+	{ "collection_index",    test_collection_index    },
+	{ "collection_cache",    test_collection_cache    },
+};
+
+void test_fail(const char *zFile,int iLine,const char *zExpr)
+{
+	fprintf(stderr,"%s:%d: check failed: %s\n",zFile,iLine,zExpr);
+}
+
+const char * test_db_path(const char *zName)
+{
+	static char zPath[256];
+	snprintf(zPath,sizeof(zPath),"unqlite_test_%s.db",zName);
+	test_db_remove(zPath);
+	return zPath;
+}
+
+void test_db_remove(const char *zPath)
+{
+	static const char *azSuffix[] = { "", "_unqlite_journal", "_unqlite_wal" };
+	char zFile[300];
+	size_t n;
+	for( n = 0 ; n < sizeof(azSuffix) / sizeof(azSuffix[0]) ; ++n ){
+		snprintf(zFile,sizeof(zFile),"%s%s",zPath,azSuffix[n]);
+		unlink(zFile);
+	}
+}
+
+/*
+ * Compile and run a Jx9 script, then extract the integer value of one
+ * of its variables if zVar is not NULL.
+ */
+int test_jx9_exec(unqlite *pDb,const char *zScript,const char *zVar,unqlite_int64 *pValue)
+{
+	unqlite_value *pVal;
+	unqlite_vm *pVm;
+	int rc;
+	rc = unqlite_compile(pDb,zScript,-1,&pVm);
+	if( rc != UNQLITE_OK ){
+		return rc;
+	}
+	rc = unqlite_vm_exec(pVm);
+	if( rc == UNQLITE_OK && zVar ){
+		pVal = unqlite_vm_extract_variable(pVm,zVar);
+		if( pVal == 0 ){
+			rc = UNQLITE_NOTFOUND;
+		}else{
+			*pValue = unqlite_value_to_int64(pVal);
+			unqlite_vm_release_value(pVm,pVal);
+		}
+	}
+	unqlite_vm_release(pVm);
+	return rc;
+}
+
+int main(int argc,char *argv[])
+{
+	size_t n;
+	int i,nRun = 0,nFail = 0;
+	/* Several tests share a handle between threads */
+	unqlite_lib_config(UNQLITE_LIB_CONFIG_THREAD_LEVEL_MULTI);
+	for( n = 0 ; n < sizeof(aTest) / sizeof(aTest[0]) ; ++n ){
+		if( argc > 1 ){
+			for( i = 1 ; i < argc ; ++i ){
+				if( strcmp(argv[i],aTest[n].zName) == 0 ){
+					break;
+				}
+			}
+			if( i >= argc ){
+				continue;
+			}
+		}
+		nRun++;
+		if( aTest[n].xTest() != 0 ){
+			printf("FAIL %s\n",aTest[n].zName);
+			nFail++;
+		}else{
+			printf("ok   %s\n",aTest[n].zName);
+		}
+	}
+	printf("%d test(s), %d failure(s)\n",nRun,nFail);
+	return nFail > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * B+Tree storage engine tests.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "unqlite_test.h"
+
+static int cursor_key(unqlite_kv_cursor *pCur,char *zBuf,int nBuf)
+{
+	int nByte = nBuf - 1;
+	int rc;
+	rc = unqlite_kv_cursor_key(pCur,zBuf,&nByte);
+	zBuf[rc == UNQLITE_OK ? nByte : 0] = 0;
+	return rc;
+}
+
+/*
+ * Keys come back in order.
+ */
+int test_btree_order(void)
+{
+	const char *zPath = test_db_path("btree_order");
+	unqlite_kv_cursor *pCur;
+	char zKey[32],zPrev[32];
+	unqlite *pDb;
+	int i,n;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,"btree"));
+	for( i = 0 ; i < 5000 ; ++i ){
+		sprintf(zKey,"key-%06d",(i * 7919) % 5000);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,zKey,(unqlite_int64)strlen(zKey)));
+	}
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_kv_cursor_init(pDb,&pCur));
+	n = 0;
+	zPrev[0] = 0;
+	for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		TEST_OK(cursor_key(pCur,zKey,sizeof(zKey)));
+		TEST_CHECK(strcmp(zPrev,zKey) < 0);
+		strcpy(zPrev,zKey);
+		n++;
+	}
+	TEST_CHECK(n == 5000);
+	TEST_OK(unqlite_kv_cursor_release(pDb,pCur));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+
+/*
+ * A cursor keeps its position when the tree is modified under it: inserts
+ * that split its leaf are neither skipped nor returned twice, and if its
+ * record is removed, the next step returns the successor.
+ */
+int test_btree_cursor_stability(void)
+{
+	const char *zPath = test_db_path("btree_cursor_stability");
+	unqlite_kv_cursor *pCur;
+	char zKey[32];
+	unqlite *pDb;
+	int i,n;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,"btree"));
+	for( i = 0 ; i < 1000 ; i += 2 ){
+		sprintf(zKey,"key-%06d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,"x",1));
+	}
+	TEST_OK(unqlite_kv_cursor_init(pDb,&pCur));
+	TEST_OK(unqlite_kv_cursor_seek(pCur,"key-000100",-1,UNQLITE_CURSOR_MATCH_EXACT));
+	/* Remove the current record */
+	TEST_OK(unqlite_kv_delete(pDb,"key-000100",-1));
+	TEST_OK(unqlite_kv_cursor_next_entry(pCur));
+	TEST_OK(cursor_key(pCur,zKey,sizeof(zKey)));
+	TEST_CHECK(strcmp(zKey,"key-000102") == 0);
+	/* Remove the current record and its successor */
+	TEST_OK(unqlite_kv_delete(pDb,"key-000102",-1));
+	TEST_OK(unqlite_kv_delete(pDb,"key-000104",-1));
+	TEST_OK(unqlite_kv_cursor_next_entry(pCur));
+	TEST_OK(cursor_key(pCur,zKey,sizeof(zKey)));
+	TEST_CHECK(strcmp(zKey,"key-000106") == 0);
+	/* Fill the gaps while walking: every odd key past the cursor is seen once */
+	n = 0;
+	for( ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		TEST_OK(cursor_key(pCur,zKey,sizeof(zKey)));
+		sscanf(zKey,"key-%d",&i);
+		if( (i & 1) == 0 && i + 1 < 1000 ){
+			sprintf(zKey,"key-%06d",i + 1);
+			TEST_OK(unqlite_kv_store(pDb,zKey,-1,"y",1));
+		}
+		n++;
+	}
+	/* 447 even keys from 106 to 998, 447 odd ones from 107 to 999 */
+	TEST_CHECK(n == 447 + 447);
+	TEST_OK(unqlite_kv_cursor_release(pDb,pCur));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
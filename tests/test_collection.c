@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Jx9 collection tests.
+ */
+#include "unqlite_test.h"
+
+/*
+ * Collection headers are written once per VM execution, a rollback in the
+ * middle of the script must not leave the counters of the rolled back
+ * records in memory nor write them at the end of the execution.
+ */
+int test_collection_rollback(void)
+{
+	const char *zPath = test_db_path("collection_rollback");
+	unqlite_int64 nTotal,nLastId;
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(test_jx9_exec(pDb,
+		"db_create('c'); db_store('c',{a:1}); db_commit();"
+		"db_store('c',[{a:2},{a:3},{a:4}]); db_rollback();"
+		"$total = db_total_records('c'); $last = db_last_record_id('c');",
+		"total",&nTotal));
+	TEST_CHECK(nTotal == 1);
+	TEST_OK(test_jx9_exec(pDb,"$last = db_last_record_id('c');","last",&nLastId));
+	TEST_CHECK(nLastId == 0);
+	TEST_OK(unqlite_close(pDb));
+	/* The header on disk must agree */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(test_jx9_exec(pDb,"$total = db_total_records('c');","total",&nTotal));
+	TEST_CHECK(nTotal == 1);
+	TEST_OK(test_jx9_exec(pDb,"$last = db_last_record_id('c');","last",&nLastId));
+	TEST_CHECK(nLastId == 0);
+	/* Stores after the rollback reuse the rolled back record IDs */
+	TEST_OK(test_jx9_exec(pDb,
+		"db_store('c',{a:5}); $last = db_last_record_id('c');",
+		"last",&nLastId));
+	TEST_CHECK(nLastId == 1);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Indexed lookups agree with a full scan while records are stored and dropped,
+ * and after the transaction that created the index was rolled back.
+ */
+int test_collection_index(void)
+{
+	const char *zPath = test_db_path("collection_index");
+	unqlite_int64 nCount;
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(test_jx9_exec(pDb,
+		"db_create('c');"
+		"for($i = 0 ; $i < 200 ; $i++){ db_store('c',{k:$i % 10,n:$i}); }"
+		"$ok = db_create_index('c','k');"
+		"for($i = 200 ; $i < 300 ; $i++){ db_store('c',{k:$i % 10,n:$i}); }"
+		"db_drop_record('c',3); db_drop_record('c',13);"
+		"$count = count(db_fetch_by('c','k',3));",
+		"count",&nCount));
+	TEST_CHECK(nCount == 28);
+	TEST_OK(test_jx9_exec(pDb,"$count = count(db_fetch_by('c','k',42));","count",&nCount));
+	TEST_CHECK(nCount == 0);
+	TEST_OK(unqlite_close(pDb));
+	/* The index is persistent */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(test_jx9_exec(pDb,
+		"$r = db_fetch_by('c','k',7); $count = 0;"
+		"foreach($r as $rec){ if($rec.k == 7 && $rec.n % 10 == 7){ $count++; } }",
+		"count",&nCount));
+	TEST_CHECK(nCount == 30);
+	/* Without the index the same records are found by a scan */
+	TEST_OK(test_jx9_exec(pDb,
+		"db_drop_index('c','k'); $count = count(db_fetch_by('c','k',3));",
+		"count",&nCount));
+	TEST_CHECK(nCount == 28);
+	/* A rolled back index is not used */
+	TEST_OK(test_jx9_exec(pDb,
+		"db_commit(); db_create_index('c','k'); db_rollback();"
+		"db_store('c',{k:3,n:300}); $count = count(db_fetch_by('c','k',3));",
+		"count",&nCount));
+	TEST_CHECK(nCount == 29);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * The record cache of a VM stays within its budget and evicts the least
+ * recently used records first.
+ */
+int test_collection_cache(void)
+{
+	const char *zPath = test_db_path("collection_cache");
+	unqlite_record_cache_stats sStats;
+	unqlite_value *pVal;
+	unqlite_vm *pVm;
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(test_jx9_exec(pDb,
+		"db_create('c');"
+		"for($i = 0 ; $i < 2000 ; $i++){ db_store('c',{n:$i,pad:'0123456789012345678901234567890123456789'}); }",
+		0,0));
+	TEST_OK(unqlite_compile(pDb,
+		"$sum = 0;"
+		"for($i = 0 ; $i < 2000 ; $i++){ $r = db_fetch_by_id('c',$i); $sum += $r.n; }"
+		"for($j = 0 ; $j < 10 ; $j++){ $r = db_fetch_by_id('c',1999); $sum += $r.n; }",
+		-1,&pVm));
+	TEST_OK(unqlite_vm_config(pVm,UNQLITE_VM_CONFIG_RECORD_CACHE,16384));
+	TEST_OK(unqlite_vm_exec(pVm));
+	pVal = unqlite_vm_extract_variable(pVm,"sum");
+	TEST_CHECK(pVal != 0);
+	TEST_CHECK(unqlite_value_to_int64(pVal) == 1999 * 1000 + 1999 * 10);
+	unqlite_vm_release_value(pVm,pVal);
+	TEST_OK(unqlite_vm_config(pVm,UNQLITE_VM_CONFIG_RECORD_CACHE_STATS,&sStats,0));
+	TEST_CHECK(sStats.nMaxByte == 16384);
+	TEST_CHECK(sStats.nByte <= sStats.nMaxByte);
+	TEST_CHECK(sStats.nEvict > 0);
+	/* The most recently used record was served from the cache */
+	TEST_CHECK(sStats.nHit >= 10);
+	TEST_CHECK(sStats.nMiss >= 2000);
+	TEST_OK(unqlite_vm_release(pVm));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
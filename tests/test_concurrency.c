@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Concurrency tests: threads sharing a handle.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unqlite_test.h"
+
+#define CONCURRENCY_READERS 4
+#define CONCURRENCY_KEYS    2000
+#define CONCURRENCY_ROUNDS  10
+
+typedef struct concurrency_ctx concurrency_ctx;
+struct concurrency_ctx
+{
+	unqlite *pDb;
+	int bStop;
+	int nFail;
+	pthread_mutex_t sMutex;
+};
+
+static void concurrency_fail(concurrency_ctx *pCtx)
+{
+	pthread_mutex_lock(&pCtx->sMutex);
+	pCtx->nFail++;
+	pthread_mutex_unlock(&pCtx->sMutex);
+}
+
+static int concurrency_stopped(concurrency_ctx *pCtx)
+{
+	int bStop;
+	pthread_mutex_lock(&pCtx->sMutex);
+	bStop = pCtx->bStop;
+	pthread_mutex_unlock(&pCtx->sMutex);
+	return bStop;
+}
+
+static void * concurrency_read(void *pArg)
+{
+	concurrency_ctx *pCtx = (concurrency_ctx *)pArg;
+	char zKey[32],zData[64],zExpect[32];
+	unqlite_kv_cursor *pCur;
+	unqlite_int64 nData;
+	int i,n,rc;
+	while( !concurrency_stopped(pCtx) ){
+		for( i = 0 ; i < CONCURRENCY_KEYS ; i += 7 ){
+			sprintf(zKey,"key-%d",i);
+			sprintf(zExpect,"value-%d-",i);
+			nData = sizeof(zData) - 1;
+			rc = unqlite_kv_fetch(pCtx->pDb,zKey,-1,zData,&nData);
+			if( rc != UNQLITE_OK || strncmp(zData,zExpect,strlen(zExpect)) != 0 ){
+				concurrency_fail(pCtx);
+			}
+		}
+		/* A cursor sees every record */
+		if( unqlite_kv_cursor_init(pCtx->pDb,&pCur) != UNQLITE_OK ){
+			concurrency_fail(pCtx);
+			continue;
+		}
+		n = 0;
+		for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+			n++;
+		}
+		unqlite_kv_cursor_release(pCtx->pDb,pCur);
+		if( n < CONCURRENCY_KEYS ){
+			concurrency_fail(pCtx);
+		}
+	}
+	return 0;
+}
+
+static void * concurrency_write(void *pArg)
+{
+	concurrency_ctx *pCtx = (concurrency_ctx *)pArg;
+	char zKey[32],zData[64];
+	int i,iRound;
+	for( iRound = 0 ; iRound < CONCURRENCY_ROUNDS ; ++iRound ){
+		for( i = 0 ; i < CONCURRENCY_KEYS ; i += 3 ){
+			sprintf(zKey,"key-%d",i);
+			sprintf(zData,"value-%d-%d%s",i,iRound,(iRound & 1) ? "-grown-to-move-the-record" : "");
+			if( unqlite_kv_store(pCtx->pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)) != UNQLITE_OK ){
+				concurrency_fail(pCtx);
+			}
+		}
+		if( unqlite_commit(pCtx->pDb) != UNQLITE_OK ){
+			concurrency_fail(pCtx);
+		}
+	}
+	pthread_mutex_lock(&pCtx->sMutex);
+	pCtx->bStop = 1;
+	pthread_mutex_unlock(&pCtx->sMutex);
+	return 0;
+}
+
+/*
+ * Run CONCURRENCY_READERS readers and one writer on a shared handle using
+ * the zEngine storage engine (the default one if NULL) and return the number
+ * of failed operations, or -1 on failure.
+ */
+static int concurrency_run(const char *zPath,const char *zEngine)
+{
+	pthread_t aThread[CONCURRENCY_READERS + 1];
+	concurrency_ctx sCtx;
+	char zKey[32],zData[64];
+	int i;
+	memset(&sCtx,0,sizeof(sCtx));
+	if( unqlite_open(&sCtx.pDb,zPath,UNQLITE_OPEN_CREATE) != UNQLITE_OK ){
+		return -1;
+	}
+	if( zEngine && unqlite_config(sCtx.pDb,UNQLITE_CONFIG_KV_ENGINE,zEngine) != UNQLITE_OK ){
+		unqlite_close(sCtx.pDb);
+		return -1;
+	}
+	for( i = 0 ; i < CONCURRENCY_KEYS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		sprintf(zData,"value-%d-init",i);
+		if( unqlite_kv_store(sCtx.pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)) != UNQLITE_OK ){
+			sCtx.nFail++;
+		}
+	}
+	if( unqlite_commit(sCtx.pDb) != UNQLITE_OK ){
+		sCtx.nFail++;
+	}
+	pthread_mutex_init(&sCtx.sMutex,0);
+	for( i = 0 ; i < CONCURRENCY_READERS ; ++i ){
+		pthread_create(&aThread[i],0,concurrency_read,&sCtx);
+	}
+	pthread_create(&aThread[CONCURRENCY_READERS],0,concurrency_write,&sCtx);
+	for( i = 0 ; i <= CONCURRENCY_READERS ; ++i ){
+		pthread_join(aThread[i],0);
+	}
+	pthread_mutex_destroy(&sCtx.sMutex);
+	unqlite_close(sCtx.pDb);
+	test_db_remove(zPath);
+	return sCtx.nFail;
+}
+
+/*
+ * Readers sharing a handle with a writer always see committed or
+ * in-progress values, never torn ones.
+ */
+int test_concurrent_readers(void)
+{
+	TEST_CHECK(concurrency_run(test_db_path("concurrent_readers"),0) == 0);
+	/* The B+Tree engine has its own shared reader path */
+	TEST_CHECK(concurrency_run(test_db_path("concurrent_readers"),"btree") == 0);
+	return 0;
+}
+
+/*
+ * Pool allocations of the engine shared by concurrent threads are
+ * served by their per-thread caches.
+ */
+int test_concurrent_alloc(void)
+{
+	unqlite_mem_stats sStats;
+	TEST_OK(unqlite_lib_mem_stats(&sStats,1));
+	TEST_CHECK(concurrency_run(test_db_path("concurrent_alloc"),0) == 0);
+	TEST_OK(unqlite_lib_mem_stats(&sStats,0));
+	TEST_CHECK(sStats.nCacheHit > 0);
+	TEST_CHECK(sStats.nRefill > 0);
+	return 0;
+}
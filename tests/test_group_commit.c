@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Group commit tests.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "unqlite_test.h"
+
+#define GROUP_THREADS 8
+#define GROUP_COMMITS 10
+
+typedef struct group_writer group_writer;
+struct group_writer
+{
+	unqlite *pDb;
+	int iId;
+	int nFail;
+};
+
+static void * group_write(void *pArg)
+{
+	group_writer *pWriter = (group_writer *)pArg;
+	char zKey[32];
+	int i;
+	for( i = 0 ; i < GROUP_COMMITS ; ++i ){
+		sprintf(zKey,"t%d-%d",pWriter->iId,i);
+		if( unqlite_kv_store(pWriter->pDb,zKey,-1,"x",1) != UNQLITE_OK ||
+			unqlite_commit(pWriter->pDb) != UNQLITE_OK ){
+			pWriter->nFail++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Run GROUP_THREADS threads committing on the same handle and return
+ * the number of syncs, or -1 on failure.
+ */
+static int group_run(const char *zPath,int nWindow)
+{
+	group_writer aWriter[GROUP_THREADS];
+	pthread_t aThread[GROUP_THREADS];
+	unqlite_pager_stats sStats;
+	unqlite_kv_cursor *pCur;
+	unqlite *pDb;
+	int i,n,nFail = 0;
+	if( unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE) != UNQLITE_OK ){
+		return -1;
+	}
+	unqlite_config(pDb,UNQLITE_CONFIG_COMMIT_WINDOW,nWindow);
+	unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,1);
+	for( i = 0 ; i < GROUP_THREADS ; ++i ){
+		aWriter[i].pDb = pDb;
+		aWriter[i].iId = i;
+		aWriter[i].nFail = 0;
+		pthread_create(&aThread[i],0,group_write,&aWriter[i]);
+	}
+	for( i = 0 ; i < GROUP_THREADS ; ++i ){
+		pthread_join(aThread[i],0);
+		nFail += aWriter[i].nFail;
+	}
+	unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,0);
+	/* Every record must be there */
+	n = 0;
+	if( unqlite_kv_cursor_init(pDb,&pCur) == UNQLITE_OK ){
+		for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+			n++;
+		}
+		unqlite_kv_cursor_release(pDb,pCur);
+	}
+	unqlite_close(pDb);
+	test_db_remove(zPath);
+	if( nFail > 0 || n != GROUP_THREADS * GROUP_COMMITS ){
+		return -1;
+	}
+	return (int)sStats.nSync;
+}
+
+/*
+ * Commits of threads sharing a handle within the commit window share
+ * their syncs. A lone writer does not wait for the window.
+ */
+int test_group_commit(void)
+{
+	const char *zPath = test_db_path("group_commit");
+	struct timeval sStart,sEnd;
+	unqlite *pDb;
+	long nElapsed;
+	int nSolo,nGroup;
+	nSolo = group_run(zPath,0);
+	TEST_CHECK(nSolo > 0);
+	nGroup = group_run(zPath,2000);
+	TEST_CHECK(nGroup > 0);
+	TEST_CHECK(nGroup < nSolo);
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_COMMIT_WINDOW,1000000));
+	gettimeofday(&sStart,0);
+	TEST_OK(unqlite_kv_store(pDb,"solo",-1,"x",1));
+	TEST_OK(unqlite_commit(pDb));
+	gettimeofday(&sEnd,0);
+	nElapsed = (sEnd.tv_sec - sStart.tv_sec) * 1000000L + (sEnd.tv_usec - sStart.tv_usec);
+	TEST_CHECK(nElapsed < 500000);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+
+typedef struct group_leader group_leader;
+struct group_leader
+{
+	unqlite *pDb;
+	const char *zKey;
+	int rc;
+};
+
+static void * group_lead(void *pArg)
+{
+	group_leader *pLeader = (group_leader *)pArg;
+	pLeader->rc = unqlite_kv_store(pLeader->pDb,pLeader->zKey,-1,"x",1);
+	if( pLeader->rc == UNQLITE_OK ){
+		pLeader->rc = unqlite_commit(pLeader->pDb);
+	}
+	return 0;
+}
+
+/*
+ * While a group is gathering, a rollback from another thread fails instead of
+ * discarding the changes of the group and a close waits for the group commit.
+ */
+int test_group_commit_rollback(void)
+{
+	const char *zPath = test_db_path("group_commit_rollback");
+	static const char *azKey[] = { "main1", "lead1", "main2", "lead2" };
+	group_leader sLeader;
+	pthread_t sThread;
+	unqlite_int64 nByte;
+	unqlite *pDb;
+	int i;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_COMMIT_WINDOW,500000));
+	/* Two writers so that the leader opens the window */
+	TEST_OK(unqlite_kv_store(pDb,azKey[0],-1,"x",1));
+	sLeader.pDb = pDb;
+	sLeader.zKey = azKey[1];
+	sLeader.rc = -1;
+	pthread_create(&sThread,0,group_lead,&sLeader);
+	usleep(100000);
+	TEST_CHECK(unqlite_rollback(pDb) == UNQLITE_BUSY);
+	pthread_join(sThread,0);
+	TEST_OK(sLeader.rc);
+	/* Close in the middle of the window */
+	TEST_OK(unqlite_kv_store(pDb,azKey[2],-1,"x",1));
+	sLeader.zKey = azKey[3];
+	sLeader.rc = -1;
+	pthread_create(&sThread,0,group_lead,&sLeader);
+	usleep(100000);
+	TEST_OK(unqlite_close(pDb));
+	pthread_join(sThread,0);
+	TEST_OK(sLeader.rc);
+	/* Nothing was lost */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	for( i = 0 ; i < 4 ; ++i ){
+		nByte = 0;
+		TEST_OK(unqlite_kv_fetch(pDb,azKey[i],-1,0,&nByte));
+		TEST_CHECK(nByte == 1);
+	}
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
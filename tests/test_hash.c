@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Linear hash engine tests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unqlite_test.h"
+
+#define HASH_RECORDS 20000
+
+/*
+ * A seeded database is readable after reopen and spreads keys sharing a long prefix.
+ */
+int test_hash_seed(void)
+{
+	const char *zPath = test_db_path("hash_seed");
+	char zKey[64],zData[32];
+	unqlite_int64 nData,iBucket,iPrev;
+	unqlite *pDb;
+	int i,nChange;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_HASH_SEED,0x5eed1234U));
+	for( i = 0 ; i < HASH_RECORDS ; ++i ){
+		sprintf(zKey,"collection_name_with_a_long_prefix_%d",i);
+		sprintf(zData,"%d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)));
+	}
+	/* The seed cannot change once records were stored */
+	TEST_CHECK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_HASH_SEED,7U) == UNQLITE_LOCKED);
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+	iPrev = 0;
+	nChange = 0;
+	for( i = 0 ; i < HASH_RECORDS ; ++i ){
+		sprintf(zKey,"collection_name_with_a_long_prefix_%d",i);
+		nData = sizeof(zData) - 1;
+		TEST_OK(unqlite_kv_fetch(pDb,zKey,-1,zData,&nData));
+		zData[nData] = 0;
+		TEST_CHECK(atoi(zData) == i);
+		iBucket = 0;
+		TEST_OK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_GET_BUCKET,zKey,(int)strlen(zKey),&iBucket));
+		TEST_CHECK(iBucket > 0);
+		if( iBucket != iPrev ){
+			nChange++;
+		}
+		iPrev = iBucket;
+	}
+	/* Consecutive keys land in different buckets */
+	TEST_CHECK(nChange > HASH_RECORDS / 2);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
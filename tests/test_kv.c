@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Key/value store tests.
+ */
+#include <string.h>
+
+#include "unqlite_test.h"
+
+static int kv_exists(unqlite *pDb,const char *zKey)
+{
+	unqlite_int64 nData = 0;
+	return unqlite_kv_fetch(pDb,zKey,-1,0,&nData) == UNQLITE_OK;
+}
+
+/*
+ * A batch stores all its records or none, and joins a write-transaction
+ * opened by the caller instead of committing it.
+ */
+int test_kv_store_batch(void)
+{
+	const char *zPath = test_db_path("kv_store_batch");
+	const void *apKey[3],*apData[3];
+	unqlite_int64 anData[3];
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	apKey[0] = "a"; apKey[1] = "b"; apKey[2] = "c";
+	apData[0] = "1"; apData[1] = "2"; apData[2] = "3";
+	anData[0] = anData[1] = anData[2] = 1;
+	/* Committed on its own */
+	TEST_OK(unqlite_kv_store_batch(pDb,3,apKey,0,apData,anData));
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_CHECK(kv_exists(pDb,"a") && kv_exists(pDb,"c"));
+	/* An empty key fails the whole batch */
+	apKey[0] = "d"; apKey[1] = ""; apKey[2] = "e";
+	TEST_CHECK(unqlite_kv_store_batch(pDb,3,apKey,0,apData,anData) == UNQLITE_EMPTY);
+	TEST_CHECK(!kv_exists(pDb,"d") && !kv_exists(pDb,"e"));
+	/* Join the caller's transaction */
+	TEST_OK(unqlite_begin(pDb));
+	TEST_OK(unqlite_kv_store(pDb,"f",-1,"6",1));
+	apKey[0] = "g"; apKey[1] = "h"; apKey[2] = "i";
+	TEST_OK(unqlite_kv_store_batch(pDb,3,apKey,0,apData,anData));
+	TEST_CHECK(kv_exists(pDb,"f") && kv_exists(pDb,"g"));
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_CHECK(!kv_exists(pDb,"f") && !kv_exists(pDb,"g") && !kv_exists(pDb,"i"));
+	TEST_CHECK(kv_exists(pDb,"a") && kv_exists(pDb,"b"));
+	/* An empty key does not touch the caller's transaction either */
+	TEST_OK(unqlite_kv_store(pDb,"j",-1,"7",1));
+	apKey[0] = "k"; apKey[1] = "";
+	TEST_CHECK(unqlite_kv_store_batch(pDb,2,apKey,0,apData,anData) == UNQLITE_EMPTY);
+	TEST_OK(unqlite_commit(pDb));
+	TEST_CHECK(kv_exists(pDb,"j") && !kv_exists(pDb,"k"));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * UNQLITE_CONFIG_BEGIN_NEW never joins a write-transaction already open,
+ * neither an explicit one nor the one started by a pending change.
+ */
+int test_kv_begin_new(void)
+{
+	const char *zPath = test_db_path("kv_begin_new");
+	unqlite *pDb;
+	int bOpen;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_BEGIN_NEW));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_IN_WRITE_TRANSACTION,&bOpen));
+	TEST_CHECK(bOpen != 0);
+	TEST_OK(unqlite_kv_store(pDb,"a",-1,"1",1));
+	TEST_CHECK(unqlite_config(pDb,UNQLITE_CONFIG_BEGIN_NEW) == UNQLITE_LOCKED);
+	TEST_OK(unqlite_commit(pDb));
+	TEST_OK(unqlite_kv_store(pDb,"b",-1,"2",1));
+	TEST_CHECK(unqlite_config(pDb,UNQLITE_CONFIG_BEGIN_NEW) == UNQLITE_LOCKED);
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_IN_WRITE_TRANSACTION,&bOpen));
+	TEST_CHECK(bOpen == 0);
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_BEGIN_NEW));
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_CHECK(kv_exists(pDb,"a") && !kv_exists(pDb,"b"));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	/* In-memory databases have no transaction to join */
+	TEST_OK(unqlite_open(&pDb,":mem:",UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_kv_store(pDb,"a",-1,"1",1));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_BEGIN_NEW));
+	TEST_OK(unqlite_close(pDb));
+	return 0;
+}
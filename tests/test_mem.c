@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * In-memory engine tests.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "unqlite_test.h"
+
+#define MEM_RECORDS 10000
+
+/*
+ * The skiplist engine iterates in key order and supports range seeks.
+ */
+int test_mem_skiplist(void)
+{
+	unqlite_kv_cursor *pCur;
+	char zKey[32],zPrev[32];
+	unqlite *pDb;
+	int i,n,nKey;
+	TEST_OK(unqlite_open(&pDb,":mem:",UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,"skiplist"));
+	/* Insert out of order, every even number */
+	for( i = 0 ; i < MEM_RECORDS ; ++i ){
+		sprintf(zKey,"%08d",((i * 7919) % MEM_RECORDS) * 2);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,"x",1));
+	}
+	/* Sorted forward scan */
+	TEST_OK(unqlite_kv_cursor_init(pDb,&pCur));
+	n = 0;
+	zPrev[0] = 0;
+	for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		nKey = (int)sizeof(zKey) - 1;
+		TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+		zKey[nKey] = 0;
+		TEST_CHECK(strcmp(zPrev,zKey) < 0);
+		strcpy(zPrev,zKey);
+		n++;
+	}
+	TEST_CHECK(n == MEM_RECORDS);
+	/* Range seeks between two keys */
+	TEST_OK(unqlite_kv_cursor_seek(pCur,"00000101",-1,UNQLITE_CURSOR_MATCH_GE));
+	nKey = (int)sizeof(zKey) - 1;
+	TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+	zKey[nKey] = 0;
+	TEST_CHECK(strcmp(zKey,"00000102") == 0);
+	TEST_OK(unqlite_kv_cursor_seek(pCur,"00000101",-1,UNQLITE_CURSOR_MATCH_LE));
+	nKey = (int)sizeof(zKey) - 1;
+	TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+	zKey[nKey] = 0;
+	TEST_CHECK(strcmp(zKey,"00000100") == 0);
+	/* Backward from there */
+	TEST_OK(unqlite_kv_cursor_prev_entry(pCur));
+	nKey = (int)sizeof(zKey) - 1;
+	TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+	zKey[nKey] = 0;
+	TEST_CHECK(strcmp(zKey,"00000098") == 0);
+	TEST_CHECK(unqlite_kv_cursor_seek(pCur,"00000101",-1,UNQLITE_CURSOR_MATCH_EXACT) == UNQLITE_NOTFOUND);
+	TEST_OK(unqlite_kv_cursor_release(pDb,pCur));
+	TEST_OK(unqlite_close(pDb));
+	return 0;
+}
+/*
+ * Records of the mem engine survive deletes, resizes and compaction.
+ */
+int test_mem_compact(void)
+{
+	static char zBig[6000];
+	char zKey[32],zData[64],zExpect[64];
+	unqlite_kv_cursor *pCur;
+	unqlite_int64 nData;
+	unqlite *pDb;
+	int i,n;
+	memset(zBig,'b',sizeof(zBig));
+	TEST_OK(unqlite_open(&pDb,":mem:",UNQLITE_OPEN_CREATE));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,"mem"));
+	for( i = 0 ; i < MEM_RECORDS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		if( i % 100 == 0 ){
+			/* Too large for a slab chunk */
+			TEST_OK(unqlite_kv_store(pDb,zKey,-1,zBig,(unqlite_int64)sizeof(zBig)));
+		}else{
+			sprintf(zData,"%d",i);
+			TEST_OK(unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)));
+		}
+	}
+	for( i = 0 ; i < MEM_RECORDS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		if( i % 3 != 0 ){
+			TEST_OK(unqlite_kv_delete(pDb,zKey,-1));
+		}else if( i % 100 != 0 ){
+			/* Move to a larger size class */
+			TEST_OK(unqlite_kv_append(pDb,zKey,-1,"-appended-to-grow-the-record",28));
+		}
+	}
+	TEST_OK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_COMPACT));
+	/* Check the survivors */
+	for( i = 0 ; i < MEM_RECORDS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		nData = sizeof(zData) - 1;
+		if( i % 3 != 0 ){
+			TEST_CHECK(unqlite_kv_fetch(pDb,zKey,-1,zData,&nData) == UNQLITE_NOTFOUND);
+		}else if( i % 100 == 0 ){
+			TEST_OK(unqlite_kv_fetch(pDb,zKey,-1,0,&nData));
+			TEST_CHECK(nData == (unqlite_int64)sizeof(zBig));
+		}else{
+			TEST_OK(unqlite_kv_fetch(pDb,zKey,-1,zData,&nData));
+			zData[nData] = 0;
+			sprintf(zExpect,"%d-appended-to-grow-the-record",i);
+			TEST_CHECK(strcmp(zData,zExpect) == 0);
+		}
+	}
+	/* The compacted engine keeps working */
+	for( i = 0 ; i < MEM_RECORDS ; i += 3 ){
+		sprintf(zKey,"new-%d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,"y",1));
+	}
+	TEST_OK(unqlite_kv_cursor_init(pDb,&pCur));
+	n = 0;
+	for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		n++;
+	}
+	TEST_OK(unqlite_kv_cursor_release(pDb,pCur));
+	TEST_CHECK(n == 2 * ((MEM_RECORDS + 2) / 3));
+	TEST_OK(unqlite_close(pDb));
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Pager tests: page cache, statistics, write paths.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "unqlite_test.h"
+
+#define PAGER_RECORDS 60000
+
+static int pager_fill(unqlite *pDb,int nRec)
+{
+	char zKey[32],zData[64];
+	int i,rc;
+	for( i = 0 ; i < nRec ; ++i ){
+		sprintf(zKey,"key-%08d",i);
+		sprintf(zData,"data-%08d-%040d",i,i);
+		rc = unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData));
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return unqlite_commit(pDb);
+}
+
+static int pager_fetch(unqlite *pDb,int iRec)
+{
+	char zKey[32],zData[64];
+	unqlite_int64 nData = sizeof(zData);
+	sprintf(zKey,"key-%08d",iRec);
+	return unqlite_kv_fetch(pDb,zKey,-1,zData,&nData);
+}
+
+/*
+ * A full scan does not evict the pages of repeated point lookups.
+ */
+int test_pager_scan_resistance(void)
+{
+	const char *zPath = test_db_path("pager_scan_resistance");
+	unqlite_pager_stats sStats;
+	unqlite_kv_cursor *pCur;
+	unqlite *pDb;
+	int i,n,nPass;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	/* The hash engine keeps its pages referenced, use the B+Tree */
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,"btree"));
+	TEST_OK(pager_fill(pDb,PAGER_RECORDS));
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_MAX_PAGE_CACHE,256));
+	/* Working set */
+	for( nPass = 0 ; nPass < 3 ; ++nPass ){
+		for( i = 0 ; i < 50 ; ++i ){
+			TEST_OK(pager_fetch(pDb,i * 997));
+		}
+	}
+	/* Scan, touching many more pages than the cache holds */
+	n = 0;
+	TEST_OK(unqlite_kv_cursor_init(pDb,&pCur));
+	for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		n++;
+	}
+	TEST_OK(unqlite_kv_cursor_release(pDb,pCur));
+	TEST_CHECK(n == PAGER_RECORDS);
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,1));
+	TEST_CHECK(sStats.nCacheEvict > 0);
+	TEST_CHECK(sStats.nPage <= 256);
+	/* The working set is still cached */
+	for( i = 0 ; i < 50 ; ++i ){
+		TEST_OK(pager_fetch(pDb,i * 997));
+	}
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,0));
+	TEST_CHECK(sStats.nCacheMiss == 0);
+	TEST_CHECK(sStats.nCacheHit > 0);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * The pager counters follow reads, writes and syncs and can be reset.
+ */
+int test_pager_stats(void)
+{
+	const char *zPath = test_db_path("pager_stats");
+	unqlite_pager_stats sStats;
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(pager_fill(pDb,5000));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,1));
+	TEST_CHECK(sStats.nPageWrite > 0);
+	TEST_CHECK(sStats.nSync > 0);
+	TEST_CHECK(sStats.nCacheMax > 0);
+	/* Overwrite existing pages so that they are journaled */
+	TEST_OK(pager_fill(pDb,5000));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,1));
+	TEST_CHECK(sStats.nJournalByte > 0);
+	/* Counters were reset */
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,0));
+	TEST_CHECK(sStats.nPageWrite == 0 && sStats.nSync == 0 && sStats.nJournalByte == 0);
+	TEST_OK(unqlite_close(pDb));
+	/* Reading from a fresh handle */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+	TEST_OK(pager_fetch(pDb,42));
+	TEST_OK(pager_fetch(pDb,42));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,0));
+	TEST_CHECK(sStats.nPageRead > 0);
+	TEST_CHECK(sStats.nCacheMiss > 0);
+	TEST_CHECK(sStats.nCacheHit > 0);
+	TEST_CHECK(sStats.nPage > 0);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Read-write memory mapped database: data survives growth, rollback and reopen.
+ */
+int test_pager_mmap(void)
+{
+	const char *zPath = test_db_path("pager_mmap");
+	unqlite *pDb;
+	int i;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_MMAP));
+	TEST_OK(pager_fill(pDb,2000));
+	for( i = 0 ; i < 2000 ; ++i ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	/* Grow the file past the current mapping */
+	TEST_OK(pager_fill(pDb,PAGER_RECORDS));
+	/* Discarded changes are not visible through the mapping */
+	TEST_OK(unqlite_kv_delete(pDb,"key-00000001",-1));
+	TEST_OK(unqlite_kv_store(pDb,"key-99999999",-1,"x",1));
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_OK(pager_fetch(pDb,1));
+	TEST_CHECK(pager_fetch(pDb,99999999) == UNQLITE_NOTFOUND);
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_MMAP));
+	for( i = 0 ; i < PAGER_RECORDS ; i += 7 ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Handles opened with UNQLITE_OPEN_SHARED_CACHE serve each other clean pages
+ * and never see a page another handle modified without committing.
+ * A handle rolled back outside of a write transaction lets the others commit.
+ */
+int test_pager_shared_cache(void)
+{
+	const char *zPath = test_db_path("pager_shared_cache");
+	unqlite_pager_stats sStats;
+	unqlite *pDb,*pOther;
+	unqlite_int64 nData;
+	char zData[64];
+	int i,bOpen;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(pager_fill(pDb,5000));
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY|UNQLITE_OPEN_SHARED_CACHE));
+	TEST_OK(unqlite_open(&pOther,zPath,UNQLITE_OPEN_READONLY|UNQLITE_OPEN_SHARED_CACHE));
+	for( i = 0 ; i < 5000 ; i += 3 ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	TEST_OK(unqlite_config(pOther,UNQLITE_CONFIG_PAGER_STATS,&sStats,1));
+	for( i = 0 ; i < 5000 ; i += 3 ){
+		TEST_OK(pager_fetch(pOther,i));
+	}
+	TEST_OK(unqlite_config(pOther,UNQLITE_CONFIG_PAGER_STATS,&sStats,0));
+	TEST_CHECK(sStats.nSharedHit > 0);
+	TEST_CHECK(sStats.nPageRead < sStats.nSharedHit);
+	TEST_OK(unqlite_close(pOther));
+	TEST_OK(unqlite_close(pDb));
+	/* A writer gets its own copy of the pages it modifies */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_SHARED_CACHE));
+	TEST_OK(unqlite_open(&pOther,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_SHARED_CACHE));
+	TEST_OK(pager_fetch(pOther,7));
+	TEST_OK(pager_fetch(pDb,7));
+	TEST_OK(unqlite_kv_store(pDb,"key-00000007",-1,"changed",7));
+	TEST_OK(unqlite_rollback(pDb));
+	nData = sizeof(zData);
+	TEST_OK(unqlite_kv_fetch(pOther,"key-00000007",-1,zData,&nData));
+	TEST_CHECK(nData > 7 && memcmp(zData,"data-",5) == 0);
+	TEST_OK(unqlite_close(pOther));
+	TEST_OK(unqlite_close(pDb));
+	/* Each handle keeps its own transaction, a reader rolls back to let the writer commit */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_SHARED_CACHE));
+	TEST_OK(unqlite_open(&pOther,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_SHARED_CACHE));
+	TEST_OK(pager_fetch(pOther,7));
+	TEST_OK(unqlite_kv_store(pDb,"pending",-1,"kept",4));
+	TEST_CHECK(unqlite_kv_store(pOther,"other",-1,"lost",4) == UNQLITE_BUSY);
+	TEST_OK(unqlite_config(pOther,UNQLITE_CONFIG_IN_WRITE_TRANSACTION,&bOpen));
+	TEST_CHECK(bOpen == 0);
+	TEST_OK(unqlite_rollback(pOther));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_IN_WRITE_TRANSACTION,&bOpen));
+	TEST_CHECK(bOpen != 0);
+	TEST_OK(unqlite_commit(pDb));
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_IN_WRITE_TRANSACTION,&bOpen));
+	TEST_CHECK(bOpen == 0);
+	nData = sizeof(zData);
+	TEST_OK(unqlite_kv_fetch(pOther,"pending",-1,zData,&nData));
+	TEST_CHECK(nData == 4 && memcmp(zData,"kept",4) == 0);
+	nData = sizeof(zData);
+	TEST_CHECK(unqlite_kv_fetch(pOther,"other",-1,zData,&nData) == UNQLITE_NOTFOUND);
+	TEST_OK(unqlite_close(pOther));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Dirty pages written ahead of the commit are still rolled back, and a
+ * write-back step checkpoints the write-ahead log between transactions.
+ */
+int test_pager_write_back(void)
+{
+	const char *zPath = test_db_path("pager_write_back");
+	char zKey[32];
+	unqlite *pDb;
+	int i,nPage;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	TEST_OK(pager_fill(pDb,1000));
+	for( i = 1000 ; i < 20000 ; ++i ){
+		sprintf(zKey,"key-%08d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,"x",1));
+	}
+	nPage = 0;
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_WRITE_BACK,1,&nPage));
+	TEST_CHECK(nPage > 0);
+	/* Below the threshold, nothing is written */
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_WRITE_BACK,1 << 30,&nPage));
+	TEST_CHECK(nPage == 0);
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_CHECK(pager_fetch(pDb,1500) == UNQLITE_NOTFOUND);
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+	for( i = 0 ; i < 1000 ; ++i ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	TEST_CHECK(pager_fetch(pDb,1500) == UNQLITE_NOTFOUND);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	/* Write-ahead log */
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_WAL));
+	TEST_OK(pager_fill(pDb,5000));
+	nPage = 0;
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_WRITE_BACK,1,&nPage));
+	TEST_CHECK(nPage > 0);
+	for( i = 0 ; i < 5000 ; i += 11 ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_WAL));
+	for( i = 0 ; i < 5000 ; i += 11 ){
+		TEST_OK(pager_fetch(pDb,i));
+	}
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Check that every iStep-th record holds its original value, or the value
+ * written by pager_overwrite() if bNew is true.
+ */
+static int pager_check(unqlite *pDb,int iStep,int bNew)
+{
+	char zKey[32],zData[64],zExpect[64];
+	unqlite_int64 nData;
+	int i,rc;
+	for( i = 0 ; i < PAGER_RECORDS ; i += iStep ){
+		sprintf(zKey,"key-%08d",i);
+		if( bNew ){
+			sprintf(zExpect,"new-%08d",i);
+		}else{
+			sprintf(zExpect,"data-%08d-%040d",i,i);
+		}
+		nData = sizeof(zData);
+		rc = unqlite_kv_fetch(pDb,zKey,-1,zData,&nData);
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+		if( nData != (unqlite_int64)strlen(zExpect) || memcmp(zData,zExpect,(size_t)nData) != 0 ){
+			return UNQLITE_CORRUPT;
+		}
+	}
+	return UNQLITE_OK;
+}
+
+static int pager_overwrite(unqlite *pDb)
+{
+	char zKey[32],zData[64];
+	int i,rc;
+	for( i = 0 ; i < PAGER_RECORDS ; ++i ){
+		sprintf(zKey,"key-%08d",i);
+		sprintf(zData,"new-%08d",i);
+		rc = unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData));
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+
+/*
+ * Runs of consecutive dirty pages and their batched journal records round-trip:
+ * a large overwrite reads back after commit, and is fully undone by a rollback
+ * or by the recovery of a hot journal after a crash, even once dirty pages
+ * reached the database file.
+ */
+int test_pager_vectored_write(void)
+{
+	static const char *azEngine[] = { "hash", "btree" };
+	const char *zPath = test_db_path("pager_vectored_write");
+	unqlite_pager_stats sStats;
+	char zJournal[300];
+	struct stat sSt;
+	unqlite *pDb;
+	pid_t pid;
+	int e,status;
+	snprintf(zJournal,sizeof(zJournal),"%s_unqlite_journal",zPath);
+	for( e = 0 ; e < 2 ; ++e ){
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+		TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,azEngine[e]));
+		TEST_OK(pager_fill(pDb,PAGER_RECORDS));
+		TEST_OK(unqlite_close(pDb));
+		/* Overwrite every record, then discard the changes */
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+		TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,1));
+		TEST_OK(pager_overwrite(pDb));
+		TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_PAGER_STATS,&sStats,0));
+		if( e == 0 ){
+			/* The hash engine releases its dirty pages, they are flushed before the commit.
+			 * The B+Tree keeps them referenced until then.
+			 */
+			TEST_CHECK(sStats.nHotFlush > 0);
+		}
+		TEST_OK(unqlite_rollback(pDb));
+		TEST_OK(pager_check(pDb,13,0));
+		TEST_OK(unqlite_close(pDb));
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+		TEST_OK(pager_check(pDb,1,0));
+		TEST_OK(unqlite_close(pDb));
+		/* Crash in the middle of the overwrite, leaving a hot journal */
+		pid = fork();
+		TEST_CHECK(pid >= 0);
+		if( pid == 0 ){
+			if( unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE) != UNQLITE_OK || pager_overwrite(pDb) != UNQLITE_OK ){
+				_exit(1);
+			}
+			_exit(0);
+		}
+		TEST_CHECK(waitpid(pid,&status,0) == pid);
+		TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		TEST_CHECK(stat(zJournal,&sSt) == 0 && sSt.st_size > 0);
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+		TEST_OK(pager_check(pDb,1,0));
+		/* Overwrite again and keep the changes */
+		TEST_OK(pager_overwrite(pDb));
+		TEST_OK(unqlite_close(pDb));
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+		TEST_OK(pager_check(pDb,1,1));
+		TEST_OK(unqlite_close(pDb));
+		test_db_remove(zPath);
+	}
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Snapshot (consistent read) tests.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "unqlite_test.h"
+
+#define SNAPSHOT_KEYS 3000
+
+/* Reverse byte order, so that the B+Tree sorts keys in descending order */
+static int snapshot_reverse_cmp(const void *pA,const void *pB,unsigned int nByte)
+{
+	return -memcmp(pA,pB,nByte);
+}
+
+static unsigned int snapshot_fnv_hash(const void *pKey,unsigned int nByte)
+{
+	const unsigned char *z = (const unsigned char *)pKey;
+	unsigned int h = 2166136261U;
+	while( nByte-- > 0 ){
+		h = (h ^ *z++) * 16777619U;
+	}
+	return h;
+}
+
+/*
+ * A snapshot cursor keeps seeing the database as it was when the
+ * snapshot was opened while writers commit.
+ */
+int test_snapshot_cursor(void)
+{
+	const char *zPath = test_db_path("snapshot_cursor");
+	char zKey[32],zData[64],zExpect[64];
+	unqlite_snapshot *pSnap;
+	unqlite_kv_cursor *pCur;
+	unqlite_int64 nData;
+	unqlite *pDb;
+	int i,n,nKey;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+	for( i = 0 ; i < SNAPSHOT_KEYS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		sprintf(zData,"old-%d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)));
+	}
+	TEST_OK(unqlite_commit(pDb));
+	TEST_OK(unqlite_snapshot_open(pDb,&pSnap));
+	TEST_OK(unqlite_snapshot_cursor_init(pSnap,&pCur));
+	/* Rewrite, delete and add records */
+	for( i = 0 ; i < SNAPSHOT_KEYS ; ++i ){
+		sprintf(zKey,"key-%d",i);
+		if( i % 3 == 0 ){
+			TEST_OK(unqlite_kv_delete(pDb,zKey,-1));
+		}else{
+			sprintf(zData,"new-%d-with-a-longer-value",i);
+			TEST_OK(unqlite_kv_store(pDb,zKey,-1,zData,(unqlite_int64)strlen(zData)));
+		}
+		sprintf(zKey,"extra-%d",i);
+		TEST_OK(unqlite_kv_store(pDb,zKey,-1,"x",1));
+	}
+	TEST_OK(unqlite_commit(pDb));
+	/* The snapshot is unchanged */
+	n = 0;
+	for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+		nKey = (int)sizeof(zKey) - 1;
+		TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+		zKey[nKey] = 0;
+		nData = sizeof(zData) - 1;
+		TEST_OK(unqlite_kv_cursor_data(pCur,zData,&nData));
+		zData[nData] = 0;
+		TEST_CHECK(strncmp(zKey,"key-",4) == 0);
+		sprintf(zExpect,"old-%s",&zKey[4]);
+		TEST_CHECK(strcmp(zData,zExpect) == 0);
+		n++;
+	}
+	TEST_CHECK(n == SNAPSHOT_KEYS);
+	TEST_OK(unqlite_snapshot_cursor_release(pSnap,pCur));
+	TEST_OK(unqlite_snapshot_release(pDb,pSnap));
+	/* The handle sees the new state */
+	nData = sizeof(zData) - 1;
+	TEST_CHECK(unqlite_kv_fetch(pDb,"key-0",-1,zData,&nData) == UNQLITE_NOTFOUND);
+	nData = sizeof(zData) - 1;
+	TEST_OK(unqlite_kv_fetch(pDb,"extra-0",-1,zData,&nData));
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+/*
+ * Snapshots use the hash and comparison functions installed on the engine.
+ */
+int test_snapshot_callbacks(void)
+{
+	static const char *azEngine[] = { "hash", "btree" };
+	const char *zPath = test_db_path("snapshot_callbacks");
+	char zKey[32],zPrev[32];
+	unqlite_snapshot *pSnap;
+	unqlite_kv_cursor *pCur;
+	unqlite *pDb;
+	int e,i,n,nKey;
+	for( e = 0 ; e < 2 ; ++e ){
+		TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE));
+		TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_KV_ENGINE,azEngine[e]));
+		if( e == 0 ){
+			TEST_OK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_HASH_FUNC,snapshot_fnv_hash));
+		}else{
+			TEST_OK(unqlite_kv_config(pDb,UNQLITE_KV_CONFIG_CMP_FUNC,snapshot_reverse_cmp));
+		}
+		for( i = 0 ; i < SNAPSHOT_KEYS ; ++i ){
+			sprintf(zKey,"key-%05d",i);
+			TEST_OK(unqlite_kv_store(pDb,zKey,-1,"x",1));
+		}
+		TEST_OK(unqlite_commit(pDb));
+		TEST_OK(unqlite_snapshot_open(pDb,&pSnap));
+		TEST_OK(unqlite_snapshot_cursor_init(pSnap,&pCur));
+		for( i = 0 ; i < SNAPSHOT_KEYS ; i += 7 ){
+			sprintf(zKey,"key-%05d",i);
+			TEST_OK(unqlite_kv_cursor_seek(pCur,zKey,-1,UNQLITE_CURSOR_MATCH_EXACT));
+		}
+		if( e == 1 ){
+			/* Descending order */
+			n = 0;
+			zPrev[0] = 0;
+			for( unqlite_kv_cursor_first_entry(pCur) ; unqlite_kv_cursor_valid_entry(pCur) ; unqlite_kv_cursor_next_entry(pCur) ){
+				nKey = (int)sizeof(zKey) - 1;
+				TEST_OK(unqlite_kv_cursor_key(pCur,zKey,&nKey));
+				zKey[nKey] = 0;
+				TEST_CHECK(n == 0 || strcmp(zPrev,zKey) > 0);
+				strcpy(zPrev,zKey);
+				n++;
+			}
+			TEST_CHECK(n == SNAPSHOT_KEYS);
+		}
+		TEST_OK(unqlite_snapshot_cursor_release(pSnap,pCur));
+		TEST_OK(unqlite_snapshot_release(pDb,pSnap));
+		TEST_OK(unqlite_close(pDb));
+		test_db_remove(zPath);
+	}
+	return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Write-ahead log tests.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "unqlite_test.h"
+
+static int wal_store(unqlite *pDb,int iFirst,int nRec)
+{
+	char zKey[32];
+	int i,rc;
+	for( i = iFirst ; i < iFirst + nRec ; ++i ){
+		sprintf(zKey,"key-%06d",i);
+		rc = unqlite_kv_store(pDb,zKey,-1,zKey,(unqlite_int64)strlen(zKey));
+		if( rc != UNQLITE_OK ){
+			return rc;
+		}
+	}
+	return UNQLITE_OK;
+}
+
+static int wal_count(unqlite *pDb,int iFirst,int nRec)
+{
+	unqlite_int64 nData;
+	char zKey[32];
+	int i,n = 0;
+	for( i = iFirst ; i < iFirst + nRec ; ++i ){
+		sprintf(zKey,"key-%06d",i);
+		nData = 0;
+		if( unqlite_kv_fetch(pDb,zKey,-1,0,&nData) == UNQLITE_OK ){
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * A process that dies after committing to the log loses nothing, and its
+ * uncommitted frames are ignored. A checkpoint moves the log content to
+ * the database file.
+ */
+int test_wal_recovery(void)
+{
+	const char *zPath = test_db_path("wal_recovery");
+	char zWal[300];
+	struct stat sSt;
+	unqlite *pDb;
+	pid_t pid;
+	int status;
+	snprintf(zWal,sizeof(zWal),"%s%s",zPath,UNQLITE_WAL_FILE_SUFFIX);
+	pid = fork();
+	TEST_CHECK(pid >= 0);
+	if( pid == 0 ){
+		/* Crash without closing the database */
+		if( unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_WAL) != UNQLITE_OK ){
+			_exit(1);
+		}
+		unqlite_config(pDb,UNQLITE_CONFIG_WAL_AUTOCHECKPOINT,0);
+		if( wal_store(pDb,0,2000) != UNQLITE_OK || unqlite_commit(pDb) != UNQLITE_OK ){
+			_exit(1);
+		}
+		if( wal_store(pDb,2000,2000) != UNQLITE_OK ){
+			_exit(1);
+		}
+		_exit(0);
+	}
+	TEST_CHECK(waitpid(pid,&status,0) == pid);
+	TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	/* The committed transaction lives in the log only */
+	TEST_CHECK(stat(zWal,&sSt) == 0 && sSt.st_size > 0);
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_WAL));
+	TEST_CHECK(wal_count(pDb,0,2000) == 2000);
+	TEST_CHECK(wal_count(pDb,2000,2000) == 0);
+	/* Transfer the log to the database file */
+	TEST_OK(unqlite_config(pDb,UNQLITE_CONFIG_WAL_CHECKPOINT));
+	TEST_OK(unqlite_close(pDb));
+	/* Readable without the log */
+	unlink(zWal);
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_READONLY));
+	TEST_CHECK(wal_count(pDb,0,2000) == 2000);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
+
+/*
+ * A rolled back transaction never reaches the log.
+ */
+int test_wal_rollback(void)
+{
+	const char *zPath = test_db_path("wal_rollback");
+	unqlite *pDb;
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_WAL));
+	TEST_OK(wal_store(pDb,0,500));
+	TEST_OK(unqlite_commit(pDb));
+	TEST_OK(wal_store(pDb,500,500));
+	TEST_OK(unqlite_rollback(pDb));
+	TEST_CHECK(wal_count(pDb,0,1000) == 500);
+	TEST_OK(unqlite_close(pDb));
+	TEST_OK(unqlite_open(&pDb,zPath,UNQLITE_OPEN_CREATE|UNQLITE_OPEN_WAL));
+	TEST_CHECK(wal_count(pDb,0,1000) == 500);
+	TEST_OK(unqlite_close(pDb));
+	test_db_remove(zPath);
+	return 0;
+}
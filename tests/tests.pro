@@ -0,0 +1,29 @@
+TARGET = unqlite_tests
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../UnQLite
+
+SOURCES += \
+    ../UnQLite/unqlite.c \
+    main.c \
+    test_kv.c \
+    test_btree.c \
+    test_wal.c \
+    test_group_commit.c \
+    test_pager.c \
+    test_hash.c \
+    test_concurrency.c \
+    test_snapshot.c \
+    test_mem.c \
+    test_collection.c
+
+HEADERS += \
+    ../UnQLite/unqlite.h \
+    unqlite_test.h
+
+DEFINES += UNQLITE_ENABLE_THREADS
+
+unix: LIBS += -lpthread
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013, galaxyworld.org
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UNQLITE_TEST_H
+#define UNQLITE_TEST_H
+
+#include "unqlite.h"
+
+/*
+ * Fail the running test if a condition does not hold.
+ */
+#define TEST_CHECK(COND) do{ \
+	if( !(COND) ){ \
+		test_fail(__FILE__,__LINE__,#COND); \
+		return 1; \
+	} \
+}while(0)
+/*
+ * Fail the running test if an UnQLite call does not return UNQLITE_OK.
+ */
+#define TEST_OK(CALL) TEST_CHECK((CALL) == UNQLITE_OK)
+
+void test_fail(const char *zFile,int iLine,const char *zExpr);
+const char * test_db_path(const char *zName);
+void test_db_remove(const char *zPath);
+int test_jx9_exec(unqlite *pDb,const char *zScript,const char *zVar,unqlite_int64 *pValue);
+
+/* Test cases */
+int test_kv_store_batch(void);
+int test_kv_begin_new(void);
+int test_btree_order(void);
+int test_btree_cursor_stability(void);
+int test_wal_recovery(void);
+int test_wal_rollback(void);
+int test_group_commit(void);
+int test_group_commit_rollback(void);
+int test_pager_scan_resistance(void);
+int test_pager_stats(void);
+int test_pager_mmap(void);
+int test_pager_shared_cache(void);
+int test_pager_write_back(void);
+int test_pager_vectored_write(void);
+int test_hash_seed(void);
+int test_concurrent_readers(void);
+int test_snapshot_cursor(void);
+int test_snapshot_callbacks(void);
+int test_mem_skiplist(void);
+int test_mem_compact(void);
+int test_concurrent_alloc(void);
+int test_collection_rollback(void);
+int test_collection_index(void);
+int test_collection_cache(void);
+
+#endif /* UNQLITE_TEST_H */